@@ -0,0 +1,180 @@
+// 异步访问日志: 调用线程每条记录的开销 (对比每条格式化后同步 write 的写法), 队列满时丢弃并计数而不阻塞,
+// 以及 HttpServer 打开访问日志前后的吞吐; 最后检查日志行数与请求数一致
+// 用法: ./access_log_bench [记录数=2000000] [请求数=20000]
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const std::string kLogPath = "/tmp/access_log_bench.log";
+const auto kClient = net::ip::make_address("10.1.2.3");
+
+class PingHandler : public common::RestApiHandlerBase {
+public:
+  PingHandler() {
+    router_.add(http::verb::get, "/api/videos/{id}", [this](common::RequestContext&) {
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    });
+  }
+};
+
+config::LogConfig logConfig(size_t ring_records) {
+  auto cfg = config::Config::getInstance().getLog();
+  cfg.access_log_path = kLogPath;
+  cfg.ring_records = ring_records;
+  return cfg;
+}
+
+size_t countLines() {
+  std::ifstream in(kLogPath);
+  size_t lines = 0;
+  for (std::string line; std::getline(in, line);) {
+    ++lines;
+  }
+  return lines;
+}
+
+// 同步写法: 每条格式化后加锁 write, 相当于在 io 线程上直接写文件
+double syncNsPerRecord(size_t records) {
+  auto path = kLogPath + ".sync";
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  std::mutex mutex;
+  auto start = Clock::now();
+  for (size_t i = 0; i < records; ++i) {
+    char line[256];
+    int n = std::snprintf(line, sizeof(line),
+                          "{\"time\":%lld,\"method\":\"GET\",\"route\":\"/api/videos/{id}\",\"status\":200,"
+                          "\"bytes\":%zu,\"latency_us\":%zu,\"client\":\"%s\"}\n",
+                          static_cast<long long>(std::chrono::system_clock::now().time_since_epoch().count()),
+                          i, i % 1000, "10.1.2.3");
+    std::lock_guard<std::mutex> lock(mutex);
+    if (::write(fd, line, n) != n) {
+      break;
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / records;
+  ::close(fd);
+  ::unlink(path.c_str());
+  return ns;
+}
+
+// 异步写法: 每次写入不超过队列容量的一批并只计这部分时间, 批次之间等写线程取走 (单核机器上写线程和调用线程
+// 不能同时运行, 这样测到的是调用线程自己的开销)
+double asyncNsPerRecord(size_t records, size_t batch) {
+  auto& log = common::AccessLog::getInstance();
+  Clock::duration spent{};
+  for (size_t done = 0; done < records;) {
+    uint64_t before = log.written();
+    size_t n = std::min(batch, records - done);
+    auto start = Clock::now();
+    for (size_t i = 0; i < n; ++i) {
+      auto now = Clock::now();
+      log.access(http::verb::get, "/api/videos/{id}", 200, i, now - std::chrono::microseconds(i % 1000), now, kClient);
+    }
+    spent += Clock::now() - start;
+    done += n;
+    while (log.written() - before < n && log.dropped() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  return std::chrono::duration<double, std::nano>(spent).count() / records;
+}
+
+// 在 keep-alive 连接上顺序发送 requests 个请求, 返回每秒请求数
+double serve(size_t requests) {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, std::make_shared<PingHandler>(),
+                            cfg};
+  server.run();
+
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  socket.connect(server.localEndpoint());
+  beast::flat_buffer buffer;
+  http::request<http::empty_body> req{http::verb::get, "/api/videos/42", 11};
+  req.set(http::field::host, "127.0.0.1");
+  auto start = Clock::now();
+  for (size_t i = 0; i < requests; ++i) {
+    http::write(socket, req);
+    http::response<http::string_body> res;
+    http::read(socket, buffer, res);
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // 最后一个响应的 onWrite 可能还没执行
+  server.stop();
+  server.join();
+  return requests / seconds;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t records = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+  size_t requests = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+  auto& log = common::AccessLog::getInstance();
+  bool ok = true;
+
+  std::printf("sync snprintf + write:        %6.1f ns/record\n", syncNsPerRecord(records / 4));
+
+  // 每批不超过队列容量时不丢记录
+  log.open(logConfig(65536));
+  std::printf("async ring, producer side:    %6.1f ns/record\n", asyncNsPerRecord(records, 32768));
+  log.close();
+  std::printf("written %llu, dropped %llu, log lines %zu\n", static_cast<unsigned long long>(log.written()),
+              static_cast<unsigned long long>(log.dropped()), countLines());
+  ok &= log.dropped() == 0 && countLines() == log.written();
+  ::unlink(kLogPath.c_str());
+
+  // 小队列: 突发写入超过队列容量时丢弃, 调用线程不等待
+  uint64_t written_before = log.written();
+  uint64_t dropped_before = log.dropped();
+  log.open(logConfig(1024));
+  size_t burst = 200000;
+  double burst_ns = 0;
+  // 已注册的队列保持原容量, 在新线程上写才会用到 1024 条的队列
+  std::thread([&] { burst_ns = asyncNsPerRecord(burst, burst); }).join();
+  log.close();
+  uint64_t written = log.written() - written_before;
+  uint64_t dropped = log.dropped() - dropped_before;
+  std::printf("burst %zu into 1024-record ring: %.1f ns/record, written %llu, dropped %llu\n", burst, burst_ns,
+              static_cast<unsigned long long>(written), static_cast<unsigned long long>(dropped));
+  ok &= dropped > 0 && written + dropped == burst;
+  ::unlink(kLogPath.c_str());
+
+  // HttpServer: 关闭与打开访问日志
+  double off = serve(requests);
+  written_before = log.written();
+  log.open(logConfig(16384));
+  double on = serve(requests);
+  log.close();
+  size_t lines = countLines();
+  std::printf("http server: log off %.0f req/s, log on %.0f req/s (%+.1f%%), %zu log lines for %zu requests\n", off,
+              on, (on / off - 1) * 100, lines, requests);
+  ok &= lines == requests;
+  {
+    std::ifstream in(kLogPath);
+    std::string line;
+    std::getline(in, line);
+    std::printf("sample: %s\n", line.c_str());
+  }
+  ::unlink(kLogPath.c_str());
+
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// 准入控制: 线程池被慢接口压满时, 对比不限制、固定上限 (有/无保留名额) 和自适应上限下
+// 慢接口被接受请求的耗时、503 的耗时, 以及轻量接口 (token 校验) 是否仍然可用
+// 用法: ./admission_check [每轮秒数=2] [并发连接数=32] [慢接口耗时ms=20]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+class LoadHandler : public common::RestApiHandlerBase {
+public:
+  explicit LoadHandler(std::chrono::milliseconds work) {
+    router_
+        .add(http::verb::get, "/slow",
+             [this, work](common::RequestContext&) {
+               std::this_thread::sleep_for(work); // 模拟同步的 mysql 查询
+               return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+                 json.beginObject().key("success").value(true).endObject();
+               });
+             }, true)
+        .add(http::verb::get, "/validate", [this](common::RequestContext&) {
+          return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+            json.beginObject().key("valid").value(true).endObject();
+          });
+        });
+  }
+};
+
+struct Samples {
+  std::mutex mutex;
+  std::vector<double> ok_us;
+  std::vector<double> rejected_us;
+
+  void add(bool ok, double us) {
+    std::lock_guard<std::mutex> lock(mutex);
+    (ok ? ok_us : rejected_us).push_back(us);
+  }
+};
+
+double percentile(std::vector<double>& v, double p) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, static_cast<size_t>(p * v.size()))];
+}
+
+// 在 deadline 之前循环请求 target, 每个请求记录耗时
+void load(unsigned short port, const char* target, Clock::time_point deadline, Samples& samples) {
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  socket.connect({net::ip::make_address("127.0.0.1"), port});
+  beast::flat_buffer buffer;
+  http::request<http::empty_body> req{http::verb::get, target, 11};
+  req.set(http::field::host, "127.0.0.1");
+
+  while (Clock::now() < deadline) {
+    auto start = Clock::now();
+    http::write(socket, req);
+    http::response<http::string_body> res;
+    http::read(socket, buffer, res);
+    double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    samples.add(res.result() == http::status::ok, us);
+  }
+}
+
+void run(const char* name, config::HttpServerConfig cfg, std::chrono::seconds duration, size_t connections,
+         std::chrono::milliseconds work) {
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0},
+                            std::make_shared<LoadHandler>(work), cfg};
+  server.run();
+  auto port = server.localEndpoint().port();
+  auto deadline = Clock::now() + duration;
+
+  Samples slow, light;
+  std::vector<std::jthread> clients;
+  for (size_t i = 0; i < connections; ++i) {
+    clients.emplace_back([&] { load(port, "/slow", deadline, slow); });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(100)); // 等线程池积压
+  load(port, "/validate", deadline, light);
+  clients.clear();
+
+  std::printf("%-18s /slow ok %5zu p50 %8.0f us p99 %8.0f us | 503 %6zu p50 %6.0f us | "
+              "/validate ok %6zu 503 %6zu p99 %6.0f us | limit %zu\n",
+              name, slow.ok_us.size(), percentile(slow.ok_us, 0.5), percentile(slow.ok_us, 0.99),
+              slow.rejected_us.size(), percentile(slow.rejected_us, 0.5),
+              light.ok_us.size(), light.rejected_us.size(), percentile(light.ok_us, 0.99),
+              server.admission().limit());
+
+  server.stop();
+  server.join();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::chrono::seconds duration{argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2};
+  size_t connections = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 32;
+  std::chrono::milliseconds work{argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20};
+
+  auto base = config::Config::getInstance().getHttpServer();
+  base.io_threads = 1;
+  base.pin_threads = false;
+  base.admission_adaptive = false;
+  base.admission_queue_timeout_ms = 0;
+
+  auto unlimited = base;
+  unlimited.admission_max_in_flight = 0;
+  run("unlimited", unlimited, duration, connections, work);
+
+  // 线程池每个线程同时只处理一个请求, 上限取线程数的 2 倍
+  auto fixed = base;
+  fixed.admission_max_in_flight = 2 * std::max(1u, std::thread::hardware_concurrency());
+  fixed.admission_reserved = 0;
+  run("fixed, no reserve", fixed, duration, connections, work);
+
+  fixed.admission_reserved = 8;
+  run("fixed + reserve", fixed, duration, connections, work);
+
+  auto adaptive = base;
+  adaptive.admission_max_in_flight = 64;
+  adaptive.admission_adaptive = true;
+  adaptive.admission_min_limit = 1;
+  adaptive.admission_reserved = 8;
+  run("adaptive + reserve", adaptive, duration, connections, work);
+  return 0;
+}
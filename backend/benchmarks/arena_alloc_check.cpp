@@ -0,0 +1,112 @@
+// 统计 HttpServer 稳定状态下每个请求在服务端线程上的全局堆分配次数
+// 用法: ./arena_alloc_check [请求数=20000]
+// /raw 直接在 arena 中构造响应, /writer 经 JsonWriter 写入 arena; /json 经过 nlohmann::json 构造与序列化, 作为对照
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <boost/asio/connect.hpp>
+#include "common/restful/http_server.hpp"
+
+namespace {
+
+std::atomic<size_t> g_allocations{0};
+thread_local bool t_uncounted = false; // 客户端线程的分配不计入
+
+} // namespace
+
+void* operator new(size_t size) {
+  if (!t_uncounted) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+class CheckHandler : public common::RestApiHandlerBase {
+public:
+  CheckHandler() {
+    router_
+        .add(http::verb::get, "/raw",
+             [](common::RequestContext& ctx) {
+               common::Allocator alloc(common::RequestArena::current());
+               common::Response res{std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc)};
+               res.result(http::status::ok);
+               res.set(http::field::content_type, "application/json");
+               res.body() = R"({"success":true,"path":")";
+               res.body() += ctx.path;
+               res.body() += "\"}";
+               res.prepare_payload();
+               return res;
+             })
+        .add(http::verb::get, "/writer",
+             [this](common::RequestContext& ctx) {
+               return writeJsonResponse(http::status::ok, [&ctx](common::JsonWriter& json) {
+                 json.beginObject().key("success").value(true).key("path").value(ctx.path).endObject();
+               });
+             })
+        .add(http::verb::get, "/json", [this](common::RequestContext& ctx) {
+          return createJsonResponse(http::status::ok, {{"success", true}, {"path", std::string(ctx.path)}});
+        });
+  }
+};
+
+// 顺序发送 keep-alive 请求, 返回服务端线程上的分配次数
+size_t run(tcp::socket& socket, beast::flat_buffer& buffer, const char* target, size_t count) {
+  http::request<http::empty_body> req{http::verb::get, target, 11};
+  req.set(http::field::host, "127.0.0.1");
+  http::response<http::string_body> res;
+
+  size_t before = g_allocations.load();
+  for (size_t i = 0; i < count; ++i) {
+    http::write(socket, req);
+    res = {};
+    http::read(socket, buffer, res);
+    if (res.result() != http::status::ok) {
+      std::fprintf(stderr, "unexpected status %u\n", res.result_int());
+      std::exit(1);
+    }
+  }
+  return g_allocations.load() - before;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  t_uncounted = true;
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+
+  for (bool per_thread : {false, true}) {
+    auto cfg = config::Config::getInstance().getHttpServer();
+    cfg.io_threads = 1;
+    cfg.reuse_port_per_thread = per_thread;
+    cfg.pin_threads = false;
+    common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0},
+                              std::make_shared<CheckHandler>(), cfg};
+    server.run();
+
+    net::io_context ioc;
+    tcp::socket socket{ioc};
+    socket.connect({net::ip::make_address("127.0.0.1"), server.localEndpoint().port()});
+    beast::flat_buffer buffer;
+
+    for (const char* target : {"/raw", "/writer", "/json"}) {
+      run(socket, buffer, target, 1000); // 预热: arena 扩容、asio 的 handler 内存复用
+      size_t allocations = run(socket, buffer, target, count);
+      std::printf("%-10s %-8s requests: %zu, server allocations/request: %.3f\n",
+                  per_thread ? "per-thread" : "shared", target, count,
+                  static_cast<double>(allocations) / count);
+    }
+
+    server.stop();
+    server.join();
+  }
+  return 0;
+}
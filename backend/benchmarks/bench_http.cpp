@@ -0,0 +1,726 @@
+// HTTP 压测客户端: 以固定速率 (开环) 向 user_service 的认证接口和 HLS 分片按比例混合发送请求, 按接口统计延迟,
+// 结果输出为 JSON, 便于对比两次运行。wrk_test 下的 wrk 脚本是闭环的, 服务端变慢时发送也随之变慢, 尾延迟被低估
+// - 每个连接按固定间隔排定发送时刻, 响应迟到时之后的请求立即补发, 延迟从排定时刻算起 (修正 coordinated omission,
+//   与 wrk2 相同); 同时记录从实际发送算起的服务时间作对比
+// - 延迟记在 HDR 直方图中: 每个 2 的幂区间 1024 个等宽子桶, 相对误差约 0.1%
+// - 验证码邮箱、注册的邮箱和用户名由运行 id、连接和序号生成, 每个请求都不同
+// - login 轮流使用预先注册的 --users 个账号 bench-user-<i>@bench.local (密码 --password);
+//   validate-token 的 token 由 --token 指定, 未指定时启动时登录第一个账号取得; hls 请求 --hls-playlist 中列出的分片
+// - https:// 的目标走 TLS (不校验证书); --reconnect 时每个请求新建连接 (请求带 Connection: close), 用来测握手吞吐,
+//   默认复用上一个连接的会话 (会话票据或服务端缓存), --no-resume 时每次完整握手; 新建连接的耗时 (TCP 连接 + TLS 握手)
+//   和恢复会话的次数单独统计
+// 用法: ./bench_http --api=http://127.0.0.1:51051 [--hls=http://127.0.0.1:8080] [--rate=1000] [--duration=30]
+//       [--warmup=5] [--connections=64] [--threads=4]
+//       [--mix=login:40,validate-token:40,validate-email:10,register:5,hls:5] [--users=1000] [--password=12345678]
+//       [--token=<jwt>] [--hls-playlist=/index.m3u8] [--reconnect] [--no-resume] [--json=result.json]
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <boost/beast/ssl.hpp>
+#include <nlohmann/json.hpp>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace net = boost::asio;
+using tcp = net::ip::tcp;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr std::chrono::seconds kTimeout{10}; // 连接、写请求和读响应各自的超时, 超时计为错误
+constexpr size_t kScratchBytes = 64 * 1024; // 读响应 body 的缓冲, 内容直接丢弃
+
+// HDR 直方图, 值为微秒: 小于 2048 时逐个计数, 之后每个 [2^k, 2^(k+1)) 区间分成 1024 个等宽子桶
+class Histogram {
+public:
+  static constexpr int kSubBits = 11;
+  static constexpr uint64_t kSubBuckets = uint64_t{1} << (kSubBits - 1);
+  static constexpr uint64_t kMaxValue = (uint64_t{1} << 40) - 1;
+
+  Histogram() : counts_(index(kMaxValue) + 1) {}
+
+  void record(uint64_t value) {
+    value = std::min(value, kMaxValue);
+    ++counts_[index(value)];
+    ++total_;
+    sum_ += value;
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const Histogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t total() const { return total_; }
+  uint64_t max() const { return max_; }
+  double mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0; }
+
+  // 第 q 百分位所在子桶的上界 (即 HdrHistogram 的 highestEquivalentValue), 不超过最大值
+  uint64_t percentile(double q) const {
+    if (total_ == 0) {
+      return 0;
+    }
+    auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q / 100 * static_cast<double>(total_))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+      seen += counts_[i];
+      if (seen >= rank) {
+        return std::min(upperBound(i), max_);
+      }
+    }
+    return max_;
+  }
+
+private:
+  static size_t index(uint64_t value) {
+    if (value < 2 * kSubBuckets) {
+      return static_cast<size_t>(value);
+    }
+    int shift = std::bit_width(value) - kSubBits;
+    return (static_cast<size_t>(shift) << (kSubBits - 1)) + static_cast<size_t>(value >> shift);
+  }
+
+  static uint64_t upperBound(size_t i) {
+    if (i < 2 * kSubBuckets) {
+      return i;
+    }
+    uint64_t shift = i / kSubBuckets - 1;
+    uint64_t sub = i - shift * kSubBuckets;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t total_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+};
+
+enum class Scenario : size_t { validate_email, register_user, login, validate_token, hls, count };
+constexpr size_t kScenarios = static_cast<size_t>(Scenario::count);
+constexpr std::array<std::string_view, kScenarios> kScenarioNames = {"validate-email", "register", "login",
+                                                                     "validate-token", "hls"};
+
+struct Stats {
+  Histogram latency; // 从排定的发送时刻算起
+  Histogram service; // 从实际发送算起
+  Histogram connect; // 请求前新建连接的耗时 (TCP 连接 + TLS 握手), 次数即新建的连接数
+  uint64_t resumed = 0; // 其中恢复了 TLS 会话的
+  std::array<uint64_t, 6> status{}; // 按状态码的百位计数, [0] 为连接、读写错误和超时
+  uint64_t bytes = 0; // 读到的响应字节数 (含响应头)
+
+  void merge(const Stats& other) {
+    latency.merge(other.latency);
+    service.merge(other.service);
+    connect.merge(other.connect);
+    resumed += other.resumed;
+    for (size_t i = 0; i < status.size(); ++i) {
+      status[i] += other.status[i];
+    }
+    bytes += other.bytes;
+  }
+};
+
+// http(s)://host:port, 路径部分忽略
+struct Target {
+  std::string host;
+  std::string port;
+  tcp::resolver::results_type endpoints;
+  bool tls = false;
+};
+
+struct Options {
+  Target api;
+  std::optional<Target> hls;
+  double rate = 1000;
+  double duration = 30;
+  double warmup = 5;
+  size_t connections = 64;
+  size_t threads = 4;
+  std::array<double, kScenarios> mix = {10, 5, 40, 40, 5};
+  size_t users = 1000;
+  std::string password = "12345678";
+  std::string token;
+  std::string hls_playlist = "/index.m3u8";
+  bool reconnect = false;
+  bool resume = true;
+  std::string json_path;
+};
+
+// 所有连接共享的只读数据
+struct Plan {
+  std::string run_id;
+  std::vector<double> cumulative; // 各场景累计权重, 按 kScenarios 顺序
+  std::vector<std::string> segments; // HLS 分片路径
+  Clock::time_point start; // 第一个请求的排定时刻
+  Clock::time_point record_from; // 预热结束, 之后排定的请求才计入统计
+  Clock::time_point end; // 之后不再排定新请求
+};
+
+Target parseTarget(std::string_view url) {
+  Target target;
+  if (url.starts_with("https://")) {
+    url.remove_prefix(8);
+    target.tls = true;
+  } else if (url.starts_with("http://")) {
+    url.remove_prefix(7);
+  }
+  url = url.substr(0, url.find('/'));
+  auto colon = url.rfind(':');
+  target.host = std::string(url.substr(0, colon));
+  target.port = colon == std::string_view::npos ? (target.tls ? "443" : "80") : std::string(url.substr(colon + 1));
+  net::io_context ioc;
+  target.endpoints = tcp::resolver(ioc).resolve(target.host, target.port);
+  return target;
+}
+
+std::optional<Scenario> scenarioByName(std::string_view name) {
+  for (size_t i = 0; i < kScenarios; ++i) {
+    if (kScenarioNames[i] == name) {
+      return static_cast<Scenario>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+// "login:40,validate-token:40", 未列出的场景权重为 0
+std::array<double, kScenarios> parseMix(std::string_view spec) {
+  std::array<double, kScenarios> mix{};
+  while (!spec.empty()) {
+    auto item = spec.substr(0, spec.find(','));
+    spec.remove_prefix(std::min(spec.size(), item.size() + 1));
+    auto colon = item.find(':');
+    auto scenario = scenarioByName(item.substr(0, colon));
+    if (!scenario || colon == std::string_view::npos) {
+      throw std::invalid_argument("bad --mix item: " + std::string(item));
+    }
+    mix[static_cast<size_t>(*scenario)] = std::strtod(std::string(item.substr(colon + 1)).c_str(), nullptr);
+  }
+  return mix;
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  bool has_api = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+    auto eq = arg.find('=');
+    auto key = arg.substr(0, eq);
+    std::string value(eq == std::string_view::npos ? std::string_view{} : arg.substr(eq + 1));
+    if (key == "--api") {
+      options.api = parseTarget(value);
+      has_api = true;
+    } else if (key == "--hls") {
+      options.hls = parseTarget(value);
+    } else if (key == "--rate") {
+      options.rate = std::strtod(value.c_str(), nullptr);
+    } else if (key == "--duration") {
+      options.duration = std::strtod(value.c_str(), nullptr);
+    } else if (key == "--warmup") {
+      options.warmup = std::strtod(value.c_str(), nullptr);
+    } else if (key == "--connections") {
+      options.connections = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if (key == "--threads") {
+      options.threads = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if (key == "--mix") {
+      options.mix = parseMix(value);
+    } else if (key == "--users") {
+      options.users = std::max<size_t>(1, std::strtoul(value.c_str(), nullptr, 10));
+    } else if (key == "--password") {
+      options.password = value;
+    } else if (key == "--token") {
+      options.token = value;
+    } else if (key == "--hls-playlist") {
+      options.hls_playlist = value;
+    } else if (key == "--reconnect") {
+      options.reconnect = true;
+    } else if (key == "--no-resume") {
+      options.resume = false;
+    } else if (key == "--json") {
+      options.json_path = value;
+    } else {
+      throw std::invalid_argument("unknown option: " + std::string(arg));
+    }
+  }
+  if (!has_api) {
+    throw std::invalid_argument("--api=http://host:port is required");
+  }
+  if (options.rate <= 0 || options.duration <= 0) {
+    throw std::invalid_argument("--rate and --duration must be positive");
+  }
+  options.threads = std::min(options.threads, options.connections);
+  return options;
+}
+
+std::string loginEmail(size_t user) {
+  return "bench-user-" + std::to_string(user) + "@bench.local";
+}
+
+// JSON 字符串字段; 生成的值都不含需要转义的字符
+std::string jsonBody(std::initializer_list<std::pair<std::string_view, std::string_view>> fields) {
+  std::string body = "{";
+  for (const auto& [key, value] : fields) {
+    if (body.size() > 1) {
+      body += ',';
+    }
+    body.append("\"").append(key).append("\":\"").append(value).append("\"");
+  }
+  body += '}';
+  return body;
+}
+
+http::request<http::string_body> makeRequest(Scenario scenario, const Options& options, const Plan& plan,
+                                             const std::string& unique, std::mt19937_64& rng) {
+  const auto& target = scenario == Scenario::hls ? *options.hls : options.api;
+  http::request<http::string_body> req;
+  req.version(11);
+  req.set(http::field::host, target.host + ":" + target.port);
+  req.keep_alive(!options.reconnect);
+  switch (scenario) {
+    case Scenario::validate_email:
+      req.target("/api/auth/register-validate-email");
+      req.body() = jsonBody({{"email", unique + "@bench.local"}});
+      break;
+    case Scenario::register_user:
+      // 验证码不对时服务端回复 400, 仍然经过查重、redis 校验等完整路径
+      req.target("/api/auth/register");
+      req.body() = jsonBody({{"email", unique + "@bench.local"}, {"verification_code", "00000000"},
+                             {"username", unique}, {"password", options.password}});
+      break;
+    case Scenario::login:
+      req.target("/api/auth/login-email-pwd");
+      req.body() = jsonBody({{"email", loginEmail(rng() % options.users)}, {"password", options.password}});
+      break;
+    case Scenario::validate_token:
+      req.target("/api/auth/validate-token");
+      req.set(http::field::authorization, "Bearer " + options.token);
+      break;
+    case Scenario::hls:
+      req.method(http::verb::get);
+      req.target(plan.segments[rng() % plan.segments.size()]);
+      return req;
+    case Scenario::count:
+      break;
+  }
+  req.method(http::verb::post);
+  req.set(http::field::content_type, "application/json");
+  req.prepare_payload();
+  return req;
+}
+
+net::ssl::context* g_tls_context = nullptr; // https 目标共用的客户端 TLS 配置, 在 main 中创建
+
+// 一个连接到某个目标的 keep-alive 流, 出错或对端不保持连接时关闭, 下一个请求重新连接
+struct Connection {
+  Connection() = default;
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+  ~Connection() {
+    if (session) {
+      SSL_SESSION_free(session);
+    }
+  }
+
+  bool open() const { return plain || tls; }
+  void close() {
+    plain.reset();
+    if (tls) {
+      // 不交换 close_notify 直接关闭; 标记为已关闭, 否则 OpenSSL 释放时把会话标为不可恢复
+      SSL_set_shutdown(tls->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+      tls.reset();
+    }
+  }
+
+  std::optional<beast::tcp_stream> plain;
+  std::optional<beast::ssl_stream<beast::tcp_stream>> tls;
+  SSL_SESSION* session = nullptr; // 上一个 TLS 连接的会话, 新连接用它恢复
+  beast::flat_buffer buffer;
+};
+
+struct Exchange {
+  unsigned status = 0; // 出错时为 0
+  uint64_t bytes = 0;
+  std::optional<Clock::duration> connect; // 这次请求前新建了连接
+  bool resumed = false;
+};
+
+// 写请求并读完响应, body 读到 scratch 中丢弃; 返回状态码, 出错时返回 0
+template <class Stream>
+net::awaitable<unsigned> roundTrip(Stream& stream, beast::flat_buffer& buffer, http::request<http::string_body>& req,
+                                   char* scratch, uint64_t& bytes, bool& keep_alive) {
+  beast::error_code ec;
+  beast::get_lowest_layer(stream).expires_after(kTimeout);
+  co_await http::async_write(stream, req, net::redirect_error(net::use_awaitable, ec));
+  http::response_parser<http::buffer_body> parser;
+  parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+  if (!ec) {
+    bytes += co_await http::async_read_header(stream, buffer, parser, net::redirect_error(net::use_awaitable, ec));
+  }
+  while (!ec && !parser.is_done()) {
+    parser.get().body().data = scratch;
+    parser.get().body().size = kScratchBytes;
+    bytes += co_await http::async_read(stream, buffer, parser, net::redirect_error(net::use_awaitable, ec));
+    if (ec == http::error::need_buffer) {
+      ec = {};
+    }
+  }
+  keep_alive = !ec && parser.keep_alive();
+  co_return ec ? 0 : parser.get().result_int();
+}
+
+net::awaitable<Exchange> exchange(Connection& conn, const Target& target, bool resume,
+                                  http::request<http::string_body>& req, char* scratch) {
+  Exchange result;
+  beast::error_code ec;
+  if (!conn.open()) {
+    auto start = Clock::now();
+    beast::tcp_stream stream(co_await net::this_coro::executor);
+    conn.buffer.clear();
+    stream.expires_after(kTimeout);
+    co_await stream.async_connect(target.endpoints, net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      co_return result;
+    }
+    stream.socket().set_option(tcp::no_delay(true), ec);
+    if (target.tls) {
+      auto& tls = conn.tls.emplace(std::move(stream), *g_tls_context);
+      SSL_set_tlsext_host_name(tls.native_handle(), target.host.c_str());
+      if (resume && conn.session) {
+        SSL_set_session(tls.native_handle(), conn.session);
+      }
+      co_await tls.async_handshake(net::ssl::stream_base::client, net::redirect_error(net::use_awaitable, ec));
+      if (ec) {
+        conn.close();
+        co_return result;
+      }
+      result.resumed = SSL_session_reused(tls.native_handle()) == 1;
+    } else {
+      conn.plain.emplace(std::move(stream));
+    }
+    result.connect = Clock::now() - start;
+  }
+
+  bool keep_alive = false;
+  if (conn.tls) {
+    result.status = co_await roundTrip(*conn.tls, conn.buffer, req, scratch, result.bytes, keep_alive);
+    // TLS 1.3 的票据在握手之后才到达, 读完响应后再取会话
+    if (result.status && resume) {
+      if (SSL_SESSION* session = SSL_get1_session(conn.tls->native_handle())) {
+        if (conn.session) {
+          SSL_SESSION_free(conn.session);
+        }
+        conn.session = session;
+      }
+    }
+  } else {
+    result.status = co_await roundTrip(*conn.plain, conn.buffer, req, scratch, result.bytes, keep_alive);
+  }
+  if (!keep_alive) {
+    conn.close();
+  }
+  co_return result;
+}
+
+// 第 id 个连接负责全局排定序列中的第 id、id + C、id + 2C... 个请求, C 为连接数
+net::awaitable<void> runConnection(size_t id, const Options& options, const Plan& plan,
+                                   std::array<Stats, kScenarios>& stats) {
+  std::array<Connection, 2> conns; // [0] api, [1] hls
+  std::mt19937_64 rng(0x9e3779b97f4a7c15ULL ^ id);
+  std::uniform_real_distribution<double> pick(0, plan.cumulative.back());
+  auto scratch = std::make_unique<char[]>(kScratchBytes);
+  net::steady_timer timer(co_await net::this_coro::executor);
+  for (uint64_t k = 0;; ++k) {
+    double offset = static_cast<double>(id + k * options.connections) / options.rate;
+    auto intended = plan.start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(offset));
+    if (intended >= plan.end) {
+      break;
+    }
+    if (intended > Clock::now()) {
+      timer.expires_at(intended);
+      co_await timer.async_wait(net::use_awaitable);
+    }
+
+    auto scenario = static_cast<Scenario>(
+      std::upper_bound(plan.cumulative.begin(), plan.cumulative.end(), pick(rng)) - plan.cumulative.begin());
+    scenario = std::min(scenario, static_cast<Scenario>(kScenarios - 1));
+    std::string unique = "bench-" + plan.run_id + "-" + std::to_string(id) + "-" + std::to_string(k);
+    auto req = makeRequest(scenario, options, plan, unique, rng);
+    bool hls = scenario == Scenario::hls;
+
+    auto sent = Clock::now();
+    auto result = co_await exchange(conns[hls], hls ? *options.hls : options.api, options.resume, req, scratch.get());
+    auto done = Clock::now();
+    if (intended < plan.record_from) {
+      continue;
+    }
+    auto& s = stats[static_cast<size_t>(scenario)];
+    s.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(done - intended).count());
+    s.service.record(std::chrono::duration_cast<std::chrono::microseconds>(done - sent).count());
+    if (result.connect) {
+      s.connect.record(std::chrono::duration_cast<std::chrono::microseconds>(*result.connect).count());
+      s.resumed += result.resumed;
+    }
+    ++s.status[std::min<size_t>(result.status / 100, s.status.size() - 1)];
+    s.bytes += result.bytes;
+  }
+}
+
+// 启动前的同步请求: 取 token、读取播放列表
+http::response<http::string_body> fetch(const Target& target, http::request<http::string_body> req) {
+  net::io_context ioc;
+  beast::tcp_stream stream(ioc);
+  stream.expires_after(kTimeout);
+  stream.connect(target.endpoints);
+  req.set(http::field::host, target.host + ":" + target.port);
+  req.prepare_payload();
+  beast::flat_buffer buffer;
+  http::response<http::string_body> res;
+  if (target.tls) {
+    beast::ssl_stream<beast::tcp_stream> tls(std::move(stream), *g_tls_context);
+    SSL_set_tlsext_host_name(tls.native_handle(), target.host.c_str());
+    tls.handshake(net::ssl::stream_base::client);
+    http::write(tls, req);
+    http::read(tls, buffer, res);
+  } else {
+    http::write(stream, req);
+    http::read(stream, buffer, res);
+  }
+  return res;
+}
+
+std::string obtainToken(const Options& options) {
+  http::request<http::string_body> req{http::verb::post, "/api/auth/login-email-pwd", 11};
+  req.set(http::field::content_type, "application/json");
+  req.body() = jsonBody({{"email", loginEmail(0)}, {"password", options.password}});
+  auto res = fetch(options.api, std::move(req));
+  auto json = nlohmann::json::parse(res.body(), nullptr, false);
+  if (res.result() != http::status::ok || !json.is_object() || !json.contains("token")) {
+    return {};
+  }
+  return json["token"].get<std::string>();
+}
+
+// 播放列表中不以 # 开头的行, 相对路径按播放列表所在目录补全
+std::vector<std::string> loadSegments(const Options& options) {
+  auto res = fetch(*options.hls, {http::verb::get, options.hls_playlist, 11});
+  std::vector<std::string> segments;
+  if (res.result() != http::status::ok) {
+    return segments;
+  }
+  auto dir = options.hls_playlist.substr(0, options.hls_playlist.rfind('/') + 1);
+  std::istringstream in(res.body());
+  for (std::string line; std::getline(in, line);) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (!line.empty() && line.front() != '#') {
+      segments.push_back(line.front() == '/' ? line : dir + line);
+    }
+  }
+  return segments;
+}
+
+nlohmann::ordered_json histogramJson(const Histogram& h) {
+  nlohmann::ordered_json json;
+  json["p50"] = h.percentile(50);
+  json["p90"] = h.percentile(90);
+  json["p99"] = h.percentile(99);
+  json["p99_9"] = h.percentile(99.9);
+  json["p99_99"] = h.percentile(99.99);
+  json["max"] = h.max();
+  json["mean"] = std::round(h.mean() * 10) / 10;
+  return json;
+}
+
+nlohmann::ordered_json statsJson(const Stats& s, double seconds) {
+  nlohmann::ordered_json json;
+  json["requests"] = s.latency.total();
+  json["throughput_rps"] = std::round(s.latency.total() / seconds * 10) / 10;
+  json["errors"] = s.status[0];
+  nlohmann::ordered_json status;
+  for (size_t i = 1; i < s.status.size(); ++i) {
+    if (s.status[i] > 0) {
+      status[std::to_string(i) + "xx"] = s.status[i];
+    }
+  }
+  json["status"] = status.is_null() ? nlohmann::ordered_json::object() : status;
+  json["bytes"] = s.bytes;
+  json["latency_us"] = histogramJson(s.latency);
+  json["service_time_us"] = histogramJson(s.service);
+  json["connections"] = {{"new", s.connect.total()}, {"tls_resumed", s.resumed},
+                         {"connect_us", histogramJson(s.connect)}};
+  return json;
+}
+
+void printRow(std::string_view name, const Stats& s, double seconds) {
+  const auto& h = s.latency;
+  std::printf("%-15s %9llu %10.1f %7llu %9llu %9llu %9llu %9llu %10llu\n", std::string(name).c_str(),
+              static_cast<unsigned long long>(h.total()), h.total() / seconds,
+              static_cast<unsigned long long>(s.status[0] + s.status[5]),
+              static_cast<unsigned long long>(h.percentile(50)), static_cast<unsigned long long>(h.percentile(90)),
+              static_cast<unsigned long long>(h.percentile(99)), static_cast<unsigned long long>(h.percentile(99.9)),
+              static_cast<unsigned long long>(h.max()));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  try {
+    options = parseOptions(argc, argv);
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 2;
+  }
+
+  // 压测用的服务端一般是自签名证书, 不校验
+  net::ssl::context tls_context(net::ssl::context::tls_client);
+  tls_context.set_verify_mode(net::ssl::verify_none);
+  g_tls_context = &tls_context;
+
+  Plan plan;
+  plan.run_id = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count());
+  try {
+    if (options.mix[static_cast<size_t>(Scenario::validate_token)] > 0 && options.token.empty()) {
+      options.token = obtainToken(options);
+      if (options.token.empty()) {
+        std::fprintf(stderr, "warning: login as %s failed, validate-token will get 401\n", loginEmail(0).c_str());
+        options.token = "invalid";
+      }
+    }
+    if (options.hls && options.mix[static_cast<size_t>(Scenario::hls)] > 0) {
+      plan.segments = loadSegments(options);
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "setup failed: %s\n", e.what());
+    return 1;
+  }
+  if (plan.segments.empty()) {
+    if (options.mix[static_cast<size_t>(Scenario::hls)] > 0) {
+      std::fprintf(stderr, "warning: no HLS segments (--hls / --hls-playlist), hls requests disabled\n");
+    }
+    options.mix[static_cast<size_t>(Scenario::hls)] = 0;
+  }
+  double weight = 0;
+  for (double w : options.mix) {
+    plan.cumulative.push_back(weight += std::max(w, 0.0));
+  }
+  if (weight <= 0) {
+    std::fprintf(stderr, "--mix has no enabled scenario\n");
+    return 2;
+  }
+
+  // 每个线程一个 io_context, 连接按编号轮流分配; 统计按线程分开, 结束后合并
+  std::vector<std::unique_ptr<net::io_context>> contexts;
+  std::vector<std::unique_ptr<std::array<Stats, kScenarios>>> stats;
+  for (size_t t = 0; t < options.threads; ++t) {
+    contexts.push_back(std::make_unique<net::io_context>(1));
+    stats.push_back(std::make_unique<std::array<Stats, kScenarios>>());
+  }
+  auto to_duration = [](double seconds) {
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+  };
+  plan.start = Clock::now() + std::chrono::milliseconds(100);
+  plan.record_from = plan.start + to_duration(options.warmup);
+  plan.end = plan.record_from + to_duration(options.duration);
+  for (size_t c = 0; c < options.connections; ++c) {
+    size_t t = c % options.threads;
+    net::co_spawn(*contexts[t], runConnection(c, options, plan, *stats[t]), net::detached);
+  }
+  std::vector<std::thread> threads;
+  for (auto& ioc : contexts) {
+    threads.emplace_back([&ioc] { ioc->run(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::array<Stats, kScenarios> merged;
+  Stats all;
+  for (auto& per_thread : stats) {
+    for (size_t i = 0; i < kScenarios; ++i) {
+      merged[i].merge((*per_thread)[i]);
+      all.merge((*per_thread)[i]);
+    }
+  }
+
+  // 服务端跟不上时排定的请求在 end 之后才陆续完成, 吞吐按预热结束到最后一个响应的时间计算
+  double seconds = std::max(options.duration, std::chrono::duration<double>(Clock::now() - plan.record_from).count());
+  std::printf("target %.0f req/s for %.0fs (+%.0fs warmup), %zu connections, %zu threads\n", options.rate,
+              options.duration, options.warmup, options.connections, options.threads);
+  std::printf("latency in us from the scheduled send time (coordinated omission corrected)\n");
+  std::printf("%-15s %9s %10s %7s %9s %9s %9s %9s %10s\n", "scenario", "requests", "req/s", "errors", "p50", "p90",
+              "p99", "p99.9", "max");
+  for (size_t i = 0; i < kScenarios; ++i) {
+    if (merged[i].latency.total() > 0) {
+      printRow(kScenarioNames[i], merged[i], seconds);
+    }
+  }
+  printRow("all", all, seconds);
+  if (all.connect.total() > 0) {
+    std::printf("new connections: %llu (%.1f/s, %llu resumed TLS sessions), connect+handshake p50 %llu us, p99 %llu us\n",
+                static_cast<unsigned long long>(all.connect.total()), all.connect.total() / seconds,
+                static_cast<unsigned long long>(all.resumed),
+                static_cast<unsigned long long>(all.connect.percentile(50)),
+                static_cast<unsigned long long>(all.connect.percentile(99)));
+  }
+
+  nlohmann::ordered_json result;
+  result["config"] = {
+    {"api", options.api.host + ":" + options.api.port},
+    {"hls", options.hls ? options.hls->host + ":" + options.hls->port : ""},
+    {"target_rps", options.rate},
+    {"duration_s", options.duration},
+    {"warmup_s", options.warmup},
+    {"connections", options.connections},
+    {"threads", options.threads},
+    {"reconnect", options.reconnect},
+    {"tls_resume", options.resume},
+  };
+  nlohmann::ordered_json mix;
+  for (size_t i = 0; i < kScenarios; ++i) {
+    mix[std::string(kScenarioNames[i])] = options.mix[i];
+  }
+  result["config"]["mix"] = mix;
+  result["run_id"] = plan.run_id;
+  result["elapsed_s"] = std::round(seconds * 1000) / 1000;
+  result["all"] = statsJson(all, seconds);
+  nlohmann::ordered_json scenarios = nlohmann::ordered_json::object();
+  for (size_t i = 0; i < kScenarios; ++i) {
+    if (merged[i].latency.total() > 0) {
+      scenarios[std::string(kScenarioNames[i])] = statsJson(merged[i], seconds);
+    }
+  }
+  result["scenarios"] = scenarios;
+
+  if (options.json_path == "-") {
+    std::cout << result.dump(2) << std::endl;
+  } else if (!options.json_path.empty()) {
+    std::ofstream(options.json_path) << result.dump(2) << '\n';
+  }
+  return all.latency.total() > 0 ? 0 : 1;
+}
@@ -0,0 +1,348 @@
+// 请求 body 的上限和流式读取: 流式上传大文件时服务端 RSS 不随 body 增长 (对比缓存整个 body 的路由),
+// Content-Length 超过上限时不读 body 直接 413 (带/不带 Expect: 100-continue), chunked 读到一半超限时 413,
+// 以及流式处理函数没读完 body 时响应后关闭连接, 客户端能收到完整响应; 流水线排满时, 流式上传读 body 期间前面的
+// 响应写完不会打乱请求队列
+// 用法: ./body_stream_check [上传 MiB=256]
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr uint64_t kMiB = 1024 * 1024;
+const std::string kUploadPath = "/tmp/body_stream_check.upload";
+
+class UploadHandler : public common::RestApiHandlerBase {
+public:
+  UploadHandler() {
+    router_
+        .addStream(http::verb::post, "/upload",
+                   [this](common::RequestContext&, common::BodyReader& body) -> net::awaitable<common::Response> {
+                     uint64_t saved = co_await common::saveBody(body, kUploadPath);
+                     co_return writeJsonResponse(http::status::ok, [saved](common::JsonWriter& json) {
+                       json.beginObject().key("bytes").value(saved).endObject();
+                     });
+                   }, 64 * 1024 * kMiB)
+        .addStream(http::verb::post, "/ignore",
+                   [this](common::RequestContext&, common::BodyReader&) -> net::awaitable<common::Response> {
+                     co_return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+                       json.beginObject().key("ignored").value(true).endObject();
+                     });
+                   })
+        .add(http::verb::post, "/buffered",
+             [this](common::RequestContext& ctx) {
+               size_t size = ctx.req.body().size();
+               return writeJsonResponse(http::status::ok, [size](common::JsonWriter& json) {
+                 json.beginObject().key("bytes").value(static_cast<uint64_t>(size)).endObject();
+               });
+             }, false, 64 * 1024 * kMiB)
+        .add(http::verb::get, "/large", [this](common::RequestContext&) {
+          // 足够填满 socket 发送缓冲区, 客户端不读时写出停住
+          return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+            json.beginObject().key("data").value(std::string(8 * kMiB, 'x')).endObject();
+          });
+        })
+        .add(http::verb::post, "/small", [this](common::RequestContext& ctx) {
+          size_t size = ctx.req.body().size();
+          return writeJsonResponse(http::status::ok, [size](common::JsonWriter& json) {
+            json.beginObject().key("bytes").value(static_cast<uint64_t>(size)).endObject();
+          });
+        });
+  }
+};
+
+size_t rssKiB() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("VmRSS:")) {
+      return std::strtoul(line.c_str() + 6, nullptr, 10);
+    }
+  }
+  return 0;
+}
+
+tcp::socket connect(net::io_context& ioc, unsigned short port) {
+  tcp::socket socket{ioc};
+  socket.connect({net::ip::make_address("127.0.0.1"), port});
+  return socket;
+}
+
+std::string header(const char* target, uint64_t length, bool expect = false, bool keep_alive = true) {
+  std::string h = std::string("POST ") + target + " HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: " +
+                  std::to_string(length) + "\r\n";
+  if (expect) {
+    h += "Expect: 100-continue\r\n";
+  }
+  if (!keep_alive) {
+    h += "Connection: close\r\n";
+  }
+  return h + "\r\n";
+}
+
+// 写 bytes 字节的 body, 对端关闭时提前返回; 返回实际写出的字节数
+uint64_t writeBody(tcp::socket& socket, uint64_t bytes) {
+  static const std::vector<char> chunk(64 * 1024, 'x');
+  uint64_t written = 0;
+  beast::error_code ec;
+  while (written < bytes && !ec) {
+    written += net::write(socket, net::buffer(chunk.data(), std::min<uint64_t>(chunk.size(), bytes - written)), ec);
+  }
+  return written;
+}
+
+struct Result {
+  unsigned status = 0;
+  std::string body;
+  bool keep_alive = false;
+};
+
+Result readResponse(tcp::socket& socket, beast::flat_buffer& buffer) {
+  http::response<http::string_body> res;
+  beast::error_code ec;
+  http::read(socket, buffer, res, ec);
+  if (ec) {
+    return {};
+  }
+  return {res.result_int(), res.body(), res.keep_alive()};
+}
+
+// 上传 bytes 字节到 target, 返回响应和服务端 RSS 的最大增量
+Result upload(unsigned short port, const char* target, uint64_t bytes, size_t& rss_peak_kib, double& seconds) {
+  net::io_context ioc;
+  auto socket = connect(ioc, port);
+  size_t rss_before = rssKiB();
+  rss_peak_kib = 0;
+  auto start = Clock::now();
+
+  bool done = false;
+  std::thread writer([&] {
+    auto h = header(target, bytes);
+    net::write(socket, net::buffer(h));
+    writeBody(socket, bytes);
+    done = true;
+  });
+  std::thread sampler([&] {
+    while (!done) {
+      rss_peak_kib = std::max(rss_peak_kib, rssKiB() - std::min(rssKiB(), rss_before));
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+  beast::flat_buffer buffer;
+  auto result = readResponse(socket, buffer);
+  seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  writer.join();
+  sampler.join();
+  rss_peak_kib = std::max(rss_peak_kib, rssKiB() - std::min(rssKiB(), rss_before));
+  return result;
+}
+
+bool check(const char* name, bool ok) {
+  std::printf("%-58s %s\n", name, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  uint64_t upload_mib = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256;
+
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.request_body_limit = kMiB;
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, std::make_shared<UploadHandler>(),
+                            cfg};
+  server.run();
+  auto port = server.localEndpoint().port();
+  bool ok = true;
+
+  // 流式上传与缓存整个 body 对比
+  size_t rss_kib = 0;
+  double seconds = 0;
+  auto streamed = upload(port, "/upload", upload_mib * kMiB, rss_kib, seconds);
+  std::printf("streamed upload %llu MiB: status %u %s, %.2f s (%.0f MiB/s), server RSS +%zu KiB\n",
+              static_cast<unsigned long long>(upload_mib), streamed.status, streamed.body.c_str(), seconds,
+              upload_mib / seconds, rss_kib);
+  ok &= check("streamed upload saved to file", streamed.status == 200 &&
+                                                   streamed.body.find(std::to_string(upload_mib * kMiB)) !=
+                                                       std::string::npos);
+  ok &= check("streamed upload RSS stays under 8 MiB", rss_kib < 8 * 1024);
+  ::unlink(kUploadPath.c_str());
+
+  uint64_t buffered_mib = std::min<uint64_t>(upload_mib, 64);
+  auto buffered = upload(port, "/buffered", buffered_mib * kMiB, rss_kib, seconds);
+  std::printf("buffered upload %llu MiB: status %u, %.2f s (%.0f MiB/s), server RSS +%zu KiB\n",
+              static_cast<unsigned long long>(buffered_mib), buffered.status, seconds, buffered_mib / seconds,
+              rss_kib);
+  ok &= check("buffered upload under its route limit", buffered.status == 200);
+
+  net::io_context ioc;
+  {
+    // Expect: 100-continue 且超过上限: 不等 body 直接 413, 客户端不用发送 body
+    auto socket = connect(ioc, port);
+    auto h = header("/small", 100 * kMiB, true);
+    net::write(socket, net::buffer(h));
+    beast::flat_buffer buffer;
+    auto start = Clock::now();
+    auto res = readResponse(socket, buffer);
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::printf("Content-Length 100 MiB with Expect: status %u in %.2f ms, keep-alive %d\n", res.status, ms,
+                res.keep_alive);
+    ok &= check("early 413 with Expect, connection closed", res.status == 413 && !res.keep_alive);
+  }
+  {
+    // 没有 Expect 时客户端直接发送 body: 413 后丢弃已发送的部分再关闭, 客户端不会被 RST 打断而收不到响应
+    auto socket = connect(ioc, port);
+    uint64_t bytes = 8 * kMiB;
+    uint64_t written = 0;
+    std::thread writer([&] {
+      auto h = header("/small", bytes);
+      net::write(socket, net::buffer(h));
+      written = writeBody(socket, bytes);
+    });
+    beast::flat_buffer buffer;
+    auto res = readResponse(socket, buffer);
+    writer.join();
+    std::printf("Content-Length 8 MiB without Expect: status %u, client wrote %llu bytes\n", res.status,
+                static_cast<unsigned long long>(written));
+    ok &= check("early 413 without Expect received by client", res.status == 413);
+  }
+  {
+    // chunked 编码没有 Content-Length, 读到超过上限时 413
+    auto socket = connect(ioc, port);
+    std::string h = "POST /small HTTP/1.1\r\nHost: 127.0.0.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    net::write(socket, net::buffer(h));
+    std::thread writer([&] {
+      std::string chunk = "10000\r\n" + std::string(0x10000, 'x') + "\r\n";
+      beast::error_code ec;
+      for (int i = 0; i < 64 && !ec; ++i) {
+        net::write(socket, net::buffer(chunk), ec);
+      }
+      net::write(socket, net::buffer(std::string("0\r\n\r\n")), ec);
+    });
+    beast::flat_buffer buffer;
+    auto res = readResponse(socket, buffer);
+    writer.join();
+    ok &= check("chunked body over limit gets 413", res.status == 413);
+  }
+  {
+    // 上限以内的缓存 body, 同一连接上继续下一个请求
+    auto socket = connect(ioc, port);
+    beast::flat_buffer buffer;
+    bool both = true;
+    for (int i = 0; i < 2; ++i) {
+      auto h = header("/small", 100 * 1024, true);
+      net::write(socket, net::buffer(h));
+      auto interim = readResponse(socket, buffer);
+      writeBody(socket, 100 * 1024);
+      auto res = readResponse(socket, buffer);
+      both &= interim.status == 100;
+      both &= res.status == 200 && res.body.find("102400") != std::string::npos;
+    }
+    ok &= check("buffered body under limit, keep-alive reused (with Expect)", both);
+  }
+  {
+    // 流式请求带 Expect: 第一次读取 body 时才回复 100, 之后上传 body
+    auto socket = connect(ioc, port);
+    auto h = header("/upload", 4 * kMiB, true);
+    net::write(socket, net::buffer(h));
+    beast::flat_buffer buffer;
+    http::response_parser<http::empty_body> interim;
+    beast::error_code ec;
+    http::read_header(socket, buffer, interim, ec);
+    bool got_continue = !ec && interim.get().result() == http::status::continue_;
+    writeBody(socket, 4 * kMiB);
+    auto res = readResponse(socket, buffer);
+    ok &= check("streamed upload with Expect gets 100 Continue then 200", got_continue && res.status == 200);
+    ::unlink(kUploadPath.c_str());
+  }
+  {
+    // 流式处理函数没有读 body 就返回: 响应后关闭连接
+    auto socket = connect(ioc, port);
+    uint64_t written = 0;
+    std::thread writer([&] {
+      auto h = header("/ignore", 900 * 1024); // 在默认上限以内
+      net::write(socket, net::buffer(h));
+      written = writeBody(socket, 900 * 1024);
+    });
+    beast::flat_buffer buffer;
+    auto res = readResponse(socket, buffer);
+    writer.join();
+    char byte;
+    beast::error_code ec;
+    socket.read_some(net::buffer(&byte, 1), ec);
+    std::printf("unread streamed body: status %u, keep-alive %d, then %s\n", res.status, res.keep_alive,
+                ec.message().c_str());
+    ok &= check("unread streamed body: response then close",
+                res.status == 200 && !res.keep_alive && (ec == net::error::eof || ec == net::error::connection_reset));
+  }
+  {
+    // 流水线排满: pipeline_depth - 1 个大响应的 GET 之后是流式上传。客户端先不读响应, 上传的处理函数等 body 时
+    // 队首的响应才写完, 回收的槽位不能换走仍在排队的请求; 之后同一连接上的请求照常处理
+    // 接收缓冲区调小 (在 connect 之前), 客户端不读时服务端的写出确实停住
+    tcp::socket socket{ioc};
+    socket.open(tcp::v4());
+    socket.set_option(net::socket_base::receive_buffer_size(64 * 1024));
+    socket.connect({net::ip::make_address("127.0.0.1"), port});
+    size_t gets = cfg.pipeline_depth - 1;
+    uint64_t bytes = 4 * kMiB;
+    std::thread writer([&] {
+      std::string requests;
+      for (size_t i = 0; i < gets; ++i) {
+        requests += "GET /large HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+      }
+      requests += header("/upload", bytes);
+      beast::error_code ec;
+      net::write(socket, net::buffer(requests), ec);
+      uint64_t half = writeBody(socket, bytes / 2);
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+      writeBody(socket, bytes - half);
+      net::write(socket, net::buffer(header("/small", 0)), ec);
+    });
+    // 服务端卡住时关闭 socket, 下面的读取随之失败
+    std::atomic<bool> finished{false};
+    std::thread watchdog([&] {
+      for (int i = 0; i < 1000 && !finished; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+      if (!finished) {
+        beast::error_code ec;
+        socket.shutdown(tcp::socket::shutdown_both, ec);
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    beast::flat_buffer buffer;
+    size_t large = 0;
+    for (size_t i = 0; i < gets; ++i) {
+      auto res = readResponse(socket, buffer);
+      large += res.status == 200 && res.body.size() > 8 * kMiB;
+    }
+    auto uploaded = readResponse(socket, buffer);
+    auto next = readResponse(socket, buffer);
+    finished = true;
+    writer.join();
+    watchdog.join();
+    std::printf("pipelined streaming upload: %zu/%zu large responses, upload status %u %s, next request %u\n", large,
+                gets, uploaded.status, uploaded.body.c_str(), next.status);
+    ok &= check("pipelined streaming upload behind a full queue",
+                large == gets && uploaded.status == 200 &&
+                  uploaded.body.find(std::to_string(bytes)) != std::string::npos && next.status == 200);
+    ::unlink(kUploadPath.c_str());
+  }
+
+  server.stop();
+  server.join();
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
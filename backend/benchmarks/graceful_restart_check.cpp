@@ -0,0 +1,290 @@
+// 优雅退出和热重启:
+// 0. stop: 返回并 join 之后监听 socket 已经关闭
+// 1. drain: 空闲的 keep-alive 连接立即关闭, 处理中的请求照常写完 (带 Connection: close), 之后不再接受新连接
+// 2. 热重启: 客户端持续请求时在同一进程中启动第二个 HttpServer 模拟新进程, 通过 Unix socket 接管监听 socket,
+//    旧的排空退出; 检查没有请求失败 (keep-alive 连接空闲时被关闭的按 HTTP 客户端的惯例换新连接重试一次), 以及最大延迟
+// 3. 交接目录其他用户可写时不启用交接, 不在其中创建 socket
+// 用法: ./graceful_restart_check [热重启前后的请求时长ms=1500]
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const std::string kHandoffDir = "/tmp/graceful_restart_handoff";
+const std::string kOpenHandoffDir = "/tmp/graceful_restart_handoff_open";
+
+class NamedHandler : public common::RestApiHandlerBase {
+public:
+  explicit NamedHandler(std::string name) : name_(std::move(name)) {
+    router_.add(http::verb::get, "/api/name", [this](common::RequestContext&) {
+      return writeJsonResponse(http::status::ok, [this](common::JsonWriter& json) {
+        json.beginObject().key("name").value(name_).endObject();
+      });
+    });
+    router_.add(http::verb::get, "/api/slow", [this](common::RequestContext&) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    }, true);
+  }
+
+private:
+  std::string name_;
+};
+
+config::HttpServerConfig serverConfig() {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.handoff_dir = kHandoffDir;
+  cfg.drain_timeout_seconds = 5;
+  return cfg;
+}
+
+// 端口为 0 时不交接, 先让系统分配一个空闲端口
+unsigned short freePort() {
+  net::io_context ioc;
+  tcp::acceptor acceptor{ioc, tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}};
+  return acceptor.local_endpoint().port();
+}
+
+struct Reply {
+  bool ok = false;
+  bool keep_alive = false;
+  std::string body;
+};
+
+Reply get(tcp::socket& socket, beast::flat_buffer& buffer, const char* target) {
+  Reply reply;
+  beast::error_code ec;
+  http::request<http::empty_body> req{http::verb::get, target, 11};
+  req.set(http::field::host, "127.0.0.1");
+  http::write(socket, req, ec);
+  if (ec) {
+    return reply;
+  }
+  http::response<http::string_body> res;
+  http::read(socket, buffer, res, ec);
+  if (ec) {
+    return reply;
+  }
+  reply.ok = res.result() == http::status::ok;
+  reply.keep_alive = res.keep_alive();
+  reply.body = res.body();
+  return reply;
+}
+
+bool readsEof(tcp::socket& socket, beast::flat_buffer& buffer) {
+  http::response<http::string_body> res;
+  beast::error_code ec;
+  http::read(socket, buffer, res, ec);
+  return ec == http::error::end_of_stream || ec == net::error::eof || ec == net::error::connection_reset;
+}
+
+// stop 之后 (io 线程已退出, HttpServer 仍然存在) 监听 socket 必须已经关闭: 关闭投递到 acceptor 的 strand 上,
+// 不能被随后的 ioc.stop 丢掉; 多个 SO_REUSEPORT 监听 socket, 重复多次
+bool stopCheck() {
+  constexpr int kRounds = 50;
+  int accepted = 0;
+  auto cfg = serverConfig();
+  cfg.io_threads = 4;
+  cfg.reuse_port_per_thread = true;
+  for (int i = 0; i < kRounds; ++i) {
+    common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0},
+                              std::make_shared<NamedHandler>("stop"), cfg};
+    server.run();
+    auto local = server.localEndpoint();
+    server.stop();
+    server.join();
+
+    net::io_context ioc;
+    tcp::socket late{ioc};
+    beast::error_code ec;
+    late.connect(local, ec);
+    accepted += !ec;
+  }
+  std::printf("stop: new connection accepted after stop in %d/%d rounds\n", accepted, kRounds);
+  return accepted == 0;
+}
+
+bool drainCheck() {
+  bool ok = true;
+  auto endpoint = tcp::endpoint{net::ip::make_address("127.0.0.1"), 0};
+  common::HttpServer server{endpoint, std::make_shared<NamedHandler>("drain"), serverConfig()};
+  server.run();
+  auto local = server.localEndpoint();
+
+  net::io_context ioc;
+  tcp::socket idle{ioc};
+  idle.connect(local);
+  beast::flat_buffer idle_buffer;
+  ok &= get(idle, idle_buffer, "/api/name").ok;
+
+  // 慢请求处理中开始排空
+  Reply slow;
+  std::thread busy([&] {
+    net::io_context client_ioc;
+    tcp::socket socket{client_ioc};
+    socket.connect(local);
+    beast::flat_buffer buffer;
+    slow = get(socket, buffer, "/api/slow");
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto start = Clock::now();
+  server.drain();
+
+  bool idle_closed = readsEof(idle, idle_buffer);
+  auto idle_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  busy.join();
+  server.join();
+  auto drained_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  tcp::socket late{ioc};
+  beast::error_code ec;
+  late.connect(local, ec);
+  bool refused = static_cast<bool>(ec);
+
+  std::printf("drain: idle keep-alive closed %s after %.1f ms, in-flight /slow %s (keep-alive %d), "
+              "stopped after %.1f ms, new connection %s\n", idle_closed ? "yes" : "no", idle_ms,
+              slow.ok ? "completed" : "FAILED", slow.keep_alive, drained_ms, refused ? "refused" : "ACCEPTED");
+  ok &= idle_closed && slow.ok && !slow.keep_alive && refused;
+  return ok;
+}
+
+bool restartCheck(std::chrono::milliseconds duration) {
+  auto endpoint = tcp::endpoint{net::ip::make_address("127.0.0.1"), freePort()};
+  auto old_server = std::make_unique<common::HttpServer>(endpoint, std::make_shared<NamedHandler>("old"),
+                                                         serverConfig());
+  old_server->run();
+  bool old_inherited = old_server->inherited();
+
+  // 两个客户端: 每个请求一个新连接 (检查 accept 不中断), 以及一个 keep-alive 连接 (服务器要求关闭时换新连接)
+  std::atomic<bool> stop{false};
+  std::atomic<size_t> requests{0}, failures{0}, retries{0}, from_old{0}, from_new{0};
+  std::atomic<int64_t> max_us{0};
+  auto count = [&](const Reply& reply, Clock::time_point start) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    for (auto prev = max_us.load(); us > prev && !max_us.compare_exchange_weak(prev, us);) {
+    }
+    ++requests;
+    if (!reply.ok) {
+      ++failures;
+    } else if (reply.body.find("\"old\"") != std::string::npos) {
+      ++from_old;
+    } else {
+      ++from_new;
+    }
+  };
+  std::thread per_request([&] {
+    net::io_context ioc;
+    while (!stop) {
+      auto start = Clock::now();
+      tcp::socket socket{ioc};
+      beast::error_code ec;
+      socket.connect(endpoint, ec);
+      beast::flat_buffer buffer;
+      count(ec ? Reply{} : get(socket, buffer, "/api/name"), start);
+    }
+  });
+  std::thread keep_alive([&] {
+    net::io_context ioc;
+    std::optional<tcp::socket> socket;
+    beast::flat_buffer buffer;
+    while (!stop) {
+      auto start = Clock::now();
+      bool reused = socket.has_value();
+      if (!socket) {
+        socket.emplace(ioc);
+        buffer.clear();
+        beast::error_code ec;
+        socket->connect(endpoint, ec);
+      }
+      auto reply = get(*socket, buffer, "/api/name");
+      if (!reply.ok && reused) {
+        // 空闲的 keep-alive 连接可能恰好被服务器关闭, GET 换新连接重试
+        ++retries;
+        socket.emplace(ioc);
+        buffer.clear();
+        beast::error_code ec;
+        socket->connect(endpoint, ec);
+        reply = get(*socket, buffer, "/api/name");
+      }
+      count(reply, start);
+      if (!reply.keep_alive) {
+        socket.reset();
+      }
+    }
+  });
+
+  std::this_thread::sleep_for(duration);
+  int64_t before_max_us = max_us.exchange(0);
+
+  // 新进程: 构造时接管监听 socket, run 之后旧进程开始排空
+  auto start = Clock::now();
+  auto new_server = std::make_unique<common::HttpServer>(endpoint, std::make_shared<NamedHandler>("new"),
+                                                         serverConfig());
+  new_server->run();
+  auto takeover_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  old_server->join();
+  auto old_exit_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  old_server.reset();
+
+  std::this_thread::sleep_for(duration);
+  stop = true;
+  per_request.join();
+  keep_alive.join();
+
+  struct stat st {};
+  bool path_kept = ::stat((kHandoffDir + "/http-" + std::to_string(endpoint.port()) + ".sock").c_str(), &st) == 0;
+  std::printf("restart: new server inherited %s (old %s), takeover %.1f ms, old server exited after %.1f ms\n",
+              new_server->inherited() ? "yes" : "no", old_inherited ? "yes" : "no", takeover_ms, old_exit_ms);
+  std::printf("restart: %zu requests, %zu failed, %zu keep-alive retries, %zu from old, %zu from new; "
+              "max latency %.2f ms before, %.2f ms during/after; handoff socket kept for next restart: %s\n",
+              requests.load(), failures.load(), retries.load(), from_old.load(), from_new.load(),
+              before_max_us / 1000.0, max_us.load() / 1000.0, path_kept ? "yes" : "no");
+  bool ok = new_server->inherited() && !old_inherited && failures == 0 && from_old > 0 && from_new > 0 && path_kept;
+  new_server->stop();
+  new_server.reset();
+  return ok;
+}
+
+bool unsafeDirCheck() {
+  ::mkdir(kOpenHandoffDir.c_str(), 0700);
+  ::chmod(kOpenHandoffDir.c_str(), 0777);
+  auto cfg = serverConfig();
+  cfg.handoff_dir = kOpenHandoffDir;
+  auto endpoint = tcp::endpoint{net::ip::make_address("127.0.0.1"), freePort()};
+  common::HttpServer server{endpoint, std::make_shared<NamedHandler>("open"), cfg};
+  server.run();
+  struct stat st {};
+  bool created = ::stat((kOpenHandoffDir + "/http-" + std::to_string(endpoint.port()) + ".sock").c_str(), &st) == 0;
+  server.stop();
+  server.join();
+  std::printf("unsafe dir: world-writable handoff dir %s\n", created ? "USED" : "refused");
+  return !created;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  auto duration = std::chrono::milliseconds(argc > 1 ? std::strtol(argv[1], nullptr, 10) : 1500);
+  ::mkdir(kHandoffDir.c_str(), 0700);
+  ::chmod(kHandoffDir.c_str(), 0700);
+  bool ok = stopCheck();
+  ok &= drainCheck();
+  ok &= restartCheck(duration);
+  ok &= unsafeDirCheck();
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
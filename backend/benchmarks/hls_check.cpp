@@ -0,0 +1,352 @@
+// HLS 路由在 common::HttpServer 上的正确性: 播放列表 (.m3u8) 和分片 (.ts) 经 HTTP/1.1 keep-alive (逐个请求、流水线、HEAD)
+// 以及 h2c (以 ENABLE_HTTP2 编译时) 取回的内容与文件逐字节一致, 连接保持可用。分片分别以文件 body 和 AsyncFileSource
+// (以 ENABLE_IO_URING 编译时) 写出; 另以内存中的 BodySource (长度已知/未知) 覆盖 HttpSession 逐块写出来源的路径
+// 用法: ./hls_check
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+#ifdef ENABLE_HTTP2
+#include <nghttp2/nghttp2.h>
+#endif
+#include "common/restful/http_server.hpp"
+#include "infrastructure/hls_server.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 内存中的 body, 每次 read 最多 chunk 字节; known_size 为 false 时长度未知 (HTTP/1.1 为 chunked)
+class MemorySource : public common::BodySource {
+public:
+  MemorySource(std::shared_ptr<const std::string> data, bool known_size, size_t chunk)
+    : data_(std::move(data)), known_size_(known_size), chunk_(chunk) {}
+
+  net::awaitable<size_t> read(net::mutable_buffer buffer) override {
+    size_t n = std::min({buffer.size(), chunk_, data_->size() - offset_});
+    std::memcpy(buffer.data(), data_->data() + offset_, n);
+    offset_ += n;
+    co_return n;
+  }
+  std::optional<uint64_t> size() const override {
+    return known_size_ ? std::optional<uint64_t>(data_->size()) : std::nullopt;
+  }
+
+private:
+  std::shared_ptr<const std::string> data_;
+  bool known_size_;
+  size_t chunk_;
+  size_t offset_ = 0;
+};
+
+class SourceHandler : public common::RestApiHandlerBase {
+public:
+  explicit SourceHandler(std::shared_ptr<const std::string> data) : data_(std::move(data)) {
+    router_.add(http::verb::get, "/source/{kind}", [this](common::RequestContext& ctx) {
+      common::Allocator alloc(common::RequestArena::current());
+      common::Response res{std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc)};
+      res.result(http::status::ok);
+      res.version(ctx.req.version());
+      res.set(http::field::content_type, "video/MP2T");
+      res.body().assignSource(std::make_shared<MemorySource>(data_, ctx.param("kind") == "sized", 10000));
+      res.prepare_payload();
+      return res;
+    });
+  }
+
+private:
+  std::shared_ptr<const std::string> data_;
+};
+
+struct Fixture {
+  std::string dir;
+  std::map<std::string, std::string> files; // 文件名 -> 内容
+};
+
+Fixture makeFixture() {
+  Fixture fixture{.dir = "/tmp/hls_check." + std::to_string(::getpid()), .files = {}};
+  fs::create_directories(fixture.dir);
+  // 分片大小不是 64KiB (文件 body 的读块) 和 16KiB (HTTP/2 帧) 的整数倍, 其中一个超过 HTTP/2 的默认窗口
+  std::string playlist = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:10\n#EXT-X-MEDIA-SEQUENCE:0\n";
+  size_t sizes[] = {300 * 1024 + 17, 1024 * 1024 + 1, 188};
+  for (size_t i = 0; i < std::size(sizes); ++i) {
+    std::string name = "video" + std::to_string(i) + ".ts";
+    std::string data(sizes[i], '\0');
+    for (size_t j = 0; j < data.size(); ++j) {
+      data[j] = static_cast<char>((j * 131 + i * 7) >> 3);
+    }
+    std::ofstream(fixture.dir + "/" + name, std::ios::binary) << data;
+    fixture.files[name] = std::move(data);
+    playlist += "#EXTINF:10.0,\n" + name + "\n";
+  }
+  playlist += "#EXT-X-ENDLIST\n";
+  std::ofstream(fixture.dir + "/video.m3u8") << playlist;
+  fixture.files["video.m3u8"] = playlist;
+  return fixture;
+}
+
+struct Reply {
+  unsigned status = 0;
+  bool keep_alive = false;
+  std::string content_length;
+  std::string body;
+};
+
+void writeRequest(tcp::socket& socket, http::verb method, const std::string& target) {
+  http::request<http::empty_body> req{method, target, 11};
+  req.set(http::field::host, "127.0.0.1");
+  http::write(socket, req);
+}
+
+Reply readReply(tcp::socket& socket, beast::flat_buffer& buffer, bool head = false) {
+  http::response_parser<http::string_body> parser;
+  parser.body_limit(64 * 1024 * 1024);
+  parser.skip(head);
+  beast::error_code ec;
+  http::read(socket, buffer, parser, ec);
+  if (ec) {
+    return {};
+  }
+  auto& res = parser.get();
+  return {res.result_int(), res.keep_alive(), std::string(res[http::field::content_length]), res.body()};
+}
+
+// 一个 keep-alive 连接上: 逐个 GET 播放列表和各分片, HEAD 分片, 不存在的分片, 最后流水线地再取一遍
+// sources 为 (target, 期望的 body)
+using Sources = std::vector<std::pair<std::string, const std::string*>>;
+
+bool http1Check(const tcp::endpoint& endpoint, const std::map<std::string, std::string>& files, const Sources& sources,
+                const std::string& label) {
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  socket.connect(endpoint);
+  beast::flat_buffer buffer;
+  size_t requests = 0, failures = 0;
+  auto expect = [&](const Reply& reply, unsigned status, const std::string* body) {
+    ++requests;
+    bool ok = reply.status == status && reply.keep_alive && (!body || reply.body == *body);
+    if (!ok) {
+      ++failures;
+      std::printf("  unexpected reply: status %u, keep-alive %d, %zu bytes\n", reply.status, reply.keep_alive,
+                  reply.body.size());
+    }
+  };
+
+  for (const auto& [name, data] : files) {
+    writeRequest(socket, http::verb::get, "/" + name);
+    expect(readReply(socket, buffer), 200, &data);
+  }
+  for (const auto& [target, data] : sources) {
+    writeRequest(socket, http::verb::get, target);
+    expect(readReply(socket, buffer), 200, data);
+  }
+  for (const auto& [name, data] : files) {
+    writeRequest(socket, http::verb::head, "/" + name);
+    auto reply = readReply(socket, buffer, true);
+    expect(reply, 200, nullptr);
+    if (reply.content_length != std::to_string(data.size())) {
+      ++failures;
+      std::printf("  HEAD /%s: Content-Length %s, expected %zu\n", name.c_str(), reply.content_length.c_str(),
+                  data.size());
+    }
+  }
+  writeRequest(socket, http::verb::get, "/missing.ts");
+  expect(readReply(socket, buffer), 404, nullptr);
+
+  for (const auto& [name, data] : files) {
+    writeRequest(socket, http::verb::get, "/" + name);
+  }
+  for (const auto& [name, data] : files) {
+    expect(readReply(socket, buffer), 200, &data);
+  }
+
+  std::printf("%-28s HTTP/1.1 keep-alive: %zu requests on one connection, %zu failed\n", label.c_str(), requests,
+              failures);
+  return failures == 0;
+}
+
+#ifdef ENABLE_HTTP2
+// 基于 nghttp2 客户端会话的阻塞式 h2c 客户端, 只发 GET
+class H2Client {
+public:
+  struct Result {
+    unsigned status = 0;
+    std::string body;
+    bool closed = false;
+  };
+
+  explicit H2Client(const tcp::endpoint& endpoint) : socket_(ioc_) {
+    socket_.connect(endpoint);
+    nghttp2_session_callbacks* cbs;
+    nghttp2_session_callbacks_new(&cbs);
+    nghttp2_session_callbacks_set_on_header_callback(cbs, &H2Client::onHeader);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(cbs, &H2Client::onData);
+    nghttp2_session_callbacks_set_on_stream_close_callback(cbs, &H2Client::onClose);
+    nghttp2_session_client_new(&session_, cbs, this);
+    nghttp2_session_callbacks_del(cbs);
+    // 默认窗口 (64KiB), 大分片要靠 WINDOW_UPDATE 续传
+    nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, nullptr, 0);
+  }
+  ~H2Client() { nghttp2_session_del(session_); }
+
+  int32_t get(const std::string& path) {
+    nghttp2_nv nva[] = {nv(":method", "GET"), nv(":scheme", "http"), nv(":authority", "127.0.0.1"), nv(":path", path)};
+    int32_t id = nghttp2_submit_request(session_, nullptr, nva, std::size(nva), nullptr, nullptr);
+    results_[id];
+    ++open_;
+    return id;
+  }
+
+  void run() {
+    char buf[64 * 1024];
+    while (open_ > 0) {
+      flush();
+      beast::error_code ec;
+      size_t n = socket_.read_some(net::buffer(buf), ec);
+      if (ec) {
+        return;
+      }
+      nghttp2_session_mem_recv(session_, reinterpret_cast<const uint8_t*>(buf), n);
+    }
+    flush();
+  }
+
+  Result& result(int32_t id) { return results_[id]; }
+
+private:
+  static nghttp2_nv nv(const char* name, const std::string& value) {
+    return {reinterpret_cast<uint8_t*>(const_cast<char*>(name)),
+            reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())), std::strlen(name), value.size(),
+            NGHTTP2_NV_FLAG_NONE};
+  }
+
+  void flush() {
+    const uint8_t* data;
+    ssize_t n;
+    while ((n = nghttp2_session_mem_send(session_, &data)) > 0) {
+      net::write(socket_, net::buffer(data, n));
+    }
+  }
+
+  static int onHeader(nghttp2_session*, const nghttp2_frame* frame, const uint8_t* name, size_t namelen,
+                      const uint8_t* value, size_t valuelen, uint8_t, void* user_data) {
+    if (namelen == 7 && std::memcmp(name, ":status", 7) == 0) {
+      static_cast<H2Client*>(user_data)->results_[frame->hd.stream_id].status =
+        std::strtoul(std::string(reinterpret_cast<const char*>(value), valuelen).c_str(), nullptr, 10);
+    }
+    return 0;
+  }
+
+  static int onData(nghttp2_session*, uint8_t, int32_t id, const uint8_t* data, size_t len, void* user_data) {
+    static_cast<H2Client*>(user_data)->results_[id].body.append(reinterpret_cast<const char*>(data), len);
+    return 0;
+  }
+
+  static int onClose(nghttp2_session*, int32_t id, uint32_t, void* user_data) {
+    auto& self = *static_cast<H2Client*>(user_data);
+    self.results_[id].closed = true;
+    --self.open_;
+    return 0;
+  }
+
+  net::io_context ioc_;
+  tcp::socket socket_;
+  nghttp2_session* session_ = nullptr;
+  std::map<int32_t, Result> results_;
+  size_t open_ = 0;
+};
+
+// 一个 h2c 连接上同时请求播放列表、各分片和不存在的分片, 之后在同一连接上再请求一轮
+bool http2Check(const tcp::endpoint& endpoint, const std::map<std::string, std::string>& files, const Sources& sources,
+                const std::string& label) {
+  H2Client client(endpoint);
+  size_t requests = 0, failures = 0;
+  for (int round = 0; round < 2; ++round) {
+    std::vector<std::pair<int32_t, const std::string*>> streams;
+    for (const auto& [name, data] : files) {
+      streams.emplace_back(client.get("/" + name), &data);
+    }
+    for (const auto& [target, data] : sources) {
+      streams.emplace_back(client.get(target), data);
+    }
+    int32_t missing = client.get("/missing.ts");
+    client.run();
+    for (const auto& [id, data] : streams) {
+      auto& result = client.result(id);
+      ++requests;
+      if (!result.closed || result.status != 200 || result.body != *data) {
+        ++failures;
+        std::printf("  stream %d: status %u, closed %d, %zu bytes, expected %zu\n", id, result.status, result.closed,
+                    result.body.size(), data->size());
+      }
+    }
+    ++requests;
+    failures += client.result(missing).status != 404;
+  }
+  std::printf("%-28s h2c: %zu streams on one connection, %zu failed\n", label.c_str(), requests, failures);
+  return failures == 0;
+}
+#endif
+
+bool check(const Fixture& fixture, bool async_file_io, const std::string& label) {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 2;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  auto hls = std::make_shared<video_service::HlsApiHandler>(async_file_io);
+  hls->setVideoDir(fixture.dir);
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, hls, cfg};
+  server.run();
+  bool ok = http1Check(server.localEndpoint(), fixture.files, {}, label);
+#ifdef ENABLE_HTTP2
+  ok &= http2Check(server.localEndpoint(), fixture.files, {}, label);
+#endif
+  server.stop();
+  server.join();
+  return ok;
+}
+
+bool sourceCheck(const Fixture& fixture) {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  auto data = std::make_shared<const std::string>(fixture.files.at("video0.ts"));
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0},
+                            std::make_shared<SourceHandler>(data), cfg};
+  server.run();
+  Sources sources = {{"/source/sized", data.get()}, {"/source/unsized", data.get()}};
+  bool ok = http1Check(server.localEndpoint(), {}, sources, "BodySource (memory)");
+#ifdef ENABLE_HTTP2
+  ok &= http2Check(server.localEndpoint(), {}, sources, "BodySource (memory)");
+#endif
+  server.stop();
+  server.join();
+  return ok;
+}
+
+} // namespace
+
+int main() {
+  auto fixture = makeFixture();
+  bool ok = check(fixture, false, "file body");
+#ifdef BOOST_ASIO_HAS_FILE
+  ok &= check(fixture, true, "AsyncFileSource (io_uring)");
+#else
+  std::printf("%-28s not built (needs ENABLE_IO_URING and Boost.Asio file support)\n", "AsyncFileSource (io_uring)");
+#endif
+  ok &= sourceCheck(fixture);
+#ifndef ENABLE_HTTP2
+  std::printf("h2c not built (needs ENABLE_HTTP2)\n");
+#endif
+  fs::remove_all(fixture.dir);
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
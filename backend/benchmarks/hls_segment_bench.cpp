@@ -0,0 +1,217 @@
+// HLS 分片: 多个 keep-alive 连接随机请求分片时的吞吐, 以及服务端 io 线程每个请求的系统调用次数
+// 同一份源码编译为 hls_segment_bench (epoll, 文件 body 在 io 线程上阻塞读取) 和 hls_segment_bench_uring
+// (以 ENABLE_IO_URING 编译, 依次测 async_file_io 关闭和开启), 两者的输出直接对比。服务端为单个 io 线程的 HttpServer
+// 系统调用由 raw_syscalls:sys_enter 跟踪点按服务端线程计数 (需要 perf_event_paranoid <= 1 或 CAP_PERFMON, 否则不输出),
+// 不包含内核 io-wq 线程代为执行的读取
+// 用法: ./hls_segment_bench [请求数=20000] [连接数=8] [分片 KiB=1024] [分片数=64]
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/restful/http_server.hpp"
+#include "infrastructure/hls_server.hpp"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// 按线程统计进入系统调用的次数
+class SyscallCounter {
+public:
+  explicit SyscallCounter(pid_t tid) {
+    std::ifstream id_file("/sys/kernel/tracing/events/raw_syscalls/sys_enter/id");
+    if (!id_file) {
+      id_file.open("/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id");
+    }
+    uint64_t id = 0;
+    if (!(id_file >> id)) {
+      return;
+    }
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = id;
+    attr.disabled = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+  }
+  ~SyscallCounter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  bool available() const { return fd_ >= 0; }
+  void start() {
+    ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  uint64_t stop() {
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    return read(fd_, &count, sizeof(count)) == sizeof(count) ? count : 0;
+  }
+
+private:
+  int fd_ = -1;
+};
+
+struct Result {
+  double requests_per_second;
+  double mib_per_second;
+  double syscalls_per_request; // 计数不可用时为负
+  bool ok;
+};
+
+Result run(const fs::path& dir, bool async_file_io, size_t requests, size_t connections, size_t segment_bytes,
+           size_t segments) {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.handoff_dir.clear();
+  cfg.admission_max_in_flight = 0;
+  cfg.admission_adaptive = false;
+  auto handler = std::make_shared<video_service::HlsApiHandler>(async_file_io);
+  handler->setVideoDir(dir.string());
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, handler, cfg};
+  server.run();
+  auto endpoint = server.localEndpoint();
+  std::promise<pid_t> tid;
+  net::post(server.ioContext(), [&tid] { tid.set_value(static_cast<pid_t>(syscall(SYS_gettid))); });
+  SyscallCounter syscalls(tid.get_future().get());
+
+  // 播放列表、不存在的分片
+  bool ok = true;
+  {
+    net::io_context ioc;
+    tcp::socket socket{ioc};
+    socket.connect(endpoint);
+    beast::flat_buffer buffer;
+    for (auto [target, status] : {std::pair{"/bench.m3u8", http::status::ok},
+                                  std::pair{"/missing.ts", http::status::not_found}}) {
+      http::request<http::empty_body> req{http::verb::get, target, 11};
+      req.set(http::field::host, "127.0.0.1");
+      http::write(socket, req);
+      http::response<http::string_body> res;
+      http::read(socket, buffer, res);
+      ok &= res.result() == status;
+    }
+  }
+
+  std::atomic<size_t> bad{0};
+  std::atomic<uint64_t> bytes{0};
+  if (syscalls.available()) {
+    syscalls.start();
+  }
+  auto start = Clock::now();
+  std::vector<std::thread> clients;
+  for (size_t c = 0; c < connections; ++c) {
+    clients.emplace_back([&, c] {
+      net::io_context ioc;
+      tcp::socket socket{ioc};
+      socket.connect(endpoint);
+      socket.set_option(tcp::no_delay(true));
+      beast::flat_buffer buffer;
+      std::mt19937 rng(static_cast<uint32_t>(c));
+      for (size_t i = c; i < requests; i += connections) {
+        http::request<http::empty_body> req{http::verb::get, "/seg" + std::to_string(rng() % segments) + ".ts", 11};
+        req.set(http::field::host, "127.0.0.1");
+        http::write(socket, req);
+        http::response_parser<http::vector_body<char>> parser;
+        parser.body_limit(segment_bytes + 1);
+        http::read(socket, buffer, parser);
+        const auto& res = parser.get();
+        if (res.result() != http::status::ok || res.body().size() != segment_bytes) {
+          ++bad;
+        }
+        bytes += res.body().size();
+      }
+    });
+  }
+  for (auto& client : clients) {
+    client.join();
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  double per_request = syscalls.available() ? static_cast<double>(syscalls.stop()) / requests : -1;
+
+  server.stop();
+  server.join();
+  return {requests / seconds, bytes / seconds / (1024 * 1024), per_request, ok && bad == 0};
+}
+
+void print(const char* name, const Result& result) {
+  std::printf("  %-32s %8.0f req/s %8.0f MiB/s", name, result.requests_per_second, result.mib_per_second);
+  if (result.syscalls_per_request >= 0) {
+    std::printf("  %6.1f syscalls/req", result.syscalls_per_request);
+  }
+  std::printf("%s\n", result.ok ? "" : "  FAILED");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  size_t connections = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 8;
+  size_t segment_bytes = (argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1024) * 1024;
+  size_t segments = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 64;
+
+  // 分片写在临时目录中, 测量前都已在页缓存里
+  char dir_template[] = "/tmp/hls_segment_bench.XXXXXX";
+  if (!mkdtemp(dir_template)) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+  fs::path dir = dir_template;
+  std::string data(segment_bytes, '\0');
+  std::mt19937 rng(42);
+  for (auto& c : data) {
+    c = static_cast<char>(rng());
+  }
+  std::ofstream playlist(dir / "bench.m3u8");
+  playlist << "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:10\n";
+  for (size_t i = 0; i < segments; ++i) {
+    std::ofstream(dir / ("seg" + std::to_string(i) + ".ts"), std::ios::binary).write(data.data(), data.size());
+    playlist << "#EXTINF:10.0,\nseg" << i << ".ts\n";
+  }
+  playlist << "#EXT-X-ENDLIST\n";
+  playlist.close();
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+  const char* backend = "io_uring";
+#elif defined(BOOST_ASIO_HAS_IO_URING)
+  const char* backend = "epoll (files on io_uring)";
+#else
+  const char* backend = "epoll";
+#endif
+  std::printf("socket backend: %s; %zu requests, %zu connections, %zu KiB segments x %zu\n", backend, requests,
+              connections, segment_bytes / 1024, segments);
+
+  bool ok = true;
+  auto blocking = run(dir, false, requests, connections, segment_bytes, segments);
+  print("file body (blocking read)", blocking);
+  ok &= blocking.ok;
+#ifdef BOOST_ASIO_HAS_FILE
+  auto async = run(dir, true, requests, connections, segment_bytes, segments);
+  print("AsyncFileSource (io_uring)", async);
+  ok &= async.ok;
+#endif
+  if (blocking.syscalls_per_request < 0) {
+    std::printf("  (syscall counts unavailable: needs perf_event_paranoid <= 1 or CAP_PERFMON)\n");
+  }
+
+  fs::remove_all(dir);
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+// HTTP/2 (h2c prior knowledge): 一个连接上多路复用的请求与 HTTP/1.1 (逐个请求、浏览器式的 6 个连接) 对比,
+// 处理函数快和慢 (异步等待 2ms, 如调用下游服务) 两种情况; 以及每个流的响应正确、Content-Length 超限的 413,
+// 流式上传受流控约束 (客户端发完的时刻接近处理函数读完的时刻), 上传期间同一连接上的其他请求不被阻塞
+// 用法: ./http2_bench [请求数=20000] [上传 MiB=16]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nghttp2/nghttp2.h>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr uint64_t kMiB = 1024 * 1024;
+
+class BenchHandler : public common::RestApiHandlerBase {
+public:
+  BenchHandler() {
+    router_
+        .add(http::verb::get, "/api/videos/{id}", [this](common::RequestContext& ctx) {
+          return writeJsonResponse(http::status::ok, [&ctx](common::JsonWriter& json) {
+            json.beginObject().key("id").value(ctx.param("id")).endObject();
+          });
+        })
+        .addStream(http::verb::get, "/api/slow/{id}",
+                   [this](common::RequestContext& ctx, common::BodyReader&) -> net::awaitable<common::Response> {
+                     // 等待 2ms 模拟调用下游服务, 不占用 io 线程
+                     std::string id(ctx.param("id"));
+                     net::steady_timer timer(co_await net::this_coro::executor, std::chrono::milliseconds(2));
+                     co_await timer.async_wait(net::use_awaitable);
+                     co_return writeJsonResponse(http::status::ok, [&id](common::JsonWriter& json) {
+                       json.beginObject().key("id").value(id).endObject();
+                     });
+                   })
+        .add(http::verb::post, "/api/echo", [this](common::RequestContext& ctx) {
+          size_t size = ctx.req.body().size();
+          return writeJsonResponse(http::status::ok, [size](common::JsonWriter& json) {
+            json.beginObject().key("bytes").value(static_cast<uint64_t>(size)).endObject();
+          });
+        }, false, 64 * 1024)
+        .addStream(http::verb::post, "/api/upload",
+                   [this](common::RequestContext&, common::BodyReader& body) -> net::awaitable<common::Response> {
+                     // 每 64KB 停 1ms 模拟写盘, 客户端应被流控拖住
+                     std::vector<char> chunk(64 * 1024);
+                     net::steady_timer timer(co_await net::this_coro::executor);
+                     uint64_t total = 0;
+                     while (size_t n = co_await body.read(net::buffer(chunk))) {
+                       total += n;
+                       timer.expires_after(std::chrono::milliseconds(1));
+                       co_await timer.async_wait(net::use_awaitable);
+                     }
+                     co_return writeJsonResponse(http::status::ok, [total](common::JsonWriter& json) {
+                       json.beginObject().key("bytes").value(total).endObject();
+                     });
+                   }, 1024 * kMiB);
+  }
+};
+
+// 基于 nghttp2 客户端会话的阻塞式 h2c 客户端
+class H2Client {
+public:
+  struct Result {
+    unsigned status = 0;
+    std::string body;
+    bool closed = false;
+    Clock::time_point sent; // 请求 body 发完的时刻
+    Clock::time_point done;
+  };
+
+  explicit H2Client(const tcp::endpoint& endpoint) : socket_(ioc_) {
+    socket_.connect(endpoint);
+    socket_.set_option(tcp::no_delay(true));
+    nghttp2_session_callbacks* cbs;
+    nghttp2_session_callbacks_new(&cbs);
+    nghttp2_session_callbacks_set_on_header_callback(cbs, &H2Client::onHeader);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(cbs, &H2Client::onData);
+    nghttp2_session_callbacks_set_on_stream_close_callback(cbs, &H2Client::onClose);
+    nghttp2_session_client_new(&session_, cbs, this);
+    nghttp2_session_callbacks_del(cbs);
+    nghttp2_settings_entry settings[] = {{NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, 16 * 1024 * 1024}};
+    nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings, 1);
+    nghttp2_session_set_local_window_size(session_, NGHTTP2_FLAG_NONE, 0, 16 * 1024 * 1024);
+  }
+  ~H2Client() { nghttp2_session_del(session_); }
+
+  int32_t submit(const char* method, const std::string& path, std::string body = {},
+                 std::string content_length = {}) {
+    std::vector<nghttp2_nv> nva = {nv(":method", method), nv(":scheme", "http"), nv(":authority", "127.0.0.1"),
+                                   nv(":path", path)};
+    if (!content_length.empty()) {
+      nva.push_back(nv("content-length", content_length));
+    }
+    auto upload = std::make_unique<Upload>();
+    upload->data = std::move(body);
+    nghttp2_data_provider provider{};
+    provider.source.ptr = upload.get();
+    provider.read_callback = &H2Client::readBody;
+    bool has_body = std::strcmp(method, "POST") == 0;
+    int32_t id = nghttp2_submit_request(session_, nullptr, nva.data(), nva.size(), has_body ? &provider : nullptr,
+                                        nullptr);
+    upload->result = &results_[id];
+    uploads_[id] = std::move(upload);
+    ++open_;
+    return id;
+  }
+
+  // 收发直到 until() 为真或所有流结束
+  void run(const std::function<bool()>& until = {}) {
+    char buf[64 * 1024];
+    while (open_ > 0 && !(until && until())) {
+      flush();
+      size_t n = socket_.read_some(net::buffer(buf));
+      nghttp2_session_mem_recv(session_, reinterpret_cast<const uint8_t*>(buf), n);
+    }
+    flush();
+  }
+
+  size_t open() const { return open_; }
+  Result& result(int32_t id) { return results_[id]; }
+  std::map<int32_t, Result>& results() { return results_; }
+
+private:
+  struct Upload {
+    std::string data;
+    size_t offset = 0;
+    Result* result = nullptr;
+  };
+
+  static nghttp2_nv nv(const char* name, const std::string& value) {
+    return {reinterpret_cast<uint8_t*>(const_cast<char*>(name)),
+            reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())), std::strlen(name), value.size(),
+            NGHTTP2_NV_FLAG_NONE};
+  }
+
+  void flush() {
+    const uint8_t* data;
+    ssize_t n;
+    while ((n = nghttp2_session_mem_send(session_, &data)) > 0) {
+      net::write(socket_, net::buffer(data, n));
+    }
+  }
+
+  static ssize_t readBody(nghttp2_session*, int32_t, uint8_t* buf, size_t length, uint32_t* flags,
+                          nghttp2_data_source* source, void*) {
+    auto& upload = *static_cast<Upload*>(source->ptr);
+    size_t n = std::min(length, upload.data.size() - upload.offset);
+    std::memcpy(buf, upload.data.data() + upload.offset, n);
+    upload.offset += n;
+    if (upload.offset == upload.data.size()) {
+      *flags |= NGHTTP2_DATA_FLAG_EOF;
+      upload.result->sent = Clock::now();
+    }
+    return static_cast<ssize_t>(n);
+  }
+
+  static int onHeader(nghttp2_session*, const nghttp2_frame* frame, const uint8_t* name, size_t namelen,
+                      const uint8_t* value, size_t valuelen, uint8_t, void* user_data) {
+    if (namelen == 7 && std::memcmp(name, ":status", 7) == 0) {
+      static_cast<H2Client*>(user_data)->results_[frame->hd.stream_id].status =
+        std::strtoul(std::string(reinterpret_cast<const char*>(value), valuelen).c_str(), nullptr, 10);
+    }
+    return 0;
+  }
+
+  static int onData(nghttp2_session*, uint8_t, int32_t id, const uint8_t* data, size_t len, void* user_data) {
+    static_cast<H2Client*>(user_data)->results_[id].body.append(reinterpret_cast<const char*>(data), len);
+    return 0;
+  }
+
+  static int onClose(nghttp2_session*, int32_t id, uint32_t, void* user_data) {
+    auto& self = *static_cast<H2Client*>(user_data);
+    auto& result = self.results_[id];
+    result.closed = true;
+    result.done = Clock::now();
+    self.uploads_.erase(id);
+    --self.open_;
+    return 0;
+  }
+
+  net::io_context ioc_;
+  tcp::socket socket_;
+  nghttp2_session* session_ = nullptr;
+  std::map<int32_t, Result> results_;
+  std::map<int32_t, std::unique_ptr<Upload>> uploads_;
+  size_t open_ = 0;
+};
+
+bool hasId(const std::string& body, size_t id) {
+  return body.find("\"" + std::to_string(id) + "\"") != std::string::npos;
+}
+
+// HTTP/1.1: connections 个连接, 每个连接逐个请求 (不流水线)
+double http1(const tcp::endpoint& endpoint, const char* prefix, size_t requests, size_t connections, bool& ok) {
+  auto start = Clock::now();
+  std::vector<std::thread> threads;
+  std::atomic<size_t> bad{0};
+  for (size_t c = 0; c < connections; ++c) {
+    threads.emplace_back([&, c] {
+      net::io_context ioc;
+      tcp::socket socket{ioc};
+      socket.connect(endpoint);
+      socket.set_option(tcp::no_delay(true));
+      beast::flat_buffer buffer;
+      for (size_t i = c; i < requests; i += connections) {
+        http::request<http::empty_body> req{http::verb::get, prefix + std::to_string(i), 11};
+        req.set(http::field::host, "127.0.0.1");
+        http::write(socket, req);
+        http::response<http::string_body> res;
+        http::read(socket, buffer, res);
+        if (res.result() != http::status::ok || !hasId(res.body(), i)) {
+          ++bad;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ok &= bad == 0;
+  return requests / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// HTTP/2: 一个连接, 最多 depth 个并发流
+double http2(const tcp::endpoint& endpoint, const std::string& prefix, size_t requests, size_t depth, bool& ok) {
+  H2Client client(endpoint);
+  std::map<int32_t, size_t> ids;
+  size_t submitted = 0;
+  size_t bad = 0;
+  auto start = Clock::now();
+  while (submitted < requests || client.open() > 0) {
+    while (submitted < requests && client.open() < depth) {
+      ids[client.submit("GET", prefix + std::to_string(submitted))] = submitted;
+      ++submitted;
+    }
+    size_t open = client.open();
+    client.run([&] { return client.open() < open; });
+    for (auto it = client.results().begin(); it != client.results().end();) {
+      if (!it->second.closed) {
+        ++it;
+        continue;
+      }
+      if (it->second.status != 200 || !hasId(it->second.body, ids[it->first])) {
+        ++bad;
+      }
+      ids.erase(it->first);
+      it = client.results().erase(it);
+    }
+  }
+  ok &= bad == 0;
+  return requests / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t requests = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+  uint64_t upload_mib = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+  bool ok = true;
+
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.handoff_dir.clear();
+  // 只比较协议: 一个连接上 100 个并发流会超过自适应准入的下限, 部分请求得到 503
+  cfg.admission_max_in_flight = 0;
+  cfg.admission_adaptive = false;
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, std::make_shared<BenchHandler>(),
+                            cfg};
+  server.run();
+  auto endpoint = server.localEndpoint();
+
+  // 快的处理函数: 连接数和往返次数决定吞吐
+  double h1_one = http1(endpoint, "/api/videos/", requests, 1, ok);
+  double h1_six = http1(endpoint, "/api/videos/", requests, 6, ok);
+  double h2_one = http2(endpoint, "/api/videos/", requests, 100, ok);
+  std::printf("fast handler, %zu requests:\n", requests);
+  std::printf("  HTTP/1.1, 1 connection:            %8.0f req/s\n", h1_one);
+  std::printf("  HTTP/1.1, 6 connections:           %8.0f req/s\n", h1_six);
+  std::printf("  HTTP/2,   1 connection, 100 streams: %6.0f req/s\n", h2_one);
+
+  // 慢的处理函数: 并发度决定吞吐
+  size_t slow = std::min<size_t>(requests / 10, 2000);
+  double s1_six = http1(endpoint, "/api/slow/", slow, 6, ok);
+  double s2_one = http2(endpoint, "/api/slow/", slow, 100, ok);
+  std::printf("handler waiting 2 ms, %zu requests:\n", slow);
+  std::printf("  HTTP/1.1, 6 connections:           %8.0f req/s\n", s1_six);
+  std::printf("  HTTP/2,   1 connection, 100 streams: %6.0f req/s\n", s2_one);
+
+  // 正确性: body 上限、流式上传的流控、上传期间同一连接上的请求
+  {
+    H2Client client(endpoint);
+    auto small = client.submit("POST", "/api/echo", std::string(1000, 'x'));
+    auto declared = client.submit("POST", "/api/echo", std::string(100 * 1024, 'x'), std::to_string(100 * 1024));
+    auto undeclared = client.submit("POST", "/api/echo", std::string(100 * 1024, 'x'));
+    auto missing = client.submit("GET", "/missing");
+    client.run();
+    bool bodies = client.result(small).status == 200 &&
+                  client.result(small).body.find("\"bytes\":1000") != std::string::npos &&
+                  client.result(declared).status == 413 && client.result(undeclared).status == 413 &&
+                  client.result(missing).status == 404;
+    std::printf("echo 1000 B -> %u %s, 100 KiB with Content-Length -> %u, without -> %u, /missing -> %u\n",
+                client.result(small).status, client.result(small).body.c_str(), client.result(declared).status,
+                client.result(undeclared).status, client.result(missing).status);
+    ok &= bodies;
+
+    auto start = Clock::now();
+    auto upload = client.submit("POST", "/api/upload", std::string(upload_mib * kMiB, 'u'));
+    // 上传开始后在同一连接上发一个 GET
+    client.run([&] { return Clock::now() - start > std::chrono::milliseconds(20); });
+    auto get_start = Clock::now();
+    auto get = client.submit("GET", "/api/videos/7");
+    client.run([&] { return client.result(get).closed; });
+    double get_ms = std::chrono::duration<double, std::milli>(client.result(get).done - get_start).count();
+    client.run();
+    auto& up = client.result(upload);
+    double sent_ms = std::chrono::duration<double, std::milli>(up.sent - start).count();
+    double done_ms = std::chrono::duration<double, std::milli>(up.done - start).count();
+    bool counted = up.body.find("\"bytes\":" + std::to_string(upload_mib * kMiB)) != std::string::npos;
+    std::printf("upload %llu MiB: status %u, counted %s, client finished sending after %.0f ms, response after %.0f ms "
+                "(window %u KiB); GET during upload %.2f ms\n", static_cast<unsigned long long>(upload_mib),
+                up.status, counted ? "yes" : "NO", sent_ms, done_ms, cfg.http2_window_bytes / 1024, get_ms);
+    // 流控生效时客户端最多比处理函数提前一个窗口发完
+    ok &= up.status == 200 && counted && sent_ms > done_ms * 0.8 && client.result(get).status == 200 &&
+          get_ms < done_ms / 2;
+  }
+
+  server.stop();
+  server.join();
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// 请求指标: io 线程上每个请求记录一次的开销 (绑定分片, 以及未绑定线程加锁写入的后备路径), 导出的耗时,
+// 以及 HttpServer 的 /metrics 输出与实际请求数一致
+// 用法: ./http_metrics_bench [记录数=5000000] [请求数=5000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+class VideoHandler : public common::RestApiHandlerBase {
+public:
+  VideoHandler() {
+    router_.add(http::verb::get, "/api/videos/{id}", [this](common::RequestContext&) {
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    });
+    router_.add(http::verb::post, "/api/videos", [this](common::RequestContext&) {
+      return createErrorResponse(http::status::bad_request, "missing title");
+    });
+  }
+};
+
+std::vector<std::pair<std::string, std::string>> benchRoutes() {
+  return {{"GET", "/api/videos/{id}"}, {"POST", "/api/videos"}};
+}
+
+common::HttpMetrics::Sample sample(size_t i) {
+  auto start = Clock::now() - std::chrono::microseconds(i % 5000);
+  return {i % 2, i % 7 == 0 ? 404u : 200u, 120, 300, start, start, start, start + std::chrono::microseconds(3),
+          start + std::chrono::microseconds(4), start + std::chrono::microseconds(i % 5000)};
+}
+
+double recordNs(common::HttpMetrics& metrics, size_t records) {
+  auto samples = std::vector<common::HttpMetrics::Sample>();
+  samples.reserve(1024);
+  for (size_t i = 0; i < 1024; ++i) {
+    samples.push_back(sample(i));
+  }
+  auto start = Clock::now();
+  for (size_t i = 0; i < records; ++i) {
+    metrics.begin();
+    metrics.record(samples[i & 1023]);
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / records;
+}
+
+// 从导出文本中取一行的值, 没有该行时返回 -1
+double valueOf(const std::string& text, const std::string& series) {
+  auto pos = text.find("\n" + series + " ");
+  if (pos == std::string::npos) {
+    return -1;
+  }
+  return std::strtod(text.c_str() + pos + series.size() + 2, nullptr);
+}
+
+double countOf(const std::string& text, const std::string& method, const std::string& route, const char* code) {
+  return valueOf(text, "http_request_duration_seconds_count{method=\"" + method + "\",route=\"" + route +
+                         "\",code=\"" + code + "\"}");
+}
+
+std::string get(tcp::socket& socket, beast::flat_buffer& buffer, const char* target) {
+  http::request<http::empty_body> req{http::verb::get, target, 11};
+  req.set(http::field::host, "127.0.0.1");
+  http::write(socket, req);
+  http::response<http::string_body> res;
+  http::read(socket, buffer, res);
+  return res.body();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t records = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+  size_t requests = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000;
+  bool ok = true;
+
+  {
+    common::HttpMetrics metrics;
+    metrics.setRoutes(benchRoutes());
+    double bound = 0;
+    std::thread([&] {
+      metrics.bindThread();
+      bound = recordNs(metrics, records);
+    }).join();
+    double fallback = recordNs(metrics, records / 10);
+    std::printf("record, per-thread shard:     %6.1f ns/request\n", bound);
+    std::printf("record, locked fallback:      %6.1f ns/request\n", fallback);
+
+    std::string text;
+    auto start = Clock::now();
+    int scrapes = 100;
+    for (int i = 0; i < scrapes; ++i) {
+      text.clear();
+      metrics.render(text, {});
+    }
+    std::printf("render: %.1f us, %zu bytes\n",
+                std::chrono::duration<double, std::micro>(Clock::now() - start).count() / scrapes, text.size());
+    double total = records + records / 10;
+    double counted = countOf(text, "GET", "/api/videos/{id}", "2xx") + countOf(text, "GET", "/api/videos/{id}", "4xx") +
+                     countOf(text, "POST", "/api/videos", "2xx") + countOf(text, "POST", "/api/videos", "4xx");
+    std::printf("recorded %.0f, counted %.0f, in flight %.0f\n", total, counted,
+                valueOf(text, "http_requests_in_flight"));
+    ok &= counted == total && valueOf(text, "http_requests_in_flight") == 0;
+  }
+
+  // HttpServer: GET 200、POST 400、未匹配的 404, 之后抓取 /metrics
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.metrics_path = "/metrics"; // 默认不导出
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, std::make_shared<VideoHandler>(),
+                            cfg};
+  server.run();
+
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  socket.connect(server.localEndpoint());
+  beast::flat_buffer buffer;
+  auto start = Clock::now();
+  for (size_t i = 0; i < requests; ++i) {
+    get(socket, buffer, "/api/videos/42");
+  }
+  double rps = requests / std::chrono::duration<double>(Clock::now() - start).count();
+  for (size_t i = 0; i < 10; ++i) {
+    http::request<http::string_body> req{http::verb::post, "/api/videos", 11};
+    req.set(http::field::host, "127.0.0.1");
+    req.body() = R"({"title":""})";
+    req.prepare_payload();
+    http::write(socket, req);
+    http::response<http::string_body> res;
+    http::read(socket, buffer, res);
+    get(socket, buffer, "/missing");
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // 最后一个响应的 onWrite 可能还没执行
+  auto text = get(socket, buffer, "/metrics");
+  server.stop();
+  server.join();
+
+  std::printf("http server: %.0f req/s with metrics recording, /metrics %zu bytes\n", rps, text.size());
+  double ok_count = countOf(text, "GET", "/api/videos/{id}", "2xx");
+  double bad_count = countOf(text, "POST", "/api/videos", "4xx");
+  double missing = countOf(text, "", "unmatched", "4xx");
+  double in_flight = valueOf(text, "http_requests_in_flight");
+  double handle = valueOf(text, R"(http_request_phase_seconds_count{phase="handle"})");
+  double read_bytes = valueOf(text, R"(http_request_bytes_total{method="POST",route="/api/videos"})");
+  std::printf("GET 2xx %.0f, POST 4xx %.0f, unmatched 4xx %.0f, in flight %.0f (the scrape), handled %.0f, "
+              "POST bytes in %.0f\n", ok_count, bad_count, missing, in_flight, handle, read_bytes);
+  ok &= ok_count == requests && bad_count == 10 && missing == 10 && in_flight == 1 && handle == requests + 10 &&
+        read_bytes > 10 * 12;
+  // 一个路由的完整序列作为示例
+  for (size_t pos = 0, end; (end = text.find('\n', pos)) != std::string::npos; pos = end + 1) {
+    auto line = text.substr(pos, end - pos);
+    if (line.find(R"(route="/api/videos/{id}")") != std::string::npos) {
+      std::printf("%s\n", line.c_str());
+    }
+  }
+
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+// 大量空闲 keep-alive 连接: 服务端进程的 RSS 和空闲时的 CPU 占用, 达到 max_connections 时淘汰最久空闲的连接,
+// 以及空闲超时。大量连接的客户端在子进程中运行, 服务端进程的 RSS 只包含服务端 (不含内核中的 socket 缓冲区)
+// 用法: ./idle_connections_bench [连接数=100000] [每个连接空闲前的请求数=4]
+// 每个进程需要约 连接数 个文件描述符, 无法调高 RLIMIT_NOFILE 时按当前上限减少连接数
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/restful/http_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+constexpr size_t kEvict = 100; // 达到上限后再建立的连接数
+
+class IdleHandler : public common::RestApiHandlerBase {
+public:
+  IdleHandler() {
+    router_.add(http::verb::get, "/ping", [this](common::RequestContext&) {
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    });
+  }
+};
+
+size_t rssKiB() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.starts_with("VmRSS:")) {
+      return std::strtoul(line.c_str() + 6, nullptr, 10);
+    }
+  }
+  return 0;
+}
+
+double cpuSeconds() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// 尽量调高文件描述符上限, 返回可用的连接数
+size_t raiseFdLimit(size_t wanted) {
+  rlimit limit{};
+  getrlimit(RLIMIT_NOFILE, &limit);
+  rlim_t need = wanted + kEvict + 256;
+  if (limit.rlim_cur < need) {
+    rlimit raised{need, std::max(need, limit.rlim_max)};
+    if (setrlimit(RLIMIT_NOFILE, &raised) != 0) {
+      raised = {limit.rlim_max, limit.rlim_max};
+      setrlimit(RLIMIT_NOFILE, &raised);
+    }
+    getrlimit(RLIMIT_NOFILE, &limit);
+  }
+  return std::min<size_t>(wanted, limit.rlim_cur > kEvict + 256 ? limit.rlim_cur - kEvict - 256 : 0);
+}
+
+template <class T>
+void send(int fd, T value) {
+  if (write(fd, &value, sizeof(value)) != sizeof(value)) {
+    std::exit(1);
+  }
+}
+
+template <class T>
+T receive(int fd) {
+  T value{};
+  if (read(fd, &value, sizeof(value)) != sizeof(value)) {
+    std::exit(1);
+  }
+  return value;
+}
+
+// 建立一个连接并完成 requests 个请求, 之后连接保持空闲; 源地址在 127.0.0.0/8 内轮换, 避免耗尽临时端口
+tcp::socket openIdle(net::io_context& ioc, unsigned short port, size_t i, size_t requests = 1) {
+  tcp::socket socket{ioc};
+  socket.open(tcp::v4());
+  socket.bind({net::ip::address_v4(0x7f000001 + static_cast<uint32_t>(i / 20000) + 1), 0});
+  socket.connect({net::ip::make_address("127.0.0.1"), port});
+
+  http::request<http::empty_body> req{http::verb::get, "/ping", 11};
+  req.set(http::field::host, "127.0.0.1");
+  beast::flat_buffer buffer;
+  for (size_t n = 0; n < requests; ++n) {
+    http::write(socket, req);
+    http::response<http::string_body> res;
+    http::read(socket, buffer, res);
+    if (res.result() != http::status::ok) {
+      std::fprintf(stderr, "unexpected status %u\n", res.result_int());
+      std::exit(1);
+    }
+  }
+  return socket;
+}
+
+// 服务端是否已经关闭了连接 (读到 EOF)
+bool closedByPeer(tcp::socket& socket) {
+  socket.non_blocking(true);
+  char byte;
+  beast::error_code ec;
+  socket.read_some(net::buffer(&byte, 1), ec);
+  return ec == net::error::eof || ec == net::error::connection_reset;
+}
+
+// 子进程: 按父进程的指令建立连接和检查连接状态
+void client(int commands, int results, size_t count, size_t requests) {
+  auto port = receive<unsigned short>(commands);
+  net::io_context ioc;
+  std::vector<tcp::socket> sockets;
+  sockets.reserve(count + kEvict);
+
+  for (size_t i = 0; i < count; ++i) {
+    sockets.push_back(openIdle(ioc, port, i, requests));
+  }
+  send(results, count);
+
+  // 超过上限的新连接应使最早的 kEvict 个空闲连接被关闭
+  receive<char>(commands);
+  for (size_t i = 0; i < kEvict; ++i) {
+    sockets.push_back(openIdle(ioc, port, count + i));
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  size_t oldest_closed = 0, others_closed = 0;
+  for (size_t i = 0; i < sockets.size(); ++i) {
+    (i < kEvict ? oldest_closed : others_closed) += closedByPeer(sockets[i]);
+  }
+  send(results, oldest_closed);
+  send(results, others_closed);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t wanted = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  size_t requests = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4;
+  size_t count = raiseFdLimit(wanted);
+  if (count < wanted) {
+    std::printf("RLIMIT_NOFILE too low for %zu connections, using %zu\n", wanted, count);
+  }
+
+  // 在启动服务端线程之前 fork
+  int commands[2], results[2];
+  if (pipe(commands) != 0 || pipe(results) != 0) {
+    return 1;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    client(commands[0], results[1], count, requests);
+    std::_Exit(0);
+  }
+
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.max_connections = count;
+  cfg.idle_timeout_seconds = 600; // 建立全部连接期间不能超时
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, std::make_shared<IdleHandler>(), cfg};
+  server.run();
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  size_t rss_before = rssKiB();
+  auto start = Clock::now();
+  send(commands[1], server.localEndpoint().port());
+  receive<size_t>(results[0]);
+  double connect_s = std::chrono::duration<double>(Clock::now() - start).count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  size_t rss_after = rssKiB();
+
+  double cpu_before = cpuSeconds();
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  double idle_cpu = cpuSeconds() - cpu_before;
+
+  std::printf("idle connections: %zu (server reports %zu) after %zu requests each, established in %.1f s\n",
+              count, server.connections(), requests, connect_s);
+  std::printf("server RSS: %zu KiB -> %zu KiB, %.0f bytes/connection\n", rss_before, rss_after,
+              (rss_after - rss_before) * 1024.0 / count);
+  std::printf("server CPU while idle: %.1f ms/s\n", idle_cpu * 1000);
+
+  send(commands[1], 'E');
+  auto oldest_closed = receive<size_t>(results[0]);
+  auto others_closed = receive<size_t>(results[0]);
+  std::printf("max_connections=%zu, %zu more connections: evicted %zu, rejected %zu, "
+              "oldest %zu closed %zu/%zu, others closed %zu\n",
+              count, kEvict, server.evictedConnections(), server.rejectedConnections(),
+              kEvict, oldest_closed, kEvict, others_closed);
+
+  waitpid(pid, nullptr, 0);
+  server.stop();
+  server.join();
+
+  // 空闲超时: 另起一个 1s 超时的服务端, 由本进程建立连接
+  cfg.max_connections = 0;
+  cfg.idle_timeout_seconds = 1;
+  common::HttpServer short_idle{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0},
+                                std::make_shared<IdleHandler>(), cfg};
+  short_idle.run();
+  net::io_context ioc;
+  std::vector<tcp::socket> sockets;
+  for (size_t i = 0; i < kEvict; ++i) {
+    sockets.push_back(openIdle(ioc, short_idle.localEndpoint().port(), i));
+  }
+  size_t open_before = short_idle.connections();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+  size_t closed = 0;
+  for (auto& socket : sockets) {
+    closed += closedByPeer(socket);
+  }
+  std::printf("idle timeout %d s: server connections %zu -> %zu, client saw %zu/%zu closed\n",
+              cfg.idle_timeout_seconds, open_before, short_idle.connections(), closed, kEvict);
+  short_idle.stop();
+  short_idle.join();
+
+  bool ok = oldest_closed == kEvict && others_closed == 0 && closed == kEvict && short_idle.connections() == 0;
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
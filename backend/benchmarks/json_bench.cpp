@@ -0,0 +1,117 @@
+// 登录接口的 JSON 开销: nlohmann::json DOM 与 JsonReader/JsonWriter 对比
+// 用法: ./json_bench [次数=1000000]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "common/restful/json_reader.hpp"
+#include "common/restful/json_writer.hpp"
+
+using namespace common;
+
+namespace {
+
+constexpr std::string_view kLoginRequest =
+  R"({"email": "user123@example.com", "password": "P@ssw0rd-123456", "remember_me": true})";
+
+struct User {
+  std::string id = "6f1c2a9e-3b7d-4c55-9a0e-2d8b1f4e7c10";
+  std::string email = "user123@example.com";
+  std::string username = "user123";
+  std::string avatar = "https://cdn.example.com/avatars/user123.png";
+};
+
+const std::string kToken =
+  "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJ1c2VyX2lkIjoiNmYxYzJhOWUtM2I3ZC00YzU1LTlhMGUtMmQ4YjFmNGU3YzEw"
+  "IiwiZXhwIjoxNzAwMDAwMDAwfQ.5mL7c2a0d8f4a1e9b3c6d2f7e8a9b0c1d2e3f4a5b6c7";
+
+template <class F>
+double nsPerOp(size_t n, F&& f) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    f();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / n;
+}
+
+// 原处理函数中的写法
+void writeDom(StringBody::value_type& out, const User& user) {
+  nlohmann::json response_json = {
+      {"success", true},
+      {"message", "Login successful"},
+      {"token", kToken},
+      {"user",
+       {{"id", user.id},
+        {"email", user.email},
+        {"username", user.username},
+        {"avatar", user.avatar}}},
+  };
+  out.assign(response_json.dump());
+}
+
+void writeDirect(StringBody::value_type& out, const User& user) {
+  JsonWriter json(out);
+  json.beginObject()
+      .key("success").value(true)
+      .key("message").value("Login successful")
+      .key("token").value(kToken)
+      .key("user").beginObject()
+          .key("id").value(user.id)
+          .key("email").value(user.email)
+          .key("username").value(user.username)
+          .key("avatar").value(user.avatar)
+      .endObject()
+      .endObject();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  size_t checksum = 0;
+
+  double parse_dom = nsPerOp(n, [&] {
+    auto body = nlohmann::json::parse(kLoginRequest);
+    std::string email = body["email"];
+    std::string password = body["password"];
+    checksum += email.size() + password.size();
+  });
+
+  double parse_ondemand = nsPerOp(n, [&] {
+    JsonReader body(kLoginRequest);
+    std::string email(*body.getString("email"));
+    std::string password(*body.getString("password"));
+    checksum += email.size() + password.size();
+  });
+
+  User user;
+  StringBody::value_type out;
+  double write_dom = nsPerOp(n, [&] {
+    out.clear();
+    writeDom(out, user);
+    checksum += out.size();
+  });
+
+  double write_direct = nsPerOp(n, [&] {
+    out.clear();
+    writeDirect(out, user);
+    checksum += out.size();
+  });
+
+  // 两种写法的输出应表示同一个 JSON (nlohmann 按键名排序, 字节不同)
+  StringBody::value_type dom_out, direct_out;
+  writeDom(dom_out, user);
+  writeDirect(direct_out, user);
+  bool same = nlohmann::json::parse(dom_out) == nlohmann::json::parse(direct_out);
+
+  std::printf("iterations: %zu, request: %zu bytes, response: %zu bytes\n",
+              n, kLoginRequest.size(), direct_out.size());
+  std::printf("parse  nlohmann DOM  : %8.1f ns/op\n", parse_dom);
+  std::printf("parse  JsonReader    : %8.1f ns/op\n", parse_ondemand);
+  std::printf("write  nlohmann dump : %8.1f ns/op\n", write_dom);
+  std::printf("write  JsonWriter    : %8.1f ns/op\n", write_direct);
+  std::printf("outputs equal: %s, checksum: %zu\n", same ? "yes" : "no", checksum);
+  return same ? 0 : 1;
+}
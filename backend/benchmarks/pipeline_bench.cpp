@@ -0,0 +1,100 @@
+// HTTP/1.1 流水线: 客户端一次发出一批请求, 对比 pipeline_depth=1 (逐个读取) 与预读时的耗时, 并检查响应顺序
+// 用法: ./pipeline_bench [批数=200] [每批请求数=16] [处理等待us=500]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "common/restful/http_server.hpp"
+
+namespace {
+
+class PipelineHandler : public common::RestApiHandlerBase {
+public:
+  explicit PipelineHandler(std::chrono::microseconds work) : work_(work) {}
+
+  const common::StaticResponse* staticResponse(const common::Request&) const override { return nullptr; }
+
+protected:
+  // 模拟异步的 redis/mysql 调用: 等待期间不占用 io 线程
+  net::awaitable<common::Response> doHandleRequestAsync(common::Request req, common::RequestTrace*) override {
+    net::steady_timer timer(co_await net::this_coro::executor, work_);
+    co_await timer.async_wait(net::use_awaitable);
+
+    common::RequestArena::Scope scope(req.get_allocator().resource());
+    auto target = common::toStringView(req.target());
+    auto seq = target.substr(target.find('=') + 1);
+    co_return writeJsonResponse(http::status::ok, [seq](common::JsonWriter& json) {
+      json.beginObject().key("seq").value(seq).endObject();
+    });
+  }
+
+private:
+  std::chrono::microseconds work_;
+};
+
+std::string expectedBody(size_t seq) {
+  return R"({"seq":")" + std::to_string(seq) + R"("})";
+}
+
+// 返回每批耗时 (us); 响应顺序不对时退出
+double run(const config::HttpServerConfig& cfg, size_t batches, size_t batch_size, std::chrono::microseconds work) {
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0},
+                            std::make_shared<PipelineHandler>(work), cfg};
+  server.run();
+
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  socket.connect({net::ip::make_address("127.0.0.1"), server.localEndpoint().port()});
+  beast::flat_buffer buffer;
+
+  auto start = std::chrono::steady_clock::now();
+  size_t seq = 0;
+  for (size_t b = 0; b < batches; ++b) {
+    std::string batch;
+    size_t first = seq;
+    for (size_t i = 0; i < batch_size; ++i, ++seq) {
+      // 每批中间夹一个 POST, 它不与其他请求并行处理
+      const char* method = i == batch_size / 2 ? "POST" : "GET";
+      batch += std::string(method) + " /work?seq=" + std::to_string(seq) +
+               " HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Length: 0\r\n\r\n";
+    }
+    net::write(socket, net::buffer(batch));
+
+    for (size_t i = 0; i < batch_size; ++i) {
+      http::response<http::string_body> res;
+      http::read(socket, buffer, res);
+      if (res.result() != http::status::ok || res.body() != expectedBody(first + i)) {
+        std::fprintf(stderr, "unexpected response %u %s, want seq %zu\n", res.result_int(), res.body().c_str(), first + i);
+        std::exit(1);
+      }
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  server.stop();
+  server.join();
+  return std::chrono::duration<double, std::micro>(elapsed).count() / batches;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t batches = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200;
+  size_t batch_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 16;
+  std::chrono::microseconds work{argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 500};
+
+  for (bool per_thread : {false, true}) {
+    for (size_t depth : {size_t{1}, batch_size}) {
+      auto cfg = config::Config::getInstance().getHttpServer();
+      cfg.io_threads = 2;
+      cfg.reuse_port_per_thread = per_thread;
+      cfg.pin_threads = false;
+      cfg.pipeline_depth = depth;
+      double us = run(cfg, batches, batch_size, work);
+      std::printf("%-10s depth %-3zu batch %zu x %lldus work: %10.1f us/batch\n", per_thread ? "per-thread" : "shared",
+                  depth, batch_size, static_cast<long long>(work.count()), us);
+    }
+  }
+  std::printf("responses in order: yes\n");
+  return 0;
+}
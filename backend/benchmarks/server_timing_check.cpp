@@ -0,0 +1,156 @@
+// 请求阶段耗时: TraceSpan 在有无 RequestTrace 时的开销, HttpServer 的 Server-Timing 头
+// (读取、线程池排队、处理函数中记录的阶段、处理函数), 以及访问日志中的 spans_us
+// 用法: ./server_timing_check [span 数=5000000] [请求数=5000]
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "common/restful/http_server.hpp"
+#include "common/restful/request_trace.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const std::string kLogPath = "/tmp/server_timing_check.log";
+
+// 模拟登录: 线程池中依次等待 mysql、两次密码哈希和 JWT 签名; token 校验不进线程池, 没有阶段
+class LoginHandler : public common::RestApiHandlerBase {
+public:
+  LoginHandler() {
+    router_.add(http::verb::post, "/api/auth/login", [this](common::RequestContext&) {
+      {
+        common::TraceSpan span("mysql");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      }
+      for (int i = 0; i < 2; ++i) {
+        common::TraceSpan span("hash");
+      }
+      common::TraceSpan span("jwt");
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    }, true);
+    router_.add(http::verb::post, "/api/auth/validate-token", [this](common::RequestContext&) {
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    });
+  }
+};
+
+double spanNs(common::RequestTrace* trace, size_t spans) {
+  auto start = Clock::now();
+  for (size_t i = 0; i < spans; ++i) {
+    common::TraceSpan span(trace, (i & 1) ? "redis" : "mysql");
+  }
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / spans;
+}
+
+http::response<http::string_body> post(tcp::socket& socket, beast::flat_buffer& buffer, const char* target) {
+  http::request<http::string_body> req{http::verb::post, target, 11};
+  req.set(http::field::host, "127.0.0.1");
+  req.body() = R"({"email":"a@b.c"})";
+  req.prepare_payload();
+  http::write(socket, req);
+  http::response<http::string_body> res;
+  http::read(socket, buffer, res);
+  return res;
+}
+
+// Server-Timing 中某一项的 dur (毫秒), 没有该项时返回 -1
+double durationOf(std::string_view timing, std::string_view name) {
+  for (size_t pos = 0; pos < timing.size();) {
+    size_t end = timing.find(", ", pos);
+    auto item = timing.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+    if (item.starts_with(name) && item.substr(name.size()).starts_with(";dur=")) {
+      return std::strtod(std::string(item.substr(name.size() + 5)).c_str(), nullptr);
+    }
+    if (end == std::string_view::npos) {
+      break;
+    }
+    pos = end + 2;
+  }
+  return -1;
+}
+
+// 依次发送 requests 个请求, 返回每秒请求数; timing 为最后一个登录响应的 Server-Timing
+double serve(bool server_timing, size_t requests, std::string& timing, bool& validate_has_timing) {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.server_timing = server_timing;
+  common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, std::make_shared<LoginHandler>(),
+                            cfg};
+  server.run();
+
+  net::io_context ioc;
+  tcp::socket socket{ioc};
+  socket.connect(server.localEndpoint());
+  beast::flat_buffer buffer;
+  auto res = post(socket, buffer, "/api/auth/login");
+  timing = std::string(res["Server-Timing"]);
+  validate_has_timing = false;
+  auto start = Clock::now();
+  for (size_t i = 0; i < requests; ++i) {
+    auto validate = post(socket, buffer, "/api/auth/validate-token");
+    validate_has_timing |= !validate["Server-Timing"].empty();
+  }
+  double rps = requests / std::chrono::duration<double>(Clock::now() - start).count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50)); // 最后一个响应的 onWrite 可能还没执行
+  server.stop();
+  server.join();
+  return rps;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t spans = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+  size_t requests = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 5000;
+  bool ok = true;
+
+  common::RequestTrace trace;
+  std::printf("TraceSpan without trace: %6.1f ns/span\n", spanNs(nullptr, spans));
+  std::printf("TraceSpan with trace:    %6.1f ns/span\n", spanNs(&trace, spans));
+  ok &= trace.spans().size() == 2 && trace.spans()[0].count + trace.spans()[1].count == spans;
+
+  std::string timing;
+  bool validate_timing = false;
+  double off = serve(false, requests, timing, validate_timing);
+  std::printf("server_timing off: %.0f req/s, header \"%s\"\n", off, timing.c_str());
+  ok &= timing.empty() && !validate_timing;
+
+  double on = serve(true, requests, timing, validate_timing);
+  std::printf("server_timing on:  %.0f req/s (%+.1f%%)\n  login: %s\n", on, (on / off - 1) * 100, timing.c_str());
+  double mysql = durationOf(timing, "mysql");
+  double handler = durationOf(timing, "handler");
+  ok &= durationOf(timing, "read") >= 0 && durationOf(timing, "queue") >= 0 && durationOf(timing, "jwt") >= 0;
+  ok &= mysql >= 2.0 && handler >= mysql && timing.find("hash;dur=") != std::string::npos &&
+        timing.find(R"(desc="x2")") != std::string::npos;
+  ok &= validate_timing; // 没有记录阶段的请求仍有 read 和 handler
+
+  // 访问日志: 登录请求带 spans_us, token 校验没有
+  auto& log = common::AccessLog::getInstance();
+  auto log_cfg = config::Config::getInstance().getLog();
+  log_cfg.access_log_path = kLogPath;
+  log.open(log_cfg);
+  serve(false, 1, timing, validate_timing);
+  log.close();
+  std::ifstream in(kLogPath);
+  std::string login_line, validate_line;
+  std::getline(in, login_line);
+  std::getline(in, validate_line);
+  std::printf("access log:\n  %s\n  %s\n", login_line.c_str(), validate_line.c_str());
+  ok &= login_line.find(R"("spans_us":{"queue":)") != std::string::npos &&
+        login_line.find(R"("mysql":)") != std::string::npos &&
+        validate_line.find("spans_us") == std::string::npos && !validate_line.empty();
+  ::unlink(kLogPath.c_str());
+
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,216 @@
+// 分片 redis 成员变更期间的读写一致性: 一个线程不断 SET / DEL / GET 一批 key, 同时加入一个节点、再摘除一个节点。
+// 检查: 迁移前后以及迁移期间读到的都是最后一次写入的值 (删除的 key 读不到, 不会被迁移复活, 切换后写入的新值
+// 不会被旧值覆盖); 迁移结束后每个 key 只留在它的归属节点上。另输出单次读写的最长耗时 (切换哈希环时的暂停)
+// 需要 redis-server (启动 3 个临时实例, 不落盘)
+// 用法: ./sharded_redis_check [redis-server 路径=redis-server] [key 数=2000]
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <hiredis/hiredis.h>
+#include "common/connection_pool/sharded_redis_client.hpp"
+
+namespace {
+
+struct RedisServer {
+  pid_t pid = -1;
+  config::RedisConfig cfg;
+};
+
+RedisServer startServer(const std::string& path, unsigned int port) {
+  RedisServer server{.pid = -1, .cfg = {.host = "127.0.0.1", .port = port}};
+  server.pid = ::fork();
+  if (server.pid == 0) {
+    std::string port_arg = std::to_string(port);
+    ::execlp(path.c_str(), path.c_str(), "--port", port_arg.c_str(), "--save", "", "--appendonly", "no",
+             static_cast<char*>(nullptr));
+    std::perror("exec redis-server");
+    ::_exit(127);
+  }
+  for (int i = 0; i < 100; ++i) {
+    if (redisContext* ctx = redisConnect("127.0.0.1", port); ctx && !ctx->err) {
+      redisFree(ctx);
+      return server;
+    } else if (ctx) {
+      redisFree(ctx);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  std::fprintf(stderr, "redis-server on port %u did not start\n", port);
+  std::exit(1);
+}
+
+void stopServer(const RedisServer& server) {
+  ::kill(server.pid, SIGTERM);
+  ::waitpid(server.pid, nullptr, 0);
+}
+
+std::string keyOf(size_t i) { return "code:{user" + std::to_string(i) + "@example.com}:register"; }
+
+std::optional<std::string> get(common::ShardedRedisClient& client, const std::string& key) {
+  return client.withConnection(key, [&](redisContext* ctx) -> std::optional<std::string> {
+    auto* reply = static_cast<redisReply*>(redisCommand(ctx, "GET %b", key.data(), key.size()));
+    if (!reply) {
+      throw std::runtime_error("GET failed");
+    }
+    std::optional<std::string> value;
+    if (reply->type == REDIS_REPLY_STRING) {
+      value.emplace(reply->str, reply->len);
+    }
+    freeReplyObject(reply);
+    return value;
+  });
+}
+
+void command(common::ShardedRedisClient& client, const std::string& key, const char* format, const std::string& value) {
+  client.withConnection(key, [&](redisContext* ctx) {
+    auto* reply = static_cast<redisReply*>(redisCommand(ctx, format, key.data(), key.size(), value.data(), value.size()));
+    if (!reply || reply->type == REDIS_REPLY_ERROR) {
+      throw std::runtime_error("command failed");
+    }
+    freeReplyObject(reply);
+  });
+}
+
+// 直接连到节点, 列出其上的全部 key
+std::vector<std::string> keysOn(const config::RedisConfig& node) {
+  redisContext* ctx = redisConnect(node.host.c_str(), node.port);
+  std::vector<std::string> keys;
+  std::string cursor = "0";
+  do {
+    auto* reply = static_cast<redisReply*>(redisCommand(ctx, "SCAN %s COUNT 1000", cursor.c_str()));
+    cursor.assign(reply->element[0]->str, reply->element[0]->len);
+    for (size_t i = 0; i < reply->element[1]->elements; ++i) {
+      keys.emplace_back(reply->element[1]->element[i]->str, reply->element[1]->element[i]->len);
+    }
+    freeReplyObject(reply);
+  } while (cursor != "0");
+  redisFree(ctx);
+  return keys;
+}
+
+struct Counters {
+  size_t writes = 0;
+  size_t deletes = 0;
+  size_t reads = 0;
+  size_t stale_reads = 0;
+  double max_op_ms = 0; // 单次读写的最长耗时, 主要是切换哈希环时暂停的时间
+};
+
+// 写线程按 key 轮流 SET / DEL / GET, expected 记录每个 key 最后一次写入的结果; change 在写线程运行期间执行
+Counters runDuring(common::ShardedRedisClient& client, std::vector<std::optional<std::string>>& expected,
+                   const std::function<void()>& change) {
+  Counters counters;
+  std::atomic<bool> changed{false};
+  std::thread writer([&] {
+    // 成员变更结束后再完整地跑两轮, 覆盖切换之后的写入
+    int rounds_after = 0;
+    for (size_t round = 0; rounds_after < 2; ++round) {
+      bool done = changed.load();
+      for (size_t i = 0; i < expected.size(); ++i) {
+        auto key = keyOf(i);
+        auto start = std::chrono::steady_clock::now();
+        switch ((i + round) % 3) {
+          case 0: {
+            auto value = "v" + std::to_string(round) + "-" + std::to_string(i);
+            command(client, key, "SET %b %b", value);
+            expected[i] = value;
+            ++counters.writes;
+            break;
+          }
+          case 1:
+            command(client, key, "DEL %b", "");
+            expected[i].reset();
+            ++counters.deletes;
+            break;
+          default:
+            if (get(client, key) != expected[i]) {
+              ++counters.stale_reads;
+            }
+            ++counters.reads;
+        }
+        counters.max_op_ms = std::max(counters.max_op_ms, std::chrono::duration<double, std::milli>(
+                                                             std::chrono::steady_clock::now() - start).count());
+      }
+      rounds_after += done;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  change();
+  changed = true;
+  writer.join();
+  return counters;
+}
+
+bool verify(common::ShardedRedisClient& client, const std::vector<std::optional<std::string>>& expected,
+            const std::vector<RedisServer>& servers, const char* label, const Counters& counters) {
+  size_t wrong = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (get(client, keyOf(i)) != expected[i]) {
+      ++wrong;
+    }
+  }
+  size_t misplaced = 0;
+  for (const auto& server : servers) {
+    auto id = common::ShardedRedisClient::nodeId(server.cfg);
+    for (const auto& key : keysOn(server.cfg)) {
+      if (client.nodeFor(key) != id) {
+        ++misplaced;
+      }
+    }
+  }
+  std::printf("%-12s %zu writes, %zu deletes, %zu reads: %zu stale reads, %zu wrong values after, %zu misplaced keys; "
+              "longest operation %.1f ms\n",
+              label, counters.writes, counters.deletes, counters.reads, counters.stale_reads, wrong, misplaced,
+              counters.max_op_ms);
+  return counters.stale_reads == 0 && wrong == 0 && misplaced == 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::string redis_server = argc > 1 ? argv[1] : "redis-server";
+  size_t key_count = argc > 2 ? std::stoul(argv[2]) : 2000;
+
+  unsigned int base_port = 20000 + static_cast<unsigned int>(::getpid() % 20000);
+  std::vector<RedisServer> servers;
+  for (unsigned int i = 0; i < 3; ++i) {
+    servers.push_back(startServer(redis_server, base_port + i));
+  }
+
+  config::RedisShardConfig shard_cfg{
+    .nodes = {servers[0].cfg, servers[1].cfg}, .virtual_nodes = 160, .migrate_timeout = std::chrono::milliseconds(2000)};
+  config::ConnectionPoolConfig cp_cfg{.min_connections = 2,
+                                      .max_connections = 8,
+                                      .timeout = std::chrono::milliseconds(5000),
+                                      .idle_timeout = std::chrono::seconds(600)};
+  common::ShardedRedisClient client(shard_cfg, cp_cfg);
+
+  std::vector<std::optional<std::string>> expected(key_count);
+  for (size_t i = 0; i < key_count; ++i) {
+    expected[i] = "v0-" + std::to_string(i);
+    command(client, keyOf(i), "SET %b %b", *expected[i]);
+  }
+
+  bool ok = true;
+  auto added = runDuring(client, expected, [&] { client.addNode(servers[2].cfg); });
+  ok &= verify(client, expected, servers, "add node", added);
+  auto removed = runDuring(client, expected, [&] { client.removeNode(common::ShardedRedisClient::nodeId(servers[0].cfg)); });
+  ok &= verify(client, expected, servers, "remove node", removed);
+
+  for (const auto& server : servers) {
+    stopServer(server);
+  }
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
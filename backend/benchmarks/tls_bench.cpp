@@ -0,0 +1,288 @@
+// TLS: HttpServer 直接终止 TLS 时完整握手和恢复会话 (票据、服务端会话缓存) 的握手吞吐, keep-alive 连接上的请求吞吐与明文对比,
+// 以及票据密钥文件使重启后的服务端仍能恢复之前签发的票据。证书为运行时生成的自签名 P-256 证书, 服务端为单个 io 线程
+// 开环、混合接口的压测见 bench_http (https:// 目标, --reconnect 测握手)
+// cfg.tls_ktls 时测 kTLS; OpenSSL 没有编译 kTLS 或内核没有 tls 模块时服务端退回 OpenSSL, 结果与不开启相同
+// 用法: ./tls_bench [握手次数=2000] [请求数=20000] [ktls=0]
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <boost/beast/ssl.hpp>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include "common/restful/http_server.hpp"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+class PingHandler : public common::RestApiHandlerBase {
+public:
+  PingHandler() {
+    router_.add(http::verb::get, "/ping", [this](common::RequestContext&) {
+      return writeJsonResponse(http::status::ok, [](common::JsonWriter& json) {
+        json.beginObject().key("success").value(true).endObject();
+      });
+    });
+  }
+};
+
+// 自签名证书和私钥写到 dir 下的 cert.pem、key.pem
+void writeCertificate(const fs::path& dir) {
+  EVP_PKEY* key = EVP_EC_gen("P-256");
+  X509* cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, key, EVP_sha256());
+  FILE* out = std::fopen((dir / "cert.pem").c_str(), "w");
+  PEM_write_X509(out, cert);
+  std::fclose(out);
+  out = std::fopen((dir / "key.pem").c_str(), "w");
+  PEM_write_PrivateKey(out, key, nullptr, nullptr, 0, nullptr, nullptr);
+  std::fclose(out);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+}
+
+config::HttpServerConfig serverConfig(const fs::path& dir, bool tls, bool ktls, bool ticket_key) {
+  auto cfg = config::Config::getInstance().getHttpServer();
+  cfg.io_threads = 1;
+  cfg.reuse_port_per_thread = false;
+  cfg.pin_threads = false;
+  cfg.handoff_dir.clear();
+  cfg.admission_max_in_flight = 0;
+  cfg.admission_adaptive = false;
+  cfg.tls_cert_file = tls ? (dir / "cert.pem").string() : "";
+  cfg.tls_key_file = tls ? (dir / "key.pem").string() : "";
+  cfg.tls_ticket_key_file = ticket_key ? (dir / "ticket.key").string() : "";
+  cfg.tls_ktls = ktls;
+  return cfg;
+}
+
+enum class Resume { none, ticket, cache };
+
+// 客户端: 每个连接发送一个请求; resume 时用上一个连接的会话, cache 时不接受票据, 只能靠服务端会话缓存
+struct Client {
+  explicit Client(Resume resume) : resume(resume), context(net::ssl::context::tls_client) {
+    context.set_verify_mode(net::ssl::verify_none);
+    if (resume == Resume::cache) {
+      context.set_options(SSL_OP_NO_TICKET);
+      SSL_CTX_set_max_proto_version(context.native_handle(), TLS1_2_VERSION); // TLS 1.3 只能用票据恢复
+    }
+  }
+  ~Client() {
+    if (session) {
+      SSL_SESSION_free(session);
+    }
+  }
+
+  // 返回响应状态, 握手或读写失败、服务端没有发 close_notify 时为 0; reused 为是否恢复了会话
+  unsigned request(const tcp::endpoint& endpoint, bool& reused, std::string* alpn = nullptr) {
+    net::io_context ioc;
+    beast::ssl_stream<tcp::socket> stream(ioc, context);
+    beast::error_code ec;
+    stream.next_layer().connect(endpoint, ec);
+    stream.next_layer().set_option(tcp::no_delay(true), ec);
+    SSL_set_alpn_protos(stream.native_handle(), reinterpret_cast<const unsigned char*>("\x08http/1.1"), 9);
+    if (resume != Resume::none && session) {
+      SSL_set_session(stream.native_handle(), session);
+    }
+    stream.handshake(net::ssl::stream_base::client, ec);
+    if (ec) {
+      return 0;
+    }
+    reused = SSL_session_reused(stream.native_handle()) == 1;
+    if (alpn) {
+      const unsigned char* data = nullptr;
+      unsigned int size = 0;
+      SSL_get0_alpn_selected(stream.native_handle(), &data, &size);
+      alpn->assign(reinterpret_cast<const char*>(data), size);
+    }
+    http::request<http::empty_body> req{http::verb::get, "/ping", 11};
+    req.set(http::field::host, "localhost");
+    req.keep_alive(false);
+    http::write(stream, req, ec);
+    beast::flat_buffer buffer;
+    http::response<http::string_body> res;
+    if (!ec) {
+      http::read(stream, buffer, res, ec);
+    }
+    if (ec) {
+      return 0;
+    }
+    // 服务端关闭连接前发出 close_notify: 再读得到干净的 EOF, 而不是截断 (stream_truncated)
+    http::response<http::string_body> next;
+    http::read(stream, buffer, next, ec);
+    if (ec != http::error::end_of_stream) {
+      return 0;
+    }
+    // 不再回 close_notify; 标记为已关闭, 否则释放时会话被标为不可恢复
+    SSL_set_shutdown(stream.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    if (resume != Resume::none) {
+      if (SSL_SESSION* next = SSL_get1_session(stream.native_handle())) {
+        if (session) {
+          SSL_SESSION_free(session);
+        }
+        session = next;
+      }
+    }
+    return res.result_int();
+  }
+
+  Resume resume;
+  net::ssl::context context;
+  SSL_SESSION* session = nullptr;
+};
+
+struct HandshakeResult {
+  double per_second;
+  size_t resumed;
+  bool ok;
+};
+
+HandshakeResult handshakes(const tcp::endpoint& endpoint, Resume resume, size_t count) {
+  Client client(resume);
+  bool reused = false;
+  bool ok = client.request(endpoint, reused) == 200; // 第一次总是完整握手, 取得会话
+  size_t resumed = 0;
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    ok &= client.request(endpoint, reused) == 200;
+    resumed += reused;
+  }
+  double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  return {count / seconds, resumed, ok};
+}
+
+// 一个 keep-alive 连接上依次发送 count 个请求, 返回每秒请求数
+template <class Stream>
+double keepAlive(Stream& stream, size_t count, bool& ok) {
+  beast::flat_buffer buffer;
+  auto start = Clock::now();
+  for (size_t i = 0; i < count; ++i) {
+    http::request<http::empty_body> req{http::verb::get, "/ping", 11};
+    req.set(http::field::host, "localhost");
+    http::write(stream, req);
+    http::response<http::string_body> res;
+    http::read(stream, buffer, res);
+    ok &= res.result() == http::status::ok;
+  }
+  return count / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 服务端 metricsText 中某个计数器的值
+double counter(const common::HttpServer& server, std::string_view name) {
+  auto text = server.metricsText();
+  auto pos = text.find(std::string("\n") + std::string(name) + " ");
+  return pos == std::string::npos ? -1 : std::strtod(text.c_str() + pos + name.size() + 2, nullptr);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+  size_t requests = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20000;
+  bool ktls = argc > 3 && std::strtoul(argv[3], nullptr, 10) != 0;
+
+  char dir_template[] = "/tmp/tls_bench.XXXXXX";
+  if (!mkdtemp(dir_template)) {
+    std::perror("mkdtemp");
+    return 1;
+  }
+  fs::path dir = dir_template;
+  writeCertificate(dir);
+  std::string ticket_key(80, '\0');
+  std::mt19937 rng(std::random_device{}());
+  for (auto& c : ticket_key) {
+    c = static_cast<char>(rng());
+  }
+  std::ofstream(dir / "ticket.key", std::ios::binary) << ticket_key;
+
+  bool ok = true;
+  auto handler = std::make_shared<PingHandler>();
+  {
+    common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, handler,
+                              serverConfig(dir, true, ktls, false)};
+    server.run();
+    auto endpoint = server.localEndpoint();
+
+    bool reused = false;
+    std::string alpn;
+    ok &= Client(Resume::none).request(endpoint, reused, &alpn) == 200 && alpn == "http/1.1";
+
+    // 明文请求发到 TLS 端口: 握手失败, 连接被关闭
+    {
+      net::io_context ioc;
+      tcp::socket socket{ioc};
+      socket.connect(endpoint);
+      http::request<http::empty_body> req{http::verb::get, "/ping", 11};
+      http::write(socket, req);
+      beast::flat_buffer buffer;
+      http::response<http::string_body> res;
+      beast::error_code ec;
+      http::read(socket, buffer, res, ec);
+      ok &= ec.failed();
+    }
+
+    std::printf("%zu handshakes per mode, single client, one request per connection\n", count);
+    double before = counter(server, "http_tls_resumed_total");
+    auto full = handshakes(endpoint, Resume::none, count);
+    auto ticket = handshakes(endpoint, Resume::ticket, count);
+    auto cache = handshakes(endpoint, Resume::cache, count);
+    double resumed = counter(server, "http_tls_resumed_total") - before;
+    std::printf("  full handshake        %8.0f conn/s\n", full.per_second);
+    std::printf("  resumed (ticket)      %8.0f conn/s  %zu/%zu resumed\n", ticket.per_second, ticket.resumed, count);
+    std::printf("  resumed (session id)  %8.0f conn/s  %zu/%zu resumed\n", cache.per_second, cache.resumed, count);
+    std::printf("  server: %.0f handshakes, %.0f resumed\n", counter(server, "http_tls_handshakes_total"), resumed);
+    ok &= full.ok && ticket.ok && cache.ok && full.resumed == 0 && ticket.resumed == count && cache.resumed == count;
+    ok &= resumed == static_cast<double>(2 * count);
+
+    net::io_context ioc;
+    net::ssl::context context(net::ssl::context::tls_client);
+    context.set_verify_mode(net::ssl::verify_none);
+    beast::ssl_stream<tcp::socket> stream(ioc, context);
+    stream.next_layer().connect(endpoint);
+    stream.handshake(net::ssl::stream_base::client);
+    std::printf("keep-alive, %zu requests on one connection\n  TLS   %8.0f req/s\n", requests,
+                keepAlive(stream, requests, ok));
+  }
+  {
+    common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, handler,
+                              serverConfig(dir, false, false, false)};
+    server.run();
+    net::io_context ioc;
+    tcp::socket socket{ioc};
+    socket.connect(server.localEndpoint());
+    std::printf("  plain %8.0f req/s\n", keepAlive(socket, requests, ok));
+  }
+
+  // 重启 (新的 TlsContext) 后恢复之前签发的票据: 共用票据密钥文件时可以, 否则随机密钥不同, 只能完整握手
+  for (bool shared_key : {true, false}) {
+    Client client(Resume::ticket);
+    bool reused = false;
+    for (int restart = 0; restart < 2; ++restart) {
+      common::HttpServer server{tcp::endpoint{net::ip::make_address("127.0.0.1"), 0}, handler,
+                                serverConfig(dir, true, ktls, shared_key)};
+      server.run();
+      ok &= client.request(server.localEndpoint(), reused) == 200;
+    }
+    std::printf("ticket after restart, %s: %s\n", shared_key ? "shared ticket key file" : "random ticket keys",
+                reused ? "resumed" : "full handshake");
+    ok &= reused == shared_key;
+  }
+
+  fs::remove_all(dir);
+  std::printf("check: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
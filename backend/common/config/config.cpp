@@ -1,5 +1,7 @@
 #include "config.hpp"
+#include <algorithm>
 #include <chrono>
+#include <thread>
 
 namespace config {
   
@@ -16,6 +18,14 @@ namespace config {
       .port = 6379
     },
 
+    redis_shards_ = {
+      .nodes = {
+        {.host = "127.0.0.1", .port = 6379},
+      },
+      .virtual_nodes = 160,
+      .migrate_timeout = std::chrono::milliseconds(2000)
+    },
+
     database_ = {
       .host = "localhost",
       .user = "root",
@@ -36,12 +46,71 @@ namespace config {
 
     streaming_ = {
       .host = "0.0.0.0",
-      .port = 8080
+      .port = 8080,
+      .async_file_io = true
+    };
+
+    http_server_ = {
+      .io_threads = std::max(1u, std::thread::hardware_concurrency()),
+      .reuse_port_per_thread = false,
+      .pin_threads = true,
+      .cors_max_age_seconds = 86400,
+      .pipeline_depth = 8,
+      .request_arena_bytes = 16 * 1024,
+      .request_arena_max_bytes = 256 * 1024,
+      .request_body_limit = 1024 * 1024,
+      .compression = true,
+      .compression_min_bytes = 1024,
+      .compression_level = 6,
+      .compression_cache_entries = 256,
+      .admission_max_in_flight = 256,
+      .admission_adaptive = true,
+      .admission_min_limit = 16,
+      .admission_max_limit = 4096,
+      .admission_reserved = 32,
+      .admission_queue_timeout_ms = 1000,
+      .admission_retry_after_seconds = 1,
+      .max_connections = 100000,
+      .idle_timeout_seconds = 30,
+      .write_timeout_seconds = 30,
+      .timer_tick_ms = 100,
+      .metrics_path = "",
+      .server_timing = false,
+      .drain_timeout_seconds = 30,
+      .handoff_dir = "",
+      .http2 = true,
+      .http2_max_concurrent_streams = 100,
+      .http2_window_bytes = 1024 * 1024,
+      .tls_cert_file = "",
+      .tls_key_file = "",
+      .tls_session_cache_size = 20480,
+      .tls_session_timeout_seconds = 7200,
+      .tls_ticket_key_file = "",
+      .tls_ktls = false
+    };
+
+    log_ = {
+      .access_log_path = "access.log",
+      .ring_records = 16384,
+      .flush_interval_ms = 50
     };
 
     auth_ = {
       .jwt_secret = "your-secret-key",
-      .jwt_expire_hours = 24
+      .jwt_expire_hours = 24,
+      .vericode_expire_seconds = 300,
+      .vericode_max_attempts = 5,
+      .vericode_resend_seconds = 60,
+      .vericode_max_sends = 10,
+      .vericode_send_window_seconds = 3600
+    };
+
+    rate_limit_ = {
+      .ip_rate = 5,
+      .ip_burst = 20,
+      .email_rate = 1.0 / 60,
+      .email_burst = 5,
+      .max_keys = 100000
     };
 
     format_ = {
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <chrono>
+#include <vector>
 
 namespace config {
 
@@ -27,6 +29,13 @@ struct RedisConfig {
   unsigned int port;
 };
 
+// 多个redis节点按一致性哈希分片
+struct RedisShardConfig {
+  std::vector<RedisConfig> nodes;
+  size_t virtual_nodes; // 每个节点在哈希环上的虚拟节点数
+  std::chrono::milliseconds migrate_timeout; // 节点变更时 MIGRATE 单批次超时
+};
+
 struct VideoStorageFormatConfig {
   std::string format;
   std::string codec_lib;
@@ -40,14 +49,90 @@ struct GrpcServiceConfig {
   int port;
 };
 
+struct HttpServerConfig {
+  size_t io_threads; // 运行 io_context 的线程数
+  // false: 所有线程共享一个 io_context 和 acceptor
+  // true: 每个线程一个 io_context, 各自持有绑定同一端口的 SO_REUSEPORT acceptor, 连接不会跨线程迁移
+  bool reuse_port_per_thread;
+  bool pin_threads; // reuse_port_per_thread 时把第 i 个线程绑定到第 i 个 CPU
+  int cors_max_age_seconds; // 预检响应的 Access-Control-Max-Age, 浏览器在此期间不再重复预检
+  // 每个连接最多同时排队的流水线请求数 (处理中和等待写出的), 达到后暂停读取; 1 表示读完一个请求就等待其响应写完
+  size_t pipeline_depth;
+  size_t request_arena_bytes; // 请求 arena 初始大小, 每个排队中的请求一个, 按需创建后随连接复用
+  size_t request_arena_max_bytes; // arena 按用量扩大的上限, 超过部分 (如大文件上传) 每次向全局堆申请
+  uint64_t request_body_limit; // 请求 body 的默认上限, 路由可以单独设置; Content-Length 超过时不读 body 直接回复 413
+  bool compression; // 按 Accept-Encoding 对 JSON/文本/m3u8 响应做 gzip 或 deflate 压缩
+  size_t compression_min_bytes; // 小于该大小的 body 不压缩
+  int compression_level; // zlib 压缩级别 0-9, -1 为 zlib 的默认级别; 超出范围时 HttpServer 启动时修正到范围内
+  size_t compression_cache_entries; // 带 ETag 的响应的压缩结果缓存条数, 0 表示不缓存
+  size_t admission_max_in_flight; // 同时处理的请求数上限 (自适应模式下为初始值), 超出时返回 503, 0 表示不限制
+  bool admission_adaptive; // 按处理耗时在 [admission_min_limit, admission_max_limit] 内自动调整上限
+  size_t admission_min_limit;
+  size_t admission_max_limit;
+  size_t admission_reserved; // 轻量接口 (不进线程池的请求, 如 token 校验) 额外保留的名额
+  int admission_queue_timeout_ms; // 在线程池中排队超过该时间的请求不再执行, 直接返回 503; 0 表示不限制
+  int admission_retry_after_seconds; // 503 响应的 Retry-After
+  // 同时保持的连接数上限, 达到后关闭最久空闲的 keep-alive 连接, 没有空闲连接时拒绝新连接; 0 表示不限制
+  // reuse_port_per_thread 时平分给各个线程
+  size_t max_connections;
+  int idle_timeout_seconds; // 等待并读取下一个请求的超时
+  int write_timeout_seconds; // 写出一个响应的超时
+  int timer_tick_ms; // 连接超时的精度
+  // 以 Prometheus 文本格式导出请求指标的 GET 路由, 为空时不导出 (仍然统计)。该路由与业务接口在同一端口上且不做鉴权,
+  // 会暴露路由、流量和内部状态, 默认关闭; 开启时应在反向代理或防火墙处只允许内部抓取
+  std::string metrics_path;
+  // 调试用: 响应带 Server-Timing 头, 列出读取、排队、处理函数及其中 redis/mysql 等各阶段的耗时 (见 RequestTrace);
+  // 会向客户端暴露内部耗时, 生产环境应关闭。访问日志启用时各阶段耗时总是写入日志
+  bool server_timing;
+  int drain_timeout_seconds; // 优雅退出时等待进行中的请求写完的上限, 超时后直接停止
+  // 热重启: 在该目录下的 http-<端口>.sock 上与新进程交接监听 socket, 为空时不启用; 端口为 0 时不启用。
+  // 目录必须归本用户所有且其他用户不可写 (如 0700 的 $XDG_RUNTIME_DIR 子目录), 否则不启用, 见 handoff::checkDirectory
+  std::string handoff_dir;
+  // 接受以 HTTP/2 前言开头的明文连接 (h2c prior knowledge), 需要以 ENABLE_HTTP2 编译; 未启用时前言按 HTTP/1 的无效请求处理
+  bool http2;
+  uint32_t http2_max_concurrent_streams; // 每个 HTTP/2 连接同时打开的流数上限
+  uint32_t http2_window_bytes; // HTTP/2 每个流 (及整个连接) 的接收窗口, 流式上传时暂存的 body 不超过它
+  // TLS: 证书链和私钥 (PEM) 都设置时端口只接受 TLS 连接, 需要以 ENABLE_TLS 编译; 为空时为明文。见 TlsContext
+  std::string tls_cert_file;
+  std::string tls_key_file;
+  size_t tls_session_cache_size; // 服务端会话缓存的条数, 所有线程共享; 0 表示不缓存 (仍然可以用会话票据恢复)
+  int tls_session_timeout_seconds; // 缓存的会话和签发的票据的有效期
+  // 会话票据密钥 (80 字节的文件), 多个进程、热重启前后使用同一文件时签发的票据互相通用; 为空时每个进程随机生成
+  std::string tls_ticket_key_file;
+  // 握手后由内核加解密 (kTLS), 连接按明文 socket 读写; 需要 OpenSSL 编译了 kTLS 且内核加载了 tls 模块, 否则仍用 OpenSSL
+  bool tls_ktls;
+};
+
+// 异步访问日志和事件日志, 见 common/logging/access_log.hpp
+struct LogConfig {
+  std::string access_log_path; // 为空时不记录访问日志, 事件直接写 stderr
+  size_t ring_records; // 每个线程的队列容量 (条), 向上取 2 的幂; 写线程来不及写出时丢弃新记录
+  int flush_interval_ms; // 写线程收集并写出的间隔
+};
+
 struct StreamingConfig {
   std::string host;
   int port;
+  bool async_file_io; // 以 io_uring 异步读取 HLS 分片, 需要以 ENABLE_IO_URING 编译, 否则仍在 io 线程上阻塞读取
 };
 
 struct AuthConfig {
   std::string jwt_secret;
   int jwt_expire_hours;
+  int vericode_expire_seconds;       // 验证码有效期
+  int vericode_max_attempts;         // 验证码允许输错的次数, 用尽后验证码作废
+  int vericode_resend_seconds;       // 同一邮箱两次发送验证码的最小间隔
+  int vericode_max_sends;            // 同一邮箱在 vericode_send_window_seconds 内最多发送次数
+  int vericode_send_window_seconds;
+};
+
+// 进程内令牌桶限流, 目前用于登录和发送验证码的接口
+struct RateLimitConfig {
+  double ip_rate; // 每个客户端 IP 每秒补充的令牌数
+  double ip_burst; // 桶容量, 允许的突发请求数
+  double email_rate; // 每个邮箱每秒补充的令牌数
+  double email_burst;
+  size_t max_keys; // 每种 key 最多跟踪的桶数, 超出时淘汰最久未访问的
 };
 
 struct SMTPConfig {
@@ -75,10 +160,14 @@ Config& operator=(Config&&) = delete;
 // Getters
 const DatabaseConfig& getDatabase() const { return database_; }
 const RedisConfig& getRedis() const { return redis_ ;}
+const RedisShardConfig& getRedisShards() const { return redis_shards_; }
 const GrpcServiceConfig& getUserService() const { return user_service_; }
 const GrpcServiceConfig& getVideoService() const { return video_service_; }
 const StreamingConfig& getStreaming() const { return streaming_; }
+const HttpServerConfig& getHttpServer() const { return http_server_; }
+const LogConfig& getLog() const { return log_; }
 const AuthConfig& getAuth() const { return auth_; }
+const RateLimitConfig& getRateLimit() const { return rate_limit_; }
 const VideoStorageFormatConfig& getFormat() const { return format_; }
 const SMTPConfig& getSMTP() const { return smtp_; }
 const ConnectionPoolConfig& getDBCntPool() const { return db_cp_; }
@@ -91,11 +180,15 @@ private:
   Config();
 
   RedisConfig redis_;
+  RedisShardConfig redis_shards_;
   DatabaseConfig database_;
   GrpcServiceConfig user_service_;
   GrpcServiceConfig video_service_;
   StreamingConfig streaming_;
+  HttpServerConfig http_server_;
+  LogConfig log_;
   AuthConfig auth_;
+  RateLimitConfig rate_limit_;
   VideoStorageFormatConfig format_;
   SMTPConfig smtp_;
   ConnectionPoolConfig db_cp_;
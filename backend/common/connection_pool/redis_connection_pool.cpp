@@ -20,12 +20,17 @@ RedisConnection& RedisConnection::operator=(RedisConnection&& other) noexcept {
 bool RedisConnection::isValid() const {
   if (!conn_) return false;
   redisReply* reply = (redisReply*)redisCommand(conn_, "ping");
-  bool result = !std::strcmp(reply->str, "PONG");
+  if (!reply) return false;
+  bool result = reply->type == REDIS_REPLY_STATUS && !std::strcmp(reply->str, "PONG");
   freeReplyObject(reply);
   return result;
 }
 
-RedisConnectionPool::RedisConnectionPool() : ConnectionPool(config::Config::getInstance().getDBCntPool()), redis_config_(config::Config::getInstance().getRedis()) {
+RedisConnectionPool::RedisConnectionPool()
+  : RedisConnectionPool(config::Config::getInstance().getRedis(), config::Config::getInstance().getDBCntPool()) {}
+
+RedisConnectionPool::RedisConnectionPool(const config::RedisConfig& redis_cfg, const config::ConnectionPoolConfig& cp_cfg)
+  : ConnectionPool(cp_cfg), redis_config_(redis_cfg) {
   for (size_t i = 0; i < cp_config_.min_connections; ++i) {
     auto conn = createConnection();
     if (conn) {
@@ -30,8 +30,12 @@ public:
     static RedisConnectionPool instance;
     return instance;
   }
+  // 分片时每个节点各持有一个连接池
+  RedisConnectionPool(const config::RedisConfig& redis_cfg, const config::ConnectionPoolConfig& cp_cfg);
   std::unique_ptr<Connection> createConnection() override;
 
+  const config::RedisConfig& redisConfig() const { return redis_config_; }
+
 private:
   RedisConnectionPool();
   config::RedisConfig redis_config_;
@@ -0,0 +1,77 @@
+#include "redis_script.hpp"
+#include <openssl/evp.h>
+#include <stdexcept>
+
+namespace common {
+
+namespace {
+
+redisReply* evalCommand(redisContext* ctx, std::string_view command, const std::string& script,
+                        const std::vector<std::string>& keys, const std::vector<std::string>& args) {
+  // EVAL/EVALSHA script numkeys key... arg...
+  std::string numkeys = std::to_string(keys.size());
+  std::vector<const char*> argv;
+  std::vector<size_t> argvlen;
+  argv.reserve(3 + keys.size() + args.size());
+  argvlen.reserve(3 + keys.size() + args.size());
+
+  auto push = [&](std::string_view arg) {
+    argv.push_back(arg.data());
+    argvlen.push_back(arg.size());
+  };
+  push(command);
+  push(script);
+  push(numkeys);
+  for (const auto& key : keys) push(key);
+  for (const auto& arg : args) push(arg);
+
+  return (redisReply*)redisCommandArgv(ctx, static_cast<int>(argv.size()), argv.data(), argvlen.data());
+}
+
+} // namespace
+
+RedisScript::RedisScript(std::string source) : source_(std::move(source)) {
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_len = 0;
+  if (EVP_Digest(source_.data(), source_.size(), digest, &digest_len, EVP_sha1(), nullptr) != 1) {
+    throw std::runtime_error("Failed to compute sha1 of redis script");
+  }
+
+  static constexpr char hex[] = "0123456789abcdef";
+  sha1_.reserve(digest_len * 2);
+  for (unsigned int i = 0; i < digest_len; i++) {
+    sha1_ += hex[digest[i] >> 4];
+    sha1_ += hex[digest[i] & 0x0f];
+  }
+}
+
+redisReply* RedisScript::eval(redisContext* ctx, const std::vector<std::string>& keys,
+                              const std::vector<std::string>& args) const {
+  redisReply* reply = evalCommand(ctx, "EVALSHA", sha1_, keys, args);
+  if (reply && reply->type == REDIS_REPLY_ERROR &&
+      std::string_view(reply->str, reply->len).starts_with("NOSCRIPT")) {
+    freeReplyObject(reply);
+    reply = evalCommand(ctx, "EVAL", source_, keys, args);
+  }
+  return reply;
+}
+
+const RedisScript& RedisScriptRegistry::registerScript(const std::string& name, std::string source) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = scripts_.find(name);
+  if (it == scripts_.end()) {
+    it = scripts_.emplace(name, std::make_unique<RedisScript>(std::move(source))).first;
+  }
+  return *it->second;
+}
+
+const RedisScript& RedisScriptRegistry::get(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = scripts_.find(name);
+  if (it == scripts_.end()) {
+    throw std::runtime_error("Redis script not registered: " + name);
+  }
+  return *it->second;
+}
+
+} // namespace common
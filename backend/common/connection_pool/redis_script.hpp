@@ -0,0 +1,60 @@
+#pragma once
+
+#include <hiredis/hiredis.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace common {
+
+/*
+  服务端Lua脚本, 整个脚本在redis内原子执行, 一次往返完成"读-判断-写"。
+  sha1 在本地计算, 调用时先发 EVALSHA; 若该节点尚未缓存脚本(NOSCRIPT),
+  退回 EVAL 发送脚本原文, redis 会同时缓存它, 之后该节点上只需 EVALSHA。
+*/
+class RedisScript {
+public:
+  explicit RedisScript(std::string source);
+
+  const std::string& sha1() const { return sha1_; }
+  const std::string& source() const { return source_; }
+
+  // 返回的 reply 由调用方 freeReplyObject, 连接异常时返回 nullptr
+  redisReply* eval(redisContext* ctx, const std::vector<std::string>& keys,
+                   const std::vector<std::string>& args) const;
+
+private:
+  std::string source_;
+  std::string sha1_;
+};
+
+class RedisScriptRegistry {
+public:
+  static RedisScriptRegistry& getInstance() {
+    static RedisScriptRegistry instance;
+    return instance;
+  }
+
+  RedisScriptRegistry(const RedisScriptRegistry&) = delete;
+  RedisScriptRegistry& operator=(const RedisScriptRegistry&) = delete;
+
+  // 同名脚本只注册一次, 返回的引用在进程生命周期内有效
+  const RedisScript& registerScript(const std::string& name, std::string source);
+  const RedisScript& get(const std::string& name) const;
+
+  redisReply* eval(redisContext* ctx, const std::string& name, const std::vector<std::string>& keys,
+                   const std::vector<std::string>& args) const {
+    return get(name).eval(ctx, keys, args);
+  }
+
+private:
+  RedisScriptRegistry() = default;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::unique_ptr<RedisScript>> scripts_;
+};
+
+} // namespace common
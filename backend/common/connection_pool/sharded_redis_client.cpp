@@ -0,0 +1,303 @@
+#include "sharded_redis_client.hpp"
+#include <algorithm>
+#include <hiredis/hiredis.h>
+#include <stdexcept>
+
+namespace common {
+
+namespace {
+
+redisReply* commandArgv(redisContext* ctx, const std::vector<std::string>& args) {
+  std::vector<const char*> argv;
+  std::vector<size_t> argvlen;
+  argv.reserve(args.size());
+  argvlen.reserve(args.size());
+  for (const auto& arg : args) {
+    argv.push_back(arg.data());
+    argvlen.push_back(arg.size());
+  }
+  return (redisReply*)redisCommandArgv(ctx, static_cast<int>(argv.size()), argv.data(), argvlen.data());
+}
+
+// 出错时抛出 std::runtime_error, what 为出错的操作
+void runCommand(redisContext* ctx, const std::vector<std::string>& args, const std::string& what) {
+  redisReply* reply = commandArgv(ctx, args);
+  if (reply == nullptr) {
+    throw std::runtime_error(what + " failed, connection may be lost");
+  }
+  // MIGRATE 返回 NOKEY: 扫描之后 key 已过期或被删除, 可以忽略
+  if (reply->type == REDIS_REPLY_ERROR) {
+    std::string error(reply->str, reply->len);
+    freeReplyObject(reply);
+    throw std::runtime_error(what + " failed: " + error);
+  }
+  freeReplyObject(reply);
+}
+
+} // namespace
+
+void ConsistentHashRing::addNode(const std::string& node_id) {
+  for (size_t i = 0; i < virtual_nodes_; ++i) {
+    points_.emplace_back(hash(node_id + "#" + std::to_string(i)), node_id);
+  }
+  std::sort(points_.begin(), points_.end());
+}
+
+void ConsistentHashRing::removeNode(const std::string& node_id) {
+  std::erase_if(points_, [&node_id](const auto& point) { return point.second == node_id; });
+}
+
+const std::string* ConsistentHashRing::nodeFor(std::string_view key) const {
+  if (points_.empty()) {
+    return nullptr;
+  }
+  uint64_t h = hash(hashTag(key));
+  auto it = std::lower_bound(points_.begin(), points_.end(), h,
+                             [](const auto& point, uint64_t value) { return point.first < value; });
+  if (it == points_.end()) {
+    it = points_.begin(); // 环尾回绕到环首
+  }
+  return &it->second;
+}
+
+uint64_t ConsistentHashRing::hash(std::string_view data) {
+  // FNV-1a 64, 再用 murmur3 的 fmix64 打散, 使相似的虚拟节点名也能均匀分布
+  uint64_t h = 14695981039346656037ull;
+  for (unsigned char c : data) {
+    h ^= c;
+    h *= 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+std::string_view ConsistentHashRing::hashTag(std::string_view key) {
+  auto open = key.find('{');
+  if (open == std::string_view::npos) {
+    return key;
+  }
+  auto close = key.find('}', open + 1);
+  if (close == std::string_view::npos || close == open + 1) {
+    return key;
+  }
+  return key.substr(open + 1, close - open - 1);
+}
+
+ShardedRedisClient::ShardedRedisClient(const config::RedisShardConfig& shard_cfg,
+                                       const config::ConnectionPoolConfig& cp_cfg)
+  : shard_cfg_(shard_cfg), cp_config_(cp_cfg), ring_(shard_cfg.virtual_nodes) {
+  for (const auto& node : shard_cfg_.nodes) {
+    auto id = nodeId(node);
+    if (shards_.contains(id)) {
+      continue;
+    }
+    shards_.emplace(id, Shard{node, std::make_shared<RedisConnectionPool>(node, cp_config_)});
+    ring_.addNode(id);
+  }
+}
+
+std::string ShardedRedisClient::nodeId(const config::RedisConfig& node) {
+  return node.host + ":" + std::to_string(node.port);
+}
+
+std::shared_ptr<RedisConnectionPool> ShardedRedisClient::poolFor(std::string_view key) const {
+  std::shared_lock lock(mutex_);
+  return poolForLocked(key);
+}
+
+std::shared_ptr<RedisConnectionPool> ShardedRedisClient::poolForLocked(std::string_view key) const {
+  auto node = ring_.nodeFor(key);
+  if (!node) {
+    throw std::runtime_error("No redis node available");
+  }
+  return shards_.at(*node).pool;
+}
+
+std::shared_lock<std::shared_mutex> ShardedRedisClient::routingLock() const {
+  std::lock_guard gate(switch_gate_);
+  return std::shared_lock(mutex_);
+}
+
+std::string ShardedRedisClient::nodeFor(std::string_view key) const {
+  std::shared_lock lock(mutex_);
+  auto node = ring_.nodeFor(key);
+  return node ? *node : std::string{};
+}
+
+std::vector<std::string> ShardedRedisClient::nodes() const {
+  std::shared_lock lock(mutex_);
+  std::vector<std::string> result;
+  result.reserve(shards_.size());
+  for (const auto& [id, shard] : shards_) {
+    result.push_back(id);
+  }
+  return result;
+}
+
+void ShardedRedisClient::addNode(const config::RedisConfig& node) {
+  std::lock_guard membership(membership_mutex_);
+  auto id = nodeId(node);
+
+  ShardMap sources, targets;
+  ConsistentHashRing next_ring(shard_cfg_.virtual_nodes);
+  {
+    std::shared_lock lock(mutex_);
+    if (shards_.contains(id)) {
+      return;
+    }
+    sources = shards_;
+    next_ring = ring_;
+  }
+
+  targets = sources;
+  targets.emplace(id, Shard{node, std::make_shared<RedisConnectionPool>(node, cp_config_)});
+  next_ring.addNode(id);
+  rebalance(sources, std::move(targets), std::move(next_ring));
+}
+
+void ShardedRedisClient::removeNode(const std::string& node_id) {
+  std::lock_guard membership(membership_mutex_);
+
+  ShardMap sources, targets;
+  ConsistentHashRing next_ring(shard_cfg_.virtual_nodes);
+  {
+    std::shared_lock lock(mutex_);
+    auto it = shards_.find(node_id);
+    if (it == shards_.end()) {
+      return;
+    }
+    sources.emplace(*it);
+    targets = shards_;
+    next_ring = ring_;
+  }
+
+  targets.erase(node_id);
+  next_ring.removeNode(node_id);
+  if (next_ring.empty()) {
+    throw std::runtime_error("Cannot remove the last redis node: " + node_id);
+  }
+  // 正在使用中的连接由 shared_ptr 保持, 归还后随连接池一起释放
+  rebalance(sources, std::move(targets), std::move(next_ring));
+}
+
+void ShardedRedisClient::rebalance(const ShardMap& sources, ShardMap targets, ConsistentHashRing next_ring) {
+  setJournal(&next_ring);
+  try {
+    migrate(sources, targets, next_ring, Pass::copy);
+    std::lock_guard gate(switch_gate_);
+    std::unique_lock lock(mutex_);
+    syncJournal(targets, next_ring);
+    shards_ = targets;
+    ring_ = next_ring;
+    journal_ring_ = nullptr;
+    journal_.clear();
+  } catch (...) {
+    setJournal(nullptr);
+    throw;
+  }
+  migrate(sources, targets, next_ring, Pass::purge);
+}
+
+void ShardedRedisClient::setJournal(const ConsistentHashRing* next_ring) {
+  std::lock_guard gate(switch_gate_);
+  std::unique_lock lock(mutex_);
+  journal_ring_ = next_ring;
+  journal_.clear();
+}
+
+void ShardedRedisClient::journal(std::string_view key) const {
+  // 调用方持有共享锁, ring_ 非空
+  if (*ring_.nodeFor(key) != *journal_ring_->nodeFor(key)) {
+    std::lock_guard lock(journal_mutex_);
+    journal_.emplace(key);
+  }
+}
+
+void ShardedRedisClient::migrate(const ShardMap& sources, const ShardMap& targets, const ConsistentHashRing& ring,
+                                 Pass pass) {
+  for (const auto& [id, shard] : sources) {
+    migrateFrom(id, shard, targets, ring, pass);
+  }
+}
+
+void ShardedRedisClient::migrateFrom(const std::string& source_id, const Shard& source, const ShardMap& targets,
+                                     const ConsistentHashRing& ring, Pass pass) {
+  RedisConnectionGuard conn_guard(*source.pool);
+  std::string cursor = "0";
+  const std::string timeout = std::to_string(shard_cfg_.migrate_timeout.count());
+
+  do {
+    redisReply* reply = (redisReply*)redisCommand(conn_guard.get(), "SCAN %s COUNT 512", cursor.c_str());
+    if (reply == nullptr) {
+      throw std::runtime_error("SCAN on " + source_id + " failed, connection may be lost");
+    }
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+      freeReplyObject(reply);
+      throw std::runtime_error("Unexpected SCAN reply from " + source_id);
+    }
+
+    cursor.assign(reply->element[0]->str, reply->element[0]->len);
+    std::unordered_map<std::string, std::vector<std::string>> batches; // 目标节点 -> keys
+    const redisReply* keys = reply->element[1];
+    for (size_t i = 0; i < keys->elements; ++i) {
+      std::string_view key(keys->element[i]->str, keys->element[i]->len);
+      auto owner = ring.nodeFor(key);
+      if (owner && *owner != source_id) {
+        batches[*owner].emplace_back(key);
+      }
+    }
+    freeReplyObject(reply);
+
+    for (const auto& [target_id, batch] : batches) {
+      if (pass == Pass::purge) {
+        std::vector<std::string> args = {"DEL"};
+        args.insert(args.end(), batch.begin(), batch.end());
+        runCommand(conn_guard.get(), args, "DEL on " + source_id);
+        continue;
+      }
+
+      const auto& target = targets.at(target_id).cfg;
+      // MIGRATE host port "" 0 timeout COPY REPLACE KEYS k1 k2 ...
+      std::vector<std::string> args = {"MIGRATE", target.host, std::to_string(target.port), "", "0", timeout,
+                                       "COPY", "REPLACE", "KEYS"};
+      args.insert(args.end(), batch.begin(), batch.end());
+      runCommand(conn_guard.get(), args, "MIGRATE from " + source_id + " to " + target_id);
+    }
+  } while (cursor != "0");
+}
+
+void ShardedRedisClient::syncJournal(const ShardMap& targets, const ConsistentHashRing& next_ring) {
+  // 源节点 -> 目标节点 -> keys
+  std::unordered_map<std::string, std::unordered_map<std::string, std::vector<std::string>>> batches;
+  for (const auto& key : journal_) {
+    batches[*ring_.nodeFor(key)][*next_ring.nodeFor(key)].push_back(key);
+  }
+  const std::string timeout = std::to_string(shard_cfg_.migrate_timeout.count());
+
+  for (const auto& [source_id, by_target] : batches) {
+    RedisConnectionGuard source_guard(*shards_.at(source_id).pool);
+    for (const auto& [target_id, keys] : by_target) {
+      const auto& target = targets.at(target_id);
+      RedisConnectionGuard target_guard(*target.pool);
+      for (size_t begin = 0; begin < keys.size(); begin += 512) {
+        auto first = keys.begin() + begin;
+        auto last = keys.begin() + std::min(keys.size(), begin + 512);
+        // 复制之后在源节点上被删除的 key 不能留在目标节点上; 仍存在的随后由 MIGRATE 复制回来
+        std::vector<std::string> del = {"DEL"};
+        del.insert(del.end(), first, last);
+        runCommand(target_guard.get(), del, "DEL on " + target_id);
+
+        std::vector<std::string> args = {"MIGRATE", target.cfg.host, std::to_string(target.cfg.port), "", "0",
+                                         timeout, "COPY", "REPLACE", "KEYS"};
+        args.insert(args.end(), first, last);
+        runCommand(source_guard.get(), args, "MIGRATE from " + source_id + " to " + target_id);
+      }
+    }
+  }
+}
+
+} // namespace common
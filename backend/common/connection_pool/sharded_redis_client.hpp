@@ -0,0 +1,133 @@
+#pragma once
+
+#include "common/config/config.hpp"
+#include "common/connection_pool/redis_connection_pool.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace common {
+
+/*
+  一致性哈希环: 每个节点在环上放置 virtual_nodes 个虚拟点,
+  key 归属于顺时针方向遇到的第一个虚拟点对应的节点。
+  增删一个节点只会影响相邻区间内的 key, 其余 key 的归属不变。
+*/
+class ConsistentHashRing {
+public:
+  explicit ConsistentHashRing(size_t virtual_nodes) : virtual_nodes_(virtual_nodes) {}
+
+  void addNode(const std::string& node_id);
+  void removeNode(const std::string& node_id);
+
+  // 环为空时返回 nullptr
+  const std::string* nodeFor(std::string_view key) const;
+  bool empty() const { return points_.empty(); }
+
+  static uint64_t hash(std::string_view data);
+  // hash tag: "code:{a@b.com}" 只对 "a@b.com" 计算哈希, 使同一tag的多个key落在同一节点
+  // 规则与 redis cluster 相同: 取第一个 '{' 与其后第一个 '}' 之间的非空内容, 否则取整个key
+  static std::string_view hashTag(std::string_view key);
+
+private:
+  size_t virtual_nodes_;
+  std::vector<std::pair<uint64_t, std::string>> points_; // 按哈希值升序
+};
+
+/*
+  分片redis客户端: 每个节点持有一个独立的 RedisConnectionPool,
+  key 经一致性哈希路由到节点。成员变更时在后台把受影响的 key 迁移到新归属节点。
+*/
+class ShardedRedisClient {
+public:
+  static ShardedRedisClient& getInstance() {
+    static ShardedRedisClient instance(config::Config::getInstance().getRedisShards(),
+                                       config::Config::getInstance().getDBCntPool());
+    return instance;
+  }
+
+  ShardedRedisClient(const config::RedisShardConfig& shard_cfg, const config::ConnectionPoolConfig& cp_cfg);
+
+  ShardedRedisClient(const ShardedRedisClient&) = delete;
+  ShardedRedisClient& operator=(const ShardedRedisClient&) = delete;
+
+  // 返回的 shared_ptr 保证节点被摘除后, 正在使用中的连接池仍然有效;
+  // 不与迁移同步, 迁移期间经它写入的 key 可能留在旧节点上, 读写 key 应使用 withConnection
+  std::shared_ptr<RedisConnectionPool> poolFor(std::string_view key) const;
+  std::string nodeFor(std::string_view key) const;
+
+  // 从 key 所在节点借出一个连接执行 f(redisContext*), 返回 f 的结果。
+  // 执行期间持有路由的共享锁, 迁移切换哈希环前会等待正在执行的 f 完成; f 中不能再调用 withConnection
+  template <class F>
+  auto withConnection(std::string_view key, F&& f) {
+    auto lock = routingLock();
+    auto pool = poolForLocked(key);
+    if (journal_ring_) {
+      journal(key);
+    }
+    RedisConnectionGuard guard(*pool);
+    return std::forward<F>(f)(guard.get());
+  }
+
+  // 加入节点后, 原节点上改为归属新节点的 key 会被迁移过去
+  void addNode(const config::RedisConfig& node);
+  // 摘除前先把该节点上的 key 迁往新的归属节点
+  void removeNode(const std::string& node_id);
+
+  std::vector<std::string> nodes() const;
+  static std::string nodeId(const config::RedisConfig& node);
+
+private:
+  struct Shard {
+    config::RedisConfig cfg;
+    std::shared_ptr<RedisConnectionPool> pool;
+  };
+
+  using ShardMap = std::unordered_map<std::string, Shard>;
+
+  /*
+    切换哈希环之前源节点始终是 key 的唯一写入位置, 切换之后新归属节点是; 迁移不会用旧值覆盖切换后的写入:
+    1. copy: 不暂停读写, 用 MIGRATE COPY REPLACE 把 key 复制到新归属节点; 开始前打开写入日志,
+       此后 withConnection 访问的、归属将改变的 key 都记入 journal_
+    2. sync: 暂停 withConnection (等正在执行的完成), 只重新同步日志中的 key: 先从新归属节点上删除,
+       再从源节点复制 (期间被删除的 key 源节点上已没有, 不会复活), 然后切换哈希环、关闭日志, 恢复读写
+    3. purge: 切换后源节点不再收到这些 key 的读写, 用 DEL 删除源节点上的副本
+    暂停时间只与复制期间被访问的 key 数有关, 不再扫描源节点; 第 2 步失败时哈希环不切换, 源节点上的数据不受影响。
+    未经 withConnection 的过期由 MIGRATE 带过去的 TTL 在新归属节点上同样生效
+  */
+  enum class Pass { copy, purge };
+
+  void rebalance(const ShardMap& sources, ShardMap targets, ConsistentHashRing next_ring);
+  void migrate(const ShardMap& sources, const ShardMap& targets, const ConsistentHashRing& ring, Pass pass);
+  void migrateFrom(const std::string& source_id, const Shard& source, const ShardMap& targets,
+                   const ConsistentHashRing& ring, Pass pass);
+  // 在持有 mutex_ 独占锁、ring_ 仍为旧环时调用
+  void syncJournal(const ShardMap& targets, const ConsistentHashRing& next_ring);
+  // 打开 (next_ring 非空) 或关闭写入日志; 等正在执行的 withConnection 完成, 之后的调用都能看到
+  void setJournal(const ConsistentHashRing* next_ring);
+  void journal(std::string_view key) const;
+
+  std::shared_lock<std::shared_mutex> routingLock() const;
+  std::shared_ptr<RedisConnectionPool> poolForLocked(std::string_view key) const;
+
+  config::RedisShardConfig shard_cfg_;
+  config::ConnectionPoolConfig cp_config_;
+
+  std::mutex membership_mutex_; // 串行化成员变更
+  mutable std::mutex switch_gate_; // 切换哈希环时持有, 使新的 withConnection 排队而不是让切换一直等不到写锁
+  mutable std::shared_mutex mutex_; // 保护 ring_、shards_ 与 journal_ring_; withConnection 执行期间持有共享锁
+  ConsistentHashRing ring_;
+  ShardMap shards_;
+  const ConsistentHashRing* journal_ring_ = nullptr; // 迁移期间为新的哈希环, 不为空时记录写入日志
+  mutable std::mutex journal_mutex_;
+  mutable std::unordered_set<std::string> journal_; // 迁移期间访问过、归属将改变的 key
+};
+
+} // namespace common
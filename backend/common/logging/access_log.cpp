@@ -0,0 +1,398 @@
+#include "access_log.hpp"
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+
+namespace common {
+
+namespace {
+
+// 格式化直接写进栈上的行缓冲区, 整行再一次追加到输出, 避免每个字段都检查 std::string 的容量
+class LineWriter {
+public:
+  // 一行的上限: 两个字符串字段和各阶段名全部需要 \u00XX 转义时也放得下
+  static constexpr size_t kMaxLine = 2048;
+
+  void put(std::string_view value) {
+    std::memcpy(p_, value.data(), value.size());
+    p_ += value.size();
+  }
+  void put(char c) { *p_++ = c; }
+
+  void number(uint64_t value) { p_ = std::to_chars(p_, p_ + 20, value).ptr; }
+
+  // 固定宽度补零, 用于时间戳的微秒部分
+  void padded(uint32_t value, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+      p_[i] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    }
+    p_ += width;
+  }
+
+  // JSON 字符串内容: 转义引号、反斜杠和控制字符
+  void escaped(std::string_view value) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    for (char c : value) {
+      auto u = static_cast<unsigned char>(c);
+      if (c == '"' || c == '\\') {
+        *p_++ = '\\';
+        *p_++ = c;
+      } else if (u < 0x20) {
+        put("\\u00");
+        *p_++ = kHex[u >> 4];
+        *p_++ = kHex[u & 0xf];
+      } else {
+        *p_++ = c;
+      }
+    }
+  }
+
+  // IPv4 手工格式化, 避免 address::to_string 每条分配字符串
+  void address(const std::array<unsigned char, 16>& bytes, bool v6) {
+    if (v6) {
+      boost::system::error_code ec;
+      put(boost::asio::ip::address_v6(bytes).to_string(ec));
+      return;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+      if (i > 0) {
+        *p_++ = '.';
+      }
+      number(bytes[i]);
+    }
+  }
+
+  void appendTo(std::string& out) const { out.append(line_, static_cast<size_t>(p_ - line_)); }
+
+private:
+  char line_[kMaxLine];
+  char* p_ = line_;
+};
+
+// 访问日志中阶段名的长度上限
+constexpr size_t kMaxSpanName = 32;
+
+const char* levelName(AccessLog::Level level) {
+  switch (level) {
+    case AccessLog::Level::info: return "info";
+    case AccessLog::Level::warn: return "warn";
+    case AccessLog::Level::error: return "error";
+  }
+  return "info";
+}
+
+uint8_t copyTruncated(char* dest, size_t capacity, std::string_view value) {
+  size_t n = std::min(value.size(), capacity);
+  std::memcpy(dest, value.data(), n);
+  return static_cast<uint8_t>(n);
+}
+
+} // namespace
+
+AccessLog::Ring::Ring(size_t capacity)
+  : records(std::make_unique_for_overwrite<Record[]>(capacity)), mask(capacity - 1) {}
+
+AccessLog& AccessLog::getInstance() {
+  static AccessLog instance;
+  return instance;
+}
+
+AccessLog::~AccessLog() {
+  close();
+}
+
+void AccessLog::open(const config::LogConfig& cfg) {
+  close();
+  if (cfg.access_log_path.empty()) {
+    return;
+  }
+
+  fd_ = ::open(cfg.access_log_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("Failed to open access log " + cfg.access_log_path + ": " + std::strerror(errno));
+  }
+  {
+    // 已注册的队列保持原容量
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    ring_records_ = std::bit_ceil(std::max<size_t>(cfg.ring_records, 2));
+  }
+  flush_interval_ = std::chrono::milliseconds(std::max(cfg.flush_interval_ms, 1));
+  stopping_ = false;
+  writer_ = std::thread([this] { run(); });
+  enabled_.store(true, std::memory_order_release);
+}
+
+void AccessLog::close() {
+  if (!writer_.joinable()) {
+    return;
+  }
+  enabled_.store(false, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wakeup_.notify_one();
+  writer_.join();
+  ::close(fd_);
+  fd_ = -1;
+}
+
+void AccessLog::access(boost::beast::http::verb method, std::string_view route, unsigned status, uint64_t bytes,
+                       Clock::time_point start, Clock::time_point end, const boost::asio::ip::address& client,
+                       const RequestTrace* trace) {
+  if (!enabled()) {
+    return;
+  }
+  Ring& ring = localRing();
+  Record* record = beginPush(ring);
+  if (!record) {
+    return;
+  }
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+  record->time = end;
+  record->bytes = bytes;
+  record->latency_us = static_cast<uint32_t>(std::clamp<int64_t>(latency, 0, UINT32_MAX));
+  record->status = static_cast<uint16_t>(status);
+  record->method = static_cast<uint8_t>(method);
+  record->is_event = false;
+  record->client_v6 = client.is_v6();
+  if (record->client_v6) {
+    record->client = client.to_v6().to_bytes();
+  } else {
+    auto v4 = client.to_v4().to_bytes();
+    std::memcpy(record->client.data(), v4.data(), v4.size());
+  }
+  record->text_size = copyTruncated(record->text, kTextBytes, route);
+  record->detail_size = 0;
+  record->span_count = 0;
+  if (trace) {
+    for (const auto& span : trace->spans().first(std::min(trace->spans().size(), kSpans))) {
+      auto us = std::chrono::duration_cast<std::chrono::microseconds>(span.duration).count();
+      record->span_names[record->span_count] = span.name;
+      record->span_us[record->span_count++] = static_cast<uint32_t>(std::clamp<int64_t>(us, 0, UINT32_MAX));
+    }
+  }
+  commitPush(ring);
+}
+
+void AccessLog::event(Level level, std::string_view message, std::string_view detail) {
+  if (!enabled()) {
+    std::cerr << message;
+    if (!detail.empty()) {
+      std::cerr << ": " << detail;
+    }
+    std::cerr << std::endl;
+    return;
+  }
+  Ring& ring = localRing();
+  Record* record = beginPush(ring);
+  if (!record) {
+    return;
+  }
+  record->time = Clock::now();
+  record->level = level;
+  record->is_event = true;
+  record->text_size = copyTruncated(record->text, kTextBytes, message);
+  record->detail_size = copyTruncated(record->text + record->text_size, kTextBytes - record->text_size, detail);
+  commitPush(ring);
+}
+
+uint64_t AccessLog::dropped() const {
+  std::lock_guard<std::mutex> lock(rings_mutex_);
+  uint64_t total = 0;
+  for (const auto& ring : rings_) {
+    total += ring->dropped.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+AccessLog::Ring& AccessLog::localRing() {
+  thread_local Ring* ring = nullptr;
+  if (!ring) {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    rings_.push_back(std::make_unique<Ring>(ring_records_));
+    ring = rings_.back().get();
+  }
+  return *ring;
+}
+
+AccessLog::Record* AccessLog::beginPush(Ring& ring) {
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  if (head - ring.cached_tail > ring.mask) {
+    ring.cached_tail = ring.tail.load(std::memory_order_acquire);
+    if (head - ring.cached_tail > ring.mask) {
+      // 只有本线程修改, 不需要原子的读-改-写
+      ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+  }
+  return &ring.records[head & ring.mask];
+}
+
+void AccessLog::commitPush(Ring& ring) {
+  ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void AccessLog::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    wakeup_.wait_for(lock, flush_interval_, [this] { return stopping_; });
+    lock.unlock();
+    flush();
+    lock.lock();
+  }
+}
+
+void AccessLog::flush() {
+  wall_offset_ = std::chrono::system_clock::now().time_since_epoch() - Clock::now().time_since_epoch();
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+    snapshot_.clear();
+    for (const auto& ring : rings_) {
+      snapshot_.push_back(ring.get());
+    }
+  }
+
+  std::vector<std::string*> buffers;
+  uint64_t drops = 0;
+  for (Ring* ring : snapshot_) {
+    drops += ring->dropped.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    if (tail == head) {
+      continue;
+    }
+    for (uint64_t i = tail; i != head; ++i) {
+      format(ring->records[i & ring->mask], ring->out);
+    }
+    // 格式化完成后才把位置还给生产者
+    ring->tail.store(head, std::memory_order_release);
+    written_.fetch_add(head - tail, std::memory_order_relaxed);
+    buffers.push_back(&ring->out);
+  }
+
+  if (drops != reported_drops_) {
+    Record notice{};
+    notice.time = Clock::now();
+    notice.level = Level::warn;
+    notice.is_event = true;
+    std::string_view message = "Access log records dropped";
+    std::string detail = std::to_string(drops - reported_drops_);
+    notice.text_size = copyTruncated(notice.text, kTextBytes, message);
+    notice.detail_size = copyTruncated(notice.text + notice.text_size, kTextBytes - notice.text_size, detail);
+    format(notice, notice_);
+    buffers.push_back(&notice_);
+    reported_drops_ = drops;
+  }
+
+  if (!buffers.empty()) {
+    writeAll(buffers);
+  }
+}
+
+void AccessLog::format(const Record& record, std::string& out) {
+  int64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+    record.time.time_since_epoch() + wall_offset_).count();
+  int64_t second = time_us / 1000000;
+  if (second != cached_second_) {
+    cached_second_ = second;
+    time_t t = static_cast<time_t>(second);
+    tm utc{};
+    gmtime_r(&t, &utc);
+    std::strftime(cached_time_, sizeof(cached_time_), "%Y-%m-%dT%H:%M:%S", &utc);
+  }
+
+  LineWriter line;
+  line.put("{\"time\":\"");
+  line.put(cached_time_);
+  line.put('.');
+  line.padded(static_cast<uint32_t>(time_us % 1000000), 6);
+  line.put("Z\"");
+  if (record.is_event) {
+    line.put(",\"level\":\"");
+    line.put(levelName(record.level));
+    line.put("\",\"message\":\"");
+    line.escaped({record.text, record.text_size});
+    if (record.detail_size > 0) {
+      line.put("\",\"detail\":\"");
+      line.escaped({record.text + record.text_size, record.detail_size});
+    }
+  } else {
+    auto method = boost::beast::http::to_string(static_cast<boost::beast::http::verb>(record.method));
+    line.put(",\"method\":\"");
+    line.put({method.data(), method.size()});
+    line.put("\",\"route\":\"");
+    line.escaped({record.text, record.text_size});
+    line.put("\",\"status\":");
+    line.number(record.status);
+    line.put(",\"bytes\":");
+    line.number(record.bytes);
+    line.put(",\"latency_us\":");
+    line.number(record.latency_us);
+    line.put(",\"client\":\"");
+    line.address(record.client, record.client_v6);
+    if (record.span_count > 0) {
+      line.put("\",\"spans_us\":{");
+      for (uint8_t i = 0; i < record.span_count; ++i) {
+        line.put(i == 0 ? "\"" : ",\"");
+        line.escaped(std::string_view(record.span_names[i]).substr(0, kMaxSpanName));
+        line.put("\":");
+        line.number(record.span_us[i]);
+      }
+      line.put("}}\n");
+      line.appendTo(out);
+      return;
+    }
+  }
+  line.put("\"}\n");
+  line.appendTo(out);
+}
+
+void AccessLog::writeAll(std::vector<std::string*>& buffers) {
+  std::vector<iovec> iov;
+  iov.reserve(buffers.size());
+  for (auto* buffer : buffers) {
+    iov.push_back({buffer->data(), buffer->size()});
+  }
+
+  // 每次最多 IOV_MAX 段, 部分写入时从断开处继续
+  size_t first = 0;
+  while (first < iov.size()) {
+    int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t n = ::writev(fd_, iov.data() + first, count);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Access log write error: " << std::strerror(errno) << std::endl;
+      break;
+    }
+    auto remaining = static_cast<size_t>(n);
+    while (first < iov.size() && remaining >= iov[first].iov_len) {
+      remaining -= iov[first].iov_len;
+      ++first;
+    }
+    if (remaining > 0) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + remaining;
+      iov[first].iov_len -= remaining;
+    }
+  }
+
+  // 保留容量, 下一批不用重新分配
+  for (auto* buffer : buffers) {
+    buffer->clear();
+  }
+}
+
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <boost/asio/ip/address.hpp>
+#include <boost/beast/http/verb.hpp>
+#include "common/config/config.hpp"
+#include "common/restful/request_trace.hpp"
+
+namespace common {
+
+/*
+  异步的访问日志和事件日志, 每条一行 JSON。
+  - 调用线程只把定长记录复制进本线程的单生产者单消费者环形队列: 不格式化、不加锁、不做系统调用
+  - 后台写线程每 flush_interval_ms 收集所有队列, 格式化后用一次 writev 写出
+  - 队列满时丢弃新记录并计数, 不阻塞调用线程; 丢弃数会写入日志, 也可以通过 dropped() 查询
+  未 open 时访问日志不记录, 事件同步写到 stderr
+*/
+class AccessLog {
+public:
+  enum class Level : uint8_t { info, warn, error };
+
+  static AccessLog& getInstance();
+
+  AccessLog(const AccessLog&) = delete;
+  AccessLog& operator=(const AccessLog&) = delete;
+
+  // 以追加方式打开日志文件并启动写线程, 文件打开失败时抛出 std::runtime_error; 路径为空时不启用
+  void open(const config::LogConfig& cfg);
+  // 写出队列中剩余的记录, 停止写线程并关闭文件; 之后可以重新 open
+  void close();
+
+  bool enabled() const { return enabled_.load(std::memory_order_acquire); }
+
+  using Clock = std::chrono::steady_clock;
+
+  // 一个请求的响应写完时调用, 时间取调用方已有的 steady_clock 时刻 (写线程换算为系统时间), 调用线程不再读时钟;
+  // route 为路由模式, 超出记录长度时截断; trace 中的前 kSpans 个阶段以微秒写入 spans_us
+  void access(boost::beast::http::verb method, std::string_view route, unsigned status, uint64_t bytes,
+              Clock::time_point start, Clock::time_point end, const boost::asio::ip::address& client,
+              const RequestTrace* trace = nullptr);
+  // message 为固定的描述 (如 "Read error"), detail 为错误信息等; 两者合计超出记录长度时截断 detail
+  void event(Level level, std::string_view message, std::string_view detail = {});
+
+  uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+  uint64_t dropped() const;
+
+private:
+  static constexpr size_t kTextBytes = 84;
+  static constexpr size_t kSpans = 5;
+
+  // 三个缓存行; 地址只存字节, boost 的 address 有 32 字节
+  struct Record {
+    Clock::time_point time;
+    uint64_t bytes;
+    uint32_t latency_us;
+    uint16_t status;
+    uint8_t method; // http::verb
+    Level level;
+    bool is_event;
+    bool client_v6;
+    uint8_t text_size; // access: 路由模式; event: message, 之后紧接 detail
+    uint8_t detail_size;
+    std::array<unsigned char, 16> client;
+    char text[kTextBytes];
+    // access: RequestTrace 的阶段, 名称是字面量, 只存指针
+    std::array<const char*, kSpans> span_names;
+    std::array<uint32_t, kSpans> span_us;
+    uint8_t span_count;
+  };
+  static_assert(sizeof(Record) == 192);
+
+  // 生产者和消费者的下标各占一个缓存行, 生产者缓存消费者的下标, 只有看起来满时才读对方的缓存行
+  struct Ring {
+    explicit Ring(size_t capacity);
+
+    std::unique_ptr<Record[]> records;
+    const uint64_t mask;
+    alignas(64) std::atomic<uint64_t> head{0}; // 生产者的下一个写入位置
+    uint64_t cached_tail = 0;
+    std::atomic<uint64_t> dropped{0};
+    alignas(64) std::atomic<uint64_t> tail{0}; // 写线程的下一个读取位置
+    std::string out; // 写线程格式化的缓冲区
+  };
+
+  AccessLog() = default;
+  ~AccessLog();
+
+  // 本线程的队列, 第一次调用时注册; 线程退出后队列保留, 其中的记录仍会写出
+  Ring& localRing();
+  // 队列满时返回 nullptr 并计入丢弃数
+  Record* beginPush(Ring& ring);
+  void commitPush(Ring& ring);
+
+  void run();
+  void flush();
+  void format(const Record& record, std::string& out);
+  void writeAll(std::vector<std::string*>& buffers);
+
+  std::atomic<bool> enabled_{false};
+  std::atomic<uint64_t> written_{0};
+  size_t ring_records_ = 0;
+  std::chrono::milliseconds flush_interval_{0};
+  int fd_ = -1;
+
+  mutable std::mutex rings_mutex_; // 保护 rings_ 的注册, 写线程每次收集时复制一份指针
+  std::vector<std::unique_ptr<Ring>> rings_;
+  std::vector<Ring*> snapshot_;
+
+  std::mutex mutex_; // 保护 stopping_, 用于唤醒写线程
+  std::condition_variable wakeup_;
+  bool stopping_ = false;
+  std::thread writer_;
+
+  uint64_t reported_drops_ = 0;
+  std::string notice_; // 丢弃数等写线程自己产生的记录
+  Clock::duration wall_offset_{}; // system_clock 与 steady_clock 的差, 每次收集时更新
+  int64_t cached_second_ = -1; // 上一条记录的秒数和格式化好的时间前缀
+  char cached_time_[32] = {};
+};
+
+}
@@ -0,0 +1,131 @@
+#include "admission_controller.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace common {
+
+namespace {
+
+constexpr auto kWindow = std::chrono::milliseconds(100); // 自适应上限的调整周期
+constexpr uint64_t kMinSamples = 10; // 样本太少的窗口不调整
+constexpr size_t kBaselineWindows = 100; // 基线每 100 个窗口 (约 10 秒) 重新取一次
+constexpr double kTolerance = 1.5; // 近期耗时超过基线的 1.5 倍才开始收缩
+constexpr double kSmoothing = 0.5; // 新上限的权重, 过载时每个窗口约收缩 1/4
+
+int64_t toNanos(AdmissionController::Clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+} // namespace
+
+AdmissionController::Permit& AdmissionController::Permit::operator=(Permit&& other) noexcept {
+  if (this != &other) {
+    release();
+    controller_ = std::exchange(other.controller_, nullptr);
+    reserved_ = other.reserved_;
+    start_ = other.start_;
+  }
+  return *this;
+}
+
+void AdmissionController::Permit::release() {
+  if (controller_) {
+    std::exchange(controller_, nullptr)->release(reserved_, Clock::now() - start_);
+  }
+}
+
+AdmissionController::AdmissionController(const config::HttpServerConfig& cfg)
+  : enabled_(cfg.admission_max_in_flight > 0),
+    adaptive_(enabled_ && cfg.admission_adaptive),
+    min_limit_(std::max<size_t>(cfg.admission_min_limit, 1)),
+    max_limit_(std::max(cfg.admission_max_limit, min_limit_)),
+    reserved_(cfg.admission_reserved),
+    queue_timeout_(std::chrono::milliseconds(cfg.admission_queue_timeout_ms)),
+    limit_(cfg.admission_max_in_flight) {
+  if (adaptive_) {
+    limit_ = std::clamp(limit_.load(), min_limit_, max_limit_);
+  }
+  limit_estimate_ = static_cast<double>(limit_.load());
+}
+
+AdmissionController::Permit AdmissionController::tryAcquire(bool lightweight) {
+  size_t in_flight = in_flight_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (!enabled_ || in_flight <= limit_.load(std::memory_order_relaxed)) {
+    if (in_flight > peak_in_flight_.load(std::memory_order_relaxed)) {
+      peak_in_flight_.store(in_flight, std::memory_order_relaxed); // 近似值即可
+    }
+    return Permit(this, false);
+  }
+  in_flight_.fetch_sub(1, std::memory_order_relaxed);
+
+  if (lightweight) {
+    if (reserved_in_flight_.fetch_add(1, std::memory_order_relaxed) < reserved_) {
+      return Permit(this, true);
+    }
+    reserved_in_flight_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  rejected_.fetch_add(1, std::memory_order_relaxed);
+  return {};
+}
+
+bool AdmissionController::queueExpired(Clock::time_point enqueued) {
+  if (!enabled_ || queue_timeout_ <= Clock::duration::zero() || Clock::now() - enqueued <= queue_timeout_) {
+    return false;
+  }
+  rejected_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void AdmissionController::release(bool reserved, Clock::duration latency) {
+  (reserved ? reserved_in_flight_ : in_flight_).fetch_sub(1, std::memory_order_relaxed);
+  if (!adaptive_) {
+    return;
+  }
+
+  auto now = Clock::now();
+  uint64_t latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count();
+  window_sum_ns_.fetch_add(latency_ns, std::memory_order_relaxed);
+  uint64_t min_ns = window_min_ns_.load(std::memory_order_relaxed);
+  while (latency_ns < min_ns && !window_min_ns_.compare_exchange_weak(min_ns, latency_ns, std::memory_order_relaxed)) {
+  }
+  uint64_t count = window_count_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (count >= kMinSamples && toNanos(now) >= window_end_ns_.load(std::memory_order_relaxed)) {
+    std::unique_lock lock(update_mutex_, std::try_to_lock);
+    if (lock) {
+      updateLimit(now);
+    }
+  }
+}
+
+void AdmissionController::updateLimit(Clock::time_point now) {
+  if (toNanos(now) < window_end_ns_.load(std::memory_order_relaxed)) {
+    return; // 其他线程刚调整过
+  }
+  window_end_ns_.store(toNanos(now + kWindow), std::memory_order_relaxed);
+
+  uint64_t count = window_count_.exchange(0, std::memory_order_relaxed);
+  uint64_t sum = window_sum_ns_.exchange(0, std::memory_order_relaxed);
+  auto window_min = static_cast<double>(window_min_ns_.exchange(UINT64_MAX, std::memory_order_relaxed));
+  if (count == 0) {
+    return;
+  }
+  double latency = static_cast<double>(sum) / static_cast<double>(count);
+
+  if (baseline_windows_++ % kBaselineWindows == 0 || window_min < baseline_ns_) {
+    baseline_ns_ = window_min;
+  }
+
+  double gradient = std::clamp(kTolerance * baseline_ns_ / latency, 0.5, 1.0);
+  double next = limit_estimate_ * gradient + std::sqrt(limit_estimate_);
+  size_t peak = peak_in_flight_.exchange(in_flight_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  if (next > limit_estimate_ && static_cast<double>(peak) < limit_estimate_ / 2) {
+    next = limit_estimate_; // 名额没有用满, 耗时低说明不了容量, 不继续增大
+  }
+
+  limit_estimate_ = std::clamp(limit_estimate_ * (1 - kSmoothing) + next * kSmoothing,
+                               static_cast<double>(min_limit_), static_cast<double>(max_limit_));
+  limit_.store(static_cast<size_t>(limit_estimate_), std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "common/config/config.hpp"
+
+namespace common {
+
+/*
+  请求准入控制: 限制同时处理的请求数, 超出时 HttpSession 直接写出预序列化的 503 + Retry-After,
+  不解析 body、不进入处理函数。
+  - 名额从请求交给处理函数时占用, 到处理函数返回时释放 (不含写出响应的时间), 静态响应不占名额
+  - 轻量请求 (默认是不进线程池的请求, 如 token 校验) 在共享名额用尽后还能使用 reserved 个保留名额,
+    慢接口过载时不受影响
+  - 自适应模式按处理耗时调整上限 (梯度算法): 以近期的最小耗时作为没有排队时的基线,
+    窗口内平均耗时超过基线的 1.5 倍时按比例收缩, 否则每个窗口增加 sqrt(limit), 名额没有用满时不增长
+  - 在线程池中排队超过 queue_timeout 的请求开始执行前就返回 503, 避免为已经超时的客户端做无用功
+  所有方法都可以被多个 io 线程和线程池同时调用
+*/
+class AdmissionController {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // 一个已占用的名额, 析构时释放并把耗时计入自适应统计
+  class Permit {
+  public:
+    Permit() = default;
+    Permit(Permit&& other) noexcept { *this = std::move(other); }
+    Permit& operator=(Permit&& other) noexcept;
+    ~Permit() { release(); }
+
+    explicit operator bool() const { return controller_ != nullptr; }
+    void release();
+
+  private:
+    friend class AdmissionController;
+    Permit(AdmissionController* controller, bool reserved)
+      : controller_(controller), reserved_(reserved), start_(Clock::now()) {}
+
+    AdmissionController* controller_ = nullptr;
+    bool reserved_ = false; // 占用的是保留名额
+    Clock::time_point start_;
+  };
+
+  explicit AdmissionController(const config::HttpServerConfig& cfg);
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+
+  // 失败时返回空的 Permit, 调用方应返回 503
+  Permit tryAcquire(bool lightweight);
+  // enqueued 时进入线程池队列的请求是否已经等待太久
+  bool queueExpired(Clock::time_point enqueued);
+
+  size_t limit() const { return limit_.load(std::memory_order_relaxed); }
+  size_t inFlight() const { return in_flight_.load(std::memory_order_relaxed); }
+  size_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+private:
+  void release(bool reserved, Clock::duration latency);
+  void updateLimit(Clock::time_point now);
+
+  bool enabled_;
+  bool adaptive_;
+  size_t min_limit_;
+  size_t max_limit_;
+  size_t reserved_;
+  Clock::duration queue_timeout_;
+
+  std::atomic<size_t> limit_;
+  std::atomic<size_t> in_flight_{0};
+  std::atomic<size_t> reserved_in_flight_{0};
+  std::atomic<size_t> rejected_{0};
+
+  // 自适应统计: 当前窗口的耗时累计, 由窗口结束后第一个拿到 update_mutex_ 的线程汇总
+  std::atomic<size_t> peak_in_flight_{0};
+  std::atomic<uint64_t> window_sum_ns_{0};
+  std::atomic<uint64_t> window_count_{0};
+  std::atomic<uint64_t> window_min_ns_{UINT64_MAX};
+  std::atomic<int64_t> window_end_ns_{0};
+  std::mutex update_mutex_;
+  // 以下只在持有 update_mutex_ 时访问
+  double baseline_ns_ = 0; // 近期窗口最小耗时中的最小值
+  size_t baseline_windows_ = 0; // 基线已经累计的窗口数, 定期重置, 接口本身变慢后基线能跟上
+  double limit_estimate_ = 0;
+};
+
+}
@@ -0,0 +1,31 @@
+#include "body_reader.hpp"
+#include <array>
+#include <stdexcept>
+#include <boost/beast/core/file.hpp>
+
+namespace common {
+
+net::awaitable<uint64_t> saveBody(BodyReader& body, const std::string& path) {
+  boost::beast::error_code ec;
+  boost::beast::file file;
+  file.open(path.c_str(), boost::beast::file_mode::write, ec);
+  if (ec) {
+    throw std::runtime_error("Failed to open " + path + ": " + ec.message());
+  }
+
+  // 写文件在 io 线程上进行, 每块写入页缓存, 不等待落盘
+  std::array<char, 64 * 1024> chunk;
+  uint64_t total = 0;
+  while (size_t n = co_await body.read(net::buffer(chunk))) {
+    for (size_t written = 0; written < n;) {
+      written += file.write(chunk.data() + written, n - written, ec);
+      if (ec) {
+        throw std::runtime_error("Failed to write " + path + ": " + ec.message());
+      }
+    }
+    total += n;
+  }
+  co_return total;
+}
+
+}
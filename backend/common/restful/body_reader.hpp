@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+
+namespace common {
+
+namespace net = boost::asio;
+
+/*
+  流式请求的 body, 由 Router::addStream 注册的处理函数按块读取。
+  - 只有调用 read 时才从 socket 读取, 处理函数处理得慢时数据积压在内核缓冲区, 由 TCP 流控让客户端暂停发送
+  - 每次 read 按空闲超时计时; 超出路由的 body 上限时 read 抛出异常, 连接回复 413 后关闭
+  - 处理函数没有读完 body 就返回时, 响应写出后关闭连接
+  只能在处理协程中 (连接的 executor 上) 调用
+*/
+class BodyReader {
+public:
+  virtual ~BodyReader() = default;
+
+  // 读取下一段数据到 buffer, 返回读到的字节数; body 已经读完时返回 0
+  virtual net::awaitable<size_t> read(net::mutable_buffer buffer) = 0;
+  // Content-Length, chunked 编码时为空
+  virtual std::optional<uint64_t> contentLength() const = 0;
+  // 已经读到的字节数
+  virtual uint64_t received() const = 0;
+};
+
+// 把剩余的 body 按块写入文件 (覆盖已有内容), 返回写入的字节数; 打开或写入失败时抛出 std::runtime_error
+net::awaitable<uint64_t> saveBody(BodyReader& body, const std::string& path);
+
+}
@@ -0,0 +1,264 @@
+#include "compression.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <stdexcept>
+#include <zlib.h>
+#include "common/config/config.hpp"
+
+namespace common {
+
+namespace {
+
+constexpr std::array<std::string_view, 7> kCompressibleTypes = {
+  "application/json",
+  "application/javascript",
+  "application/xml",
+  "application/vnd.apple.mpegurl",
+  "application/x-mpegurl",
+  "image/svg+xml",
+  "text/",
+};
+
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+  while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+  return s;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isCompressible(const Response& res) {
+  if (res.count(http::field::content_encoding) || res.result() == http::status::no_content ||
+      res.result() == http::status::not_modified) {
+    return false;
+  }
+  auto type = toStringView(res[http::field::content_type]);
+  type = trim(type.substr(0, type.find(';')));
+  for (auto prefix : kCompressibleTypes) {
+    if (type.size() >= prefix.size() && iequals(type.substr(0, prefix.size()), prefix) &&
+        (prefix.back() == '/' || type.size() == prefix.size())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void addVary(Response& res) {
+  auto vary = toStringView(res[http::field::vary]);
+  if (vary.empty()) {
+    res.set(http::field::vary, "Accept-Encoding");
+  } else if (vary.find("Accept-Encoding") == std::string_view::npos && vary != "*") {
+    std::string value(vary);
+    value += ", Accept-Encoding";
+    res.set(http::field::vary, value);
+  }
+}
+
+// 每线程复用的 deflate 状态, 每个压缩级别一个: 同一进程中的多个 HttpServer 可以配置不同的 compression_level
+class ThreadCompressor {
+public:
+  ThreadCompressor(const ThreadCompressor&) = delete;
+  ThreadCompressor& operator=(const ThreadCompressor&) = delete;
+
+  // level 为 zlib 的压缩级别 0-9 或 Z_DEFAULT_COMPRESSION (-1), 超出范围的已由 HttpServer 在启动时修正, 这里只是兜底
+  static ThreadCompressor& get(int level) {
+    thread_local std::array<std::unique_ptr<ThreadCompressor>, 11> compressors;
+    level = std::clamp(level, Z_DEFAULT_COMPRESSION, Z_BEST_COMPRESSION);
+    auto& compressor = compressors[level + 1];
+    if (!compressor) {
+      compressor.reset(new ThreadCompressor(level));
+    }
+    return *compressor;
+  }
+
+  ~ThreadCompressor() {
+    for (auto& [stream, initialized] : streams_) {
+      if (initialized) {
+        deflateEnd(&stream);
+      }
+    }
+  }
+
+  // 压缩 in 写入 out 开头, out 至少 bound() 字节, 返回压缩后长度
+  size_t compress(ContentEncoding encoding, std::string_view in, char* out, size_t capacity) {
+    z_stream& stream = streamFor(encoding);
+    deflateReset(&stream);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out);
+    stream.avail_out = static_cast<uInt>(capacity);
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+      throw std::runtime_error("deflate failed");
+    }
+    return capacity - stream.avail_out;
+  }
+
+  size_t bound(ContentEncoding encoding, size_t size) {
+    return deflateBound(&streamFor(encoding), size);
+  }
+
+private:
+  explicit ThreadCompressor(int level) : level_(level) {}
+
+  z_stream& streamFor(ContentEncoding encoding) {
+    // windowBits 15 为 zlib 格式 (HTTP 的 deflate), +16 为 gzip 格式
+    int index = encoding == ContentEncoding::gzip ? 0 : 1;
+    auto& [stream, initialized] = streams_[index];
+    if (!initialized) {
+      int window_bits = encoding == ContentEncoding::gzip ? 15 + 16 : 15;
+      if (deflateInit2(&stream, level_, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+      }
+      initialized = true;
+    }
+    return stream;
+  }
+
+  int level_;
+  std::array<std::pair<z_stream, bool>, 2> streams_{};
+};
+
+} // namespace
+
+std::string_view encodingName(ContentEncoding encoding) {
+  switch (encoding) {
+    case ContentEncoding::gzip: return "gzip";
+    case ContentEncoding::deflate: return "deflate";
+    default: return "identity";
+  }
+}
+
+ContentEncoding negotiateEncoding(std::string_view accept_encoding) {
+  // 未出现的编码取 "*" 的 q 值, "*" 也未出现时视为不接受
+  double gzip = -1, deflate = -1, any = -1;
+
+  std::string_view rest = accept_encoding;
+  while (!rest.empty()) {
+    auto comma = rest.find(',');
+    auto item = rest.substr(0, comma);
+    rest = comma == std::string_view::npos ? std::string_view{} : rest.substr(comma + 1);
+
+    auto semicolon = item.find(';');
+    auto coding = trim(item.substr(0, semicolon));
+    double q = 1;
+    if (semicolon != std::string_view::npos) {
+      auto param = trim(item.substr(semicolon + 1));
+      if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+        auto value = param.substr(2);
+        if (std::from_chars(value.data(), value.data() + value.size(), q).ec != std::errc{}) {
+          q = 0;
+        }
+      }
+    }
+
+    if (iequals(coding, "gzip") || iequals(coding, "x-gzip")) {
+      gzip = q;
+    } else if (iequals(coding, "deflate")) {
+      deflate = q;
+    } else if (coding == "*") {
+      any = q;
+    }
+  }
+
+  if (gzip < 0) gzip = any;
+  if (deflate < 0) deflate = any;
+  if (gzip <= 0 && deflate <= 0) {
+    return ContentEncoding::identity;
+  }
+  return gzip >= deflate ? ContentEncoding::gzip : ContentEncoding::deflate;
+}
+
+bool compressResponse(Response& res, ContentEncoding encoding, const CompressionOptions& options,
+                      std::string_view resource) {
+  // 文件、vector 等换入的 body 原样写出
+  if (!options.enabled || !res.body().isString() || res.body().size() < options.min_bytes || !isCompressible(res)) {
+    return false;
+  }
+  // 同一资源对不同客户端可能返回不同编码, 即使这次不压缩也要告知缓存
+  addVary(res);
+  if (encoding == ContentEncoding::identity) {
+    return false;
+  }
+
+  auto name = encodingName(encoding);
+  auto etag = toStringView(res[http::field::etag]);
+  std::string cache_key;
+  std::shared_ptr<const std::string> cached;
+  if (!etag.empty()) {
+    cache_key.reserve(resource.size() + etag.size() + name.size() + 2);
+    cache_key.append(resource).append(1, ' ').append(etag).append(1, ' ').append(name);
+    cached = CompressionCache::getInstance().get(cache_key);
+  }
+
+  if (cached) {
+    res.body().assign(*cached);
+  } else {
+    auto& compressor = ThreadCompressor::get(options.level);
+    const auto& body = res.body();
+    StringBody::value_type compressed(body.get_allocator());
+    compressed.resize_and_overwrite(compressor.bound(encoding, body.size()), [&](char* out, size_t capacity) {
+      return compressor.compress(encoding, body, out, capacity);
+    });
+    if (!etag.empty()) {
+      CompressionCache::getInstance().put(std::move(cache_key),
+                                          std::make_shared<const std::string>(compressed));
+    }
+    res.body().swap(compressed);
+  }
+
+  // 压缩后的表示与原表示不同, ETag 也要区分: "abc" -> "abc-gzip"
+  if (!etag.empty() && etag.back() == '"') {
+    std::string variant(etag.substr(0, etag.size() - 1));
+    variant.append(1, '-').append(name).append(1, '"');
+    res.set(http::field::etag, variant);
+  }
+  res.set(http::field::content_encoding, boost::beast::string_view(name.data(), name.size()));
+  res.prepare_payload();
+  return true;
+}
+
+CompressionCache& CompressionCache::getInstance() {
+  static CompressionCache instance(config::Config::getInstance().getHttpServer().compression_cache_entries);
+  return instance;
+}
+
+std::shared_ptr<const std::string> CompressionCache::get(std::string_view key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return it->second->second;
+}
+
+void CompressionCache::put(std::string key, std::shared_ptr<const std::string> value) {
+  if (capacity_ == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto it = index_.find(key); it != index_.end()) {
+    it->second->second = std::move(value);
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return;
+  }
+  lru_.emplace_front(std::move(key), std::move(value));
+  index_.emplace(lru_.front().first, lru_.begin());
+  if (lru_.size() > capacity_) {
+    index_.erase(lru_.back().first);
+    lru_.pop_back();
+  }
+}
+
+}
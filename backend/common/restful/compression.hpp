@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "common/restful/http_types.hpp"
+
+namespace common {
+
+enum class ContentEncoding { identity, gzip, deflate };
+
+std::string_view encodingName(ContentEncoding encoding);
+
+// 按 Accept-Encoding 选择编码, q 值相同时优先 gzip; 不接受任何压缩时返回 identity
+ContentEncoding negotiateEncoding(std::string_view accept_encoding);
+
+struct CompressionOptions {
+  bool enabled = false;
+  size_t min_bytes = 1024;
+  int level = 6;
+};
+
+/*
+  压缩 JSON/文本/m3u8 等可压缩类型且不小于 min_bytes 的字符串 body, 设置 Content-Encoding 和 Vary, 返回是否压缩。
+  - zlib 的 z_stream 每线程每种 (编码, 压缩级别) 一个, deflateReset 后复用, 不必每次 deflateInit 重新分配约 256KB 的状态
+  - 带 ETag 的响应视为内容不变, 压缩结果按 (resource, ETag, 编码) 缓存在 CompressionCache 中, ETag 加上编码后缀。
+    ETag 只在同一资源内唯一 (内容哈希、版本号等), 不同资源可能相同, 所以 resource 是请求的方法和 target, 如 "GET /a?b=1"
+*/
+bool compressResponse(Response& res, ContentEncoding encoding, const CompressionOptions& options,
+                      std::string_view resource);
+
+// 带 ETag 响应的压缩结果, 按条数 LRU 淘汰, 多线程共享
+class CompressionCache {
+public:
+  static CompressionCache& getInstance();
+
+  std::shared_ptr<const std::string> get(std::string_view key);
+  void put(std::string key, std::shared_ptr<const std::string> value);
+
+private:
+  explicit CompressionCache(size_t capacity) : capacity_(capacity) {}
+  CompressionCache(const CompressionCache&) = delete;
+  CompressionCache& operator=(const CompressionCache&) = delete;
+
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+  using Entry = std::pair<std::string, std::shared_ptr<const std::string>>;
+
+  size_t capacity_;
+  std::mutex mutex_;
+  std::list<Entry> lru_; // 最近使用的在前
+  std::unordered_map<std::string, std::list<Entry>::iterator, StringHash, std::equal_to<>> index_;
+};
+
+}
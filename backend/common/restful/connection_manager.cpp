@@ -0,0 +1,111 @@
+#include "connection_manager.hpp"
+#include <algorithm>
+
+namespace common {
+
+ConnectionManager::ConnectionManager(size_t max_connections, Clock::duration tick)
+  : max_connections_(max_connections), tick_(std::max(tick, Clock::duration(std::chrono::milliseconds(1)))),
+    epoch_(Clock::now()) {}
+
+bool ConnectionManager::admit() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (max_connections_ == 0 || connections_ < max_connections_) {
+    ++connections_;
+    return true;
+  }
+  if (!idle_head_) {
+    ++rejected_;
+    return false;
+  }
+
+  // 被淘汰的连接在自己的 executor 上关闭后才析构, 期间连接数会暂时超过上限
+  Connection& oldest = *idle_head_;
+  unlinkIdle(oldest);
+  wheel_.cancel(oldest);
+  oldest.expire(true);
+  ++evicted_;
+  ++connections_;
+  return true;
+}
+
+void ConnectionManager::remove(Connection& connection) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  unlinkIdle(connection);
+  wheel_.cancel(connection);
+  --connections_;
+}
+
+void ConnectionManager::update(Connection& connection, std::optional<Clock::time_point> deadline, bool idle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (deadline) {
+    wheel_.schedule(connection, tickOf(*deadline));
+  } else {
+    wheel_.cancel(connection);
+  }
+
+  if (idle && draining()) {
+    unlinkIdle(connection);
+    connection.expire(true);
+  } else if (idle && !connection.idle_) {
+    connection.idle_ = true;
+    connection.idle_prev_ = idle_tail_;
+    (idle_tail_ ? idle_tail_->idle_next_ : idle_head_) = &connection;
+    idle_tail_ = &connection;
+  } else if (!idle) {
+    unlinkIdle(connection);
+  }
+}
+
+void ConnectionManager::tick(Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 向下取整: 到期时刻所在的 tick 要等它结束后才处理
+  uint64_t current = now < epoch_ ? 0 : static_cast<uint64_t>((now - epoch_) / tick_);
+  wheel_.advance(current, [](TimerWheel::Entry& entry) {
+    static_cast<Connection&>(entry).expire(false);
+  });
+}
+
+void ConnectionManager::drain() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  draining_.store(true, std::memory_order_relaxed);
+  while (idle_head_) {
+    Connection& connection = *idle_head_;
+    unlinkIdle(connection);
+    connection.expire(true);
+  }
+}
+
+size_t ConnectionManager::connections() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return connections_;
+}
+
+size_t ConnectionManager::evicted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return evicted_;
+}
+
+size_t ConnectionManager::rejected() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rejected_;
+}
+
+uint64_t ConnectionManager::tickOf(Clock::time_point time) const {
+  // 向上取整, 保证不会提前到期
+  if (time <= epoch_) {
+    return 0;
+  }
+  return static_cast<uint64_t>((time - epoch_ + tick_ - Clock::duration(1)) / tick_);
+}
+
+void ConnectionManager::unlinkIdle(Connection& connection) {
+  if (!connection.idle_) {
+    return;
+  }
+  (connection.idle_prev_ ? connection.idle_prev_->idle_next_ : idle_head_) = connection.idle_next_;
+  (connection.idle_next_ ? connection.idle_next_->idle_prev_ : idle_tail_) = connection.idle_prev_;
+  connection.idle_prev_ = connection.idle_next_ = nullptr;
+  connection.idle_ = false;
+}
+
+}
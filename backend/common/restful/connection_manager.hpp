@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include "common/restful/timer_wheel.hpp"
+
+namespace common {
+
+/*
+  连接管理: 一个 io_context 上所有连接的超时和数量上限。
+  - 每个连接一个嵌入式的时间轮条目, 不再每个 socket 一个 asio 定时器; 调度器的定时器堆中只有每个 tick 一个
+  - 数量达到 max_connections 时关闭最久空闲 (在等下一个请求) 的连接给新连接腾出名额, 没有空闲连接时拒绝新连接
+  - 排空时关闭所有空闲连接, 之后变为空闲的连接也立即关闭
+  方法都加锁, 共享 io_context 时多个 io 线程可以同时调用
+*/
+class ConnectionManager {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  class Connection : private TimerWheel::Entry {
+  public:
+    Connection() = default;
+
+  protected:
+    ~Connection() = default;
+
+    // 超时 (evicted 为 false) 或被淘汰 (包括排空时关闭空闲连接) 时在管理器的锁内调用,
+    // 实现中只能把关闭操作投递到连接自己的 executor
+    virtual void expire(bool evicted) = 0;
+
+  private:
+    friend class ConnectionManager;
+    Connection* idle_prev_ = nullptr; // 空闲链表, 最久空闲的在头部
+    Connection* idle_next_ = nullptr;
+    bool idle_ = false;
+  };
+
+  // max_connections 为 0 表示不限制
+  ConnectionManager(size_t max_connections, Clock::duration tick);
+  ConnectionManager(const ConnectionManager&) = delete;
+  ConnectionManager& operator=(const ConnectionManager&) = delete;
+
+  // 新连接到达时调用, 返回 false 时调用方应直接关闭新连接
+  bool admit();
+  // 在连接的析构函数开头调用, 之后不会再对它调用 expire
+  void remove(Connection& connection);
+  // deadline 为空表示不计时 (如请求正在处理); idle 表示连接在等下一个请求, 可以被淘汰
+  void update(Connection& connection, std::optional<Clock::time_point> deadline, bool idle);
+  // 调用所有到期连接的 expire, 由 HttpServer 每个 tick 调用一次
+  void tick(Clock::time_point now = Clock::now());
+  // 开始排空: 对所有空闲连接调用 expire(true); 连接在处理完排队的请求后自行关闭, 见 draining()
+  void drain();
+  bool draining() const { return draining_.load(std::memory_order_relaxed); }
+
+  Clock::duration tickInterval() const { return tick_; }
+  size_t connections() const;
+  size_t evicted() const;
+  size_t rejected() const;
+
+private:
+  uint64_t tickOf(Clock::time_point time) const;
+  void unlinkIdle(Connection& connection);
+
+  const size_t max_connections_;
+  const Clock::duration tick_;
+  const Clock::time_point epoch_; // 第 0 个 tick
+
+  mutable std::mutex mutex_;
+  TimerWheel wheel_;
+  Connection* idle_head_ = nullptr;
+  Connection* idle_tail_ = nullptr;
+  size_t connections_ = 0;
+  size_t evicted_ = 0;
+  size_t rejected_ = 0;
+  std::atomic<bool> draining_{false};
+};
+
+}
@@ -0,0 +1,483 @@
+#include "http2_connection.hpp"
+// 以 ENABLE_HTTP2 编译时才需要 nghttp2, 见 CMakeLists.txt 的 ENABLE_HTTP2 选项
+#ifdef ENABLE_HTTP2
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <nghttp2/nghttp2.h>
+
+namespace common {
+
+namespace {
+
+// HTTP/1 中逐跳的头, HTTP/2 中禁止出现 (RFC 9113 8.2.2)
+bool connectionSpecific(boost::beast::string_view name) {
+  return boost::beast::iequals(name, "connection") || boost::beast::iequals(name, "keep-alive") ||
+         boost::beast::iequals(name, "proxy-connection") || boost::beast::iequals(name, "transfer-encoding") ||
+         boost::beast::iequals(name, "upgrade");
+}
+
+boost::beast::string_view view(const uint8_t* data, size_t size) {
+  return {reinterpret_cast<const char*>(data), size};
+}
+
+nghttp2_nv header(std::string_view name, std::string_view value) {
+  return {reinterpret_cast<uint8_t*>(const_cast<char*>(name.data())),
+          reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())), name.size(), value.size(),
+          NGHTTP2_NV_FLAG_NONE};
+}
+
+} // namespace
+
+// nghttp2 的回调, user_data 为 Http2Connection
+struct Http2Callbacks {
+  static Http2Connection& self(void* user_data) { return *static_cast<Http2Connection*>(user_data); }
+
+  static Http2Connection::Stream* stream(nghttp2_session* session, int32_t id) {
+    return static_cast<Http2Connection::Stream*>(nghttp2_session_get_stream_user_data(session, id));
+  }
+
+  static int onBeginHeaders(nghttp2_session* session, const nghttp2_frame* frame, void* user_data) {
+    if (frame->hd.type == NGHTTP2_HEADERS && frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+      auto& s = self(user_data).open(frame->hd.stream_id);
+      nghttp2_session_set_stream_user_data(session, s.id, &s);
+    }
+    return 0;
+  }
+
+  static int onHeader(nghttp2_session* session, const nghttp2_frame* frame, const uint8_t* name_data,
+                      size_t name_size, const uint8_t* value_data, size_t value_size, uint8_t, void*) {
+    auto* s = stream(session, frame->hd.stream_id);
+    if (!s || !s->req || s->started) { // 尾部的头 (trailers) 不交给处理函数
+      return 0;
+    }
+    auto& req = *s->req;
+    auto name = view(name_data, name_size);
+    auto value = view(value_data, value_size);
+    if (name == ":method") {
+      req.method_string(value);
+    } else if (name == ":path") {
+      req.target(value);
+    } else if (name == ":authority") {
+      if (req.find(http::field::host) == req.end()) {
+        req.set(http::field::host, value);
+      }
+    } else if (name.starts_with(':')) {
+      // :scheme 等, 处理函数用不到
+    } else if (name == "cookie" && req.find(http::field::cookie) != req.end()) {
+      // HTTP/2 可以把 cookie 拆成多个头, 合并回一个 (RFC 9113 8.2.3)
+      std::string merged(toStringView(req[http::field::cookie]));
+      merged.append("; ").append(value.data(), value.size());
+      req.set(http::field::cookie, merged);
+    } else {
+      req.insert(name, value);
+    }
+    return 0;
+  }
+
+  static int onFrameRecv(nghttp2_session* session, const nghttp2_frame* frame, void* user_data) {
+    if (frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) {
+      return 0;
+    }
+    auto* s = stream(session, frame->hd.stream_id);
+    if (!s) {
+      return 0;
+    }
+    auto& connection = self(user_data);
+    if (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) {
+      s->eof = true;
+    }
+    if (frame->hd.type == NGHTTP2_HEADERS && !s->started) {
+      s->started = true;
+      s->method = s->req->method();
+      connection.callbacks_.on_headers(*s);
+      // Content-Length 已经超过上限时不等 body, 直接回复 413
+      if (auto it = s->req->find(http::field::content_length); it != s->req->end()) {
+        auto value = toStringView(it->value());
+        uint64_t length = 0;
+        auto parsed = std::from_chars(value.data(), value.data() + value.size(), length);
+        if (parsed.ec == std::errc()) {
+          s->content_length = length;
+          s->too_large = length > s->body_limit;
+        }
+      }
+    }
+    if (s->dispatched) {
+      if (s->streaming && s->eof) {
+        connection.callbacks_.on_data(*s);
+      }
+      return 0;
+    }
+    if (s->too_large || s->streaming || s->eof) {
+      s->dispatched = true;
+      if (!s->too_large && !s->streaming) {
+        s->req->prepare_payload(); // 按收到的 body 设置 Content-Length
+      }
+      connection.callbacks_.on_request(*s);
+    }
+    return 0;
+  }
+
+  static int onDataChunk(nghttp2_session* session, uint8_t, int32_t id, const uint8_t* data, size_t size,
+                         void* user_data) {
+    auto* s = stream(session, id);
+    if (!s || s->too_large) {
+      nghttp2_session_consume(session, id, size); // 丢弃, 直接归还窗口
+      return 0;
+    }
+    auto& connection = self(user_data);
+    s->bytes_in += size;
+    if (s->bytes_in > s->body_limit) {
+      s->too_large = true;
+      nghttp2_session_consume(session, id, size);
+      if (s->streaming) {
+        connection.discard(*s);
+        connection.callbacks_.on_data(*s); // 处理函数的下一次 read 抛出异常
+      } else {
+        s->req->body().clear();
+        s->dispatched = true;
+        connection.callbacks_.on_request(*s);
+      }
+      return 0;
+    }
+    if (s->streaming) {
+      s->pending.append(reinterpret_cast<const char*>(data), size); // 处理函数读取后归还窗口
+      connection.callbacks_.on_data(*s);
+    } else {
+      s->req->body().append(reinterpret_cast<const char*>(data), size);
+      nghttp2_session_consume(session, id, size);
+    }
+    return 0;
+  }
+
+  static int onFrameSend(nghttp2_session* session, const nghttp2_frame* frame, void*) {
+    if ((frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) ||
+        !(frame->hd.flags & NGHTTP2_FLAG_END_STREAM)) {
+      return 0;
+    }
+    auto* s = stream(session, frame->hd.stream_id);
+    if (!s) {
+      return 0;
+    }
+    s->end = Http2Connection::Clock::now();
+    // 响应已经写完而客户端还在发送 body (413, 或流式处理函数没有读完): 重置流让它停止 (RFC 9113 8.1)
+    if (!nghttp2_session_get_stream_remote_close(session, s->id)) {
+      nghttp2_submit_rst_stream(session, NGHTTP2_FLAG_NONE, s->id, NGHTTP2_NO_ERROR);
+    }
+    return 0;
+  }
+
+  static int onStreamClose(nghttp2_session* session, int32_t id, uint32_t, void* user_data) {
+    if (auto* s = stream(session, id)) {
+      self(user_data).close(*s);
+    }
+    return 0;
+  }
+
+  static ssize_t readBody(nghttp2_session*, int32_t, uint8_t* buf, size_t length, uint32_t* data_flags,
+                          nghttp2_data_source* source, void* user_data) {
+    auto& s = *static_cast<Http2Connection::Stream*>(source->ptr);
+    const auto& body = s.res->body();
+    size_t n = 0;
+    bool eof = false;
+    if (body.source()) {
+      if (s.chunk_offset == s.chunk.size()) {
+        if (!s.source_eof) {
+          if (!s.source_reading) {
+            s.source_reading = true;
+            self(user_data).callbacks_.on_source_read(s);
+          }
+          return NGHTTP2_ERR_DEFERRED;
+        }
+        eof = true;
+      } else {
+        n = std::min(length, s.chunk.size() - s.chunk_offset);
+        std::memcpy(buf, s.chunk.data() + s.chunk_offset, n);
+        s.chunk_offset += n;
+      }
+    } else if (auto* file = body.file()) {
+      // 响应的复制共享同一个文件, 从头读取时先定位
+      boost::beast::error_code ec;
+      if (s.sent == 0) {
+        file->file().seek(0, ec);
+      }
+      uint64_t remain = file->size() - s.sent;
+      n = ec ? 0 : file->file().read(buf, static_cast<size_t>(std::min<uint64_t>(length, remain)), ec);
+      if (ec || (n == 0 && remain > 0)) {
+        return NGHTTP2_ERR_TEMPORAL_CALLBACK_FAILURE; // 重置这个流
+      }
+      eof = n == remain;
+    } else {
+      const auto* vector = body.vector();
+      const char* data = vector ? vector->data() : body.data();
+      size_t size = vector ? vector->size() : body.size();
+      n = std::min(length, size - s.sent);
+      std::memcpy(buf, data + s.sent, n);
+      eof = s.sent + n == size;
+    }
+    s.sent += n;
+    s.bytes_out += n;
+    if (eof) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return static_cast<ssize_t>(n);
+  }
+};
+
+Http2Connection::Http2Connection(const Options& options, Callbacks callbacks)
+  : options_(options), callbacks_(std::move(callbacks)) {
+  nghttp2_session_callbacks* cbs;
+  if (nghttp2_session_callbacks_new(&cbs) != 0) {
+    throw std::runtime_error("Failed to create nghttp2 callbacks");
+  }
+  nghttp2_session_callbacks_set_on_begin_headers_callback(cbs, &Http2Callbacks::onBeginHeaders);
+  nghttp2_session_callbacks_set_on_header_callback(cbs, &Http2Callbacks::onHeader);
+  nghttp2_session_callbacks_set_on_frame_recv_callback(cbs, &Http2Callbacks::onFrameRecv);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(cbs, &Http2Callbacks::onDataChunk);
+  nghttp2_session_callbacks_set_on_frame_send_callback(cbs, &Http2Callbacks::onFrameSend);
+  nghttp2_session_callbacks_set_on_stream_close_callback(cbs, &Http2Callbacks::onStreamClose);
+  // 接收窗口由 nghttp2_session_consume 归还: 缓存的 body 收到即归还, 流式请求的 body 在处理函数读取后归还
+  nghttp2_option* option;
+  if (nghttp2_option_new(&option) != 0) {
+    nghttp2_session_callbacks_del(cbs);
+    throw std::runtime_error("Failed to create nghttp2 option");
+  }
+  nghttp2_option_set_no_auto_window_update(option, 1);
+  int rv = nghttp2_session_server_new2(&session_, cbs, this, option);
+  nghttp2_option_del(option);
+  nghttp2_session_callbacks_del(cbs);
+  if (rv != 0) {
+    throw std::runtime_error(std::string("Failed to create nghttp2 session: ") + nghttp2_strerror(rv));
+  }
+
+  // 窗口不超过 2^31-1; 连接的窗口同样放大, 避免多个流同时上传时被默认的 64KB 连接窗口限制
+  uint32_t window = std::min<uint32_t>(options_.window_bytes, NGHTTP2_MAX_WINDOW_SIZE);
+  nghttp2_settings_entry settings[] = {
+    {NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, options_.max_concurrent_streams},
+    {NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE, window},
+  };
+  nghttp2_submit_settings(session_, NGHTTP2_FLAG_NONE, settings, std::size(settings));
+  nghttp2_session_set_local_window_size(session_, NGHTTP2_FLAG_NONE, 0, static_cast<int32_t>(window));
+}
+
+Http2Connection::~Http2Connection() {
+  // 不会再调用回调; 流 (及其中的 arena) 随 streams_ 析构
+  nghttp2_session_del(session_);
+}
+
+Http2Connection::Stream& Http2Connection::open(int32_t id) {
+  std::unique_ptr<Stream> stream;
+  if (!free_.empty()) {
+    stream = std::move(free_.back());
+    free_.pop_back();
+  } else {
+    stream = std::make_unique<Stream>(options_.arena_bytes, options_.arena_max_bytes);
+  }
+  stream->id = id;
+  Allocator alloc(stream->arena.resource());
+  stream->req.emplace(std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc));
+  stream->req->version(11); // 处理函数按 HTTP/1.1 的语义处理 (如 keep_alive), 与协议版本无关
+  auto& slot = streams_[id];
+  slot = std::move(stream);
+  return *slot;
+}
+
+void Http2Connection::close(Stream& stream) {
+  stream.closed = true;
+  discard(stream);
+  callbacks_.on_close(stream);
+  if (!stream.handling) {
+    release(stream);
+  }
+}
+
+void Http2Connection::discard(Stream& stream) {
+  if (size_t unread = stream.pending.size() - stream.pending_offset) {
+    // 流已经关闭时只能归还连接的窗口
+    if (stream.closed || nghttp2_session_consume(session_, stream.id, unread) != 0) {
+      nghttp2_session_consume_connection(session_, unread);
+    }
+  }
+  stream.pending.clear();
+  stream.pending_offset = 0;
+}
+
+size_t Http2Connection::read(Stream& stream, net::mutable_buffer buffer) {
+  size_t n = std::min(buffer.size(), stream.pending.size() - stream.pending_offset);
+  if (n == 0) {
+    return 0;
+  }
+  std::memcpy(buffer.data(), stream.pending.data() + stream.pending_offset, n);
+  stream.pending_offset += n;
+  if (stream.pending_offset == stream.pending.size()) {
+    stream.pending.clear();
+    stream.pending_offset = 0;
+  }
+  nghttp2_session_consume(session_, stream.id, n);
+  return n;
+}
+
+void Http2Connection::release(Stream& stream) {
+  auto it = streams_.find(stream.id);
+  if (it == streams_.end()) {
+    return;
+  }
+  auto owned = std::move(it->second);
+  streams_.erase(it);
+  // 复位后放回, 保留的数量不超过并发流上限
+  owned->req.reset();
+  owned->res.reset();
+  owned->reader.reset();
+  owned->permit.release();
+  owned->arena.reset();
+  if (free_.size() < options_.max_concurrent_streams) {
+    Stream& s = *owned;
+    s.method = http::verb::unknown;
+    s.content_length.reset();
+    s.body_limit = s.bytes_in = s.bytes_out = 0;
+    s.sent = 0;
+    if (s.pending.capacity() > 64 * 1024) {
+      s.pending = std::string();
+    }
+    s.chunk = std::string();
+    s.chunk_offset = 0;
+    s.started = s.streaming = s.eof = s.too_large = s.dispatched = s.handling = s.closed = false;
+    s.source_reading = s.source_eof = false;
+    s.route = {};
+    s.route_id = SIZE_MAX;
+    s.encoding = ContentEncoding::identity;
+    s.resource.clear();
+    s.start = s.read_done = s.handle_start = s.handle_done = s.write_start = s.end = {};
+    s.trace.clear();
+    free_.push_back(std::move(owned));
+  }
+}
+
+bool Http2Connection::receive(std::string_view data) {
+  receiving_ = true;
+  auto n = nghttp2_session_mem_recv(session_, reinterpret_cast<const uint8_t*>(data.data()), data.size());
+  receiving_ = false;
+  if (n < 0) {
+    // 客户端前言错误、帧洪泛等: 发送 GOAWAY 后关闭连接
+    nghttp2_session_terminate_session(session_, n == NGHTTP2_ERR_FLOODED ? NGHTTP2_ENHANCE_YOUR_CALM
+                                                                          : NGHTTP2_PROTOCOL_ERROR);
+    return false;
+  }
+  return true;
+}
+
+std::string_view Http2Connection::output(size_t max) {
+  out_.clear();
+  while (out_.size() < max) {
+    const uint8_t* data = nullptr;
+    auto n = nghttp2_session_mem_send(session_, &data);
+    if (n <= 0) { // 0 为没有要写的; 负值只有内存不足等致命错误, 不再写出, 连接随之关闭
+      break;
+    }
+    out_.append(reinterpret_cast<const char*>(data), static_cast<size_t>(n));
+  }
+  return out_;
+}
+
+bool Http2Connection::wantRead() const {
+  return nghttp2_session_want_read(session_) != 0;
+}
+
+bool Http2Connection::wantWrite() const {
+  return nghttp2_session_want_write(session_) != 0;
+}
+
+void Http2Connection::respond(Stream& stream, Response&& response) {
+  if (stream.closed) {
+    return;
+  }
+  stream.res.emplace(std::move(response));
+  auto& res = *stream.res;
+
+  // 头名称转成小写, 先全部写入 names_ 再取指针, 避免扩容后失效
+  names_.clear();
+  for (const auto& field : res) {
+    if (!connectionSpecific(field.name_string())) {
+      names_.append(toStringView(field.name_string()));
+    }
+  }
+  std::transform(names_.begin(), names_.end(), names_.begin(),
+                 [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+  char status[4];
+  std::snprintf(status, sizeof(status), "%03u", std::min(res.result_int(), 999u));
+
+  std::vector<nghttp2_nv> nva;
+  nva.reserve(16);
+  nva.push_back(header(":status", status));
+  size_t offset = 0;
+  for (const auto& field : res) {
+    auto name = field.name_string();
+    if (connectionSpecific(name)) {
+      continue;
+    }
+    nva.push_back(header(std::string_view(names_).substr(offset, name.size()), toStringView(field.value())));
+    offset += name.size();
+  }
+
+  // HEAD、204 和 304 的响应没有 body
+  bool body = stream.method != http::verb::head && res.result() != http::status::no_content &&
+              res.result() != http::status::not_modified &&
+              (res.body().source() || ResponseBody::size(res.body()) > 0);
+  nghttp2_data_provider provider{};
+  provider.source.ptr = &stream;
+  provider.read_callback = &Http2Callbacks::readBody;
+  int rv = nghttp2_submit_response(session_, stream.id, nva.data(), nva.size(), body ? &provider : nullptr);
+  if (rv != 0) {
+    nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_NONE, stream.id, NGHTTP2_INTERNAL_ERROR);
+  }
+}
+
+void Http2Connection::supply(Stream& stream, std::string&& chunk) {
+  stream.source_reading = false;
+  if (stream.closed) {
+    return;
+  }
+  stream.source_eof = chunk.empty();
+  stream.chunk = std::move(chunk);
+  stream.chunk_offset = 0;
+  nghttp2_session_resume_data(session_, stream.id);
+}
+
+void Http2Connection::reset(Stream& stream, uint32_t error_code) {
+  if (!stream.closed) {
+    nghttp2_submit_rst_stream(session_, NGHTTP2_FLAG_NONE, stream.id, error_code);
+  }
+}
+
+Http2Connection::Stream* Http2Connection::find(int32_t id) {
+  auto it = streams_.find(id);
+  return it == streams_.end() ? nullptr : it->second.get();
+}
+
+void Http2Connection::terminate() {
+  std::vector<Stream*> open;
+  for (auto& [id, stream] : streams_) {
+    if (!stream->closed) {
+      open.push_back(stream.get());
+    }
+  }
+  for (auto* stream : open) {
+    close(*stream);
+  }
+}
+
+void Http2Connection::shutdown() {
+  if (shutdown_) {
+    return;
+  }
+  shutdown_ = true;
+  nghttp2_submit_goaway(session_, NGHTTP2_FLAG_NONE, nghttp2_session_get_last_proc_stream_id(session_),
+                        NGHTTP2_NO_ERROR, nullptr, 0);
+}
+
+}
+
+#endif
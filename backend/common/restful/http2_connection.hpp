@@ -0,0 +1,146 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "common/restful/admission_controller.hpp"
+#include "common/restful/body_reader.hpp"
+#include "common/restful/compression.hpp"
+#include "common/restful/http_types.hpp"
+#include "common/restful/request_arena.hpp"
+#include "common/restful/request_trace.hpp"
+
+typedef struct nghttp2_session nghttp2_session;
+
+namespace common {
+
+/*
+  一个 HTTP/2 连接的协议状态, 基于 nghttp2: 帧的解析和生成、HPACK、流的多路复用和流控。
+  不做 IO: 调用方把从 socket 读到的字节交给 receive, 把 output 返回的字节写到 socket。
+  每个流的请求读完后通过 Callbacks::on_request 交给调用方处理, 处理完用 respond 提交响应; 各个流的响应按流控交错写出。
+  流式路由的请求读完请求头即交给调用方, body 暂存在流中由 read 取走; 取走之后才发送 WINDOW_UPDATE,
+  处理函数读得慢时客户端因窗口用尽而暂停发送, 暂存的数据不超过一个窗口
+  响应的 body 为 BodySource 时, 需要数据而没有时暂停这个流的 DATA 帧并调用 on_source_read, 调用方读到后用 supply 交回
+  只能在连接的 executor 上使用; 不能在回调中 (receive 期间) 调用 output
+*/
+class Http2Connection {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // 一个请求流, 请求头、body 和处理期间的分配都在自己的 arena 中; 流关闭后复用
+  struct Stream {
+    Stream(size_t arena_bytes, size_t arena_max_bytes) : arena(arena_bytes, arena_max_bytes) {}
+
+    RequestArena arena; // 需在 req/res 之前声明, 保证最后析构
+    std::optional<Request> req; // 交给处理函数后为空
+    std::optional<Response> res;
+    std::unique_ptr<BodyReader> reader; // 交给流式处理函数的 BodyReader
+    std::string pending; // 流式请求收到、还没有被 read 取走的 body
+    size_t pending_offset = 0;
+    int32_t id = 0;
+    http::verb method = http::verb::unknown;
+    std::optional<uint64_t> content_length;
+    uint64_t body_limit = 0; // on_headers 中由调用方设置
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    size_t sent = 0; // 已经交给 DATA 帧的 body 字节数
+    std::string chunk; // BodySource 读到、还没有交给 DATA 帧的数据
+    size_t chunk_offset = 0;
+    bool started = false; // 已调用 on_headers
+    bool streaming = false; // on_headers 中由调用方设置: 读完请求头即调用 on_request, body 通过 read 读取
+    bool eof = false; // 请求已经读完 (收到 END_STREAM)
+    bool too_large = false; // body 超过上限, 不再接收, 回复 413 后 RST_STREAM
+    bool dispatched = false; // 已调用 on_request
+    bool handling = false; // 处理函数还在运行, 流关闭后保留到 release
+    bool closed = false;
+    bool source_reading = false; // 已调用 on_source_read, 等待 supply
+    bool source_eof = false;
+    // 以下由调用方使用: 路由、准入名额、响应编码, 以及各阶段的时刻 (见 HttpMetrics::Sample)
+    std::string_view route;
+    size_t route_id = SIZE_MAX;
+    AdmissionController::Permit permit;
+    ContentEncoding encoding = ContentEncoding::identity;
+    std::string resource; // 协商了压缩时为 "方法 target", 与 ETag 一起作为压缩缓存的 key
+    Clock::time_point start;
+    Clock::time_point read_done;
+    Clock::time_point handle_start;
+    Clock::time_point handle_done;
+    Clock::time_point write_start;
+    Clock::time_point end; // 响应的最后一帧交给 output 的时刻
+    RequestTrace trace;
+  };
+
+  struct Callbacks {
+    std::function<void(Stream&)> on_headers; // 请求头读完, 读 body 之前
+    std::function<void(Stream&)> on_request; // 请求读完 (流式请求为请求头读完), 或 body 超过上限 (too_large)
+    std::function<void(Stream&)> on_data; // 流式请求收到 body、读完或超过上限
+    std::function<void(Stream&)> on_close; // 流关闭 (响应写完、对端 RST_STREAM 或连接关闭); 之后 Stream 可能被复用
+    // 响应的 BodySource 需要读取下一块; 在 output 中调用, 调用方不能在回调中同步调用 supply
+    std::function<void(Stream&)> on_source_read;
+  };
+
+  struct Options {
+    uint32_t max_concurrent_streams;
+    uint32_t window_bytes; // 每个流和整个连接的接收窗口
+    size_t arena_bytes;
+    size_t arena_max_bytes;
+  };
+
+  // 客户端前言的开头; HTTP/1 解析器读到它时因版本号报错 (不消费数据), 调用方据此把连接转为 HTTP/2
+  static constexpr std::string_view kPrefaceStart = "PRI * HTTP/2.0";
+
+  Http2Connection(const Options& options, Callbacks callbacks);
+  ~Http2Connection();
+  Http2Connection(const Http2Connection&) = delete;
+  Http2Connection& operator=(const Http2Connection&) = delete;
+
+  // 返回 false 表示连接级错误 (如客户端前言不对), 此时已排队 GOAWAY, 写出后关闭连接
+  bool receive(std::string_view data);
+  bool receiving() const { return receiving_; }
+  // 取出要写到 socket 的字节 (约 max 字节, 至少一帧), 返回的数据在下次调用前有效; 为空表示暂时没有要写的
+  std::string_view output(size_t max);
+  // wantRead 和 wantWrite 都为 false 时连接可以关闭
+  bool wantRead() const;
+  bool wantWrite() const;
+
+  // 流式请求: 取走暂存的 body 并更新接收窗口, 返回取走的字节数; 为 0 时看 eof/too_large/closed
+  size_t read(Stream& stream, net::mutable_buffer buffer);
+  // 提交流的响应, 流已经关闭时丢弃
+  void respond(Stream& stream, Response&& response);
+  // 交回 BodySource 读到的下一块, 为空表示结束; 流已经关闭时丢弃
+  void supply(Stream& stream, std::string&& chunk);
+  // 以 error_code 重置流 (如处理函数抛出异常时的 INTERNAL_ERROR)
+  void reset(Stream& stream, uint32_t error_code);
+  // 处理函数返回后查找流, 包括处理期间已经关闭的; 关闭了的调用方用 release 回收
+  Stream* find(int32_t id);
+  void release(Stream& stream);
+  // 优雅关闭: 发送 GOAWAY, 已经开始的流继续处理, 之后不再接受新流; 重复调用无效
+  void shutdown();
+  // 连接已经断开: 对所有未关闭的流调用 on_close, 之后不再使用 receive/output
+  void terminate();
+
+private:
+  Stream& open(int32_t id);
+  void close(Stream& stream);
+  // 归还流式请求暂存而没有读取的 body 所占的接收窗口
+  void discard(Stream& stream);
+
+  friend struct Http2Callbacks;
+  Options options_;
+  Callbacks callbacks_;
+  nghttp2_session* session_ = nullptr;
+  std::unordered_map<int32_t, std::unique_ptr<Stream>> streams_;
+  std::vector<std::unique_ptr<Stream>> free_; // 复用的流, 保留 arena 的内存
+  std::string out_;
+  std::string names_; // 提交响应时转成小写的头名称
+  bool receiving_ = false;
+  bool shutdown_ = false;
+};
+
+}
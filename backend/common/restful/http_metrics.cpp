@@ -0,0 +1,355 @@
+#include "http_metrics.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+
+namespace common {
+
+namespace {
+
+// 当前线程绑定的 HttpMetrics 和分片
+thread_local const HttpMetrics* t_owner = nullptr;
+thread_local void* t_shard = nullptr;
+
+constexpr const char* kClassNames[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+constexpr const char* kPhaseNames[] = {"read", "handle", "write"};
+constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+// Prometheus histogram 的 le: 16us 到 2^26 us (约 67 s) 的 4 的幂, 与细分桶的边界对齐
+constexpr unsigned kFirstLeExponent = 4;
+constexpr unsigned kLastLeExponent = 26;
+
+uint64_t micros(std::chrono::steady_clock::duration d) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  return us > 0 ? static_cast<uint64_t>(us) : 0;
+}
+
+void appendNumber(std::string& out, double value) {
+  char buf[32];
+  auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+  out.append(buf, end);
+}
+
+void appendNumber(std::string& out, uint64_t value) {
+  char buf[20];
+  auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+  out.append(buf, end);
+}
+
+void appendSeconds(std::string& out, uint64_t us) {
+  appendNumber(out, static_cast<double>(us) / 1e6);
+}
+
+// 标签值转义反斜杠、引号和换行
+void appendLabel(std::string& out, const char* name, std::string_view value, bool first = false) {
+  if (!first) {
+    out += ',';
+  }
+  out += name;
+  out += "=\"";
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+  out += '"';
+}
+
+void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+}
+
+// 合并后的直方图
+struct Merged {
+  std::vector<uint64_t> buckets = std::vector<uint64_t>(HttpMetrics::kBuckets);
+  uint64_t count = 0;
+  uint64_t sum_us = 0;
+};
+
+// 桶的中点作为分位数的估计值
+uint64_t quantileOf(const Merged& h, double q) {
+  auto rank = static_cast<uint64_t>(q * static_cast<double>(h.count - 1)) + 1;
+  uint64_t seen = 0;
+  for (size_t b = 0; b < h.buckets.size(); ++b) {
+    seen += h.buckets[b];
+    if (seen >= rank) {
+      uint64_t lower = b == 0 ? 0 : HttpMetrics::bucketUpper(b - 1);
+      return lower + (HttpMetrics::bucketUpper(b) - lower) / 2;
+    }
+  }
+  return HttpMetrics::bucketUpper(h.buckets.size() - 1);
+}
+
+// labels 为已格式化的标签 (不含大括号), 依次输出 _bucket、_sum、_count
+void appendHistogram(std::string& out, const char* name, const std::string& labels, const Merged& h) {
+  uint64_t cumulative = 0;
+  size_t b = 0;
+  for (unsigned e = kFirstLeExponent; e <= kLastLeExponent; e += 2) {
+    uint64_t bound = uint64_t{1} << e;
+    for (; b < h.buckets.size() && HttpMetrics::bucketUpper(b) <= bound; ++b) {
+      cumulative += h.buckets[b];
+    }
+    out += name;
+    out += "_bucket{";
+    out += labels;
+    out += ",le=\"";
+    appendSeconds(out, bound);
+    out += "\"} ";
+    appendNumber(out, cumulative);
+    out += '\n';
+  }
+  out += name;
+  out += "_bucket{";
+  out += labels;
+  out += ",le=\"+Inf\"} ";
+  appendNumber(out, h.count);
+  out += '\n';
+  out += name;
+  out += "_sum{";
+  out += labels;
+  out += "} ";
+  appendSeconds(out, h.sum_us);
+  out += '\n';
+  out += name;
+  out += "_count{";
+  out += labels;
+  out += "} ";
+  appendNumber(out, h.count);
+  out += '\n';
+}
+
+} // namespace
+
+size_t HttpMetrics::bucketOf(uint64_t us) {
+  if (us < kSubBuckets) {
+    return static_cast<size_t>(us);
+  }
+  unsigned exponent = static_cast<unsigned>(std::bit_width(us)) - 1; // >= 3
+  if (exponent > kMaxExponent) {
+    return kBuckets - 1;
+  }
+  size_t sub = (us >> (exponent - 3)) & (kSubBuckets - 1);
+  return kSubBuckets + (exponent - 3) * kSubBuckets + sub;
+}
+
+uint64_t HttpMetrics::bucketUpper(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket + 1;
+  }
+  size_t exponent = (bucket - kSubBuckets) / kSubBuckets + 3;
+  size_t sub = (bucket - kSubBuckets) % kSubBuckets;
+  return (kSubBuckets + sub + 1) << (exponent - 3);
+}
+
+void HttpMetrics::Histogram::record(uint64_t us) {
+  buckets[bucketOf(us)].add(1);
+  count.add(1);
+  sum_us.add(us);
+}
+
+void HttpMetrics::setRoutes(std::vector<std::pair<std::string, std::string>> routes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  routes_ = std::move(routes);
+  fallback_ = std::make_unique<Shard>(routes_.size() + 1);
+}
+
+void HttpMetrics::bindThread() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  shards_.push_back(std::make_unique<Shard>(routes_.size() + 1));
+  t_owner = this;
+  t_shard = shards_.back().get();
+}
+
+template <class F>
+void HttpMetrics::withShard(F&& f) {
+  if (t_owner == this) {
+    f(*static_cast<Shard*>(t_shard));
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (fallback_) {
+    f(*fallback_);
+  }
+}
+
+void HttpMetrics::begin() {
+  withShard([](Shard& shard) {
+    shard.in_flight.store(shard.in_flight.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  });
+}
+
+void HttpMetrics::abandon(size_t count) {
+  withShard([count](Shard& shard) {
+    shard.in_flight.store(shard.in_flight.load(std::memory_order_relaxed) - static_cast<int64_t>(count),
+                          std::memory_order_relaxed);
+  });
+}
+
+void HttpMetrics::record(const Sample& sample) {
+  withShard([this, &sample](Shard& shard) { recordInto(shard, sample); });
+}
+
+void HttpMetrics::recordInto(Shard& shard, const Sample& sample) {
+  shard.in_flight.store(shard.in_flight.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+
+  auto& stats = shard.routes[std::min(sample.route, shard.routes.size() - 1)];
+  size_t status_class = std::clamp(sample.status / 100, 1u, 5u) - 1;
+  stats.latency[status_class].record(micros(sample.end - sample.start));
+  stats.bytes_in.add(sample.bytes_in);
+  stats.bytes_out.add(sample.bytes_out);
+
+  constexpr Clock::time_point none{};
+  if (sample.read_done != none) {
+    shard.phases[static_cast<size_t>(Phase::read)].record(micros(sample.read_done - sample.start));
+  }
+  if (sample.handle_start != none && sample.handle_done != none) {
+    shard.phases[static_cast<size_t>(Phase::handle)].record(micros(sample.handle_done - sample.handle_start));
+  }
+  if (sample.write_start != none) {
+    shard.phases[static_cast<size_t>(Phase::write)].record(micros(sample.end - sample.write_start));
+  }
+}
+
+void HttpMetrics::render(std::string& out, const std::vector<Gauge>& gauges) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t route_count = routes_.size() + 1;
+
+  // 合并所有分片; 记录线程同时在写, 各计数器之间不是同一时刻的快照, 相差最多几个正在记录的请求
+  std::vector<std::array<Merged, 5>> latency(route_count);
+  std::vector<std::pair<uint64_t, uint64_t>> bytes(route_count);
+  std::array<Merged, 3> phases;
+  int64_t in_flight = 0;
+  auto merge = [](Merged& into, const Histogram& from) {
+    for (size_t b = 0; b < kBuckets; ++b) {
+      into.buckets[b] += from.buckets[b].get();
+    }
+    into.count += from.count.get();
+    into.sum_us += from.sum_us.get();
+  };
+  auto mergeShard = [&](const Shard& shard) {
+    for (size_t r = 0; r < route_count; ++r) {
+      for (size_t c = 0; c < 5; ++c) {
+        if (shard.routes[r].latency[c].count.get() > 0) {
+          merge(latency[r][c], shard.routes[r].latency[c]);
+        }
+      }
+      bytes[r].first += shard.routes[r].bytes_in.get();
+      bytes[r].second += shard.routes[r].bytes_out.get();
+    }
+    for (size_t p = 0; p < phases.size(); ++p) {
+      merge(phases[p], shard.phases[p]);
+    }
+    in_flight += shard.in_flight.load(std::memory_order_relaxed);
+  };
+  for (const auto& shard : shards_) {
+    mergeShard(*shard);
+  }
+  if (fallback_) {
+    mergeShard(*fallback_);
+  }
+
+  auto routeLabels = [this, route_count](size_t r) {
+    std::string labels;
+    if (r + 1 == route_count) {
+      appendLabel(labels, "method", "", true);
+      appendLabel(labels, "route", "unmatched");
+    } else {
+      appendLabel(labels, "method", routes_[r].first, true);
+      appendLabel(labels, "route", routes_[r].second);
+    }
+    return labels;
+  };
+
+  // 没有请求的序列不输出
+  appendHeader(out, "http_request_duration_seconds", "histogram",
+               "Time from request header received to response written.");
+  for (size_t r = 0; r < route_count; ++r) {
+    for (size_t c = 0; c < 5; ++c) {
+      if (latency[r][c].count == 0) {
+        continue;
+      }
+      auto labels = routeLabels(r);
+      appendLabel(labels, "code", kClassNames[c]);
+      appendHistogram(out, "http_request_duration_seconds", labels, latency[r][c]);
+    }
+  }
+
+  appendHeader(out, "http_request_duration_quantile_seconds", "gauge",
+               "Request duration quantiles from the log-linear histogram (12.5% relative error).");
+  for (size_t r = 0; r < route_count; ++r) {
+    for (size_t c = 0; c < 5; ++c) {
+      if (latency[r][c].count == 0) {
+        continue;
+      }
+      auto labels = routeLabels(r);
+      appendLabel(labels, "code", kClassNames[c]);
+      for (double q : kQuantiles) {
+        out += "http_request_duration_quantile_seconds{";
+        out += labels;
+        out += ",quantile=\"";
+        appendNumber(out, q);
+        out += "\"} ";
+        appendSeconds(out, quantileOf(latency[r][c], q));
+        out += '\n';
+      }
+    }
+  }
+
+  appendHeader(out, "http_request_bytes_total", "counter", "Request header and body bytes read.");
+  for (size_t r = 0; r < route_count; ++r) {
+    if (bytes[r].first == 0 && bytes[r].second == 0) {
+      continue;
+    }
+    out += "http_request_bytes_total{";
+    out += routeLabels(r);
+    out += "} ";
+    appendNumber(out, bytes[r].first);
+    out += '\n';
+  }
+  appendHeader(out, "http_response_bytes_total", "counter", "Response bytes written.");
+  for (size_t r = 0; r < route_count; ++r) {
+    if (bytes[r].first == 0 && bytes[r].second == 0) {
+      continue;
+    }
+    out += "http_response_bytes_total{";
+    out += routeLabels(r);
+    out += "} ";
+    appendNumber(out, bytes[r].second);
+    out += '\n';
+  }
+
+  appendHeader(out, "http_request_phase_seconds", "histogram",
+               "Time spent reading the body, in the handler, and writing the response.");
+  for (size_t p = 0; p < phases.size(); ++p) {
+    std::string labels;
+    appendLabel(labels, "phase", kPhaseNames[p], true);
+    appendHistogram(out, "http_request_phase_seconds", labels, phases[p]);
+  }
+
+  appendHeader(out, "http_requests_in_flight", "gauge", "Requests with header read and response not yet written.");
+  out += "http_requests_in_flight ";
+  appendNumber(out, static_cast<double>(std::max<int64_t>(in_flight, 0)));
+  out += '\n';
+
+  for (const auto& gauge : gauges) {
+    appendHeader(out, gauge.name, gauge.type, gauge.help);
+    out += gauge.name;
+    out += ' ';
+    appendNumber(out, gauge.value);
+    out += '\n';
+  }
+}
+
+}
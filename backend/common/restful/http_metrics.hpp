@@ -0,0 +1,113 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace common {
+
+/*
+  HttpServer 的请求指标, 以 Prometheus 文本格式导出。
+  - 每个 io 线程一个分片, 只有该线程写入: 计数器用 relaxed 的 load + store, 不需要原子的读-改-写
+  - 导出时合并所有分片, 不阻塞记录
+  - 耗时直方图按 HDR 的对数-线性分桶 (每个 2 的幂区间分 8 个桶, 相对误差不超过 12.5%), 单位微秒;
+    导出时按 4 的幂合并为 Prometheus histogram 的 le, 另外从细分桶计算分位数
+  - 路由按 Router 注册时分配的 id 直接索引, 记录时不查表
+*/
+class HttpMetrics {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // 阶段: 读 body (请求头之后), 处理 (交给处理函数到生成响应), 写响应
+  enum class Phase { read, handle, write };
+
+  // 一个写完的请求, 时刻为空 (time_point{}) 的阶段不记录
+  struct Sample {
+    size_t route; // Router 中的 id, 未匹配的请求为 routes.size()
+    unsigned status;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    Clock::time_point start; // 读完请求头
+    Clock::time_point read_done;
+    Clock::time_point handle_start;
+    Clock::time_point handle_done;
+    Clock::time_point write_start;
+    Clock::time_point end;
+  };
+
+  // 导出时附带的服务器级别的值
+  struct Gauge {
+    const char* name;
+    const char* type; // "gauge" 或 "counter"
+    const char* help;
+    double value;
+  };
+
+  // routes 的下标为 Router 中的 id, 元素为 (方法, 路由模式); 在任何线程 bindThread 之前调用
+  void setRoutes(std::vector<std::pair<std::string, std::string>> routes);
+  // 为当前线程创建分片, 由 HttpServer 在每个 io 线程开始时调用
+  void bindThread();
+
+  // 读完请求头时调用; 之后必须以 record 或 abandon 结束
+  void begin();
+  void record(const Sample& sample);
+  // 请求没有写出响应 (连接关闭)
+  void abandon(size_t count = 1);
+
+  void render(std::string& out, const std::vector<Gauge>& gauges) const;
+
+  static constexpr size_t kSubBuckets = 8;
+  static constexpr size_t kMaxExponent = 27; // 2^27 us 约 134 s, 更大的值计入最后一个桶
+  static constexpr size_t kBuckets = kSubBuckets + (kMaxExponent - 2) * kSubBuckets;
+
+  // 值 (微秒) 所在的桶; 小于 kSubBuckets 的值每个一个桶
+  static size_t bucketOf(uint64_t us);
+  // 桶内值的上界 (不含)
+  static uint64_t bucketUpper(size_t bucket);
+
+private:
+  // 单写者计数器: 只有所属分片的线程写入, 导出线程读取
+  struct Counter {
+    std::atomic<uint64_t> value{0};
+    void add(uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+  };
+
+  struct Histogram {
+    std::array<Counter, kBuckets> buckets;
+    Counter count;
+    Counter sum_us;
+    void record(uint64_t us);
+  };
+
+  // 按状态码类别 1xx-5xx
+  struct RouteStats {
+    std::array<Histogram, 5> latency;
+    Counter bytes_in;
+    Counter bytes_out;
+  };
+
+  struct Shard {
+    explicit Shard(size_t routes) : routes(routes) {}
+    std::vector<RouteStats> routes;
+    std::array<Histogram, 3> phases;
+    std::atomic<int64_t> in_flight{0}; // 请求可能在另一个线程上开始, 单个分片可以为负
+  };
+
+  // 当前线程绑定的分片; 没有绑定的线程 (如析构时的主线程) 加锁写入 fallback_
+  template <class F>
+  void withShard(F&& f);
+  void recordInto(Shard& shard, const Sample& sample);
+
+  std::vector<std::pair<std::string, std::string>> routes_;
+  mutable std::mutex mutex_; // 保护 shards_ 的注册和 fallback_ 的写入
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::unique_ptr<Shard> fallback_;
+};
+
+}
@@ -1,115 +1,1637 @@
 #include "http_server.hpp"
-#include <iostream>
+#include <unistd.h>
+#include <algorithm>
+#include <boost/asio/co_spawn.hpp>
+#include <limits>
+#include "common/restful/listener_handoff.hpp"
+#include "common/restful/tls_context.hpp"
+#ifdef ENABLE_HTTP2
+#include <nghttp2/nghttp2.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace common {
 
+namespace {
+
+// 给回调关联 arena 的 allocator, beast/asio 为这次异步读写分配的中间状态也落在 arena 中。
+// 这些状态在回调执行前释放, 不会跨过 onWrite 中的 arena_.reset()
+template <class Handler>
+class ArenaBoundHandler {
+public:
+  using allocator_type = ArenaAllocator<void>;
+
+  ArenaBoundHandler(Handler handler, std::pmr::memory_resource* resource)
+    : handler_(std::move(handler)), resource_(resource) {}
+
+  allocator_type get_allocator() const noexcept { return allocator_type(resource_); }
+
+  template <class... Args>
+  void operator()(Args&&... args) { handler_(std::forward<Args>(args)...); }
+
+private:
+  Handler handler_;
+  std::pmr::memory_resource* resource_;
+};
+
+constexpr std::string_view kContinue = "HTTP/1.1 100 Continue\r\n\r\n";
+
+bool expectsContinue(const http::request_header<http::basic_fields<Allocator>>& req) {
+  return beast::iequals(req[http::field::expect], "100-continue");
+}
+
+constexpr size_t kSourceChunk = 64 * 1024; // 每次从 BodySource 读取的字节数
+
+// 响应的 body 为 BodySource: 长度已知时写 Content-Length, 否则 HTTP/1.1 用 chunked, HTTP/1.0 写完后关闭连接
+// (HTTP/2 不发送 Transfer-Encoding 和 Connection, 以 END_STREAM 结束)
+void frameSource(Response& res) {
+  if (auto size = res.body().source()->size()) {
+    res.chunked(false);
+    res.content_length(*size);
+  } else if (res.version() == 11) {
+    res.content_length(boost::none);
+    res.chunked(true);
+  } else {
+    res.content_length(boost::none);
+    res.keep_alive(false);
+  }
+}
+
+template <class Stream, class Socket>
+Stream makeStream(Socket&& socket, TlsContext* tls) {
+  if constexpr (std::is_same_v<Stream, Socket>) {
+    boost::ignore_unused(tls);
+    return std::move(socket);
+  } else {
+#ifdef ENABLE_TLS
+    return Stream(std::move(socket), tls->context());
+#endif
+  }
+}
+
+// 对端关闭了连接但不是 TCP 层面的 EOF: TLS 连接没有 close_notify 就关闭 (stream_truncated),
+// kTLS 连接收到 close_notify 等非数据记录 (EIO)
+bool closedByPeer(const beast::error_code& ec, bool kernel_tls) {
+#ifdef ENABLE_TLS
+  if (ec == net::ssl::error::stream_truncated) {
+    return true;
+  }
+#endif
+  return kernel_tls && ec == boost::system::errc::io_error;
+}
+
+} // namespace
+
 // HttpServer implementation
-HttpServer::HttpServer(net::io_context& ioc, tcp::endpoint endpoint, 
-                       std::shared_ptr<RestApiHandlerBase> api_handler)
-  : ioc_(ioc), acceptor_(ioc), api_handler_(api_handler) {
-  
+HttpServer::HttpServer(tcp::endpoint endpoint, std::shared_ptr<RestApiHandlerBase> api_handler,
+                       const config::HttpServerConfig& cfg)
+  : cfg_(cfg), api_handler_(api_handler), admission_(cfg_) {
+  cfg_.io_threads = std::max<size_t>(cfg_.io_threads, 1);
+  // 压缩级别在启动时检查一次, 不在 io 线程上逐个响应检查
+  if (cfg_.compression_level < -1 || cfg_.compression_level > 9) {
+    int level = std::clamp(cfg_.compression_level, -1, 9);
+    AccessLog::getInstance().event(AccessLog::Level::warn, "Invalid compression_level",
+                                   std::to_string(cfg_.compression_level) + ", using " + std::to_string(level));
+    cfg_.compression_level = level;
+  }
+  api_handler_->setAdmissionController(&admission_);
+#ifdef ENABLE_TLS
+  if (!cfg_.tls_cert_file.empty() && !cfg_.tls_key_file.empty()) {
+    tls_ = TlsContext::get(cfg_);
+  }
+#endif
+  if (!cfg_.metrics_path.empty()) {
+    api_handler_->setMetricsSource(cfg_.metrics_path, [this] { return metricsText(); });
+  }
+  // 路由 id 在注册时分配, 指标按 id 直接索引
+  std::vector<std::pair<std::string, std::string>> routes;
+  for (const auto& [method, pattern] : api_handler_->router().routes()) {
+    routes.emplace_back(toStringView(http::to_string(method)), pattern);
+  }
+  metrics_.setRoutes(std::move(routes));
+
+  // 端口为 0 时每次绑定的端口不同, 没有可以交接的旧进程
+  std::vector<int> inherited;
+  if (!cfg_.handoff_dir.empty() && endpoint.port() != 0) {
+    try {
+      handoff::checkDirectory(cfg_.handoff_dir);
+      handoff_path_ = cfg_.handoff_dir + "/http-" + std::to_string(endpoint.port()) + ".sock";
+    } catch (const std::exception& e) {
+      AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff disabled", e.what());
+    }
+  }
+  if (!handoff_path_.empty()) {
+    inherited = takeOverListeners();
+    inherited_ = !inherited.empty();
+  }
+
+  auto tick = std::chrono::milliseconds(cfg_.timer_tick_ms);
+  if (cfg_.reuse_port_per_thread) {
+    // 每个线程独占一个 io_context, 无需调度器内部加锁; 连接数上限按线程平分
+    size_t max_connections = (cfg_.max_connections + cfg_.io_threads - 1) / cfg_.io_threads;
+    for (size_t i = 0; i < cfg_.io_threads; ++i) {
+      listeners_.push_back(std::make_unique<Listener>(1, max_connections, tick));
+      if (inherited_) {
+        listeners_.back()->acceptor.assign(endpoint.protocol(), inherited[i]);
+      } else {
+        openAcceptor(listeners_.back()->acceptor, endpoint, true);
+      }
+    }
+  } else {
+    listeners_.push_back(std::make_unique<Listener>(static_cast<int>(cfg_.io_threads), cfg_.max_connections, tick));
+    if (inherited_) {
+      listeners_.back()->acceptor.assign(endpoint.protocol(), inherited.front());
+    } else {
+      openAcceptor(listeners_.back()->acceptor, endpoint, false);
+    }
+  }
+}
+
+HttpServer::~HttpServer() {
+  stop();
+  join();
+  api_handler_->setAdmissionController(nullptr);
+  api_handler_->setMetricsSource({}, nullptr);
+  if (handoff_peer_ >= 0) {
+    ::close(handoff_peer_); // 没有 run 过, 旧进程继续服务
+  }
+  if (handoff_acceptor_ && !handed_over_) {
+    ::unlink(handoff_path_.c_str());
+  }
+}
+
+void HttpServer::openAcceptor(tcp::acceptor& acceptor, const tcp::endpoint& endpoint, bool reuse_port) {
   beast::error_code ec;
   
-  acceptor_.open(endpoint.protocol(), ec);
+  acceptor.open(endpoint.protocol(), ec);
   if (ec) {
     throw std::runtime_error("Failed to open acceptor: " + ec.message());
   }
   
-  acceptor_.set_option(net::socket_base::reuse_address(true), ec);
+  acceptor.set_option(net::socket_base::reuse_address(true), ec);
   if (ec) {
     throw std::runtime_error("Failed to set reuse_address: " + ec.message());
   }
+
+  if (reuse_port) {
+    // 多个 socket 绑定同一端口, 由内核按四元组哈希把新连接分给各个 acceptor
+    acceptor.set_option(net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+    if (ec) {
+      throw std::runtime_error("Failed to set reuse_port: " + ec.message());
+    }
+  }
   
-  acceptor_.bind(endpoint, ec);
+  acceptor.bind(endpoint, ec);
   if (ec) {
     throw std::runtime_error("Failed to bind: " + ec.message());
   }
   
-  acceptor_.listen(net::socket_base::max_listen_connections, ec);
+  acceptor.listen(net::socket_base::max_listen_connections, ec);
   if (ec) {
     throw std::runtime_error("Failed to listen: " + ec.message());
   }
 }
 
 void HttpServer::run() {
-  doAccept();
+  for (auto& listener : listeners_) {
+    doAccept(*listener);
+    doTick(*listener);
+  }
+
+  threads_.reserve(cfg_.io_threads);
+  for (size_t i = 0; i < cfg_.io_threads; ++i) {
+    auto& ioc = cfg_.reuse_port_per_thread ? listeners_[i]->ioc : listeners_.front()->ioc;
+    threads_.emplace_back([this, &ioc]() {
+      metrics_.bindThread();
+      ioc.run();
+    });
+
+#ifdef __linux__
+    if (cfg_.reuse_port_per_thread && cfg_.pin_threads) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(i % std::max(1u, std::thread::hardware_concurrency()), &cpus);
+      if (pthread_setaffinity_np(threads_.back().native_handle(), sizeof(cpus), &cpus) != 0) {
+        AccessLog::getInstance().event(AccessLog::Level::warn, "Failed to pin io thread", std::to_string(i));
+      }
+    }
+#endif
+  }
+
+  // 已经开始接受连接, 旧进程可以停止接受并排空
+  if (handoff_peer_ >= 0) {
+    try {
+      handoff::ready(handoff_peer_);
+    } catch (const std::exception& e) {
+      AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff ack failed", e.what());
+    }
+    handoff_peer_ = -1;
+  }
+  if (!handoff_path_.empty()) {
+    listenHandoff();
+  }
+}
+
+void HttpServer::stop() {
+  // ioc.stop() 之后还没执行的回调不会再执行: 等所有 acceptor 关闭之后再停止 io_context, 否则监听 socket 一直开着
+  stopAccepting([this]() {
+    for (auto& listener : listeners_) {
+      listener->ioc.stop();
+    }
+  });
+}
+
+void HttpServer::stopAccepting(std::function<void()> closed) {
+  struct Pending {
+    std::atomic<size_t> count;
+    std::function<void()> closed;
+  };
+  auto pending = std::make_shared<Pending>(listeners_.size() + (handoff_acceptor_ ? 1 : 0), std::move(closed));
+  auto done = [pending]() {
+    if (pending->count.fetch_sub(1) == 1 && pending->closed) {
+      pending->closed();
+    }
+  };
+  for (auto& listener : listeners_) {
+    // acceptor 运行在自己的 strand 上, 关闭操作也要投递到该 strand
+    net::dispatch(listener->acceptor.get_executor(), [&acceptor = listener->acceptor, done]() {
+      beast::error_code ec;
+      acceptor.close(ec);
+      done();
+    });
+  }
+  if (handoff_acceptor_) {
+    net::dispatch(handoff_acceptor_->get_executor(), [this, done]() {
+      beast::error_code ec;
+      handoff_acceptor_->close(ec);
+      done();
+    });
+  }
 }
 
-void HttpServer::doAccept() {
-  acceptor_.async_accept(
-    net::make_strand(ioc_),
-    beast::bind_front_handler(&HttpServer::onAccept, this));
+void HttpServer::drain() {
+  if (draining_.exchange(true)) {
+    return;
+  }
+  stopAccepting();
+  for (auto& listener : listeners_) {
+    listener->connections.drain();
+  }
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(cfg_.drain_timeout_seconds);
+  net::post(listeners_.front()->ioc, [this, deadline]() {
+    drain_timer_.emplace(listeners_.front()->ioc);
+    waitDrained(deadline);
+  });
+}
+
+void HttpServer::waitDrained(std::chrono::steady_clock::time_point deadline) {
+  if (connections() == 0 || std::chrono::steady_clock::now() >= deadline) {
+    stop();
+    return;
+  }
+  drain_timer_->expires_after(std::chrono::milliseconds(50));
+  drain_timer_->async_wait([this, deadline](beast::error_code ec) {
+    if (!ec) {
+      waitDrained(deadline);
+    }
+  });
+}
+
+std::vector<int> HttpServer::takeOverListeners() {
+  int peer = -1;
+  std::vector<int> fds;
+  try {
+    peer = handoff::connect(handoff_path_);
+    if (peer < 0) {
+      return {};
+    }
+    fds = handoff::receive(peer, std::chrono::seconds(5));
+  } catch (const std::exception& e) {
+    if (peer >= 0) {
+      ::close(peer);
+    }
+    AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff failed", e.what());
+    return {};
+  }
+  // 线程模式或线程数变化时不能沿用: 不确认, 旧进程继续服务; 本进程自己绑定 (reuse_port 时与旧进程共享端口)
+  size_t expected = cfg_.reuse_port_per_thread ? cfg_.io_threads : 1;
+  if (fds.size() != expected) {
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    ::close(peer);
+    AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff skipped",
+                                   std::to_string(fds.size()) + " listeners offered, " + std::to_string(expected) +
+                                   " needed");
+    return {};
+  }
+  handoff_peer_ = peer;
+  return fds;
 }
 
-void HttpServer::onAccept(beast::error_code ec, tcp::socket socket) {
+void HttpServer::listenHandoff() {
+  // 旧进程的 socket 文件 (它收到确认后不再使用), 或异常退出时遗留的
+  ::unlink(handoff_path_.c_str());
+  handoff_acceptor_.emplace(net::make_strand(listeners_.front()->ioc));
+  net::local::stream_protocol::endpoint endpoint(handoff_path_);
+  beast::error_code ec;
+  handoff_acceptor_->open(endpoint.protocol(), ec);
+  if (!ec) {
+    handoff_acceptor_->bind(endpoint, ec);
+  }
+  if (!ec) {
+    handoff_acceptor_->listen(1, ec);
+  }
   if (ec) {
-    std::cerr << "Accept error: " << ec.message() << std::endl;
+    AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff disabled", ec.message());
+    handoff_acceptor_.reset();
+    return;
+  }
+  doHandoffAccept();
+}
+
+void HttpServer::doHandoffAccept() {
+  handoff_acceptor_->async_accept([this](beast::error_code ec, net::local::stream_protocol::socket peer) {
+    if (ec == net::error::operation_aborted) {
+      return;
+    }
+    if (ec) {
+      AccessLog::getInstance().event(AccessLog::Level::error, "Listener handoff accept error", ec.message());
+      return doHandoffAccept();
+    }
+
+    std::vector<int> fds;
+    for (auto& listener : listeners_) {
+      fds.push_back(listener->acceptor.native_handle());
+    }
+    try {
+      handoff::checkPeer(peer.native_handle());
+      handoff::send(peer.native_handle(), fds);
+    } catch (const std::exception& e) {
+      AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff failed", e.what());
+      return doHandoffAccept();
+    }
+
+    // 等新进程开始接受连接; 新进程启动失败时连接关闭, 继续等待下一次交接
+    struct Pending {
+      net::local::stream_protocol::socket peer;
+      char ack = 0;
+    };
+    auto pending = std::make_shared<Pending>(std::move(peer));
+    net::async_read(pending->peer, net::buffer(&pending->ack, 1), [this, pending](beast::error_code ec, size_t) {
+      if (ec) {
+        AccessLog::getInstance().event(AccessLog::Level::warn, "Listener handoff aborted", ec.message());
+        return doHandoffAccept();
+      }
+      handed_over_ = true;
+      AccessLog::getInstance().event(AccessLog::Level::info, "Listeners handed over, draining");
+      drain();
+    });
+  });
+}
+
+void HttpServer::join() {
+  for (auto& thread : threads_) {
+    if (thread.joinable() && thread.get_id() != std::this_thread::get_id()) {
+      thread.join();
+    }
+  }
+}
+
+size_t HttpServer::connections() const {
+  size_t total = 0;
+  for (const auto& listener : listeners_) {
+    total += listener->connections.connections();
+  }
+  return total;
+}
+
+size_t HttpServer::evictedConnections() const {
+  size_t total = 0;
+  for (const auto& listener : listeners_) {
+    total += listener->connections.evicted();
+  }
+  return total;
+}
+
+size_t HttpServer::rejectedConnections() const {
+  size_t total = 0;
+  for (const auto& listener : listeners_) {
+    total += listener->connections.rejected();
+  }
+  return total;
+}
+
+std::string HttpServer::metricsText() const {
+  std::vector<HttpMetrics::Gauge> gauges{
+    {"http_connections", "gauge", "Open connections.", static_cast<double>(connections())},
+    {"http_connections_evicted_total", "counter", "Idle connections closed to stay under max_connections.",
+     static_cast<double>(evictedConnections())},
+    {"http_connections_rejected_total", "counter", "Connections refused at max_connections.",
+     static_cast<double>(rejectedConnections())},
+    {"http_admission_limit", "gauge", "Current concurrency limit of the admission controller.",
+     static_cast<double>(admission_.limit())},
+    {"http_admission_in_flight", "gauge", "Requests holding an admission permit.",
+     static_cast<double>(admission_.inFlight())},
+    {"http_admission_rejected_total", "counter", "Requests rejected with 503 by admission control.",
+     static_cast<double>(admission_.rejected())},
+    {"access_log_dropped_total", "counter", "Access log records dropped because a ring was full.",
+     static_cast<double>(AccessLog::getInstance().dropped())},
+  };
+#ifdef ENABLE_TLS
+  if (tls_) {
+    gauges.push_back({"http_tls_handshakes_total", "counter", "Completed TLS handshakes.",
+                      static_cast<double>(tls_->handshakes())});
+    gauges.push_back({"http_tls_resumed_total", "counter", "TLS handshakes that resumed a session (cache or ticket).",
+                      static_cast<double>(tls_->resumed())});
+  }
+#endif
+  std::string out;
+  metrics_.render(out, gauges);
+  return out;
+}
+
+void HttpServer::doTick(Listener& listener) {
+  listener.tick_timer.expires_after(listener.connections.tickInterval());
+  listener.tick_timer.async_wait([this, &listener](beast::error_code ec) {
+    if (ec) {
+      return;
+    }
+    listener.connections.tick();
+    doTick(listener);
+  });
+}
+
+void HttpServer::doAccept(Listener& listener) {
+  // 共享模式下多个线程同时运行 io_context, 每个连接需要自己的 strand;
+  // 每线程模式下 io_context 只有一个线程, 直接使用其 executor 即可
+#ifdef ENABLE_TLS
+  // kTLS 模式的连接握手后按明文 socket 读写, 与明文连接是同一种会话
+  if (tls_ && !tls_->kernelTls()) {
+    if (cfg_.reuse_port_per_thread) {
+      listener.acceptor.async_accept(
+        listener.ioc.get_executor(),
+        beast::bind_front_handler(&HttpServer::onAccept<PerThreadTlsSession>, this, std::ref(listener)));
+    } else {
+      listener.acceptor.async_accept(
+        net::make_strand(listener.ioc),
+        beast::bind_front_handler(&HttpServer::onAccept<SharedTlsSession>, this, std::ref(listener)));
+    }
+    return;
+  }
+#endif
+  if (cfg_.reuse_port_per_thread) {
+    listener.acceptor.async_accept(
+      listener.ioc.get_executor(),
+      beast::bind_front_handler(&HttpServer::onAccept<PerThreadSession>, this, std::ref(listener)));
+  } else {
+    listener.acceptor.async_accept(
+      net::make_strand(listener.ioc),
+      beast::bind_front_handler(&HttpServer::onAccept<SharedSession>, this, std::ref(listener)));
+  }
+}
+
+template <class Session>
+void HttpServer::onAccept(Listener& listener, beast::error_code ec, typename Session::Socket socket) {
+  if (ec == net::error::operation_aborted) {
+    return; // acceptor 已关闭
+  }
+  if (ec) {
+    AccessLog::getInstance().event(AccessLog::Level::error, "Accept error", ec.message());
+  } else if (!listener.connections.admit()) {
+    // 连接数已满且没有可以淘汰的空闲连接
+    beast::error_code close_ec;
+    socket.close(close_ec);
   } else {
-    std::make_shared<HttpSession>(std::move(socket), api_handler_)->run();
+    std::make_shared<Session>(std::move(socket), api_handler_, cfg_, admission_, listener.connections, metrics_,
+                              tls_.get())
+      ->run();
   }
   
-  doAccept();
+  doAccept(listener);
 }
 
 // HttpSession implementation
-HttpSession::HttpSession(tcp::socket&& socket, std::shared_ptr<RestApiHandlerBase> api_handler)
-  : stream_(std::move(socket)), api_handler_(api_handler) {}
+template <class Executor, bool Tls>
+HttpSession<Executor, Tls>::HttpSession(Socket&& socket, std::shared_ptr<RestApiHandlerBase> api_handler,
+                                        const config::HttpServerConfig& cfg, AdmissionController& admission,
+                                        ConnectionManager& connections, HttpMetrics& metrics, TlsContext* tls)
+  : stream_(makeStream<Stream>(std::move(socket), tls)), slots_(std::max<size_t>(cfg.pipeline_depth, 1)), body_limit_(cfg.request_body_limit),
+    idle_timeout_(cfg.idle_timeout_seconds), write_timeout_(cfg.write_timeout_seconds),
+    arena_bytes_(cfg.request_arena_bytes), arena_max_bytes_(cfg.request_arena_max_bytes),
+    api_handler_(api_handler), admission_(admission), connections_(connections), metrics_(metrics),
+    compression_{cfg.compression, cfg.compression_min_bytes, cfg.compression_level},
+    server_timing_(cfg.server_timing), tls_(tls)
+#ifdef ENABLE_HTTP2
+    , http2_(cfg.http2),
+    h2_options_{cfg.http2_max_concurrent_streams, cfg.http2_window_bytes, cfg.request_arena_bytes,
+                cfg.request_arena_max_bytes}
+#endif
+{
+#ifdef ENABLE_TLS
+  kernel_tls_ = !Tls && tls_ && tls_->kernelTls();
+#endif
+}
 
-void HttpSession::run() {
-  net::dispatch(stream_.get_executor(),
-                beast::bind_front_handler(&HttpSession::doRead, shared_from_this()));
+template <class Executor, bool Tls>
+HttpSession<Executor, Tls>::~HttpSession() {
+#ifdef ENABLE_TLS
+  if constexpr (Tls) {
+    // 出错或超时中止的连接没有发送 close_notify, 释放时 OpenSSL 会把会话从缓存中删除; 标记为已关闭以便客户端之后恢复会话
+    if (!(SSL_get_shutdown(stream_.native_handle()) & SSL_SENT_SHUTDOWN)) {
+      SSL_set_shutdown(stream_.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+  }
+#endif
+  connections_.remove(*this);
+  if (in_flight_ > 0) {
+    metrics_.abandon(in_flight_);
+  }
 }
 
-void HttpSession::doRead() {
-  req_ = {};
-  
-  stream_.expires_after(std::chrono::seconds(30));
-  
-  http::async_read(stream_, buffer_, req_,
-                   beast::bind_front_handler(&HttpSession::onRead, shared_from_this()));
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::run() {
+  // 流水线下会连续写出多个小响应, 关闭 Nagle, 避免后一个响应等前一个的 ACK (与客户端的延迟 ACK 叠加可达 40ms)
+  beast::error_code ec;
+  socket().set_option(tcp::no_delay(true), ec);
+  client_ = socket().remote_endpoint(ec).address();
+
+  net::dispatch(stream_.get_executor(), [self = this->shared_from_this()]() {
+#ifdef ENABLE_TLS
+    if (self->tls_) {
+      self->doHandshake();
+      return self->updateTimer();
+    }
+#endif
+    self->doRead();
+    self->updateTimer();
+  });
+}
+
+template <class Executor, bool Tls>
+typename HttpSession<Executor, Tls>::Socket& HttpSession<Executor, Tls>::socket() {
+  if constexpr (Tls) {
+    return stream_.next_layer();
+  } else {
+    return stream_;
+  }
+}
+
+#ifdef ENABLE_TLS
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doHandshake() {
+  read_deadline_ = Clock::now() + idle_timeout_;
+  if constexpr (Tls) {
+    stream_.async_handshake(net::ssl::stream_base::server,
+                            beast::bind_front_handler(&HttpSession::onHandshake, this->shared_from_this()));
+  } else {
+    net::co_spawn(stream_.get_executor(), kernelTlsHandshake(),
+                  [self = this->shared_from_this()](std::exception_ptr) {});
+  }
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onHandshake(beast::error_code ec) {
+  read_deadline_.reset();
+  if (ec) {
+    handshakeFailed(ec.message());
+    return updateTimer();
+  }
+  doRead();
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+net::awaitable<void> HttpSession<Executor, Tls>::kernelTlsHandshake() {
+  beast::error_code ec;
+  socket().native_non_blocking(true, ec);
+  KernelTlsHandshake handshake(*tls_, socket().native_handle());
+  for (;;) {
+    auto step = handshake.step();
+    if (step == KernelTlsHandshake::Step::done) {
+      // 协商的套件限制在内核支持的范围内, 一般不会出现
+      if (!handshake.offloaded()) {
+        handshakeFailed("kTLS offload not enabled for the negotiated cipher");
+        updateTimer();
+      } else {
+        onHandshake({});
+      }
+      co_return;
+    }
+    if (step == KernelTlsHandshake::Step::failed) {
+      handshakeFailed(handshake.error());
+      updateTimer();
+      co_return;
+    }
+    co_await socket().async_wait(step == KernelTlsHandshake::Step::want_read ? tcp::socket::wait_read
+                                                                             : tcp::socket::wait_write,
+                                 net::redirect_error(net::use_awaitable, ec));
+    if (ec) {
+      onHandshake(ec);
+      co_return;
+    }
+  }
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::handshakeFailed(std::string_view reason) {
+  read_deadline_.reset();
+  if (!closed_) { // 超时关闭时不记录
+    AccessLog::getInstance().event(AccessLog::Level::warn, "TLS handshake failed",
+                                   client_.to_string() + ": " + std::string(reason));
+  }
+  closed_ = true;
+  read_closed_ = true;
+  beast::error_code ec;
+  socket().close(ec);
 }
+#endif
 
-void HttpSession::onRead(beast::error_code ec, std::size_t bytes_transferred) {
+template <class Executor, bool Tls>
+typename HttpSession<Executor, Tls>::Slot& HttpSession<Executor, Tls>::slotAt(size_t offset) {
+  auto& slot = slots_[(head_ + offset) % slots_.size()];
+  if (!slot) {
+    slot = std::make_unique<Slot>(arena_bytes_, arena_max_bytes_);
+  }
+  return *slot;
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doRead() {
+  if (!read_closed_ && connections_.draining()) {
+    // 排空: 不再读取新请求, 已读取的写完响应后关闭; 没有排队的请求时直接关闭
+    read_closed_ = true;
+    if (count_ == 0 && !writing_ && !closed_) {
+      doClose();
+    }
+  }
+  if (reading_ || read_closed_ || closed_ || body_pending_ || count_ == slots_.size()) {
+    return;
+  }
+
+  Slot& slot = slotAt(count_);
+  Allocator alloc(slot.arena.resource());
+  slot.parser.emplace(std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc));
+  // 读完请求头后按路由设置。不能传 boost::none: beast 直接比较 len_ > body_limit_, 空 optional 小于任何值
+  slot.parser->body_limit(std::numeric_limits<uint64_t>::max());
+
+  if (count_ == 0) {
+    read_deadline_ = Clock::now() + idle_timeout_;
+  } else {
+    read_deadline_.reset();
+  }
+
+  reading_ = true;
+  http::async_read_header(stream_, buffer_, *slot.parser,
+                          ArenaBoundHandler(beast::bind_front_handler(&HttpSession::onReadHeader,
+                                                                      this->shared_from_this()),
+                                            slot.arena.resource()));
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onReadHeader(beast::error_code ec, std::size_t bytes_transferred) {
+#ifdef ENABLE_HTTP2
+  // h2c prior knowledge: 连接以 HTTP/2 前言开头, 解析器在版本号处报错, 前言仍在 buffer_ 中
+  if (ec == http::error::bad_version && http2_ && count_ == 0 && !closed_ &&
+      std::string_view(static_cast<const char*>(buffer_.data().data()), buffer_.size())
+        .starts_with(Http2Connection::kPrefaceStart)) {
+    return startHttp2();
+  }
+#endif
+  if (ec || closed_) {
+    return onRead(ec, bytes_transferred);
+  }
+
+  Slot& slot = slotAt(count_);
+  auto& parser = *slot.parser;
+  auto route = api_handler_->routeInfo(parser.get());
+  slot.method = parser.get().method();
+  slot.route = route.pattern;
+  slot.route_id = route.id;
+  slot.bytes_in = bytes_transferred;
+  slot.start = Clock::now();
+  slot.read_done = slot.handle_start = slot.handle_done = slot.write_start = {};
+  slot.trace.clear();
+  metrics_.begin();
+  ++in_flight_;
+  uint64_t limit = route.limit ? route.limit : body_limit_;
+  if (auto length = parser.content_length(); length && *length > limit) {
+    reading_ = false;
+    read_deadline_.reset();
+    rejectBody(slot);
+    return updateTimer();
+  }
+  parser.body_limit(limit);
+
+  // 流式请求只读请求头, body 由处理函数读取
+  slot.streaming = route.streaming;
+  if (parser.is_done() || slot.streaming) {
+    if (!slot.streaming) {
+      slot.read_done = slot.start;
+    }
+    return onRead(ec, 0);
+  }
+
+  // 客户端等到 100 Continue 才发送 body; 前面还有响应没写出时不能先写中间响应, 客户端等待超时后会直接发送
+  if (count_ == 0 && expectsContinue(parser.get())) {
+    reading_body_ = true;
+    writing_ = true;
+    write_deadline_ = Clock::now() + write_timeout_;
+    net::async_write(stream_, net::buffer(kContinue),
+                     ArenaBoundHandler(beast::bind_front_handler(&HttpSession::onContinue, this->shared_from_this()),
+                                       slot.arena.resource()));
+    return updateTimer();
+  }
+
+  // 继续读 body, 沿用读请求头时的期限
+  reading_body_ = true;
+  http::async_read(stream_, buffer_, parser,
+                   ArenaBoundHandler(beast::bind_front_handler(&HttpSession::onRead, this->shared_from_this()),
+                                     slot.arena.resource()));
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onContinue(beast::error_code ec, std::size_t bytes_transferred) {
   boost::ignore_unused(bytes_transferred);
+  writing_ = false;
+  write_deadline_.reset();
+
+  if (ec) {
+    reading_ = false;
+    reading_body_ = false;
+    read_deadline_.reset();
+    if (!closed_) {
+      AccessLog::getInstance().event(AccessLog::Level::error, "Write error", ec.message());
+    }
+    doClose(false);
+    return updateTimer();
+  }
+
+  Slot& slot = slotAt(count_);
+  http::async_read(stream_, buffer_, *slot.parser,
+                   ArenaBoundHandler(beast::bind_front_handler(&HttpSession::onRead, this->shared_from_this()),
+                                     slot.arena.resource()));
+  doWrite(); // 写 100 Continue 期间可能有响应完成
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onRead(beast::error_code ec, std::size_t bytes_transferred) {
+  reading_ = false;
+  reading_body_ = false;
+  read_deadline_.reset();
+
+  if (closed_) { // 超时关闭, 或关闭后等对端关闭时读到了数据
+    return updateTimer();
+  }
   
-  if (ec == http::error::end_of_stream) {
-    return doClose();
+  if (ec == http::error::end_of_stream || closedByPeer(ec, kernel_tls_)) {
+    read_closed_ = true;
+    eof_ = true;
+    if (count_ == 0) {
+      doClose();
+    }
+    return updateTimer();
   }
   
+  if (ec == http::error::body_limit) { // chunked 编码的 body 读到一半超过上限
+    rejectBody(slotAt(count_));
+    return updateTimer();
+  }
+
+  if (ec) {
+    read_closed_ = true;
+    AccessLog::getInstance().event(AccessLog::Level::error, "Read error", ec.message());
+    return updateTimer();
+  }
+
+  Slot& slot = slotAt(count_);
+  ++count_;
+  if (bytes_transferred > 0) { // 读完了 body; 只有请求头的请求由 onReadHeader 传入 0
+    slot.bytes_in += bytes_transferred;
+    slot.read_done = Clock::now();
+  }
+  if (slot.streaming && !slot.parser->is_done()) {
+    body_pending_ = true;
+  }
+
+  const auto& req = slot.parser->get();
+  if (!req.keep_alive()) {
+    read_closed_ = true; // 响应后关闭连接, 之后的数据不再处理
+  }
+
+  // 预检和未匹配的路由直接写出共享的预序列化响应, 不进入处理协程; 预序列化的响应带 body, HEAD 不使用
+  if (req.version() == 11 && req.keep_alive() && req.method() != http::verb::head) {
+    slot.static_response = api_handler_->staticResponse(req);
+  }
+  if (!slot.static_response && compression_.enabled) {
+    slot.encoding = negotiateEncoding(toStringView(req[http::field::accept_encoding]));
+    if (slot.encoding != ContentEncoding::identity) {
+      slot.resource.assign(toStringView(req.method_string())).append(1, ' ').append(toStringView(req.target()));
+    }
+  }
+
+  dispatchRequests();
+  doWrite();
+  doRead();
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::rejectBody(Slot& slot) {
+  // 在队列中排在前面的响应之后写出
+  slot.res.emplace(StaticResponseCache::getInstance().payloadTooLarge().toResponse(slot.parser->get().version(), false));
+  slot.ready = true;
+  ++count_;
+  read_closed_ = true;
+  unread_body_ = true;
+  dispatchRequests();
+  doWrite();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::skipBody() {
+  read_closed_ = true;
+  if (body_pending_) {
+    unread_body_ = true;
+  }
+}
+
+template <class Executor, bool Tls>
+net::awaitable<size_t> HttpSession<Executor, Tls>::readStream(StreamReader& reader, net::mutable_buffer buffer) {
+  auto& parser = *reader.slot_.stream_parser;
+  if (parser.is_done() || buffer.size() == 0) {
+    co_return 0;
+  }
+  if (closed_) {
+    throw beast::system_error(net::error::operation_aborted);
+  }
+
+  // 同 onReadHeader, 只有前面的响应都已写出时才写 100 Continue
+  if (reader.expect_continue_) {
+    reader.expect_continue_ = false;
+    if (count_ == 1 && !writing_) {
+      writing_ = true;
+      write_deadline_ = Clock::now() + write_timeout_;
+      updateTimer();
+      beast::error_code ec;
+      co_await net::async_write(stream_, net::buffer(kContinue), net::redirect_error(net::use_awaitable, ec));
+      writing_ = false;
+      write_deadline_.reset();
+      updateTimer();
+      if (ec) {
+        throw beast::system_error(ec);
+      }
+    }
+  }
+
+  auto& body = parser.get().body();
+  body.data = buffer.data();
+  body.size = buffer.size();
+  body.more = true;
+
+  // 每次读取单独按空闲超时计时, 处理函数处理数据期间不计时
+  reading_ = true;
+  read_deadline_ = Clock::now() + idle_timeout_;
+  updateTimer();
+  beast::error_code ec;
+  co_await http::async_read(stream_, buffer_, parser, net::redirect_error(net::use_awaitable, ec));
+  reading_ = false;
+  read_deadline_.reset();
+  if (ec == http::error::need_buffer) { // buffer 已读满
+    ec = {};
+  }
   if (ec) {
-    std::cerr << "Read error: " << ec.message() << std::endl;
+    reader.error_ = ec;
+    updateTimer();
+    throw beast::system_error(ec);
+  }
+
+  size_t n = buffer.size() - body.size;
+  reader.received_ += n;
+  reader.slot_.bytes_in += n;
+  if (parser.is_done()) {
+    reader.slot_.read_done = Clock::now();
+    // 继续读取后续请求
+    body_pending_ = false;
+    doRead();
+  }
+  updateTimer();
+  co_return n;
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::dispatchRequests() {
+  while (dispatched_ < count_ && !closed_) {
+    Slot& slot = slotAt(dispatched_);
+    if (slot.static_response || slot.ready) {
+      slot.ready = true;
+      ++dispatched_;
+      continue;
+    }
+
+    // RFC 9112 9.3.2: 只有安全方法的请求可以并行处理
+    const auto& req = slot.parser->get();
+    auto method = req.method();
+    bool safe = method == http::verb::get || method == http::verb::head || method == http::verb::options;
+    if (running_ > 0 && (!safe || unsafe_running_)) {
+      return;
+    }
+
+    // 中间件拒绝的请求 (如限流) 不占用准入名额
+    std::optional<Response> early;
+    {
+      RequestArena::Scope scope(slot.arena.resource());
+      early = api_handler_->runMiddlewares(req, client_);
+    }
+    if (early) {
+      if (slot.streaming) {
+        early->keep_alive(false); // 不读 body, 响应后关闭连接
+        skipBody();
+      }
+      slot.res.emplace(std::move(*early));
+      slot.ready = true;
+      ++dispatched_;
+      continue;
+    }
+
+    slot.permit = admission_.tryAcquire(api_handler_->isLightweight(req));
+    if (!slot.permit) {
+      // 过载: 不执行处理函数, 直接回复 503
+      const auto& rejected = StaticResponseCache::getInstance().serviceUnavailable();
+      if (slot.streaming) {
+        skipBody();
+      }
+      if (req.version() == 11 && req.keep_alive() && !slot.streaming) {
+        slot.static_response = &rejected;
+      } else {
+        slot.res.emplace(rejected.toResponse(req.version(), req.keep_alive() && !slot.streaming));
+      }
+      slot.ready = true;
+      ++dispatched_;
+      continue;
+    }
+
+    ++running_;
+    unsafe_running_ = !safe;
+    ++dispatched_;
+    slot.handle_start = Clock::now();
+
+    if (slot.streaming) {
+      // 处理函数拿到请求头, 通过 reader 从接管 parser 的 stream_parser 继续读 body
+      bool expect_continue = !slot.parser->is_done() && expectsContinue(req);
+      slot.stream_parser.emplace(std::move(*slot.parser));
+      slot.parser.reset();
+      slot.reader.emplace(*this, slot, expect_continue);
+      Request header{std::move(slot.stream_parser->get().base()), Allocator(slot.arena.resource())};
+      net::co_spawn(
+        stream_.get_executor(),
+        api_handler_->handleStreamAsync(std::move(header), *slot.reader, tracing() ? &slot.trace : nullptr),
+        [self = this->shared_from_this(), &slot](std::exception_ptr ep, Response response) {
+          self->onHandled(slot, ep, std::move(response));
+        });
+      continue;
+    }
+
+    // 处理协程运行在本连接的 strand 上; 挂起等待时 io 线程继续服务其他连接
+    net::co_spawn(
+      stream_.get_executor(),
+      api_handler_->handleRequestAsync(slot.parser->release(), tracing() ? &slot.trace : nullptr),
+      [self = this->shared_from_this(), &slot](std::exception_ptr ep, Response response) {
+        self->onHandled(slot, ep, std::move(response));
+      });
+  }
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onHandled(Slot& slot, std::exception_ptr ep, Response&& response) {
+  slot.handle_done = Clock::now();
+  slot.permit.release();
+  if (--running_ == 0) {
+    unsafe_running_ = false;
+  }
+  if (closed_) {
     return;
   }
-  
-  auto response = std::make_shared<http::response<http::string_body>>(
-    api_handler_->handleRequest(std::move(req_)));
-  
-  res_ = response;
-  
-  http::async_write(stream_, *response,
-                    beast::bind_front_handler(&HttpSession::onWrite, shared_from_this(),
-                                            response->need_eof()));
+  if (ep) {
+    AccessLog::getInstance().event(AccessLog::Level::error, "Handler error", "unknown exception");
+    doClose();
+    return updateTimer();
+  }
+
+  if (slot.streaming) {
+    if (slot.reader->error_ == http::error::body_limit) {
+      response = StaticResponseCache::getInstance().payloadTooLarge().toResponse(response.version(), false);
+    }
+    if (!slot.stream_parser->is_done()) {
+      // 处理函数没有读完 body: 响应后关闭连接, 剩余的 body 在关闭前丢弃
+      response.keep_alive(false);
+      skipBody();
+    }
+  }
+
+  slot.res.emplace(std::move(response));
+  finishResponse(slot, *slot.res);
+  slot.ready = true;
+
+  dispatchRequests();
+  doWrite();
+  updateTimer();
 }
 
-void HttpSession::onWrite(bool close, beast::error_code ec, std::size_t bytes_transferred) {
-  boost::ignore_unused(bytes_transferred);
+template <class Executor, bool Tls>
+template <class Item>
+void HttpSession<Executor, Tls>::finishResponse(Item& item, Response& res) {
+  if (!tracing()) {
+    compressResponse(res, item.encoding, compression_, item.resource);
+    return;
+  }
+  auto compress_start = Clock::now();
+  if (compressResponse(res, item.encoding, compression_, item.resource)) {
+    item.trace.add("compress", Clock::now() - compress_start);
+  }
+  if (!server_timing_) {
+    return;
+  }
+  std::string timing;
+  if (item.read_done != Clock::time_point{}) {
+    RequestTrace::appendServerTiming(timing, "read", item.read_done - item.start);
+  }
+  item.trace.appendServerTiming(timing);
+  if (item.handle_done != Clock::time_point{}) {
+    RequestTrace::appendServerTiming(timing, "handler", item.handle_done - item.handle_start);
+  }
+  res.set("Server-Timing", timing);
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doWrite() {
+  if (writing_ || closed_ || count_ == 0 || !slotAt(0).ready) {
+    return;
+  }
+  Slot& slot = slotAt(0);
+  writing_ = true;
+
+  // 排空时最后一个响应带 Connection: close, 客户端不会再在这个连接上发送请求; 请求带 Connection: close
+  // 或对端已关闭时同样如此, 写完后走 doClose (TLS 连接先发 close_notify), 而不是等连接析构时直接关闭 socket
+  if (count_ == 1 && (read_closed_ || connections_.draining())) {
+    read_closed_ = true;
+    if (slot.static_response) {
+      slot.res.emplace(slot.static_response->toResponse(11, false));
+      slot.static_response = nullptr;
+    } else {
+      slot.res->keep_alive(false);
+    }
+  }
+
+  // 处理耗时可能超过读超时, 写单独计时; 正在进行的读取保持原来的期限
+  slot.write_start = Clock::now();
+  write_deadline_ = slot.write_start + write_timeout_;
+
+  if (slot.static_response) {
+    // 缓存中的响应在进程生命周期内有效, 不需要由槽位持有
+    net::async_write(stream_, slot.static_response->buffer(),
+                     ArenaBoundHandler(beast::bind_front_handler(&HttpSession::onWrite, this->shared_from_this(), false),
+                                       slot.arena.resource()));
+  } else if (slot.res->body().source() || slot.method == http::verb::head) {
+    // HEAD 的响应只写出头部 (Content-Length 与 GET 相同), 与 BodySource 一样由 writeSource 写出
+    if (slot.res->body().source()) {
+      frameSource(*slot.res);
+    }
+    net::co_spawn(stream_.get_executor(), writeSource(slot, slot.res->need_eof()),
+                  [self = this->shared_from_this()](std::exception_ptr) {});
+  } else {
+    http::async_write(stream_, *slot.res,
+                      ArenaBoundHandler(beast::bind_front_handler(&HttpSession::onWrite, this->shared_from_this(),
+                                                                  slot.res->need_eof()),
+                                        slot.arena.resource()));
+  }
+}
+
+template <class Executor, bool Tls>
+net::awaitable<void> HttpSession<Executor, Tls>::writeSource(Slot& slot, bool close) {
+  auto& res = *slot.res;
+  auto source = res.body().source();
+  beast::error_code ec;
+  size_t written = 0;
+  try {
+    http::response_serializer<ResponseBody, Fields> serializer(res);
+    written += co_await http::async_write_header(stream_, serializer, net::use_awaitable);
+    write_deadline_.reset();
+    updateTimer();
+    if (slot.method != http::verb::head) {
+      bool chunked = res.chunked();
+      auto expected = source->size();
+      uint64_t total = 0;
+      auto chunk = std::make_unique<char[]>(kSourceChunk);
+      while (size_t n = co_await source->read(net::buffer(chunk.get(), kSourceChunk))) {
+        // 读取来源时不计时, 每块的写出单独按写超时计时
+        write_deadline_ = Clock::now() + write_timeout_;
+        updateTimer();
+        auto data = net::buffer(chunk.get(), n);
+        // 不写成条件表达式: GCC 12 对 ?: 两个分支中的 co_await 都会求值, 同一块被写出两次
+        if (chunked) {
+          written += co_await net::async_write(stream_, http::make_chunk(data), net::use_awaitable);
+        } else {
+          written += co_await net::async_write(stream_, data, net::use_awaitable);
+        }
+        write_deadline_.reset();
+        updateTimer();
+        total += n;
+      }
+      if (chunked) {
+        written += co_await net::async_write(stream_, http::make_chunk_last(), net::use_awaitable);
+      } else if (expected && total != *expected) {
+        ec = http::error::short_read; // 已经写出的 Content-Length 无法满足, 只能关闭连接
+      }
+    }
+  } catch (const beast::system_error& e) {
+    ec = e.code();
+  } catch (const std::exception& e) {
+    AccessLog::getInstance().event(AccessLog::Level::error, "Body source error", e.what());
+    ec = net::error::operation_aborted;
+  }
+  onWrite(close, ec, written);
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onWrite(bool close, beast::error_code ec, std::size_t bytes_transferred) {
+  writing_ = false;
+  write_deadline_.reset();
   
   if (ec) {
-    std::cerr << "Write error: " << ec.message() << std::endl;
-    return;
+    if (!closed_) {
+      AccessLog::getInstance().event(AccessLog::Level::error, "Write error", ec.message());
+    }
+    doClose(false);
+    return updateTimer();
+  }
+
+  Slot& slot = slotAt(0);
+  auto end = Clock::now();
+  unsigned status = slot.static_response ? static_cast<unsigned>(slot.static_response->status())
+                                         : slot.res->result_int();
+  metrics_.record({slot.route_id, status, slot.bytes_in, bytes_transferred, slot.start, slot.read_done,
+                   slot.handle_start, slot.handle_done, slot.write_start, end});
+  --in_flight_;
+  if (auto& log = AccessLog::getInstance(); log.enabled()) {
+    log.access(slot.method, slot.route, status, bytes_transferred, slot.start, end, client_, &slot.trace);
   }
   
   if (close) {
-    return doClose();
+    doClose();
+    return updateTimer();
   }
   
-  res_ = nullptr;
+  // 队首请求/响应都已析构, 整体回收其 arena
+  slot.res.reset();
+  slot.reader.reset();
+  slot.stream_parser.reset();
+  slot.parser.reset();
+  slot.static_response = nullptr;
+  slot.encoding = ContentEncoding::identity;
+  slot.resource.clear();
+  slot.streaming = false;
+  slot.ready = false;
+  slot.arena.reset();
+  head_ = (head_ + 1) % slots_.size();
+  --count_;
+  --dispatched_;
+  // 回收的槽位换到下一个要读取的位置: 逐个处理请求的连接只在两个槽位之间轮换, 不会把整个环都创建出来。
+  // 正在预读请求头的槽位还没有计入 count_, 要跳过它; readStream 读流式请求的 body 时 reading_ 也为真,
+  // 但那个槽位已经计入 count_
+  bool reading_header = reading_ && !body_pending_;
+  std::swap(slots_[(head_ + slots_.size() - 1) % slots_.size()],
+            slots_[(head_ + count_ + (reading_header ? 1 : 0)) % slots_.size()]);
+
+  if (count_ == 0) {
+    if (eof_) {
+      doClose();
+      return updateTimer();
+    }
+    // 预读没有计时, 队列排空后开始按空闲超时计时
+    if (reading_) {
+      read_deadline_ = Clock::now() + idle_timeout_;
+    }
+  }
+
   doRead();
+  dispatchRequests();
+  doWrite();
+  updateTimer();
 }
 
-void HttpSession::doClose() {
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doClose(bool graceful) {
+  closed_ = true;
+  read_closed_ = true;
+#ifdef ENABLE_TLS
+  // 还要丢弃对端的 body 时不发: 之后的读取会因为已标记收到 close_notify 而立即结束; 这种响应带 Content-Length, 不会被误判
+  if (graceful && !close_notify_sent_ && !writing_ && !unread_body_) {
+    close_notify_sent_ = true;
+    if constexpr (Tls) {
+      // 只发送 close_notify, 不等对端回复 (标记为已收到), 写出后与明文连接一样关闭发送方向; 会话仍留在缓存中
+      SSL_set_shutdown(stream_.native_handle(), SSL_RECEIVED_SHUTDOWN);
+      writing_ = true;
+      write_deadline_ = Clock::now() + write_timeout_;
+      stream_.async_shutdown([self = this->shared_from_this()](beast::error_code) {
+        self->writing_ = false;
+        self->write_deadline_.reset();
+        self->closeSend();
+        self->updateTimer();
+      });
+      return;
+    } else if (kernel_tls_) {
+      sendKernelTlsCloseNotify(socket().native_handle());
+    }
+  }
+#else
+  boost::ignore_unused(graceful);
+#endif
+  closeSend();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::closeSend() {
   beast::error_code ec;
-  stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+  socket().shutdown(tcp::socket::shutdown_send, ec);
+  // 对端可能一直不关闭, 正在进行的读取 (或丢弃 body) 最多再等一个空闲超时
+  if (reading_) {
+    read_deadline_ = Clock::now() + idle_timeout_;
+  } else if (unread_body_ && !eof_) {
+    read_deadline_ = Clock::now() + idle_timeout_;
+    doDrain();
+  }
 }
 
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doDrain() {
+  reading_ = true;
+  buffer_.consume(buffer_.size());
+  stream_.async_read_some(buffer_.prepare(16 * 1024),
+                          beast::bind_front_handler(&HttpSession::onDrain, this->shared_from_this()));
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onDrain(beast::error_code ec, std::size_t bytes_transferred) {
+  boost::ignore_unused(bytes_transferred);
+  if (ec) { // 对端关闭, 或超时关闭了 socket
+    reading_ = false;
+    read_deadline_.reset();
+    return updateTimer();
+  }
+  doDrain();
+}
+
+template <class Executor, bool Tls>
+std::optional<uint64_t> HttpSession<Executor, Tls>::StreamReader::contentLength() const {
+  if (auto length = slot_.stream_parser->content_length()) {
+    return *length;
+  }
+  return std::nullopt;
+}
+
+#ifdef ENABLE_HTTP2
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::startHttp2() {
+  reading_ = false;
+  read_deadline_.reset();
+  Slot& slot = slotAt(0);
+  slot.parser.reset();
+  slot.arena.reset();
+
+  h2_ = std::make_unique<Http2Connection>(h2_options_, Http2Connection::Callbacks{
+    [this](H2Stream& stream) { onH2Headers(stream); },
+    [this](H2Stream& stream) { onH2Request(stream); },
+    [this](H2Stream& stream) { onH2Data(stream); },
+    [this](H2Stream& stream) { onH2Close(stream); },
+    [this](H2Stream& stream) { onH2SourceRead(stream); },
+  });
+  onH2Read({}, 0); // 前言和随后已经读到的帧都在 buffer_ 中
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doH2Read() {
+  if (reading_ || closed_ || !h2_->wantRead()) {
+    return;
+  }
+  // 没有打开的流时按空闲超时计时; 有流在处理时不计时, 同 HTTP/1 的预读
+  if (count_ == 0) {
+    read_deadline_ = Clock::now() + idle_timeout_;
+  } else {
+    read_deadline_.reset();
+  }
+  reading_ = true;
+  stream_.async_read_some(buffer_.prepare(16 * 1024),
+                          beast::bind_front_handler(&HttpSession::onH2Read, this->shared_from_this()));
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Read(beast::error_code ec, std::size_t bytes_transferred) {
+  reading_ = false;
+  read_deadline_.reset();
+  if (closed_) {
+    return updateTimer();
+  }
+  if (ec) {
+    if (ec != net::error::eof && ec != net::error::connection_reset && !closedByPeer(ec, kernel_tls_)) {
+      AccessLog::getInstance().event(AccessLog::Level::error, "Read error", ec.message());
+    }
+    h2_->terminate();
+    doClose(false);
+    return updateTimer();
+  }
+
+  buffer_.commit(bytes_transferred);
+  auto data = buffer_.data();
+  if (!h2_->receive({static_cast<const char*>(data.data()), data.size()})) {
+    AccessLog::getInstance().event(AccessLog::Level::warn, "HTTP/2 protocol error", client_.to_string());
+  }
+  buffer_.consume(buffer_.size());
+
+  doH2Write();
+  doH2Read();
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::doH2Write() {
+  // nghttp2 不允许在 receive 的回调中取出输出, receive 返回后再写
+  if (writing_ || closed_ || h2_->receiving()) {
+    return;
+  }
+  if (connections_.draining()) {
+    h2_->shutdown();
+  }
+  auto out = h2_->output(64 * 1024);
+  if (out.empty()) {
+    if (!h2_->wantRead() && !h2_->wantWrite()) { // GOAWAY 已经写出且所有流已关闭
+      h2_->terminate();
+      doClose();
+    }
+    return;
+  }
+  writing_ = true;
+  write_deadline_ = Clock::now() + write_timeout_;
+  net::async_write(stream_, net::buffer(out.data(), out.size()),
+                   beast::bind_front_handler(&HttpSession::onH2Write, this->shared_from_this()));
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Write(beast::error_code ec, std::size_t bytes_transferred) {
+  boost::ignore_unused(bytes_transferred);
+  writing_ = false;
+  write_deadline_.reset();
+  if (ec) {
+    if (!closed_) {
+      AccessLog::getInstance().event(AccessLog::Level::error, "Write error", ec.message());
+    }
+    h2_->terminate();
+    doClose(false);
+    return updateTimer();
+  }
+  doH2Write();
+  doH2Read();
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Headers(H2Stream& stream) {
+  auto route = api_handler_->routeInfo(*stream.req);
+  stream.route = route.pattern;
+  stream.route_id = route.id;
+  stream.streaming = route.streaming;
+  stream.body_limit = route.limit ? route.limit : body_limit_;
+  stream.start = Clock::now();
+  metrics_.begin();
+  ++in_flight_;
+  ++count_;
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Request(H2Stream& stream) {
+  const auto& cache = StaticResponseCache::getInstance();
+  if (stream.too_large) {
+    return respondH2(stream, cache.payloadTooLarge().toResponse(11, true));
+  }
+  if (!stream.streaming) {
+    stream.read_done = Clock::now();
+  }
+  const auto& req = *stream.req;
+  if (compression_.enabled) {
+    stream.encoding = negotiateEncoding(toStringView(req[http::field::accept_encoding]));
+    if (stream.encoding != ContentEncoding::identity) {
+      stream.resource.assign(toStringView(req.method_string())).append(1, ' ').append(toStringView(req.target()));
+    }
+  }
+
+  // 中间件拒绝的请求 (如限流) 不占用准入名额
+  std::optional<Response> early;
+  {
+    RequestArena::Scope scope(stream.arena.resource());
+    early = api_handler_->runMiddlewares(req, client_);
+  }
+  if (early) {
+    return respondH2(stream, std::move(*early));
+  }
+  stream.permit = admission_.tryAcquire(api_handler_->isLightweight(req));
+  if (!stream.permit) {
+    return respondH2(stream, cache.serviceUnavailable().toResponse(11, true));
+  }
+
+  // 处理协程运行在本连接的 executor 上, 各个流的处理互不等待
+  stream.handling = true;
+  stream.handle_start = Clock::now();
+  auto done = [self = this->shared_from_this(), id = stream.id](std::exception_ptr ep, Response response) {
+    self->onH2Handled(id, ep, std::move(response));
+  };
+  // 处理函数结束前流不会回收 (handling), trace 一直有效
+  RequestTrace* trace = tracing() ? &stream.trace : nullptr;
+  if (stream.streaming) {
+    stream.reader = std::make_unique<H2Reader>(*this, stream.id, stream.content_length);
+    net::co_spawn(stream_.get_executor(),
+                  api_handler_->handleStreamAsync(std::move(*stream.req), *stream.reader, trace),
+                  std::move(done));
+  } else {
+    net::co_spawn(stream_.get_executor(), api_handler_->handleRequestAsync(std::move(*stream.req), trace),
+                  std::move(done));
+  }
+  stream.req.reset();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Data(H2Stream& stream) {
+  if (stream.reader) {
+    static_cast<H2Reader&>(*stream.reader).timer_.cancel();
+  }
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Close(H2Stream& stream) {
+  onH2Data(stream); // 等待 body 的处理函数结束等待
+  if (!stream.started) {
+    return;
+  }
+  if (--count_ == 0 && reading_) {
+    read_deadline_ = Clock::now() + idle_timeout_;
+  }
+  --in_flight_;
+  if (stream.res && stream.end != Clock::time_point{}) {
+    unsigned status = stream.res->result_int();
+    metrics_.record({stream.route_id, status, stream.bytes_in, stream.bytes_out, stream.start, stream.read_done,
+                     stream.handle_start, stream.handle_done, stream.write_start, stream.end});
+    if (auto& log = AccessLog::getInstance(); log.enabled()) {
+      log.access(stream.method, stream.route, status, stream.bytes_out, stream.start, stream.end, client_,
+                 &stream.trace);
+    }
+  } else {
+    metrics_.abandon(1); // 对端重置了流, 或连接断开
+  }
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2Handled(int32_t id, std::exception_ptr ep, Response&& response) {
+  auto* stream = h2_->find(id);
+  if (!stream) {
+    return;
+  }
+  stream->handling = false;
+  stream->handle_done = Clock::now();
+  stream->permit.release();
+  if (stream->closed || closed_) {
+    h2_->release(*stream);
+    return updateTimer();
+  }
+
+  if (ep) {
+    AccessLog::getInstance().event(AccessLog::Level::error, "Handler error", "unknown exception");
+    h2_->reset(*stream, NGHTTP2_INTERNAL_ERROR);
+  } else if (stream->too_large) { // 流式请求读到一半超过上限
+    respondH2(*stream, StaticResponseCache::getInstance().payloadTooLarge().toResponse(11, true));
+  } else {
+    respondH2(*stream, std::move(response));
+  }
+  doH2Write();
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onH2SourceRead(H2Stream& stream) {
+  // co_spawn 先 post 再开始执行, 不会在 output 中同步调用 supply
+  net::co_spawn(stream_.get_executor(), readH2Source(stream.id, stream.res->body().source()),
+                [self = this->shared_from_this()](std::exception_ptr) {});
+}
+
+template <class Executor, bool Tls>
+net::awaitable<void> HttpSession<Executor, Tls>::readH2Source(int32_t id, std::shared_ptr<BodySource> source) {
+  // 读取期间流可能被对端重置并回收, 读到的数据放在自己的缓冲中, 读完后按 id 重新查找
+  std::string chunk(kSourceChunk, '\0');
+  bool failed = false;
+  try {
+    chunk.resize(co_await source->read(net::buffer(chunk)));
+  } catch (const std::exception& e) {
+    AccessLog::getInstance().event(AccessLog::Level::error, "Body source error", e.what());
+    failed = true;
+  }
+  auto* stream = h2_->find(id);
+  if (closed_ || !stream || stream->closed) {
+    co_return;
+  }
+  if (failed) {
+    h2_->reset(*stream, NGHTTP2_INTERNAL_ERROR);
+  } else {
+    h2_->supply(*stream, std::move(chunk));
+  }
+  doH2Write();
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::respondH2(H2Stream& stream, Response&& response) {
+  finishResponse(stream, response);
+  if (response.body().source()) {
+    frameSource(response);
+  }
+  stream.write_start = Clock::now();
+  h2_->respond(stream, std::move(response));
+}
+
+template <class Executor, bool Tls>
+net::awaitable<size_t> HttpSession<Executor, Tls>::readH2(H2Reader& reader, net::mutable_buffer buffer) {
+  for (;;) {
+    auto* stream = h2_->find(reader.id_);
+    if (closed_ || !stream || stream->closed) {
+      throw beast::system_error(net::error::operation_aborted);
+    }
+    if (stream->too_large) {
+      throw beast::system_error(http::error::body_limit);
+    }
+    if (size_t n = h2_->read(*stream, buffer)) {
+      reader.received_ += n;
+      doH2Write(); // 归还的窗口 (WINDOW_UPDATE)
+      updateTimer();
+      co_return n;
+    }
+    if (stream->eof || buffer.size() == 0) {
+      if (stream->eof && stream->read_done == Clock::time_point{}) {
+        stream->read_done = Clock::now();
+      }
+      co_return 0;
+    }
+
+    reader.timer_.expires_after(idle_timeout_);
+    beast::error_code ec;
+    co_await reader.timer_.async_wait(net::redirect_error(net::use_awaitable, ec));
+    if (!ec) {
+      throw beast::system_error(beast::error::timeout);
+    }
+  }
+}
+#endif
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::expire(bool evicted) {
+  // 连接可能正在另一个线程上析构, 此时 lock 返回空, 析构函数等待管理器的锁后把它移除
+  if (auto self = this->weak_from_this().lock()) {
+    net::post(stream_.get_executor(), [self = std::move(self), evicted]() { self->onExpired(evicted); });
+  }
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::onExpired(bool evicted) {
+  // 投递期间状态可能已经变化: 收到了新请求, 或重新计时
+  auto now = Clock::now();
+  bool expired = evicted ? !closed_ && reading_ && !reading_body_ && count_ == 0
+                         : (read_deadline_ && *read_deadline_ <= now) || (write_deadline_ && *write_deadline_ <= now);
+  if (expired) {
+    // 关闭 socket, 进行中的读写以 operation_aborted 结束, 所有回调返回后连接析构
+    closed_ = true;
+    read_closed_ = true;
+    read_deadline_.reset();
+    write_deadline_.reset();
+    beast::error_code ec;
+    socket().close(ec);
+  }
+  updateTimer();
+}
+
+template <class Executor, bool Tls>
+void HttpSession<Executor, Tls>::updateTimer() {
+  auto deadline = read_deadline_;
+  if (write_deadline_ && (!deadline || *write_deadline_ < *deadline)) {
+    deadline = write_deadline_;
+  }
+  connections_.update(*this, deadline, !closed_ && reading_ && !reading_body_ && count_ == 0);
+}
+
+template class HttpSession<net::strand<net::io_context::executor_type>>;
+template class HttpSession<net::io_context::executor_type>;
+#ifdef ENABLE_TLS
+template class HttpSession<net::strand<net::io_context::executor_type>, true>;
+template class HttpSession<net::io_context::executor_type, true>;
+#endif
+
 }
@@ -1,8 +1,26 @@
 #pragma once
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <boost/asio.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#ifdef ENABLE_TLS
+#include <boost/beast/ssl.hpp>
+#endif
+#include "common/config/config.hpp"
+#include "common/logging/access_log.hpp"
+#include "common/restful/admission_controller.hpp"
+#include "common/restful/compression.hpp"
+#include "common/restful/connection_manager.hpp"
+#include "common/restful/http2_connection.hpp"
+#include "common/restful/http_metrics.hpp"
+#include "common/restful/request_arena.hpp"
+#include "common/restful/request_trace.hpp"
 #include "common/restful/rest_api_handler_base.hpp"
 
 namespace beast = boost::beast;
@@ -12,39 +30,324 @@ using tcp = net::ip::tcp;
 
 namespace common {
 
-class HttpSession : public std::enable_shared_from_this<HttpSession> {
+class TlsContext;
+
+// Executor 使用具体类型而不是 any_io_executor: strand 超出 any_io_executor 的内联存储,
+// 每次异步操作复制 executor 都会访问全局堆。只在 http_server.cpp 中为下面两种 executor 实例化
+//
+// 支持 HTTP/1.1 流水线: 前面的请求在处理或写出时继续读取和解析后续请求, 最多排队 pipeline_depth 个,
+// 响应按请求顺序写出。安全方法 (GET/HEAD/OPTIONS) 的请求可以并行处理, 其他请求要等前面的处理完成后单独处理
+//
+// 超时由 ConnectionManager 的时间轮管理, 不使用 basic_stream 的 per-socket 定时器; 到期时关闭 socket
+//
+// 先读请求头, 再按路由的 RouteInfo 读 body: 缓存到 arena 中 (Content-Length 超过上限时不读 body, 直接 413),
+// 或由流式处理函数通过 BodyReader 按块读取, body 读完之前不读取后续请求
+//
+// 访问日志启用或 cfg.server_timing 时为每个请求记录 RequestTrace: 处理函数中的各阶段写入访问日志,
+// server_timing 时连同读取、处理函数和压缩的耗时以 Server-Timing 头返回 (预序列化的静态响应除外)
+//
+// 排空 (ConnectionManager::draining) 时不再读取新请求, 已读取的请求照常处理, 最后一个响应带 Connection: close
+//
+// 响应的 body 可以是字符串、文件、vector 或 BodySource (见 response_body.hpp): 前三种经由 serializer 写出,
+// BodySource 先写响应头, 再逐块 co_await 读取并写出
+//
+// 以 ENABLE_HTTP2 编译且 cfg.http2 时, 以 HTTP/2 前言开头的连接 (h2c prior knowledge) 转为 HTTP/2, 协议由 Http2Connection 处理:
+// 各个流的请求同时交给处理函数 (不受 pipeline_depth 和安全方法的限制), 准入、中间件、压缩、指标和访问日志与 HTTP/1 相同;
+// 排空时发送 GOAWAY, 已经开始的流处理完后关闭
+//
+// 以 ENABLE_TLS 编译且配置了证书时先做 TLS 握手 (按空闲超时计时, 不算空闲连接), 之后与明文连接相同:
+// Tls 为 true 时经由 beast::ssl_stream (OpenSSL) 读写; kTLS 模式 (TlsContext::kernelTls) 的连接 Tls 为 false,
+// 握手由 OpenSSL 直接在 socket 上完成, 之后内核加解密, 按明文 socket 读写。ALPN 选中 h2 时客户端随后发送 HTTP/2 前言,
+// 同 h2c 转入 HTTP/2。关闭时只关闭 TCP 的发送方向, 不发送 close_notify (HTTP 报文自带长度, 不依赖它判断截断)
+template <class Executor, bool Tls = false>
+class HttpSession : public std::enable_shared_from_this<HttpSession<Executor, Tls>>,
+                    public ConnectionManager::Connection {
 public:
-  HttpSession(tcp::socket&& socket, std::shared_ptr<RestApiHandlerBase> api_handler);
+  using Socket = typename tcp::socket::template rebind_executor<Executor>::other;
+#ifdef ENABLE_TLS
+  using Stream = std::conditional_t<Tls, beast::ssl_stream<Socket>, Socket>;
+#else
+  using Stream = Socket;
+#endif
+
+  // tls 为空时为明文连接
+  HttpSession(Socket&& socket, std::shared_ptr<RestApiHandlerBase> api_handler,
+              const config::HttpServerConfig& cfg, AdmissionController& admission,
+              ConnectionManager& connections, HttpMetrics& metrics, TlsContext* tls = nullptr);
+  ~HttpSession();
   
   void run();
 
 private:
+  using Clock = ConnectionManager::Clock;
+
+  struct Slot;
+
+  // 流式请求的 BodyReader, 从槽位的 stream_parser 继续读取 body
+  class StreamReader : public BodyReader {
+  public:
+    StreamReader(HttpSession& session, Slot& slot, bool expect_continue)
+      : session_(session), slot_(slot), expect_continue_(expect_continue) {}
+
+    net::awaitable<size_t> read(net::mutable_buffer buffer) override { return session_.readStream(*this, buffer); }
+    std::optional<uint64_t> contentLength() const override;
+    uint64_t received() const override { return received_; }
+
+  private:
+    friend class HttpSession;
+    HttpSession& session_;
+    Slot& slot_;
+    bool expect_continue_; // 第一次读取前回复 100 Continue
+    uint64_t received_ = 0;
+    beast::error_code error_;
+  };
+
+  // 一个排队中的请求, 解析、处理和响应都分配在自己的 arena 中, 响应写完后整体复位
+  struct Slot {
+    Slot(size_t arena_bytes, size_t arena_max_bytes) : arena(arena_bytes, arena_max_bytes) {}
+
+    RequestArena arena; // 需在 parser/res 之前声明, 保证最后析构
+    std::optional<http::request_parser<StringBody, Allocator>> parser;
+    std::optional<http::request_parser<http::buffer_body, Allocator>> stream_parser; // 流式请求交给处理函数后接管 parser
+    std::optional<Response> res;
+    AdmissionController::Permit permit; // 处理期间占用的名额
+    const StaticResponse* static_response = nullptr;
+    ContentEncoding encoding = ContentEncoding::identity; // 协商的响应编码
+    std::string resource; // 协商了压缩时为 "方法 target", 与 ETag 一起作为压缩缓存的 key; 复用容量
+    bool streaming = false; // 流式路由的请求, 只读了请求头
+    bool ready = false; // 响应已生成, 轮到时即可写出
+    std::optional<StreamReader> reader; // 交给流式处理函数的 BodyReader
+    // 访问日志和指标: 读完请求头时记录, 处理函数拿走请求之后仍然可用
+    http::verb method = http::verb::unknown;
+    std::string_view route; // 指向 router 中的路由模式, 未匹配时为空
+    size_t route_id = SIZE_MAX;
+    uint64_t bytes_in = 0;
+    Clock::time_point start;
+    // 各阶段的时刻, 见 HttpMetrics::Sample; 没有经过的阶段为空
+    Clock::time_point read_done;
+    Clock::time_point handle_start;
+    Clock::time_point handle_done;
+    Clock::time_point write_start;
+    RequestTrace trace;
+  };
+
+  // 队首之后第 offset 个槽位, 第一次用到时才创建
+  Slot& slotAt(size_t offset);
+  // TCP socket (TLS 连接的下层)
+  Socket& socket();
+
+#ifdef ENABLE_TLS
+  void doHandshake();
+  void onHandshake(beast::error_code ec);
+  // kTLS 模式: 在 socket 上非阻塞地握手, 等待 socket 可读写时挂起
+  net::awaitable<void> kernelTlsHandshake();
+  // 握手失败: 记录原因 (超时关闭时不记录) 并关闭连接
+  void handshakeFailed(std::string_view reason);
+#endif
+
   void doRead();
+  void onReadHeader(beast::error_code ec, std::size_t bytes_transferred);
+  void onContinue(beast::error_code ec, std::size_t bytes_transferred);
   void onRead(beast::error_code ec, std::size_t bytes_transferred);
+  // body 超过上限: 不再读取, 回复 413 后关闭连接
+  void rejectBody(Slot& slot);
+  // 不再读取流式请求剩余的 body 和后续请求, 连接在响应后关闭
+  void skipBody();
+  // 流式请求的处理函数通过 StreamReader 调用
+  net::awaitable<size_t> readStream(StreamReader& reader, net::mutable_buffer buffer);
+  // 关闭前读掉并丢弃对端还在发送的 body, 避免带着未读数据关闭 socket 时内核发送 RST, 导致客户端收不到响应
+  void doDrain();
+  void onDrain(beast::error_code ec, std::size_t bytes_transferred);
+  void dispatchRequests();
+  void onHandled(Slot& slot, std::exception_ptr ep, Response&& response);
+  // 是否为新请求记录 RequestTrace
+  bool tracing() const { return server_timing_ || AccessLog::getInstance().enabled(); }
+  // 压缩处理函数的响应 (Slot 或 HTTP/2 流), 记录压缩耗时; server_timing 时加上 Server-Timing 头
+  template <class Item>
+  void finishResponse(Item& item, Response& res);
+  void doWrite();
+  // body 为 BodySource 的响应: 写出响应头后逐块读取并写出, 完成后调用 onWrite
+  net::awaitable<void> writeSource(Slot& slot, bool close);
   void onWrite(bool close, beast::error_code ec, std::size_t bytes_transferred);
-  void doClose();
+  // 关闭连接。graceful 时 TLS 连接先发送 close_notify (按写超时计时), 客户端据此区分完整的响应和被截断的
+  // (Connection: close、写完才关闭的 body); 读写出错时直接关闭
+  void doClose(bool graceful = true);
+  // 关闭发送方向, 对端还在发送时读掉剩余数据
+  void closeSend();
+
+#ifdef ENABLE_HTTP2
+  using H2Stream = Http2Connection::Stream;
 
-  beast::tcp_stream stream_;
+  // 流式路由在 HTTP/2 上的 BodyReader: 从流中取走暂存的 body, 没有数据时等待 on_data
+  class H2Reader : public BodyReader {
+  public:
+    H2Reader(HttpSession& session, int32_t id, std::optional<uint64_t> content_length)
+      : session_(session), id_(id), content_length_(content_length), timer_(session.stream_.get_executor()) {}
+
+    net::awaitable<size_t> read(net::mutable_buffer buffer) override { return session_.readH2(*this, buffer); }
+    std::optional<uint64_t> contentLength() const override { return content_length_; }
+    uint64_t received() const override { return received_; }
+
+  private:
+    friend class HttpSession;
+    HttpSession& session_;
+    int32_t id_;
+    std::optional<uint64_t> content_length_;
+    uint64_t received_ = 0;
+    // 等待数据时按空闲超时计时, 收到数据或流关闭时取消
+    net::basic_waitable_timer<Clock, net::wait_traits<Clock>, Executor> timer_;
+  };
+
+  // 连接的第一个请求头是 HTTP/2 前言时从 onReadHeader 转入, 之后只走下面的 HTTP/2 路径
+  void startHttp2();
+  void doH2Read();
+  void onH2Read(beast::error_code ec, std::size_t bytes_transferred);
+  void doH2Write();
+  void onH2Write(beast::error_code ec, std::size_t bytes_transferred);
+  // Http2Connection::Callbacks
+  void onH2Headers(H2Stream& stream);
+  void onH2Request(H2Stream& stream);
+  void onH2Data(H2Stream& stream);
+  void onH2Close(H2Stream& stream);
+  void onH2SourceRead(H2Stream& stream);
+  net::awaitable<void> readH2Source(int32_t id, std::shared_ptr<BodySource> source);
+  void onH2Handled(int32_t id, std::exception_ptr ep, Response&& response);
+  void respondH2(H2Stream& stream, Response&& response);
+  net::awaitable<size_t> readH2(H2Reader& reader, net::mutable_buffer buffer);
+#endif
+
+  // 在管理器的锁内调用, 转到本连接的 executor 上执行 onExpired
+  void expire(bool evicted) override;
+  void onExpired(bool evicted);
+  // 把读写的超时时刻和是否空闲同步给 ConnectionManager, 每个回调处理完状态变化后调用一次
+  void updateTimer();
+
+  Stream stream_;
+  net::ip::address client_; // 对端地址, 供中间件按 IP 限流等
   beast::flat_buffer buffer_;
-  http::request<http::string_body> req_;
-  std::shared_ptr<void> res_;
+  std::vector<std::unique_ptr<Slot>> slots_; // 环形队列, 大小为 pipeline_depth
+  size_t head_ = 0; // 最早的请求, 下一个要写出的响应
+  size_t count_ = 0; // 已解析、尚未写完的请求数
+  size_t dispatched_ = 0; // 队首起已交给处理函数 (或有静态响应) 的请求数
+  size_t running_ = 0; // 正在处理的请求数
+  bool unsafe_running_ = false; // 正在处理的是非安全方法的请求, 此时不并行
+  bool reading_ = false;
+  bool reading_body_ = false; // 读完请求头、正在读 body, 此时 count_ 为 0 但连接不是空闲的
+  bool read_closed_ = false; // 不再读取新请求 (对端关闭、读错误或非 keep-alive 请求)
+  bool eof_ = false; // 对端已关闭写方向, 响应写完后关闭连接
+  bool writing_ = false;
+  bool closed_ = false;
+  bool body_pending_ = false; // 队尾的流式请求的 body 还没有读完, 读完之前不读后续请求
+  bool unread_body_ = false; // 有 body 没有读完, 关闭前需要丢弃
+  uint64_t body_limit_; // 路由没有设置上限时的默认值
+  // 队列为空时等待下一个请求按空闲超时计时; 预读时前面的请求可能处理很久, 不计时, 队列排空后再计时
+  std::optional<Clock::time_point> read_deadline_;
+  std::optional<Clock::time_point> write_deadline_;
+  std::chrono::seconds idle_timeout_;
+  std::chrono::seconds write_timeout_;
+  size_t arena_bytes_;
+  size_t arena_max_bytes_;
   std::shared_ptr<RestApiHandlerBase> api_handler_;
+  AdmissionController& admission_;
+  ConnectionManager& connections_;
+  HttpMetrics& metrics_;
+  size_t in_flight_ = 0; // 已计入 metrics_ 的 in-flight、还没有写完的请求数, 连接析构时扣除
+  CompressionOptions compression_;
+  bool server_timing_; // cfg.server_timing
+  TlsContext* tls_; // 明文连接为空
+  bool kernel_tls_ = false; // kTLS 模式的连接: 对端的 close_notify 等非数据记录在读取时表现为 EIO
+  bool close_notify_sent_ = false; // doClose 已开始发送 close_notify
+#ifdef ENABLE_HTTP2
+  bool http2_; // cfg.http2
+  Http2Connection::Options h2_options_;
+  std::unique_ptr<Http2Connection> h2_; // 转为 HTTP/2 之后才创建; HTTP/2 下 count_ 为打开的流数
+#endif
 };
 
+// 共享 io_context 时每个连接一个 strand; 每线程一个 io_context 时直接使用其 executor
+using SharedSession = HttpSession<net::strand<net::io_context::executor_type>>;
+using PerThreadSession = HttpSession<net::io_context::executor_type>;
+#ifdef ENABLE_TLS
+using SharedTlsSession = HttpSession<net::strand<net::io_context::executor_type>, true>;
+using PerThreadTlsSession = HttpSession<net::io_context::executor_type, true>;
+#endif
+
 class HttpServer {
 public:
-  HttpServer(net::io_context& ioc, tcp::endpoint endpoint, 
-             std::shared_ptr<RestApiHandlerBase> api_handler);
-  
+  HttpServer(tcp::endpoint endpoint, std::shared_ptr<RestApiHandlerBase> api_handler,
+             const config::HttpServerConfig& cfg = config::Config::getInstance().getHttpServer());
+  ~HttpServer();
+
+  HttpServer(const HttpServer&) = delete;
+  HttpServer& operator=(const HttpServer&) = delete;
+
+  // 开始接受连接, 并启动 cfg.io_threads 个线程运行 io_context, 立即返回
+  // 请求处理仍经由同一个 RestApiHandlerBase, 与线程模式无关
   void run();
+  // 停止监听, 监听 socket 关闭后停止 io_context; 可以在任意线程(包括 io 线程上的信号回调)中调用。
+  // 还没有 run 时, 关闭和停止在 run 之后执行
+  void stop();
+  // 等待所有 io 线程退出
+  void join();
+
+  // 信号等全局事件注册在第一个 io_context 上
+  net::io_context& ioContext() { return listeners_.front()->ioc; }
+  // 实际监听的地址, 端口传 0 时由系统分配
+  tcp::endpoint localEndpoint() const { return listeners_.front()->acceptor.local_endpoint(); }
+  const AdmissionController& admission() const { return admission_; }
+  // 当前连接数, 以及因 max_connections 淘汰的空闲连接数和拒绝的新连接数
+  size_t connections() const;
+  size_t evictedConnections() const;
+  size_t rejectedConnections() const;
+
+  // 优雅退出: 停止接受新连接并关闭空闲连接, 其余连接写完已读取请求的响应后关闭;
+  // 所有连接关闭或超过 cfg.drain_timeout_seconds 后 stop。可以在任意线程调用, 重复调用无效
+  void drain();
+  bool draining() const { return draining_.load(std::memory_order_relaxed); }
+  // 监听 socket 是否从旧进程交接而来, 见 listener_handoff.hpp
+  bool inherited() const { return inherited_; }
+  // 请求指标和服务器状态的 Prometheus 文本, cfg.metrics_path 的路由返回它
+  std::string metricsText() const;
 
 private:
-  void doAccept();
-  void onAccept(beast::error_code ec, tcp::socket socket);
+  // 一个 io_context 及其 acceptor; 共享模式只有一个, reuse_port_per_thread 模式每个线程一个
+  struct Listener {
+    Listener(int concurrency_hint, size_t max_connections, ConnectionManager::Clock::duration tick)
+      : connections(max_connections, tick), ioc(concurrency_hint), acceptor(net::make_strand(ioc)), tick_timer(ioc) {}
+    ConnectionManager connections; // 需在 ioc 之前声明: ioc 析构时销毁未完成的回调, 其中的连接析构时还要访问它
+    net::io_context ioc;
+    tcp::acceptor acceptor;
+    net::steady_timer tick_timer; // 每个 tick 推进一次连接的时间轮
+  };
+
+  static void openAcceptor(tcp::acceptor& acceptor, const tcp::endpoint& endpoint, bool reuse_port);
+  // 在各自的 strand 上关闭所有 acceptor, 全部关闭后 (在最后关闭的那个 io 线程上) 调用 closed
+  void stopAccepting(std::function<void()> closed = {});
+  void waitDrained(std::chrono::steady_clock::time_point deadline);
+  // 热重启: 新进程从旧进程接收监听 socket, 没有旧进程或不能沿用时返回空; 之后在 handoff_path_ 上等待下一个进程
+  std::vector<int> takeOverListeners();
+  void listenHandoff();
+  void doHandoffAccept();
+  void doAccept(Listener& listener);
+  void doTick(Listener& listener);
+  template <class Session>
+  void onAccept(Listener& listener, beast::error_code ec, typename Session::Socket socket);
 
-  net::io_context& ioc_;
-  tcp::acceptor acceptor_;
+  config::HttpServerConfig cfg_;
   std::shared_ptr<RestApiHandlerBase> api_handler_;
+  std::shared_ptr<TlsContext> tls_; // 配置了证书时 (以 ENABLE_TLS 编译), 否则为空
+  AdmissionController admission_; // 所有连接共享, 需在 listeners_ 之前声明, 保证连接析构时仍然有效
+  HttpMetrics metrics_; // 同上
+  std::atomic<bool> draining_{false};
+  std::string handoff_path_; // 为空时不交接
+  int handoff_peer_ = -1; // 交接来的 socket 开始接受连接后, 通过它通知旧进程
+  bool inherited_ = false;
+  bool handed_over_ = false; // 已交给新进程, socket 文件已属于新进程, 析构时不删除
+  std::vector<std::unique_ptr<Listener>> listeners_;
+  // 以下两个使用 listeners_ 的 io_context, 需在其后声明以先析构
+  std::optional<net::local::stream_protocol::acceptor> handoff_acceptor_;
+  std::optional<net::steady_timer> drain_timer_;
+  std::vector<std::jthread> threads_;
 };
 
 }
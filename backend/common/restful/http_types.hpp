@@ -0,0 +1,24 @@
+#pragma once
+#include <string_view>
+#include <boost/beast/http.hpp>
+#include "common/restful/request_arena.hpp"
+#include "common/restful/response_body.hpp"
+
+namespace common {
+
+namespace http = boost::beast::http;
+
+// REST 接口统一使用的请求/响应类型
+// 头和 body 通过 ArenaAllocator 分配, HttpSession 让它们落在连接的 RequestArena 中
+// 响应的 body 默认同样是字符串, 也可以换成文件、vector 或 BodySource, 见 response_body.hpp
+using Allocator = ArenaAllocator<char>;
+using Fields = http::basic_fields<Allocator>;
+using StringBody = http::basic_string_body<char, std::char_traits<char>, Allocator>;
+using Request = http::request<StringBody, Fields>;
+using Response = http::response<ResponseBody, Fields>;
+
+inline std::string_view toStringView(boost::beast::string_view s) {
+  return {s.data(), s.size()};
+}
+
+}
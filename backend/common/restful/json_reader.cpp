@@ -0,0 +1,108 @@
+#include "json_reader.hpp"
+#include <stdexcept>
+#include <string>
+
+namespace common {
+
+namespace {
+
+simdjson::ondemand::parser& threadParser() {
+  thread_local simdjson::ondemand::parser parser;
+  return parser;
+}
+
+// simdjson 会越过输入末尾读取至多 SIMDJSON_PADDING 字节, body 之后的内存不一定可读, 先复制到这里
+std::string& threadInput() {
+  thread_local std::string input;
+  return input;
+}
+
+[[noreturn]] void invalidJson(simdjson::error_code ec) {
+  throw std::runtime_error("Invalid JSON in request body: " + std::string(simdjson::error_message(ec)));
+}
+
+[[noreturn]] void wrongType(std::string_view key, std::string_view type) {
+  throw std::runtime_error("Field '" + std::string(key) + "' must be " + std::string(type));
+}
+
+// 取出 T 类型的值: 类型不符抛 wrongType, 其他错误说明 JSON 本身非法
+template <class T>
+T getAs(simdjson::ondemand::value& value, std::string_view key, std::string_view type) {
+  T result;
+  if (auto ec = value.get(result)) {
+    if (ec == simdjson::INCORRECT_TYPE || ec == simdjson::NUMBER_OUT_OF_RANGE) {
+      wrongType(key, type);
+    }
+    invalidJson(ec);
+  }
+  return result;
+}
+
+} // namespace
+
+JsonReader::JsonReader(std::string_view body) {
+  if (body.find_first_not_of(" \t\r\n") == std::string_view::npos) {
+    empty_ = true;
+    return;
+  }
+
+  auto& input = threadInput();
+  input.reserve(body.size() + simdjson::SIMDJSON_PADDING);
+  input.assign(body);
+  simdjson::padded_string_view padded(input.data(), input.size(), input.capacity());
+
+  if (auto ec = threadParser().iterate(padded).get(doc_)) {
+    invalidJson(ec);
+  }
+  if (auto ec = doc_.get_object().get(object_)) {
+    if (ec == simdjson::INCORRECT_TYPE) {
+      throw std::runtime_error("Invalid JSON in request body: expected an object");
+    }
+    invalidJson(ec);
+  }
+}
+
+std::optional<simdjson::ondemand::value> JsonReader::find(std::string_view key) {
+  if (empty_) {
+    return std::nullopt;
+  }
+  simdjson::ondemand::value value;
+  auto ec = object_.find_field_unordered(key).get(value);
+  if (ec == simdjson::NO_SUCH_FIELD) {
+    return std::nullopt;
+  }
+  if (ec) {
+    invalidJson(ec);
+  }
+  return value;
+}
+
+bool JsonReader::contains(std::string_view key) {
+  return find(key).has_value();
+}
+
+std::optional<std::string_view> JsonReader::getString(std::string_view key) {
+  auto value = find(key);
+  if (!value) {
+    return std::nullopt;
+  }
+  return getAs<std::string_view>(*value, key, "a string");
+}
+
+std::optional<int64_t> JsonReader::getInt(std::string_view key) {
+  auto value = find(key);
+  if (!value) {
+    return std::nullopt;
+  }
+  return getAs<int64_t>(*value, key, "an integer");
+}
+
+std::optional<bool> JsonReader::getBool(std::string_view key) {
+  auto value = find(key);
+  if (!value) {
+    return std::nullopt;
+  }
+  return getAs<bool>(*value, key, "a boolean");
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <simdjson.h>
+
+namespace common {
+
+/*
+  按需读取请求体顶层对象中的字段 (simdjson on-demand), 不构造 DOM, 字段值直接从 body 中解析。
+  - 字段缺失返回 nullopt; JSON 非法或字段类型不符时抛 std::runtime_error, 与 parseRequestBody 一致
+  - 空 body 视为空对象
+  - 解析器和输入缓冲区每线程一个并复用, 同一线程同一时刻只能有一个 JsonReader;
+    返回的 string_view 指向解析器内部的缓冲区, 在 JsonReader 析构前有效
+*/
+class JsonReader {
+public:
+  explicit JsonReader(std::string_view body);
+  JsonReader(const JsonReader&) = delete;
+  JsonReader& operator=(const JsonReader&) = delete;
+
+  bool contains(std::string_view key);
+  std::optional<std::string_view> getString(std::string_view key);
+  std::optional<int64_t> getInt(std::string_view key);
+  std::optional<bool> getBool(std::string_view key);
+
+private:
+  std::optional<simdjson::ondemand::value> find(std::string_view key);
+
+  bool empty_ = false;
+  simdjson::ondemand::document doc_;
+  simdjson::ondemand::object object_;
+};
+
+}
@@ -0,0 +1,146 @@
+#include "json_writer.hpp"
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace common {
+
+namespace {
+
+bool needsEscape(unsigned char c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+// 返回 s 中从 pos 开始第一个需要转义的字符位置, 一次检查 8 个字节
+size_t findEscape(std::string_view s, size_t pos) {
+  constexpr uint64_t ones = 0x0101010101010101ULL;
+  constexpr uint64_t highs = 0x8080808080808080ULL;
+  auto hasZero = [](uint64_t x) { return (x - ones) & ~x & highs; };
+
+  for (; pos + 8 <= s.size(); pos += 8) {
+    uint64_t chunk;
+    std::memcpy(&chunk, s.data() + pos, 8);
+    uint64_t control = (chunk - ones * 0x20) & ~chunk & highs; // 字节 < 0x20
+    uint64_t mask = control | hasZero(chunk ^ (ones * '"')) | hasZero(chunk ^ (ones * '\\'));
+    if (mask) {
+      // 借位可能让更高的字节误报, 最低位的命中总是准确的 (小端)
+      return pos + std::countr_zero(mask) / 8;
+    }
+  }
+  for (; pos < s.size(); ++pos) {
+    if (needsEscape(static_cast<unsigned char>(s[pos]))) {
+      return pos;
+    }
+  }
+  return s.size();
+}
+
+} // namespace
+
+void JsonWriter::beforeValue() {
+  if (after_key_) {
+    after_key_ = false;
+  } else if (need_comma_) {
+    out_ += ',';
+  }
+}
+
+JsonWriter& JsonWriter::beginObject() {
+  beforeValue();
+  out_ += '{';
+  need_comma_ = false;
+  return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+  out_ += '}';
+  need_comma_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+  beforeValue();
+  out_ += '[';
+  need_comma_ = false;
+  return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+  out_ += ']';
+  need_comma_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::key(std::string_view name) {
+  if (need_comma_) {
+    out_ += ',';
+  }
+  writeString(name);
+  out_ += ':';
+  after_key_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(std::string_view s) {
+  beforeValue();
+  writeString(s);
+  need_comma_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(bool b) {
+  beforeValue();
+  out_ += b ? "true" : "false";
+  need_comma_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(double d) {
+  beforeValue();
+  if (std::isfinite(d)) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), d);
+    out_.append(buf, end - buf);
+  } else {
+    out_ += "null"; // 与 nlohmann::json 一致, NaN/Inf 输出为 null
+  }
+  need_comma_ = true;
+  return *this;
+}
+
+JsonWriter& JsonWriter::value(std::nullptr_t) {
+  beforeValue();
+  out_ += "null";
+  need_comma_ = true;
+  return *this;
+}
+
+void JsonWriter::writeString(std::string_view s) {
+  static constexpr char hex[] = "0123456789abcdef";
+
+  out_ += '"';
+  size_t run = 0; // 尚未写出的、不需要转义的一段的起点
+  for (size_t i = findEscape(s, 0); i < s.size(); i = findEscape(s, run)) {
+    out_.append(s.data() + run, i - run);
+    run = i + 1;
+    auto c = static_cast<unsigned char>(s[i]);
+    switch (c) {
+      case '"': out_ += "\\\""; break;
+      case '\\': out_ += "\\\\"; break;
+      case '\b': out_ += "\\b"; break;
+      case '\f': out_ += "\\f"; break;
+      case '\n': out_ += "\\n"; break;
+      case '\r': out_ += "\\r"; break;
+      case '\t': out_ += "\\t"; break;
+      default:
+        out_ += "\\u00";
+        out_ += hex[c >> 4];
+        out_ += hex[c & 0x0f];
+    }
+  }
+  out_.append(s.data() + run, s.size() - run);
+  out_ += '"';
+}
+
+}
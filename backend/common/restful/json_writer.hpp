@@ -0,0 +1,54 @@
+#pragma once
+#include <charconv>
+#include <concepts>
+#include <cstddef>
+#include <string_view>
+#include "common/restful/http_types.hpp"
+
+namespace common {
+
+/*
+  把 JSON 直接追加到响应 body 中, 不构造 DOM。调用方保证 begin/end 成对、对象中 key 与 value 交替:
+    JsonWriter json(res.body());
+    json.beginObject().key("success").value(true).key("token").value(token).endObject();
+  字符串按 JSON 规则转义, 不校验 UTF-8
+*/
+class JsonWriter {
+public:
+  using Buffer = StringBody::value_type;
+
+  explicit JsonWriter(Buffer& out) : out_(out) {}
+
+  JsonWriter& beginObject();
+  JsonWriter& endObject();
+  JsonWriter& beginArray();
+  JsonWriter& endArray();
+  JsonWriter& key(std::string_view name);
+
+  JsonWriter& value(std::string_view s);
+  JsonWriter& value(const char* s) { return value(std::string_view(s)); }
+  JsonWriter& value(bool b);
+  JsonWriter& value(double d);
+  JsonWriter& value(std::nullptr_t);
+
+  template <std::integral T>
+    requires (!std::same_as<T, bool>)
+  JsonWriter& value(T n) {
+    beforeValue();
+    char buf[24];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), n);
+    out_.append(buf, end - buf);
+    need_comma_ = true;
+    return *this;
+  }
+
+private:
+  void beforeValue();
+  void writeString(std::string_view s);
+
+  Buffer& out_;
+  bool need_comma_ = false; // 上一个元素之后需要逗号
+  bool after_key_ = false;  // 刚写完 key, 下一个值紧跟冒号
+};
+
+}
@@ -0,0 +1,169 @@
+#include "listener_handoff.hpp"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace common::handoff {
+
+namespace {
+
+// SCM_RIGHTS 一次最多传递的描述符数 (内核的 SCM_MAX_FD)
+constexpr size_t kMaxFds = 253;
+
+[[noreturn]] void fail(const char* what) {
+  throw std::runtime_error(std::string("Listener handoff: ") + what + ": " + std::strerror(errno));
+}
+
+} // namespace
+
+void checkDirectory(const std::string& dir) {
+  struct stat st{};
+  if (::lstat(dir.c_str(), &st) != 0) {
+    fail(("stat " + dir).c_str());
+  }
+  if (!S_ISDIR(st.st_mode) || st.st_uid != ::geteuid() || (st.st_mode & (S_IWGRP | S_IWOTH))) {
+    throw std::runtime_error("Listener handoff: " + dir +
+                             " must be a directory owned by this user and not writable by group or others");
+  }
+}
+
+void checkPeer(int socket) {
+  ucred cred{};
+  socklen_t len = sizeof(cred);
+  if (::getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+    fail("SO_PEERCRED");
+  }
+  if (cred.uid != ::geteuid()) {
+    throw std::runtime_error("Listener handoff: peer pid " + std::to_string(cred.pid) + " runs as uid " +
+                             std::to_string(cred.uid));
+  }
+}
+
+int connect(const std::string& path) {
+  sockaddr_un addr{};
+  if (path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("Listener handoff: path too long: " + path);
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  struct stat st{};
+  if (::lstat(path.c_str(), &st) != 0) {
+    if (errno == ENOENT) {
+      return -1;
+    }
+    fail("stat");
+  }
+  if (!S_ISSOCK(st.st_mode) || st.st_uid != ::geteuid()) {
+    throw std::runtime_error("Listener handoff: " + path + " is not a socket owned by this user");
+  }
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    fail("socket");
+  }
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    int error = errno;
+    ::close(fd);
+    if (error == ENOENT || error == ECONNREFUSED) {
+      return -1; // 没有旧进程, 或旧进程异常退出后留下的 socket 文件
+    }
+    errno = error;
+    fail("connect");
+  }
+  try {
+    checkPeer(fd);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  return fd;
+}
+
+std::vector<int> receive(int socket, std::chrono::milliseconds timeout) {
+  timeval tv{};
+  tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+  tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+  ::setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+  uint32_t count = 0;
+  iovec iov{&count, sizeof(count)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxFds)];
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  do {
+    n = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n < 0) {
+    fail("recvmsg");
+  }
+
+  std::vector<int> fds;
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      fds.resize(received);
+      std::memcpy(fds.data(), CMSG_DATA(cmsg), received * sizeof(int));
+    }
+  }
+  if (n != sizeof(count) || (msg.msg_flags & MSG_CTRUNC) || fds.size() != count) {
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    throw std::runtime_error("Listener handoff: incomplete message");
+  }
+  return fds;
+}
+
+void ready(int socket) {
+  char ack = 'R';
+  ssize_t n;
+  do {
+    n = ::send(socket, &ack, 1, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  int error = errno;
+  ::close(socket);
+  if (n != 1) {
+    errno = error;
+    fail("send");
+  }
+}
+
+void send(int socket, const std::vector<int>& fds) {
+  if (fds.empty() || fds.size() > kMaxFds) {
+    throw std::runtime_error("Listener handoff: unsupported listener count");
+  }
+  auto count = static_cast<uint32_t>(fds.size());
+  iovec iov{&count, sizeof(count)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kMaxFds)] = {};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+
+  ssize_t n;
+  do {
+    n = ::sendmsg(socket, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+  if (n != sizeof(count)) {
+    fail("sendmsg");
+  }
+}
+
+}
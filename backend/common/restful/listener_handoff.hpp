@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace common {
+
+/*
+  热重启时在新旧进程之间交接监听 socket:
+  1. 旧进程在 Unix socket 上等待; 新进程启动时连接它, 旧进程通过 SCM_RIGHTS 发送所有监听 socket
+  2. 新进程用收到的 socket 开始接受连接后回复一个字节的确认
+  3. 旧进程收到确认后停止接受连接并排空, 新进程接管 Unix socket 的路径等待下一次重启
+  监听 socket 始终有进程持有, 交接期间到达的连接留在同一个 accept 队列中, 不会被拒绝
+  拿到监听 socket 就能接管端口, 所以 Unix socket 所在目录必须只有本用户可写, 两端都用 SO_PEERCRED 确认对方是同一用户
+  失败时抛出 std::runtime_error
+*/
+namespace handoff {
+
+// 交接目录必须是本进程有效用户所有、组和其他用户不可写的目录 (不能是符号链接), 如 0700 的运行时目录;
+// 否则其他本地用户可以预先创建 socket 文件冒充旧进程, 或连上来拿走监听 socket
+void checkDirectory(const std::string& dir);
+// 对端进程的有效用户必须与本进程相同
+void checkPeer(int socket);
+
+// 新进程: 连接 path 上的旧进程并确认对端, 没有旧进程 (路径不存在或没有进程监听) 时返回 -1;
+// path 不是本用户的 socket 文件时抛出
+int connect(const std::string& path);
+// 新进程: 接收旧进程发来的监听 socket, 最多等待 timeout
+std::vector<int> receive(int socket, std::chrono::milliseconds timeout);
+// 新进程: 开始接受连接后通知旧进程, 并关闭 socket
+void ready(int socket);
+
+// 旧进程: 向新进程发送监听 socket, 调用方保留自己的副本
+void send(int socket, const std::vector<int>& fds);
+
+}
+
+}
@@ -0,0 +1,143 @@
+#include "rate_limiter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <memory>
+#include "common/restful/json_reader.hpp"
+#include "common/restful/json_writer.hpp"
+
+namespace common {
+
+RateLimiter::RateLimiter(double rate, double burst, size_t max_keys)
+  : rate_(rate), burst_(std::max(burst, 1.0)), shard_capacity_(std::max<size_t>(max_keys / kShards, 1)) {}
+
+bool RateLimiter::tryAcquire(std::string_view key, Clock::duration& retry_after, Clock::time_point now) {
+  auto& shard = shards_[StringHash{}(key) % kShards];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  Bucket* bucket;
+  if (auto it = shard.index.find(key); it != shard.index.end()) {
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    bucket = &it->second->second;
+    double elapsed = std::chrono::duration<double>(now - bucket->updated).count();
+    bucket->tokens = std::min(burst_, bucket->tokens + elapsed * rate_);
+    bucket->updated = now;
+  } else {
+    if (shard.lru.size() >= shard_capacity_) {
+      // 复用最久未访问的链表节点和哈希表节点, 稳定状态下不再分配内存
+      auto node = shard.index.extract(shard.lru.back().first);
+      shard.lru.splice(shard.lru.begin(), shard.lru, std::prev(shard.lru.end()));
+      shard.lru.front().first.assign(key);
+      node.key().assign(key);
+      shard.index.insert(std::move(node));
+    } else {
+      shard.lru.emplace_front(std::string(key), Bucket{});
+      shard.index.emplace(shard.lru.front().first, shard.lru.begin());
+    }
+    bucket = &shard.lru.front().second;
+    *bucket = {burst_, now};
+  }
+
+  if (bucket->tokens >= 1) {
+    bucket->tokens -= 1;
+    return true;
+  }
+  retry_after = std::chrono::duration_cast<Clock::duration>(
+    std::chrono::duration<double>((1 - bucket->tokens) / rate_));
+  return false;
+}
+
+size_t RateLimiter::size() const {
+  size_t total = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.lru.size();
+  }
+  return total;
+}
+
+namespace {
+
+Response tooManyRequests(const Request& req, RateLimiter::Clock::duration retry_after) {
+  Allocator alloc(RequestArena::current());
+  Response res{std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc)};
+  res.result(http::status::too_many_requests);
+  res.version(req.version());
+  res.keep_alive(req.keep_alive());
+  res.set(http::field::content_type, "application/json");
+  res.set(http::field::access_control_allow_origin, "*");
+  auto seconds = std::max<long long>(1, std::ceil(std::chrono::duration<double>(retry_after).count()));
+  res.set(http::field::retry_after, std::to_string(seconds));
+  JsonWriter(res.body())
+      .beginObject()
+      .key("success").value(false)
+      .key("error").value("Too many requests, please retry later")
+      .endObject();
+  res.prepare_payload();
+  return res;
+}
+
+// IP 地址的原始字节作为 key, 不格式化成字符串
+std::string_view addressKey(const net::ip::address& address) {
+  thread_local std::array<unsigned char, 16> bytes;
+  if (address.is_v4()) {
+    auto v4 = address.to_v4().to_bytes();
+    std::copy(v4.begin(), v4.end(), bytes.begin());
+    return {reinterpret_cast<const char*>(bytes.data()), v4.size()};
+  }
+  bytes = address.to_v6().to_bytes();
+  return {reinterpret_cast<const char*>(bytes.data()), bytes.size()};
+}
+
+} // namespace
+
+RestApiHandlerBase::Middleware rateLimitMiddleware(std::vector<std::string> paths,
+                                                   const config::RateLimitConfig& cfg) {
+  // std::function 要求可复制, 限流器由各个副本共享
+  auto by_ip = std::make_shared<RateLimiter>(cfg.ip_rate, cfg.ip_burst, cfg.max_keys);
+  auto by_email = std::make_shared<RateLimiter>(cfg.email_rate, cfg.email_burst, cfg.max_keys);
+
+  return [paths = std::move(paths), by_ip, by_email](const Request& req,
+                                                     const net::ip::address& client) -> std::optional<Response> {
+    auto target = toStringView(req.target());
+    auto path = target.substr(0, target.find('?'));
+    if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+      return std::nullopt;
+    }
+
+    RateLimiter::Clock::duration retry_after{};
+    auto now = RateLimiter::Clock::now();
+    if (!by_ip->tryAcquire(addressKey(client), retry_after, now)) {
+      return tooManyRequests(req, retry_after);
+    }
+
+    // email 指向 reader 的缓冲区, reader 要活到下面用完 email 为止
+    std::optional<JsonReader> reader;
+    std::optional<std::string_view> email;
+    try {
+      reader.emplace(toStringView(req.body()));
+      email = reader->getString("email");
+    } catch (const std::exception&) {
+      return std::nullopt;
+    }
+    if (!email) {
+      return std::nullopt;
+    }
+
+    // 去掉首尾空白并转为小写, 避免换个大小写就绕过
+    auto value = *email;
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) value.remove_prefix(1);
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) value.remove_suffix(1);
+    char key[256];
+    if (value.size() > sizeof(key)) {
+      value = value.substr(0, sizeof(key));
+    }
+    std::transform(value.begin(), value.end(), key, [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (!by_email->tryAcquire({key, value.size()}, retry_after, now)) {
+      return tooManyRequests(req, retry_after);
+    }
+    return std::nullopt;
+  };
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "common/config/config.hpp"
+#include "common/restful/rest_api_handler_base.hpp"
+
+namespace common {
+
+/*
+  按 key (客户端 IP、邮箱等) 的令牌桶限流, 每个 key 每秒补充 rate 个令牌, 最多积累 burst 个。
+  - 按 key 的哈希分成 kShards 个分片, 各自加锁, 多个 io 线程同时调用时很少竞争
+  - 内存有上界: 每个分片最多 max_keys / kShards 个桶, 满了淘汰最久未访问的, 复用其节点;
+    被淘汰的 key 下次出现时桶是满的, 所以 max_keys 要明显大于同时活跃的 key 数
+*/
+class RateLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr size_t kShards = 32;
+
+  RateLimiter(double rate, double burst, size_t max_keys);
+  RateLimiter(const RateLimiter&) = delete;
+  RateLimiter& operator=(const RateLimiter&) = delete;
+
+  // 从 key 的桶中取一个令牌; 不足时返回 false, retry_after 为下一个令牌补充前的等待时间
+  bool tryAcquire(std::string_view key, Clock::duration& retry_after, Clock::time_point now = Clock::now());
+
+  size_t size() const;
+
+private:
+  struct Bucket {
+    double tokens;
+    Clock::time_point updated;
+  };
+
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+
+  using Entry = std::pair<std::string, Bucket>;
+
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::list<Entry> lru; // 最近访问的在前
+    std::unordered_map<std::string, std::list<Entry>::iterator, StringHash, std::equal_to<>> index;
+  };
+
+  double rate_;
+  double burst_;
+  size_t shard_capacity_;
+  std::array<Shard, kShards> shards_;
+};
+
+/*
+  按客户端 IP 和 JSON body 中 email 字段限流的中间件, 只作用于 paths 中的接口,
+  超出时回复 429 + Retry-After, 在查询数据库、计算哈希或发送邮件之前拒绝。
+  邮箱比较前去掉首尾空白并转为小写; body 不是合法 JSON 时只按 IP 限流, 由处理函数返回 400
+*/
+RestApiHandlerBase::Middleware rateLimitMiddleware(std::vector<std::string> paths,
+                                                   const config::RateLimitConfig& cfg);
+
+}
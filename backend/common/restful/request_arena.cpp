@@ -0,0 +1,55 @@
+#include "request_arena.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace common {
+
+namespace {
+thread_local std::pmr::memory_resource* t_current = nullptr;
+}
+
+// 缓冲区不清零, 没有用到的页不占物理内存 (大量空闲连接时每个连接只驻留实际用过的部分)
+RequestArena::RequestArena(size_t initial_bytes, size_t max_bytes)
+  : capacity_(initial_bytes), max_bytes_(std::max(initial_bytes, max_bytes)),
+    buffer_(std::make_unique_for_overwrite<std::byte[]>(initial_bytes)) {
+  resource_.emplace(buffer_.get(), capacity_, &upstream_);
+}
+
+void RequestArena::reset() {
+  if (upstream_.overflow == 0 || capacity_ >= max_bytes_) {
+    upstream_.overflow = 0;
+    resource_->release(); // 回到初始缓冲区的起点
+    return;
+  }
+
+  // 本轮用量超出初始缓冲区: 按用量扩大后重建, 之后同样大小的请求全部落在缓冲区内
+  size_t wanted = std::min(std::bit_ceil(capacity_ + upstream_.overflow), max_bytes_);
+  resource_.reset();
+  upstream_.overflow = 0;
+  buffer_ = std::make_unique_for_overwrite<std::byte[]>(wanted);
+  capacity_ = wanted;
+  resource_.emplace(buffer_.get(), capacity_, &upstream_);
+}
+
+std::pmr::memory_resource* RequestArena::current() {
+  return t_current ? t_current : std::pmr::get_default_resource();
+}
+
+RequestArena::Scope::Scope(std::pmr::memory_resource* resource) : previous_(t_current) {
+  t_current = resource;
+}
+
+RequestArena::Scope::~Scope() {
+  t_current = previous_;
+}
+
+void* RequestArena::OverflowResource::do_allocate(size_t bytes, size_t alignment) {
+  overflow += bytes;
+  return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void RequestArena::OverflowResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+  std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <type_traits>
+
+namespace common {
+
+/*
+  连接上每个排队中的请求一块单调分配的内存, 请求头/体的解析、处理函数构造的响应都从这里分配,
+  响应写完后 reset() 整体回收, 不逐个释放。
+  - 初始缓冲区用完后向全局堆申请, reset() 时按本轮用量扩大初始缓冲区 (不超过 max_bytes),
+    稳定状态下同样大小的请求不再访问全局堆
+  - 同一时刻只被一个线程使用: io 线程解析请求, 处理函数可能在线程池中执行, 两者不会同时进行
+*/
+class RequestArena {
+public:
+  RequestArena(size_t initial_bytes, size_t max_bytes);
+  RequestArena(const RequestArena&) = delete;
+  RequestArena& operator=(const RequestArena&) = delete;
+
+  std::pmr::memory_resource* resource() { return &*resource_; }
+  size_t capacity() const { return capacity_; }
+  void reset();
+
+  // 当前线程正在处理的请求所属的 arena, 没有时为默认的全局堆
+  static std::pmr::memory_resource* current();
+
+  // 在处理函数执行期间设置 current()
+  class Scope {
+  public:
+    explicit Scope(std::pmr::memory_resource* resource);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    std::pmr::memory_resource* previous_;
+  };
+
+private:
+  // 记录溢出到全局堆的字节数, 作为下次扩容的依据
+  class OverflowResource : public std::pmr::memory_resource {
+  public:
+    size_t overflow = 0;
+
+  private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+  };
+
+  size_t capacity_;
+  size_t max_bytes_;
+  std::unique_ptr<std::byte[]> buffer_;
+  OverflowResource upstream_;
+  std::optional<std::pmr::monotonic_buffer_resource> resource_;
+};
+
+/*
+  从 memory_resource 分配的 allocator, 用于 beast 的 basic_fields 和 string body。
+  std::pmr::polymorphic_allocator 不可赋值, 不满足 basic_fields 的要求; 这里在移动赋值时随对象传递,
+  响应/请求在协程、线程池和连接之间移动时始终留在原来的 arena 中
+*/
+template <class T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() noexcept : resource_(std::pmr::get_default_resource()) {}
+  ArenaAllocator(std::pmr::memory_resource* resource) noexcept : resource_(resource) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept : resource_(other.resource()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    resource_->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  std::pmr::memory_resource* resource() const noexcept { return resource_; }
+
+  template <class U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept { return resource_ == other.resource(); }
+
+private:
+  std::pmr::memory_resource* resource_;
+};
+
+}
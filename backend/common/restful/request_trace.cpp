@@ -0,0 +1,61 @@
+#include "request_trace.hpp"
+#include <charconv>
+#include <cstring>
+
+namespace common {
+
+namespace {
+
+thread_local RequestTrace* t_current = nullptr;
+
+} // namespace
+
+void RequestTrace::add(const char* name, Clock::duration duration) {
+  for (size_t i = 0; i < size_; ++i) {
+    // 名称是字面量, 先比较指针; 不同编译单元中的同名字面量不保证合并, 再比较内容
+    if (spans_[i].name == name || std::strcmp(spans_[i].name, name) == 0) {
+      spans_[i].duration += duration;
+      ++spans_[i].count;
+      return;
+    }
+  }
+  if (size_ < kMaxSpans) {
+    spans_[size_++] = {name, duration, 1};
+  }
+}
+
+void RequestTrace::appendServerTiming(std::string& out) const {
+  for (const auto& span : spans()) {
+    appendServerTiming(out, span.name, span.duration, span.count);
+  }
+}
+
+void RequestTrace::appendServerTiming(std::string& out, const char* name, Clock::duration duration, uint32_t count) {
+  if (!out.empty()) {
+    out += ", ";
+  }
+  out += name;
+  out += ";dur=";
+  char buffer[32];
+  double ms = std::chrono::duration<double, std::milli>(duration).count();
+  out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), ms, std::chars_format::fixed, 3).ptr);
+  if (count > 1) {
+    out += ";desc=\"x";
+    out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), count).ptr);
+    out += '"';
+  }
+}
+
+RequestTrace* RequestTrace::current() {
+  return t_current;
+}
+
+RequestTrace::Scope::Scope(RequestTrace* trace) : previous_(t_current) {
+  t_current = trace;
+}
+
+RequestTrace::Scope::~Scope() {
+  t_current = previous_;
+}
+
+}
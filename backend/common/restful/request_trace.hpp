@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace common {
+
+/*
+  一个请求各阶段的耗时 (线程池排队、redis、mysql、密码哈希、JWT 签名等), 写入访问日志,
+  HttpServerConfig::server_timing 时同时作为 Server-Timing 响应头返回。
+  - 阶段名必须是字符串字面量 (HTTP token, 不含空格和引号): 只保存指针, 记录时不分配内存
+  - 同名的阶段累加耗时和次数; 最多 kMaxSpans 个不同的名称, 之后新出现的名称丢弃
+  - 与 RequestArena 一样同一时刻只被一个线程使用。同步的处理函数及其调用的 AuthService、仓储通过 current() 取得,
+    RestApiHandlerBase 在调用处理函数期间设置; 协程 (流式处理函数) 使用 RequestContext::trace
+*/
+class RequestTrace {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr size_t kMaxSpans = 12;
+
+  struct Span {
+    const char* name;
+    Clock::duration duration;
+    uint32_t count;
+  };
+
+  void add(const char* name, Clock::duration duration);
+  std::span<const Span> spans() const { return {spans_.data(), size_}; }
+  bool empty() const { return size_ == 0; }
+  void clear() { size_ = 0; }
+
+  // 追加 Server-Timing 的各项, 如 "queue;dur=0.012, mysql;dur=1.530"; 耗时为毫秒, 次数大于 1 时带 desc="xN"
+  void appendServerTiming(std::string& out) const;
+  static void appendServerTiming(std::string& out, const char* name, Clock::duration duration, uint32_t count = 1);
+
+  // 当前线程正在处理的请求的 trace, 没有时为 nullptr (不记录)
+  static RequestTrace* current();
+
+  // 在处理函数执行期间设置 current(), trace 为 nullptr 时表示不记录
+  class Scope {
+  public:
+    explicit Scope(RequestTrace* trace);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    RequestTrace* previous_;
+  };
+
+private:
+  std::array<Span, kMaxSpans> spans_;
+  size_t size_ = 0;
+};
+
+// 在 trace 中记录从构造到析构 (或 end()) 的耗时; 没有 trace 时不读时钟
+class TraceSpan {
+public:
+  explicit TraceSpan(const char* name) : TraceSpan(RequestTrace::current(), name) {}
+  TraceSpan(RequestTrace* trace, const char* name) : trace_(trace), name_(name) {
+    if (trace_) {
+      start_ = RequestTrace::Clock::now();
+    }
+  }
+  ~TraceSpan() { end(); }
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  // 提前结束, 之后析构不再记录
+  void end() {
+    if (trace_) {
+      trace_->add(name_, RequestTrace::Clock::now() - start_);
+      trace_ = nullptr;
+    }
+  }
+
+private:
+  RequestTrace* trace_;
+  const char* name_;
+  RequestTrace::Clock::time_point start_;
+};
+
+}
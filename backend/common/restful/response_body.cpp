@@ -0,0 +1,118 @@
+#include "response_body.hpp"
+#include <algorithm>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/error.hpp>
+#ifdef BOOST_ASIO_HAS_FILE
+#include <boost/asio/read_at.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#endif
+
+namespace common {
+
+namespace {
+
+constexpr size_t kFileChunk = 64 * 1024;
+
+} // namespace
+
+void ResponseBody::value_type::assignFile(File&& file) {
+  clear();
+  payload_ = std::make_shared<File>(std::move(file));
+}
+
+void ResponseBody::value_type::assignVector(std::vector<char>&& data) {
+  clear();
+  payload_ = std::make_shared<const std::vector<char>>(std::move(data));
+}
+
+void ResponseBody::value_type::assignSource(std::shared_ptr<BodySource> source) {
+  clear();
+  payload_ = std::move(source);
+}
+
+ResponseBody::File* ResponseBody::value_type::file() const {
+  auto* file = std::get_if<std::shared_ptr<File>>(&payload_);
+  return file ? file->get() : nullptr;
+}
+
+const std::vector<char>* ResponseBody::value_type::vector() const {
+  auto* data = std::get_if<std::shared_ptr<const std::vector<char>>>(&payload_);
+  return data ? data->get() : nullptr;
+}
+
+const std::shared_ptr<BodySource>& ResponseBody::value_type::source() const {
+  static const std::shared_ptr<BodySource> none;
+  auto* source = std::get_if<std::shared_ptr<BodySource>>(&payload_);
+  return source ? *source : none;
+}
+
+uint64_t ResponseBody::value_type::payloadSize() const {
+  if (auto* file = this->file()) {
+    return file->size();
+  }
+  if (auto* data = vector()) {
+    return data->size();
+  }
+  if (const auto& source = this->source()) {
+    return source->size().value_or(0);
+  }
+  return String::size();
+}
+
+void ResponseBody::writer::init(boost::beast::error_code& ec) {
+  ec = {};
+  if (auto* file = body_.file()) {
+    remain_ = file->size();
+    file->file().seek(0, ec);
+  }
+}
+
+boost::optional<std::pair<ResponseBody::writer::const_buffers_type, bool>>
+ResponseBody::writer::get(boost::beast::error_code& ec) {
+  ec = {};
+  if (auto* file = body_.file()) {
+    if (remain_ == 0) {
+      return boost::none;
+    }
+    if (!chunk_) {
+      chunk_ = std::make_unique<char[]>(kFileChunk);
+    }
+    size_t n = file->file().read(chunk_.get(), static_cast<size_t>(std::min<uint64_t>(remain_, kFileChunk)), ec);
+    if (ec) {
+      return boost::none;
+    }
+    if (n == 0) { // 文件在打开后被截短
+      ec = http::error::short_read;
+      return boost::none;
+    }
+    remain_ -= n;
+    return {{const_buffers_type(chunk_.get(), n), remain_ > 0}};
+  }
+  if (body_.source()) {
+    ec = make_error_code(boost::beast::errc::operation_not_supported);
+    return boost::none;
+  }
+  if (auto* data = body_.vector()) {
+    return {{const_buffers_type(data->data(), data->size()), false}};
+  }
+  return {{const_buffers_type(body_.data(), body_.String::size()), false}};
+}
+
+#ifdef BOOST_ASIO_HAS_FILE
+net::awaitable<size_t> AsyncFileSource::read(net::mutable_buffer buffer) {
+  if (offset_ >= size_ || buffer.size() == 0) {
+    co_return 0;
+  }
+  if (!file_) {
+    file_.emplace(co_await net::this_coro::executor, path_, net::random_access_file::read_only);
+  }
+  // 文件在打开后被截短时抛出 eof, 已经写出的 Content-Length 无法满足, 连接随之关闭
+  size_t want = static_cast<size_t>(std::min<uint64_t>(buffer.size(), size_ - offset_));
+  size_t n = co_await file_->async_read_some_at(offset_, net::buffer(buffer.data(), want), net::use_awaitable);
+  offset_ += n;
+  co_return n;
+}
+#endif
+
+}
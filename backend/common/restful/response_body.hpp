@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/http/file_body.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+#include "common/restful/request_arena.hpp"
+#ifdef BOOST_ASIO_HAS_FILE
+#include <boost/asio/random_access_file.hpp>
+#endif
+
+namespace common {
+
+namespace net = boost::asio;
+namespace http = boost::beast::http;
+
+/*
+  异步产生的响应 body (如以 io_uring 读取的文件), HttpSession 逐块 read 后写出:
+  size() 已知时按 Content-Length 写出, 否则 HTTP/1.1 按 chunked、HTTP/1.0 写完后关闭连接。
+  read 在连接的 executor 上调用, 返回 0 表示结束; 抛出异常时连接 (HTTP/2 为这个流) 直接关闭, 响应头可能已经写出
+*/
+class BodySource {
+public:
+  virtual ~BodySource() = default;
+
+  virtual net::awaitable<size_t> read(net::mutable_buffer buffer) = 0;
+  virtual std::optional<uint64_t> size() const = 0;
+};
+
+#ifdef BOOST_ASIO_HAS_FILE
+// 以 asio::random_access_file 读取的文件; 第一次 read 时在调用方的 executor 上打开, 所以可以在同步的处理函数中构造
+class AsyncFileSource : public BodySource {
+public:
+  AsyncFileSource(std::string path, uint64_t size) : path_(std::move(path)), size_(size) {}
+
+  net::awaitable<size_t> read(net::mutable_buffer buffer) override;
+  std::optional<uint64_t> size() const override { return size_; }
+
+private:
+  std::string path_;
+  uint64_t size_;
+  uint64_t offset_ = 0;
+  std::optional<net::random_access_file> file_;
+};
+#endif
+
+/*
+  common::Response 的 body。默认是 arena 中的字符串 (JSON、m3u8 等): value_type 就是这个字符串, 原有的用法不变。
+  处理函数也可以换成:
+  - 文件 (http::file_body::value_type): 写出时按块读取, 不整个读入内存
+  - std::vector<char>
+  - BodySource: 由 HttpSession 逐块 co_await 读取后写出
+  换成其他 body 后字符串不再使用, 压缩只处理字符串 body; prepare_payload 按换入的 body 设置 Content-Length
+  (长度未知的 BodySource 由 HttpSession 改为 chunked)。复制响应时共享同一个文件/vector/来源
+*/
+struct ResponseBody {
+  using String = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+  using File = http::file_body::value_type;
+
+  class value_type : public String {
+  public:
+    using String::String;
+    using String::operator=;
+    value_type() = default;
+    value_type(const String& s) : String(s) {}
+    value_type(String&& s) : String(std::move(s)) {}
+
+    void assignFile(File&& file);
+    void assignVector(std::vector<char>&& data);
+    void assignSource(std::shared_ptr<BodySource> source);
+
+    bool isString() const { return payload_.index() == 0; }
+    File* file() const;
+    const std::vector<char>* vector() const;
+    const std::shared_ptr<BodySource>& source() const;
+    // 换入的 body 的字节数, 长度未知的 BodySource 为 0
+    uint64_t payloadSize() const;
+
+  private:
+    std::variant<std::monostate, std::shared_ptr<File>, std::shared_ptr<const std::vector<char>>,
+                 std::shared_ptr<BodySource>> payload_;
+  };
+
+  static uint64_t size(const value_type& body) { return body.payloadSize(); }
+
+  // 字符串和 vector 一次写出, 文件按块读取后写出; BodySource 不经过 serializer, 由 HttpSession 写出 body
+  class writer {
+  public:
+    using const_buffers_type = net::const_buffer;
+
+    template <bool isRequest, class Fields>
+    writer(const http::header<isRequest, Fields>&, const value_type& body) : body_(body) {}
+
+    void init(boost::beast::error_code& ec);
+    boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec);
+
+  private:
+    const value_type& body_;
+    uint64_t remain_ = 0; // 文件还没有读出的字节数
+    std::unique_ptr<char[]> chunk_; // 文件的读缓冲, 第一次读取时分配
+  };
+};
+
+}
@@ -2,27 +2,170 @@
 
 namespace common {
 
-http::response<http::string_body> RestApiHandlerBase::createJsonResponse(
+net::awaitable<Response> RestApiHandlerBase::handleRequestAsync(
+  Request req, RequestTrace* trace) {
+
+  if (req.method() == http::verb::options) {
+    co_return StaticResponseCache::getInstance().preflight().toResponse(req.version(), req.keep_alive());
+  }
+
+  Response response;
+  try {
+    response = co_await doHandleRequestAsync(std::move(req), trace);
+  } catch (const std::exception& e) {
+    response = createErrorResponse(http::status::internal_server_error,
+                                   "Internal server error: " + std::string(e.what()));
+  }
+  addCorsHeaders(response);
+  co_return response;
+}
+
+net::awaitable<Response> RestApiHandlerBase::handleStreamAsync(Request header, BodyReader& body, RequestTrace* trace) {
+  Response response;
+  try {
+    auto match = router_.match(header.method(), toStringView(header.target()));
+    if (!match.route || !match.route->stream_handler) {
+      throw std::logic_error("Not a streaming route");
+    }
+    RequestContext ctx{header, match.path, match.query_string, match.params, trace};
+    response = co_await match.route->stream_handler(ctx, body);
+  } catch (const std::exception& e) {
+    response = createErrorResponse(http::status::internal_server_error,
+                                   "Internal server error: " + std::string(e.what()));
+  }
+  addCorsHeaders(response);
+  co_return response;
+}
+
+net::awaitable<Response> RestApiHandlerBase::doHandleRequestAsync(
+  Request req, RequestTrace* trace) {
+  auto* arena = req.get_allocator().resource();
+  if (isBlocking(req)) {
+    // 先命名再传入: GCC 12 对 co_await 表达式中带初始化捕获的 lambda 会按位复制捕获的请求而不调用移动构造
+    auto task = [this, arena, trace, enqueued = AdmissionController::Clock::now(), req = std::move(req)]() mutable {
+      if (trace) {
+        trace->add("queue", AdmissionController::Clock::now() - enqueued);
+      }
+      // 线程池积压时排队过久的请求, 客户端多半已经放弃, 不再执行
+      if (admission_ && admission_->queueExpired(enqueued)) {
+        return StaticResponseCache::getInstance().serviceUnavailable().toResponse(req.version(), req.keep_alive());
+      }
+      RequestArena::Scope scope(arena);
+      RequestTrace::Scope trace_scope(trace);
+      return doHandleRequest(std::move(req));
+    };
+    co_return co_await runBlocking(std::move(task));
+  }
+  RequestArena::Scope scope(arena);
+  RequestTrace::Scope trace_scope(trace);
+  co_return doHandleRequest(std::move(req));
+}
+
+bool RestApiHandlerBase::isBlocking(const Request& req) const {
+  auto match = router_.match(req.method(), toStringView(req.target()));
+  return match.route && match.route->blocking;
+}
+
+bool RestApiHandlerBase::isLightweight(const Request& req) const {
+  auto match = router_.match(req.method(), toStringView(req.target()));
+  return !match.route || (!match.route->blocking && !match.route->stream_handler);
+}
+
+RestApiHandlerBase::RouteInfo RestApiHandlerBase::routeInfo(const Request& header) const {
+  auto match = router_.match(header.method(), toStringView(header.target()));
+  if (!match.route) {
+    return {};
+  }
+  return {match.route->pattern, match.route->id, static_cast<bool>(match.route->stream_handler),
+          match.route->body_limit};
+}
+
+const StaticResponse* RestApiHandlerBase::staticResponse(const Request& req) const {
+  auto& cache = StaticResponseCache::getInstance();
+  if (req.method() == http::verb::options) {
+    return &cache.preflight();
+  }
+  auto match = router_.match(req.method(), toStringView(req.target()));
+  if (match.route) {
+    return nullptr;
+  }
+  return match.status == http::status::method_not_allowed ? &cache.methodNotAllowed(match.allow) : &cache.notFound();
+}
+
+std::optional<Response> RestApiHandlerBase::runMiddlewares(const Request& req, const net::ip::address& client) const {
+  for (const auto& middleware : middlewares_) {
+    if (auto response = middleware(req, client)) {
+      return response;
+    }
+  }
+  return std::nullopt;
+}
+
+void RestApiHandlerBase::setMetricsSource(std::string_view path, std::function<std::string()> source) {
+  metrics_source_ = std::move(source);
+  if (!metrics_source_ || metrics_route_) {
+    return;
+  }
+  metrics_route_ = true;
+  router_.add(http::verb::get, path, [this](RequestContext& ctx) {
+    if (!metrics_source_) {
+      return StaticResponseCache::getInstance().notFound().toResponse(ctx.req.version(), ctx.req.keep_alive());
+    }
+    Allocator alloc(RequestArena::current());
+    Response res{std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc)};
+    res.result(http::status::ok);
+    res.version(ctx.req.version());
+    res.set(http::field::content_type, "text/plain; version=0.0.4");
+    res.set(http::field::cache_control, "no-store");
+    res.body().assign(metrics_source_());
+    res.prepare_payload();
+    return res;
+  });
+}
+
+Response RestApiHandlerBase::doHandleRequest(Request&& req) {
+  auto match = router_.match(req.method(), toStringView(req.target()));
+  if (!match.route) {
+    auto& cache = StaticResponseCache::getInstance();
+    const auto& response = match.status == http::status::method_not_allowed
+      ? cache.methodNotAllowed(match.allow) : cache.notFound();
+    return response.toResponse(req.version(), req.keep_alive());
+  }
+
+  RequestContext ctx{req, match.path, match.query_string, match.params, RequestTrace::current()};
+  return match.route->handler(ctx);
+}
+
+Response RestApiHandlerBase::newJsonResponse(http::status status) {
+  Allocator alloc(RequestArena::current());
+  Response res{std::piecewise_construct, std::make_tuple(alloc), std::make_tuple(alloc)};
+  res.result(status);
+  res.version(11);
+  res.set(http::field::content_type, "application/json");
+  return res;
+}
+
+Response RestApiHandlerBase::createJsonResponse(
   http::status status, const nlohmann::json& json) {
   
-  http::response<http::string_body> res{status, 11};
-  res.set(http::field::content_type, "application/json");
-  res.body() = json.dump();
+  Response res = newJsonResponse(status);
+  res.body().assign(json.dump());
   res.prepare_payload();
   return res;
 }
 
-http::response<http::string_body> RestApiHandlerBase::createErrorResponse(
+Response RestApiHandlerBase::createErrorResponse(
   http::status status, const std::string& message) {
   
-  nlohmann::json error_json = {
-    {"success", false},
-    {"error", message}
-  };
-  return createJsonResponse(status, error_json);
+  return writeJsonResponse(status, [&message](JsonWriter& json) {
+    json.beginObject()
+        .key("success").value(false)
+        .key("error").value(message)
+        .endObject();
+  });
 }
 
-nlohmann::json RestApiHandlerBase::parseRequestBody(const std::string& body) {
+nlohmann::json RestApiHandlerBase::parseRequestBody(std::string_view body) {
   try {
     if (body.empty()) {
         return nlohmann::json{};
@@ -1,12 +1,32 @@
 #pragma once
+#include <cstdint>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/use_awaitable.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 #include <nlohmann/json.hpp>
+#include "common/restful/admission_controller.hpp"
+#include "common/restful/body_reader.hpp"
+#include "common/restful/http_types.hpp"
+#include "common/restful/json_writer.hpp"
+#include "common/restful/router.hpp"
+#include "common/restful/static_response.hpp"
+#include "common/thread_pool.hpp"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
+namespace net = boost::asio;
 
 namespace common {
 
@@ -15,20 +35,11 @@ public:
   virtual ~RestApiHandlerBase() = default;
 
   template<class Body, class Allocator>
-  http::response<http::string_body> handleRequest(
+  Response handleRequest(
     http::request<Body, http::basic_fields<Allocator>>&& req) {
-    
-    auto addCorsHeaders = [](auto& res) {
-      res.set(http::field::access_control_allow_origin, "*");
-      res.set(http::field::access_control_allow_methods, "GET, POST, PUT, DELETE, OPTIONS");
-      res.set(http::field::access_control_allow_headers, "Content-Type, Authorization");
-    };
 
     if (req.method() == http::verb::options) {
-      http::response<http::string_body> res{http::status::ok, req.version()};
-      addCorsHeaders(res);
-      res.prepare_payload();
-      return res;
+      return StaticResponseCache::getInstance().preflight().toResponse(req.version(), req.keep_alive());
     }
 
     try {
@@ -43,17 +54,121 @@ public:
     }
   }
 
+  // 协程入口, HttpSession 在连接的 strand 上驱动它; 与 handleRequest 一样处理 OPTIONS、CORS 和异常
+  // trace 不为空时记录各阶段耗时, 由调用方持有到协程结束
+  net::awaitable<Response> handleRequestAsync(
+    Request req, RequestTrace* trace = nullptr);
+
+  // 流式路由的协程入口, header 只有请求头。处理函数构造的响应不在 arena 中 (协程挂起期间不能设置 RequestArena::Scope),
+  // 同理 trace 只通过 RequestContext::trace 传递
+  net::awaitable<Response> handleStreamAsync(Request header, BodyReader& body, RequestTrace* trace = nullptr);
+
+  // 读完请求头、读 body 之前调用, 决定 body 的读取方式。limit 为 0 时使用 HttpServerConfig::request_body_limit,
+  // Content-Length 超过上限的请求不读 body 直接回复 413
+  struct RouteInfo {
+    std::string_view pattern; // 匹配到的路由模式, 未匹配时为空; 指向 router_ 中的字符串
+    size_t id = SIZE_MAX; // Router::Route::id, 未匹配时为 SIZE_MAX
+    bool streaming = false;
+    uint64_t limit = 0;
+  };
+  virtual RouteInfo routeInfo(const Request& header) const;
+
+  // 返回 true 的请求会交给工作线程池处理, 不占用 io 线程 (同步的 mysql/redis/邮件调用等)
+  // 默认取 router_ 中对应路由的 blocking 标记
+  virtual bool isBlocking(const Request& req) const;
+
+  // 不需要执行处理函数就能确定的响应 (OPTIONS 预检, 未匹配路由的 404/405), HttpSession 直接写出预序列化的字节
+  // 返回 nullptr 时走 handleRequestAsync
+  virtual const StaticResponse* staticResponse(const Request& req) const;
+
+  // 准入控制中可以使用保留名额的轻量请求, 默认是不进线程池的非流式请求
+  virtual bool isLightweight(const Request& req) const;
+
+  // HttpServer 构造时设置; 线程池中排队超时的请求由 doHandleRequestAsync 直接返回 503
+  void setAdmissionController(AdmissionController* admission) { admission_ = admission; }
+
+  // 中间件: HttpSession 在请求交给处理函数之前 (占用准入名额、进入线程池之前) 在 io 线程上依次调用,
+  // 返回响应时直接回复, 不再调用处理函数。client 为对端地址。只能在构造时注册
+  using Middleware = std::function<std::optional<Response>(const Request& req, const net::ip::address& client)>;
+  void use(Middleware middleware) { middlewares_.push_back(std::move(middleware)); }
+  std::optional<Response> runMiddlewares(const Request& req, const net::ip::address& client) const;
+
+  // HttpServer 构造时设置: 第一次设置时在 path 上注册 GET 路由, 返回 source() 生成的 Prometheus 文本;
+  // 析构时传入空函数, 之后该路由返回 404
+  void setMetricsSource(std::string_view path, std::function<std::string()> source);
+
+  const Router& router() const { return router_; }
+
 protected:
-  virtual http::response<http::string_body> doHandleRequest(
-    http::request<http::string_body, http::basic_fields<std::allocator<char>>>&& req) = 0;
+  template<class Body, class Fields>
+  static void addCorsHeaders(http::response<Body, Fields>& res) {
+    // Allow-Methods/Allow-Headers 只在预检响应中有意义, 见 StaticResponseCache::preflight
+    res.set(http::field::access_control_allow_origin, "*");
+  }
+
+  // 默认按 router_ 分发, 未匹配时返回 404/405
+  virtual Response doHandleRequest(Request&& req);
+
+  // 协程版本, 可以 co_await 异步的 redis/mysql/grpc 调用。
+  // 默认实现适配同步的 doHandleRequest: isBlocking 的请求放到线程池执行 (排队时间记为 queue 阶段), 其余直接在 io 线程执行;
+  // 两种情况都在调用 doHandleRequest 期间设置 RequestArena::Scope 和 RequestTrace::Scope
+  virtual net::awaitable<Response> doHandleRequestAsync(
+    Request req, RequestTrace* trace);
+
+  // 在线程池中执行 f(), 协程挂起期间不占用 io 线程, 完成后回到协程原来的 executor 上继续
+  template <class F>
+  static net::awaitable<std::invoke_result_t<F&>> runBlocking(F f) {
+    using Result = std::invoke_result_t<F&>;
+    co_return co_await net::async_initiate<const net::use_awaitable_t<>&, void(std::exception_ptr, Result)>(
+      [&f](auto handler) {
+        ThreadPool::getInstance().commit([f = std::move(f), handler = std::move(handler)]() mutable {
+          std::exception_ptr ep;
+          Result result{};
+          try {
+            auto fn = std::move(f); // f 捕获的请求在回到 io 线程前析构, 之后连接可以复位 arena
+            result = fn();
+          } catch (...) {
+            ep = std::current_exception();
+          }
+          auto executor = net::get_associated_executor(handler);
+          net::dispatch(executor, [handler = std::move(handler), ep, result = std::move(result)]() mutable {
+            std::move(handler)(ep, std::move(result));
+          });
+        });
+      },
+      net::use_awaitable);
+  }
 
-  http::response<http::string_body> createJsonResponse(
+  // 响应从 RequestArena::current() 分配
+  Response createJsonResponse(
     http::status status, const nlohmann::json& json);
+
+  // write(JsonWriter&) 直接把 JSON 写进响应 body, 不构造 nlohmann::json
+  template <class F>
+  Response writeJsonResponse(http::status status, F&& write) {
+    Response res = newJsonResponse(status);
+    JsonWriter writer(res.body());
+    write(writer);
+    res.prepare_payload();
+    return res;
+  }
   
-  http::response<http::string_body> createErrorResponse(
+  Response createErrorResponse(
     http::status status, const std::string& message);
   
-  nlohmann::json parseRequestBody(const std::string& body);
+  // 构造完整的 nlohmann::json; 只读取几个字段时使用 JsonReader
+  nlohmann::json parseRequestBody(std::string_view body);
+
+  // 子类在构造函数中注册路由
+  Router router_;
+
+private:
+  static Response newJsonResponse(http::status status);
+
+  AdmissionController* admission_ = nullptr;
+  std::vector<Middleware> middlewares_;
+  std::function<std::string()> metrics_source_;
+  bool metrics_route_ = false;
 };
 
 }
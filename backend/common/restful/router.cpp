@@ -0,0 +1,181 @@
+#include "router.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace common {
+
+namespace {
+
+// 取出下一个非空路径段, rest 前进到该段之后
+std::string_view nextSegment(std::string_view& rest) {
+  while (!rest.empty() && rest.front() == '/') {
+    rest.remove_prefix(1);
+  }
+  auto slash = rest.find('/');
+  auto segment = rest.substr(0, slash);
+  rest.remove_prefix(segment.size());
+  return segment;
+}
+
+} // namespace
+
+std::string_view RouteParams::get(std::string_view name) const {
+  for (size_t i = 0; i < size_; ++i) {
+    if (items_[i].first == name) {
+      return items_[i].second;
+    }
+  }
+  return {};
+}
+
+std::optional<std::string_view> RequestContext::query(std::string_view name) const {
+  std::string_view rest = query_string;
+  while (!rest.empty()) {
+    auto amp = rest.find('&');
+    auto pair = rest.substr(0, amp);
+    rest = amp == std::string_view::npos ? std::string_view{} : rest.substr(amp + 1);
+
+    auto eq = pair.find('=');
+    if (pair.substr(0, eq) == name) {
+      return eq == std::string_view::npos ? std::string_view{} : pair.substr(eq + 1);
+    }
+  }
+  return std::nullopt;
+}
+
+Router& Router::add(http::verb method, std::string_view pattern, Handler handler, bool blocking,
+                    uint64_t body_limit) {
+  return addRoute(method, pattern, Route{.handler = std::move(handler), .blocking = blocking, .body_limit = body_limit});
+}
+
+Router& Router::addStream(http::verb method, std::string_view pattern, StreamHandler handler, uint64_t body_limit) {
+  return addRoute(method, pattern, Route{.stream_handler = std::move(handler), .body_limit = body_limit});
+}
+
+Router& Router::addRoute(http::verb method, std::string_view pattern, Route entry) {
+  Node* node = root_.get();
+  std::string normalized;
+  bool is_static = true;
+
+  std::string_view rest = pattern;
+  for (auto segment = nextSegment(rest); !segment.empty(); segment = nextSegment(rest)) {
+    normalized += '/';
+    normalized += segment;
+
+    if (segment.front() == '{' && segment.back() == '}') {
+      is_static = false;
+      std::string name(segment.substr(1, segment.size() - 2));
+      if (!node->param_child) {
+        node->param_child = std::make_unique<Node>();
+        node->param_child->param_name = name;
+      } else if (node->param_child->param_name != name) {
+        throw std::logic_error("Conflicting route parameter names at " + std::string(pattern));
+      }
+      node = node->param_child.get();
+      continue;
+    }
+
+    auto it = std::lower_bound(node->children.begin(), node->children.end(), segment,
+                               [](const auto& child, std::string_view value) { return child.first < value; });
+    if (it == node->children.end() || it->first != segment) {
+      it = node->children.emplace(it, std::string(segment), std::make_unique<Node>());
+    }
+    node = it->second.get();
+  }
+  if (normalized.empty()) {
+    normalized = "/";
+  }
+
+  for (const auto& [verb, route] : node->routes) {
+    if (verb == method) {
+      throw std::logic_error("Duplicate route: " + std::string(toStringView(http::to_string(method))) + " " + normalized);
+    }
+  }
+  entry.pattern = normalized;
+  entry.id = routes_.size();
+  routes_.emplace_back(method, normalized);
+  node->routes.emplace_back(method, std::move(entry));
+
+  node->allow.clear();
+  bool get = false, head = false;
+  for (const auto& [verb, route] : node->routes) {
+    node->allow += toStringView(http::to_string(verb));
+    node->allow += ", ";
+    get |= verb == http::verb::get;
+    head |= verb == http::verb::head;
+  }
+  if (get && !head) {
+    node->allow += "HEAD, ";
+  }
+  node->allow += "OPTIONS";
+
+  if (is_static) {
+    static_routes_[normalized] = node;
+  }
+  return *this;
+}
+
+const Router::Node* Router::find(const Node* node, std::string_view rest, RouteParams& params) const {
+  auto segment = nextSegment(rest);
+  if (segment.empty()) {
+    return node->routes.empty() ? nullptr : node;
+  }
+
+  auto it = std::lower_bound(node->children.begin(), node->children.end(), segment,
+                             [](const auto& child, std::string_view value) { return child.first < value; });
+  if (it != node->children.end() && it->first == segment) {
+    if (auto found = find(it->second.get(), rest, params)) {
+      return found;
+    }
+  }
+
+  if (node->param_child && params.size_ < RouteParams::kMaxParams) {
+    params.items_[params.size_++] = {node->param_child->param_name, segment};
+    if (auto found = find(node->param_child.get(), rest, params)) {
+      return found;
+    }
+    --params.size_; // 回溯
+  }
+  return nullptr;
+}
+
+Router::Match Router::match(http::verb method, std::string_view target) const {
+  Match result;
+  auto question = target.find('?');
+  result.path = target.substr(0, question);
+  if (question != std::string_view::npos) {
+    result.query_string = target.substr(question + 1);
+  }
+
+  const Node* node = nullptr;
+  if (auto it = static_routes_.find(result.path); it != static_routes_.end()) {
+    node = it->second;
+  } else {
+    node = find(root_.get(), result.path, result.params);
+  }
+  if (!node) {
+    return result;
+  }
+
+  const Route* get = nullptr;
+  for (const auto& [verb, route] : node->routes) {
+    if (verb == method) {
+      result.route = &route;
+      result.status = http::status::ok;
+      return result;
+    }
+    if (verb == http::verb::get) {
+      get = &route;
+    }
+  }
+  if (method == http::verb::head && get) {
+    result.route = get;
+    result.status = http::status::ok;
+    return result;
+  }
+  result.status = http::status::method_not_allowed;
+  result.allow = node->allow;
+  return result;
+}
+
+}
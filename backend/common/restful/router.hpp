@@ -0,0 +1,108 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/asio/awaitable.hpp>
+#include "common/restful/body_reader.hpp"
+#include "common/restful/http_types.hpp"
+#include "common/restful/request_trace.hpp"
+
+namespace common {
+
+// 路径参数: "/api/video/{id}" 匹配 "/api/video/42" 时 get("id") == "42", 值直接指向请求的 target
+class RouteParams {
+public:
+  static constexpr size_t kMaxParams = 8;
+
+  std::string_view get(std::string_view name) const;
+  size_t size() const { return size_; }
+
+private:
+  friend class Router;
+  std::array<std::pair<std::string_view, std::string_view>, kMaxParams> items_;
+  size_t size_ = 0;
+};
+
+struct RequestContext {
+  Request& req;
+  std::string_view path;
+  std::string_view query_string;
+  RouteParams params;
+  RequestTrace* trace = nullptr; // 本请求的 RequestTrace, 不记录时为 nullptr; 同步的处理函数中与 RequestTrace::current() 相同
+
+  std::string_view param(std::string_view name) const { return params.get(name); }
+  // 查询参数 "?a=1&b=2", 值未做百分号解码; 不存在时返回 nullopt, 只有键没有值时返回空串
+  std::optional<std::string_view> query(std::string_view name) const;
+};
+
+/*
+  按 (method, path) 分发请求的路由表, 启动时注册, 之后只读, 可被多个线程同时使用。
+  - 纯静态路径放在哈希表中, 一次查找命中
+  - 带 {param} 的路径放在按 '/' 分段的前缀树中, 同一层静态段优先于参数段
+  - 路径存在但方法不匹配时返回 405 及 Allow, 路径不存在时返回 404
+  - 没有单独注册 HEAD 时, HEAD 由同一路径的 GET 路由处理 (RFC 9110 9.3.2), 响应只写出头部
+  - 每个路由可以单独设置请求 body 的上限, 0 表示使用 HttpServerConfig::request_body_limit
+*/
+class Router {
+public:
+  using Handler = std::function<Response(RequestContext&)>;
+  // 流式路由的处理协程, ctx.req 只有请求头, body 通过 BodyReader 按块读取
+  using StreamHandler = std::function<net::awaitable<Response>(RequestContext&, BodyReader&)>;
+
+  struct Route {
+    Handler handler{};
+    StreamHandler stream_handler{}; // 非空时为流式路由, handler 为空
+    bool blocking = false; // 同 RestApiHandlerBase::isBlocking, 为 true 时在工作线程池执行
+    uint64_t body_limit = 0;
+    std::string pattern{}; // 注册时规范化的路径模式, 如 /api/videos/{id}, 用于访问日志
+    size_t id = 0; // 注册顺序, 即 routes() 中的下标, 用于按路由统计指标
+  };
+
+  struct Match {
+    const Route* route = nullptr;
+    http::status status = http::status::not_found; // route 为空时为 not_found 或 method_not_allowed
+    std::string_view allow; // method_not_allowed 时该路径支持的方法
+    RouteParams params;
+    std::string_view path;
+    std::string_view query_string;
+  };
+
+  Router() : root_(std::make_unique<Node>()) {}
+
+  Router& add(http::verb method, std::string_view pattern, Handler handler, bool blocking = false,
+             uint64_t body_limit = 0);
+  // body 不缓存在内存中, 由处理函数边读边处理 (如大文件上传), 处理协程运行在连接的 executor 上
+  Router& addStream(http::verb method, std::string_view pattern, StreamHandler handler, uint64_t body_limit = 0);
+  Match match(http::verb method, std::string_view target) const;
+  // 按注册顺序的 (方法, 规范化的路径模式)
+  const std::vector<std::pair<http::verb, std::string>>& routes() const { return routes_; }
+
+private:
+  struct Node {
+    std::vector<std::pair<std::string, std::unique_ptr<Node>>> children; // 静态段, 按字典序排列
+    std::unique_ptr<Node> param_child;
+    std::string param_name;
+    std::vector<std::pair<http::verb, Route>> routes;
+    std::string allow;
+  };
+
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+
+  Router& addRoute(http::verb method, std::string_view pattern, Route entry);
+  const Node* find(const Node* node, std::string_view rest, RouteParams& params) const;
+
+  std::unique_ptr<Node> root_;
+  std::unordered_map<std::string, const Node*, StringHash, std::equal_to<>> static_routes_;
+  std::vector<std::pair<http::verb, std::string>> routes_;
+};
+
+}
@@ -0,0 +1,85 @@
+#include "static_response.hpp"
+#include <mutex>
+#include <sstream>
+#include <nlohmann/json.hpp>
+#include "common/config/config.hpp"
+
+namespace common {
+
+namespace {
+
+std::string errorBody(const std::string& message) {
+  return nlohmann::json{{"success", false}, {"error", message}}.dump();
+}
+
+std::vector<std::pair<http::field, std::string>> preflightHeaders() {
+  const auto& cfg = config::Config::getInstance().getHttpServer();
+  return {
+    {http::field::access_control_allow_methods, "GET, POST, PUT, DELETE, OPTIONS"},
+    {http::field::access_control_allow_headers, "Content-Type, Authorization"},
+    {http::field::access_control_max_age, std::to_string(cfg.cors_max_age_seconds)},
+  };
+}
+
+} // namespace
+
+StaticResponse::StaticResponse(http::status status, std::string body,
+                               std::vector<std::pair<http::field, std::string>> headers)
+  : response_(status, 11) {
+  response_.set(http::field::access_control_allow_origin, "*");
+  if (!body.empty()) {
+    response_.set(http::field::content_type, "application/json");
+  }
+  for (const auto& [field, value] : headers) {
+    response_.set(field, value);
+  }
+  response_.body() = std::move(body);
+  if (status != http::status::no_content) { // 204 不能带 Content-Length
+    response_.prepare_payload();
+  }
+
+  std::ostringstream os;
+  os << response_;
+  wire_ = std::make_shared<const std::string>(os.str());
+}
+
+Response StaticResponse::toResponse(unsigned version, bool keep_alive) const {
+  Response response = response_;
+  response.version(version);
+  response.keep_alive(keep_alive);
+  return response;
+}
+
+StaticResponseCache& StaticResponseCache::getInstance() {
+  static StaticResponseCache instance;
+  return instance;
+}
+
+StaticResponseCache::StaticResponseCache()
+  : preflight_(http::status::no_content, "", preflightHeaders()),
+    not_found_(http::status::not_found, errorBody("Endpoint not found")),
+    service_unavailable_(http::status::service_unavailable, errorBody("Server is overloaded, please retry later"),
+                         {{http::field::retry_after,
+                           std::to_string(config::Config::getInstance().getHttpServer().admission_retry_after_seconds)}}),
+    payload_too_large_(http::status::payload_too_large, errorBody("Request body too large")) {}
+
+const StaticResponse& StaticResponseCache::methodNotAllowed(std::string_view allow) {
+  {
+    std::shared_lock lock(mutex_);
+    if (auto it = method_not_allowed_.find(allow); it != method_not_allowed_.end()) {
+      return *it->second;
+    }
+  }
+
+  std::unique_lock lock(mutex_);
+  auto it = method_not_allowed_.find(allow);
+  if (it == method_not_allowed_.end()) {
+    auto response = std::make_unique<StaticResponse>(
+      http::status::method_not_allowed, errorBody("Method not allowed"),
+      std::vector<std::pair<http::field, std::string>>{{http::field::allow, std::string(allow)}});
+    it = method_not_allowed_.emplace(std::string(allow), std::move(response)).first;
+  }
+  return *it->second;
+}
+
+}
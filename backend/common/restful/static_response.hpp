@@ -0,0 +1,67 @@
+#pragma once
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/asio/buffer.hpp>
+#include "common/restful/http_types.hpp"
+
+namespace common {
+
+/*
+  预先序列化好的完整 HTTP/1.1 响应 (状态行 + 头 + body), 构造后不可变, 所有连接共享同一份字节,
+  写出时直接 async_write(buffer()), 不再构造 json、设置头或 prepare_payload。
+  字节中不带 Connection 头, 只适用于 HTTP/1.1 keep-alive 的请求, 其他请求用 toResponse() 走普通路径。
+*/
+class StaticResponse {
+public:
+  StaticResponse(http::status status, std::string body,
+                 std::vector<std::pair<http::field, std::string>> headers = {});
+
+  http::status status() const { return response_.result(); }
+  boost::asio::const_buffer buffer() const { return boost::asio::buffer(*wire_); }
+
+  // 同样内容的普通响应, 用于 HTTP/1.0、Connection: close 或需要继续修改响应的场景
+  Response toResponse(unsigned version, bool keep_alive) const;
+
+private:
+  Response response_;
+  std::shared_ptr<const std::string> wire_;
+};
+
+// 进程内共享的预序列化响应: CORS 预检、未匹配路由的 404、按 Allow 区分的 405、body 超限的 413 和过载时的 503
+class StaticResponseCache {
+public:
+  static StaticResponseCache& getInstance();
+
+  const StaticResponse& preflight() const { return preflight_; }
+  const StaticResponse& notFound() const { return not_found_; }
+  // 准入控制拒绝的请求, 带 Retry-After
+  const StaticResponse& serviceUnavailable() const { return service_unavailable_; }
+  // 请求 body 超过上限; 未读的 body 留在连接上, 总是以 toResponse(version, false) 回复后关闭
+  const StaticResponse& payloadTooLarge() const { return payload_too_large_; }
+  // allow 取自 Router 中节点预先拼好的字符串, 种类有限, 首次出现时序列化并缓存
+  const StaticResponse& methodNotAllowed(std::string_view allow);
+
+private:
+  StaticResponseCache();
+  StaticResponseCache(const StaticResponseCache&) = delete;
+  StaticResponseCache& operator=(const StaticResponseCache&) = delete;
+
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+  };
+
+  StaticResponse preflight_;
+  StaticResponse not_found_;
+  StaticResponse service_unavailable_;
+  StaticResponse payload_too_large_;
+  std::shared_mutex mutex_;
+  std::unordered_map<std::string, std::unique_ptr<StaticResponse>, StringHash, std::equal_to<>> method_not_allowed_;
+};
+
+}
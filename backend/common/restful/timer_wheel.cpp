@@ -0,0 +1,72 @@
+#include "timer_wheel.hpp"
+#include <algorithm>
+
+namespace common {
+
+TimerWheel::TimerWheel(uint64_t now) : current_(now) {
+  for (auto& head : slots_) {
+    head.prev_ = head.next_ = &head;
+  }
+}
+
+void TimerWheel::schedule(Entry& entry, uint64_t expires) {
+  if (entry.scheduled()) {
+    unlink(entry);
+    --size_;
+  }
+  // 当前 tick 的槽已经处理过, 放进去要等一圈
+  entry.expires_ = std::max(expires, current_ + 1);
+  insert(entry);
+  ++size_;
+}
+
+void TimerWheel::cancel(Entry& entry) {
+  if (entry.scheduled()) {
+    unlink(entry);
+    --size_;
+  }
+}
+
+void TimerWheel::insert(Entry& entry) {
+  uint64_t delta = entry.expires_ - current_;
+  size_t level = 0;
+  while (level + 1 < kLevels && delta >= (uint64_t{1} << (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+  // 超出最高层范围的条目放在最高层, 所在槽被重新分配时再按剩余时间放置
+  size_t index = (entry.expires_ >> (kSlotBits * level)) & (kSlots - 1);
+  link(slot(level, index), entry);
+}
+
+void TimerWheel::cascade(size_t level) {
+  Entry& head = slot(level, (current_ >> (kSlotBits * level)) & (kSlots - 1));
+  if (head.next_ == &head) {
+    return;
+  }
+  // 先摘下整条链表, 重新插入时可能落回同一个槽 (最高层中超出范围的条目)
+  Entry* entry = head.next_;
+  head.prev_->next_ = nullptr;
+  head.prev_ = head.next_ = &head;
+  while (entry) {
+    Entry* next = entry->next_;
+    entry->prev_ = entry->next_ = nullptr;
+    // 到期时间不早于 current_: 本 tick 到期的条目落在即将处理的最低层槽中
+    insert(*entry);
+    entry = next;
+  }
+}
+
+void TimerWheel::link(Entry& head, Entry& entry) {
+  entry.prev_ = head.prev_;
+  entry.next_ = &head;
+  head.prev_->next_ = &entry;
+  head.prev_ = &entry;
+}
+
+void TimerWheel::unlink(Entry& entry) {
+  entry.prev_->next_ = entry.next_;
+  entry.next_->prev_ = entry.prev_;
+  entry.prev_ = entry.next_ = nullptr;
+}
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace common {
+
+/*
+  分层时间轮: kLevels 层, 每层 kSlots 个槽, 第 n 层一个槽覆盖 kSlots^n 个 tick。
+  - 调度、取消都是 O(1) 的链表操作, 计时器不分配内存 (Entry 嵌入在使用者中)
+  - advance 每个 tick 只处理一个最低层的槽, 低层转完一圈时把上一层对应槽中的条目重新分配到下层
+  - 精度为一个 tick, 到期回调在到期的 tick 或之后调用, 不会提前
+  不加锁, 由使用者保证同一时刻只有一个线程访问
+*/
+class TimerWheel {
+public:
+  static constexpr unsigned kSlotBits = 6;
+  static constexpr size_t kSlots = size_t{1} << kSlotBits;
+  static constexpr size_t kLevels = 4; // 可直接表示 kSlots^4 (约 1677 万) 个 tick 内的到期时间, 更远的到时再重新分配
+
+  class Entry {
+  public:
+    Entry() = default;
+    Entry(const Entry&) = delete;
+    Entry& operator=(const Entry&) = delete;
+
+    bool scheduled() const { return next_ != nullptr; }
+    uint64_t expires() const { return expires_; }
+
+  private:
+    friend class TimerWheel;
+    Entry* prev_ = nullptr;
+    Entry* next_ = nullptr;
+    uint64_t expires_ = 0;
+  };
+
+  explicit TimerWheel(uint64_t now = 0);
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // 在第 expires 个 tick 到期; 已调度的先取消。不晚于当前 tick 的在下一个 tick 到期
+  void schedule(Entry& entry, uint64_t expires);
+  void cancel(Entry& entry);
+
+  // 推进到第 now 个 tick, 对每个到期的条目调用 on_expired(Entry&)。
+  // 调用前条目已移出时间轮, 回调中可以重新调度它或操作其他条目
+  template <class F>
+  void advance(uint64_t now, F&& on_expired);
+
+  uint64_t now() const { return current_; }
+  size_t size() const { return size_; }
+
+private:
+  Entry& slot(size_t level, size_t index) { return slots_[level * kSlots + index]; }
+  // 按到期时间与 current_ 的差值放入对应层的槽
+  void insert(Entry& entry);
+  // 当前 tick 是第 level 层某个槽的起点时, 把该槽中的条目重新分配到下层
+  void cascade(size_t level);
+  static void link(Entry& head, Entry& entry);
+  static void unlink(Entry& entry);
+
+  std::array<Entry, kLevels * kSlots> slots_; // 各槽的循环链表头
+  uint64_t current_;
+  size_t size_ = 0;
+};
+
+template <class F>
+void TimerWheel::advance(uint64_t now, F&& on_expired) {
+  while (current_ < now) {
+    ++current_;
+    for (size_t level = kLevels - 1; level > 0; --level) {
+      if ((current_ & ((uint64_t{1} << (kSlotBits * level)) - 1)) == 0) {
+        cascade(level);
+      }
+    }
+
+    Entry& head = slot(0, current_ & (kSlots - 1));
+    while (head.next_ != &head) {
+      Entry& entry = *head.next_;
+      unlink(entry);
+      --size_;
+      on_expired(entry);
+    }
+  }
+}
+
+}
@@ -0,0 +1,238 @@
+#include "tls_context.hpp"
+#ifdef ENABLE_TLS
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <openssl/err.h>
+#include "common/logging/access_log.hpp"
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+namespace common {
+
+namespace {
+
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+constexpr bool kKtlsBuilt = true;
+#else
+constexpr bool kKtlsBuilt = false;
+#endif
+
+constexpr size_t kTicketKeyBytes = 80; // 16 字节名称 + 32 字节 HMAC 密钥 + 32 字节 AES 密钥
+constexpr unsigned char kSessionIdContext[] = "common::HttpServer";
+
+// 内核是否支持 kTLS: 在一对回环连接上设置 TCP_ULP "tls", 没有加载 tls 模块时失败
+bool kernelSupportsTls() {
+  int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+  int client = ::socket(AF_INET, SOCK_STREAM, 0);
+  int server = -1;
+  bool supported = false;
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(addr);
+  if (listener >= 0 && client >= 0 && ::bind(listener, reinterpret_cast<sockaddr*>(&addr), len) == 0 &&
+      ::listen(listener, 1) == 0 && ::getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) == 0 &&
+      ::connect(client, reinterpret_cast<sockaddr*>(&addr), len) == 0 &&
+      (server = ::accept(listener, nullptr, nullptr)) >= 0) {
+    supported = ::setsockopt(server, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0;
+  }
+  for (int fd : {listener, client, server}) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  return supported;
+}
+
+std::string lastError() {
+  char buffer[256];
+  ERR_error_string_n(ERR_get_error(), buffer, sizeof(buffer));
+  return buffer;
+}
+
+} // namespace
+
+std::shared_ptr<TlsContext> TlsContext::get(const config::HttpServerConfig& cfg) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<TlsContext>> cache;
+  std::string key = cfg.tls_cert_file + '\n' + cfg.tls_key_file + '\n' + cfg.tls_ticket_key_file + '\n' +
+                    std::to_string(cfg.tls_session_cache_size) + '\n' +
+                    std::to_string(cfg.tls_session_timeout_seconds) + '\n' + (cfg.tls_ktls ? "k" : "-") +
+                    (cfg.http2 ? "h" : "-");
+  std::lock_guard lock(mutex);
+  auto& entry = cache[key];
+  auto context = entry.lock();
+  if (!context) {
+    context = std::make_shared<TlsContext>(cfg);
+    entry = context;
+  }
+  return context;
+}
+
+TlsContext::TlsContext(const config::HttpServerConfig& cfg) : context_(boost::asio::ssl::context::tls_server) {
+  namespace ssl = boost::asio::ssl;
+#ifdef ENABLE_HTTP2
+  http2_ = cfg.http2;
+#endif
+  SSL_CTX* ctx = context_.native_handle();
+  SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+  context_.set_options(ssl::context::default_workarounds | ssl::context::single_dh_use | SSL_OP_NO_RENEGOTIATION);
+  SSL_CTX_set_mode(ctx, SSL_MODE_RELEASE_BUFFERS);
+  context_.use_certificate_chain_file(cfg.tls_cert_file);
+  context_.use_private_key_file(cfg.tls_key_file, ssl::context::pem);
+  if (SSL_CTX_check_private_key(ctx) != 1) {
+    throw std::runtime_error("TLS private key does not match certificate: " + cfg.tls_key_file);
+  }
+
+  // 会话缓存在所有线程间共享 (OpenSSL 内部加锁); 票据默认启用, 客户端不支持票据时才用到缓存
+  SSL_CTX_set_session_id_context(ctx, kSessionIdContext, sizeof(kSessionIdContext) - 1);
+  SSL_CTX_set_timeout(ctx, cfg.tls_session_timeout_seconds);
+  if (cfg.tls_session_cache_size > 0) {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, static_cast<long>(cfg.tls_session_cache_size));
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  }
+  if (!cfg.tls_ticket_key_file.empty()) {
+    loadTicketKeys(cfg.tls_ticket_key_file);
+  }
+
+  SSL_CTX_set_alpn_select_cb(
+    ctx,
+    [](SSL*, const unsigned char** out, unsigned char* out_len, const unsigned char* in, unsigned int in_len,
+       void* arg) {
+      static constexpr unsigned char kH2[] = "\x02h2\x08http/1.1";
+      static constexpr unsigned char kHttp11[] = "\x08http/1.1";
+      bool h2 = static_cast<TlsContext*>(arg)->http2_;
+      auto* selected = const_cast<unsigned char**>(out);
+      int result = h2 ? SSL_select_next_proto(selected, out_len, kH2, sizeof(kH2) - 1, in, in_len)
+                      : SSL_select_next_proto(selected, out_len, kHttp11, sizeof(kHttp11) - 1, in, in_len);
+      return result == OPENSSL_NPN_NEGOTIATED ? SSL_TLSEXT_ERR_OK : SSL_TLSEXT_ERR_NOACK;
+    },
+    this);
+
+  if (cfg.tls_ktls) {
+    if (!kKtlsBuilt) {
+      AccessLog::getInstance().event(AccessLog::Level::warn, "kTLS disabled", "OpenSSL built without kTLS");
+    } else if (!kernelSupportsTls()) {
+      AccessLog::getInstance().event(AccessLog::Level::warn, "kTLS disabled", "kernel tls module not available");
+    } else {
+      kernel_tls_ = true;
+#if defined(SSL_OP_ENABLE_KTLS)
+      context_.set_options(SSL_OP_ENABLE_KTLS);
+#endif
+      // 只协商内核能加解密的套件
+#if OPENSSL_VERSION_NUMBER < 0x30200000L
+      SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+#endif
+      SSL_CTX_set_cipher_list(ctx, "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+                                   "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384");
+      SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384");
+    }
+  }
+}
+
+void TlsContext::loadTicketKeys(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::string keys((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (!in.good() && !in.eof()) {
+    throw std::runtime_error("Failed to read TLS ticket key file: " + path);
+  }
+  if (keys.size() != kTicketKeyBytes) {
+    throw std::runtime_error("TLS ticket key file must be " + std::to_string(kTicketKeyBytes) + " bytes: " + path);
+  }
+  if (SSL_CTX_set_tlsext_ticket_keys(context_.native_handle(), keys.data(), keys.size()) != 1) {
+    throw std::runtime_error("Failed to set TLS ticket keys: " + lastError());
+  }
+}
+
+uint64_t TlsContext::handshakes() const {
+  return static_cast<uint64_t>(SSL_CTX_sess_accept_good(const_cast<boost::asio::ssl::context&>(context_).native_handle()));
+}
+
+uint64_t TlsContext::resumed() const {
+  return static_cast<uint64_t>(SSL_CTX_sess_hits(const_cast<boost::asio::ssl::context&>(context_).native_handle()));
+}
+
+KernelTlsHandshake::KernelTlsHandshake(TlsContext& context, int fd) : ssl_(SSL_new(context.context().native_handle())) {
+  // SSL_set_fd 创建的 socket BIO 不关闭 fd
+  if (ssl_ && SSL_set_fd(ssl_, fd) != 1) {
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+  }
+}
+
+KernelTlsHandshake::~KernelTlsHandshake() {
+  if (ssl_) {
+    // 之后由内核收发, 连接关闭时不会经过 OpenSSL; 标记为已关闭, 否则释放时会话被从缓存中删除
+    if (SSL_is_init_finished(ssl_)) {
+      SSL_set_shutdown(ssl_, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+    SSL_free(ssl_);
+  }
+}
+
+KernelTlsHandshake::Step KernelTlsHandshake::step() {
+  if (!ssl_) {
+    error_ = "SSL_new failed";
+    return Step::failed;
+  }
+  ERR_clear_error();
+  errno = 0;
+  int result = SSL_accept(ssl_);
+  if (result == 1) {
+    return Step::done;
+  }
+  switch (SSL_get_error(ssl_, result)) {
+    case SSL_ERROR_WANT_READ:
+      return Step::want_read;
+    case SSL_ERROR_WANT_WRITE:
+      return Step::want_write;
+    case SSL_ERROR_SYSCALL:
+      error_ = errno ? std::string(std::strerror(errno)) : "connection closed";
+      return Step::failed;
+    default:
+      error_ = lastError();
+      return Step::failed;
+  }
+}
+
+void sendKernelTlsCloseNotify(int fd) {
+  unsigned char alert[2] = {1, 0}; // warning, close_notify
+  iovec iov{alert, sizeof(alert)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(unsigned char))] = {};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_TLS;
+  cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+  *CMSG_DATA(cmsg) = 21; // 记录类型: alert
+  ::sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+bool KernelTlsHandshake::offloaded() const {
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+  return ssl_ && BIO_get_ktls_send(SSL_get_wbio(ssl_)) && BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+#else
+  return false;
+#endif
+}
+
+}
+#endif
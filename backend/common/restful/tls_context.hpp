@@ -0,0 +1,74 @@
+#pragma once
+// 以 ENABLE_TLS 编译时才需要 OpenSSL, 见 CMakeLists.txt 的 ENABLE_TLS 选项
+#ifdef ENABLE_TLS
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <boost/asio/ssl.hpp>
+#include "common/config/config.hpp"
+
+namespace common {
+
+/*
+  HttpServer 的 TLS 配置: 证书链和私钥只在创建时读取一次, 所有线程、所有连接共用一个 SSL_CTX。
+  - 服务端会话缓存和会话票据都在 SSL_CTX 中, 同一进程的所有线程共享, 回访的客户端 (TLS 1.2 会话 id 或票据, TLS 1.3 票据)
+    只做简短握手; cfg.tls_ticket_key_file 时票据密钥从文件读取, 多个进程、热重启前后签发的票据互相通用
+  - 空闲的 keep-alive 连接释放 OpenSSL 的读写缓冲 (SSL_MODE_RELEASE_BUFFERS), 大量空闲连接时每个省下约 34KB
+  - ALPN: cfg.http2 且以 ENABLE_HTTP2 编译时优先选择 h2, 否则 http/1.1
+  - cfg.tls_ktls 时握手直接在 socket 上进行 (见 KernelTlsHandshake), OpenSSL 在握手完成后把两个方向的记录层交给内核 (kTLS),
+    之后连接按明文 socket 读写, 响应 (包括文件) 由内核加密, 不再经过 OpenSSL 的缓冲。OpenSSL 3.2 之前内核不能接收
+    TLS 1.3 的记录, 此时最高协商 TLS 1.2; OpenSSL 没有编译 kTLS 或内核没有 tls 模块时记录警告, 退回 asio::ssl
+*/
+class TlsContext {
+public:
+  // 按证书、私钥和选项缓存: 同一进程中的多个 HttpServer (以及重复创建的) 共用同一个 TlsContext 和其中的会话缓存;
+  // 文件读取或校验失败时抛出 std::runtime_error
+  static std::shared_ptr<TlsContext> get(const config::HttpServerConfig& cfg);
+
+  explicit TlsContext(const config::HttpServerConfig& cfg);
+  TlsContext(const TlsContext&) = delete;
+  TlsContext& operator=(const TlsContext&) = delete;
+
+  boost::asio::ssl::context& context() { return context_; }
+  // 是否以 kTLS 模式接受连接
+  bool kernelTls() const { return kernel_tls_; }
+
+  // 完成的握手数, 以及其中恢复会话 (会话缓存或票据) 的次数
+  uint64_t handshakes() const;
+  uint64_t resumed() const;
+
+private:
+  void loadTicketKeys(const std::string& path);
+
+  boost::asio::ssl::context context_;
+  bool kernel_tls_ = false;
+  bool http2_ = false;
+};
+
+// kTLS 模式的握手: OpenSSL 直接读写 (非阻塞的) socket, 需要等待时由调用方等 socket 可读或可写后再次调用 step
+class KernelTlsHandshake {
+public:
+  enum class Step { done, want_read, want_write, failed };
+
+  // 不接管 fd, 析构时不关闭
+  KernelTlsHandshake(TlsContext& context, int fd);
+  ~KernelTlsHandshake();
+  KernelTlsHandshake(const KernelTlsHandshake&) = delete;
+  KernelTlsHandshake& operator=(const KernelTlsHandshake&) = delete;
+
+  Step step();
+  // 握手完成后收发是否都已交给内核; 否则连接不能按明文 socket 使用
+  bool offloaded() const;
+  // failed 时的原因
+  std::string error() const { return error_; }
+
+private:
+  SSL* ssl_;
+  std::string error_;
+};
+
+// kTLS 模式的连接关闭前发送 close_notify 告警 (由内核加密成告警记录); 尽力而为, 发送失败时忽略
+void sendKernelTlsCloseNotify(int fd);
+
+}
+#endif
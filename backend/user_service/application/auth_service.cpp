@@ -1,6 +1,10 @@
 #include "auth_service.hpp"
 #include "common/config/config.hpp"
-#include "common/connection_pool/redis_connection_pool.hpp"
+#include "common/connection_pool/redis_script.hpp"
+#include "common/connection_pool/sharded_redis_client.hpp"
+#include "common/logging/access_log.hpp"
+#include "common/restful/request_trace.hpp"
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <expected>
@@ -11,30 +15,38 @@
 
 namespace user_service {
 
-std::expected<std::string, std::string> AuthService::sendAndSaveEmailVerificationCode(const std::string& email, const std::string& type) {
+std::expected<std::string, VerificationCodeError> AuthService::sendAndSaveEmailVerificationCode(const std::string& email, const std::string& type) {
   if (!std::regex_match(email, email_pattern_)){
-    return std::unexpected("Email format invalid");
+    return std::unexpected(VerificationCodeError{"Email format invalid"});
   }
   if (type == "register"){
     if (repository_->findByEmail(email)){
-      return std::unexpected("Email already exists");
+      return std::unexpected(VerificationCodeError{"Email already exists"});
     }
   }
   auto res_code = generateVerificationCode(email);
   if (!res_code){
-    return std::unexpected("failed to generate verification code: " + res_code.error());
+    return std::unexpected(VerificationCodeError{"failed to generate verification code: " + res_code.error()});
   }
   std::string code = res_code.value();
-  auto res = sendEmailVerificationCode(email, code);
-  if (!res){
-    return std::unexpected("failed to send verification code: " + res.error());
-  }else{
-    res = saveVerificationCodeToRedis(email, code, type);
-    if (!res){
-      return std::unexpected("failed to save verification code: " + res.error());
+  // 先在redis中登记(同时检查发送频率), 再发送邮件; 发送失败时作废该验证码
+  auto issued = issueVerificationCode(email, code, type);
+  if (!issued){
+    if (issued.error().retry_after.count() == 0) {
+      issued.error().message = "failed to save verification code: " + issued.error().message;
     }
-    return code;
+    return std::unexpected(std::move(issued.error()));
   }
+  auto sent = sendEmailVerificationCode(email, code);
+  if (!sent){
+    // 作废失败时没有发出的验证码在有效期内仍然可用, 记录下来
+    if (auto discarded = discardVerificationCode(email, type); !discarded) {
+      common::AccessLog::getInstance().event(common::AccessLog::Level::error, "failed to discard verification code",
+                                             type + " " + email + ": " + discarded.error());
+    }
+    return std::unexpected(VerificationCodeError{"failed to send verification code: " + sent.error()});
+  }
+  return code;
 }
 
 std::expected<std::string, std::string> AuthService::generateVerificationCode(const std::string& email){
@@ -56,59 +68,180 @@ std::expected<std::string, std::string> AuthService::generateVerificationCode(co
   return code;
 }
 
-std::expected<void, std::string> AuthService::saveVerificationCodeToRedis(const std::string& email, const std::string& code, const std::string& type){
-  common::RedisConnectionGuard conn_guard(common::RedisConnectionPool::getInstance());
-  std::string command = std::format("SETEX {}:email_vericode:{} 300 {}", type, email, code);
-  redisReply *reply = (redisReply*)redisCommand(conn_guard.get(), command.c_str());
-
+namespace {
+
+// KEYS[1] 验证码 KEYS[2] 窗口内发送次数 KEYS[3] 输错次数
+// ARGV[1] 新验证码 ARGV[2] 有效期(s) ARGV[3] 重发间隔(s) ARGV[4] 窗口内最多发送次数 ARGV[5] 窗口长度(s)
+// 返回 {状态, 需等待的秒数}, 状态 1: 已保存; -1: 距上次发送不足重发间隔; -2: 窗口内发送次数已用完
+constexpr const char* kIssueVerificationCodeScript = R"lua(
+local ttl = redis.call('TTL', KEYS[1])
+local elapsed = tonumber(ARGV[2]) - ttl
+if ttl > 0 and elapsed < tonumber(ARGV[3]) then
+  return {-1, tonumber(ARGV[3]) - elapsed}
+end
+local sent = tonumber(redis.call('GET', KEYS[2]) or '0')
+if sent >= tonumber(ARGV[4]) then
+  return {-2, math.max(redis.call('TTL', KEYS[2]), 1)}
+end
+redis.call('SET', KEYS[1], ARGV[1], 'EX', ARGV[2])
+redis.call('DEL', KEYS[3])
+if redis.call('INCR', KEYS[2]) == 1 then
+  redis.call('EXPIRE', KEYS[2], ARGV[5])
+end
+return {1, 0}
+)lua";
+
+// KEYS[1] 验证码 KEYS[2] 输错次数
+// ARGV[1] 提交的验证码 ARGV[2] 允许输错的次数
+// 返回 1: 正确, 验证码已删除; 0: 错误; -1: 没有验证码; -2: 输错次数用尽, 验证码已作废
+constexpr const char* kConsumeVerificationCodeScript = R"lua(
+local code = redis.call('GET', KEYS[1])
+if not code then
+  return -1
+end
+if code == ARGV[1] then
+  redis.call('DEL', KEYS[1], KEYS[2])
+  return 1
+end
+local attempts = redis.call('INCR', KEYS[2])
+if attempts == 1 then
+  redis.call('EXPIRE', KEYS[2], math.max(redis.call('TTL', KEYS[1]), 1))
+end
+if attempts >= tonumber(ARGV[2]) then
+  redis.call('DEL', KEYS[1], KEYS[2])
+  return -2
+end
+return 0
+)lua";
+
+// 解析脚本返回的整数, 出错时返回错误信息
+std::expected<long long, std::string> scriptResult(redisReply* reply) {
   if (reply == nullptr) {
     return std::unexpected("redisCommand returned nullptr. Connection may be lost.");
   }
-
-  bool success = false;
-  std::string error_msg;
-
-  if (reply->type == REDIS_REPLY_STATUS && strcmp(reply->str, "OK") == 0) {
-    success = true;
+  std::expected<long long, std::string> result;
+  if (reply->type == REDIS_REPLY_INTEGER) {
+    result = reply->integer;
   } else if (reply->type == REDIS_REPLY_ERROR) {
-    error_msg = "Redis error: " + std::string(reply->str, reply->len);
+    result = std::unexpected("Redis error: " + std::string(reply->str, reply->len));
   } else {
-    error_msg = "Unexpected Redis reply type: " + std::to_string(reply->type);
+    result = std::unexpected("Unexpected Redis reply type: " + std::to_string(reply->type));
   }
-
   freeReplyObject(reply);
-
-  if (success) {
-    return {};
-  } else {
-    return std::unexpected(error_msg);
-  }
+  return result;
 }
 
-std::expected<std::string, std::string> AuthService::loadVerificationCodeFromRedis(const std::string& email, const std::string& type){
-  common::RedisConnectionGuard conn_guard(common::RedisConnectionPool::getInstance());
-  std::string command = std::format("GET {}:email_vericode:{}", type, email);
-  redisReply *reply = (redisReply*)redisCommand(conn_guard.get(), command.c_str());
-
+// 解析脚本返回的 {状态, 秒数}
+std::expected<std::pair<long long, long long>, std::string> scriptStatus(redisReply* reply) {
   if (reply == nullptr) {
     return std::unexpected("redisCommand returned nullptr. Connection may be lost.");
   }
-
-  std::expected<std::string, std::string> result;
-  if (reply->type == REDIS_REPLY_NIL) {
-    result = std::unexpected("no verification code for email: " + email);
-  } else if (reply->type == REDIS_REPLY_STRING) {
-    result = std::string(reply->str, reply->len);
+  std::expected<std::pair<long long, long long>, std::string> result;
+  if (reply->type == REDIS_REPLY_ARRAY && reply->elements == 2 && reply->element[0]->type == REDIS_REPLY_INTEGER &&
+      reply->element[1]->type == REDIS_REPLY_INTEGER) {
+    result = std::pair{reply->element[0]->integer, reply->element[1]->integer};
   } else if (reply->type == REDIS_REPLY_ERROR) {
     result = std::unexpected("Redis error: " + std::string(reply->str, reply->len));
   } else {
     result = std::unexpected("Unexpected Redis reply type: " + std::to_string(reply->type));
   }
-
   freeReplyObject(reply);
   return result;
 }
 
+} // namespace
+
+std::string AuthService::verificationCodeKey(const std::string& email, const std::string& type, const std::string& suffix){
+  // 以邮箱作为 hash tag, 同一邮箱的验证码相关 key 落在同一个 redis 分片, 脚本才能同时操作它们
+  return std::format("{}:email_vericode{}:{{{}}}", type, suffix, email);
+}
+
+std::expected<void, VerificationCodeError> AuthService::issueVerificationCode(const std::string& email, const std::string& code, const std::string& type){
+  const auto& auth = config::Config::getInstance().getAuth();
+  static const auto& script = common::RedisScriptRegistry::getInstance().registerScript(
+    "issue_verification_code", kIssueVerificationCodeScript);
+
+  std::vector<std::string> keys = {
+    verificationCodeKey(email, type),
+    verificationCodeKey(email, type, "_sent"),
+    verificationCodeKey(email, type, "_attempts"),
+  };
+  std::vector<std::string> args = {
+    code,
+    std::to_string(auth.vericode_expire_seconds),
+    std::to_string(auth.vericode_resend_seconds),
+    std::to_string(auth.vericode_max_sends),
+    std::to_string(auth.vericode_send_window_seconds),
+  };
+
+  common::TraceSpan redis_span("redis");
+  auto res = scriptStatus(common::ShardedRedisClient::getInstance().withConnection(keys[0], [&](redisContext* ctx) {
+    return script.eval(ctx, keys, args);
+  }));
+  redis_span.end();
+  if (!res) {
+    return std::unexpected(VerificationCodeError{res.error()});
+  }
+  auto [status, wait_seconds] = res.value();
+  std::chrono::seconds retry_after(std::max<long long>(wait_seconds, 1));
+  switch (status) {
+    case 1:
+      return {};
+    case -1:
+      return std::unexpected(VerificationCodeError{"please wait before requesting another verification code", retry_after});
+    case -2:
+      return std::unexpected(VerificationCodeError{"too many verification codes requested, try again later", retry_after});
+    default:
+      return std::unexpected(VerificationCodeError{"Unexpected script result: " + std::to_string(status)});
+  }
+}
+
+std::expected<void, std::string> AuthService::discardVerificationCode(const std::string& email, const std::string& type){
+  std::string key = verificationCodeKey(email, type);
+  common::TraceSpan redis_span("redis");
+  redisReply *reply = common::ShardedRedisClient::getInstance().withConnection(key, [&](redisContext* ctx) {
+    return (redisReply*)redisCommand(ctx, "DEL %s", key.c_str());
+  });
+  auto res = scriptResult(reply);
+  if (!res) {
+    return std::unexpected(res.error());
+  }
+  return {};
+}
+
+std::expected<void, std::string> AuthService::consumeVerificationCode(const std::string& email, const std::string& code, const std::string& type){
+  const auto& auth = config::Config::getInstance().getAuth();
+  static const auto& script = common::RedisScriptRegistry::getInstance().registerScript(
+    "consume_verification_code", kConsumeVerificationCodeScript);
+
+  std::vector<std::string> keys = {
+    verificationCodeKey(email, type),
+    verificationCodeKey(email, type, "_attempts"),
+  };
+  std::vector<std::string> args = {code, std::to_string(auth.vericode_max_attempts)};
+
+  common::TraceSpan redis_span("redis");
+  auto res = scriptResult(common::ShardedRedisClient::getInstance().withConnection(keys[0], [&](redisContext* ctx) {
+    return script.eval(ctx, keys, args);
+  }));
+  redis_span.end();
+  if (!res) {
+    return std::unexpected("failed to check verification code: " + res.error());
+  }
+  switch (res.value()) {
+    case 1:
+      return {};
+    case 0:
+      return std::unexpected("verification code wrong");
+    case -1:
+      return std::unexpected("verification code not prepared");
+    case -2:
+      return std::unexpected("too many wrong attempts, request a new verification code");
+    default:
+      return std::unexpected("Unexpected script result: " + std::to_string(res.value()));
+  }
+}
+
 std::expected<std::tuple<std::string, User>, std::string> AuthService::registerAndStore(const std::string& email,
                                                                                        const std::string& vericode,
                                                                                        const std::string& username,
@@ -117,21 +250,16 @@ std::expected<std::tuple<std::string, User>, std::string> AuthService::registerA
   if (repository_->findByEmail(email)){
     return std::unexpected("Email already exists");
   }
-  auto code_res = loadVerificationCodeFromRedis(email, "register");
+  auto code_res = consumeVerificationCode(email, vericode, "register");
   if (!code_res){
-    if (code_res.error() == "no verification code for email"){
-      return std::unexpected("verification code not prepared");
-    }
-    return std::unexpected("failed to get verification code from database: " + code_res.error());
-  }
-  if (code_res.value() != vericode){
-    return std::unexpected("verification code wrong");
+    return std::unexpected(code_res.error());
   }
   uuid_t uuid;
   uuid_generate(uuid);
   char uuid_str[37];
   uuid_unparse(uuid, uuid_str);
 
+  common::TraceSpan hash_span("hash");
   unsigned char salt[16];
   if (RAND_bytes(salt, sizeof(salt)) != 1) {
     return std::unexpected("Failed to generate salt");
@@ -160,6 +288,7 @@ std::expected<std::tuple<std::string, User>, std::string> AuthService::registerA
     snprintf(hex, sizeof(hex), "%02x", hash[i]);
     hash_str += hex;
   }
+  hash_span.end();
 
   User user(uuid_str, email, username, hash_str, salt_str, avatar);
   if (!repository_->save(user)) {
@@ -172,15 +301,9 @@ std::expected<std::tuple<std::string, User>, std::string> AuthService::registerA
 
 std::expected<std::tuple<std::string, User>, std::string> AuthService::loginEmailVeriCode(const std::string& email,
                                                                                          const std::string& code) {
-  auto code_res = loadVerificationCodeFromRedis(email, "login");
+  auto code_res = consumeVerificationCode(email, code, "login");
   if (!code_res){
-    if (code_res.error() == "no verification code for email"){
-      return std::unexpected("verification code not prepared");
-    }
-    return std::unexpected("failed to get verification code from database: " + code_res.error());
-  }
-  if (code_res.value() != code){
-    return std::unexpected("verification code wrong");
+    return std::unexpected(code_res.error());
   }
 
   auto user_opt = repository_->findByEmail(email);
@@ -201,6 +324,7 @@ std::expected<std::tuple<std::string, User>, std::string> AuthService::loginEmai
   }
 
   auto user = user_opt.value();
+  common::TraceSpan hash_span("hash");
   std::string salted_password = password + user.salt();
   unsigned char hash[EVP_MAX_MD_SIZE];
   unsigned int hash_len;
@@ -217,6 +341,7 @@ std::expected<std::tuple<std::string, User>, std::string> AuthService::loginEmai
     snprintf(hex, sizeof(hex), "%02x", hash[i]);
     hash_str += hex;
   }
+  hash_span.end();
 
   if (hash_str != user.password_hash()) {
     return std::unexpected("Invalid email or password");
@@ -227,6 +352,7 @@ std::expected<std::tuple<std::string, User>, std::string> AuthService::loginEmai
 }
 
 std::expected<std::string, std::string> AuthService::validateToken(const std::string& token) {
+  common::TraceSpan span("jwt");
   try {
     auto decoded = jwt::decode(token);
     auto verifier = jwt::verify()
@@ -241,6 +367,7 @@ std::expected<std::string, std::string> AuthService::validateToken(const std::st
 }
 
 std::string AuthService::createToken(const std::string& user_id) {
+  common::TraceSpan span("jwt");
   const auto& auth = config::Config::getInstance().getAuth();
   return jwt::create()
     .set_issuer("jmanime_user_service")
@@ -264,6 +391,7 @@ std::expected<void, std::string> AuthService::sendEmailVerificationCode(const st
   std::string subject = "Email Verification Code";
   std::string body = "Your verification code is: " + code;
   
+  common::TraceSpan span("smtp");
   auto future = email_sender_->addTask(email, subject, body);
   
   // 等待邮件发送结果（可以设置超时）
@@ -1,4 +1,5 @@
 #pragma once
+#include <chrono>
 #include <string>
 #include <expected>
 #include <regex>
@@ -9,6 +10,13 @@
 #include "domain/email_sender.hpp"
 
 namespace user_service {
+// 发送验证码失败的原因; retry_after 非 0 时是发送频率限制 (重发间隔未到或窗口内次数用尽), 之后才能再次申请
+struct VerificationCodeError {
+  std::string message;
+  std::chrono::seconds retry_after{0};
+};
+
+// 各步骤 (redis、密码哈希、JWT、邮件) 的耗时记入当前请求的 common::RequestTrace, 由仓储记录 mysql 的耗时
 class AuthService {
 public:
   AuthService(std::shared_ptr<UserRepository> repository, std::shared_ptr<EmailSender> email_sender)
@@ -23,7 +31,7 @@ public:
                                                                             const std::string& password,
                                                                             const std::string& avatar);
 
-  std::expected<std::string, std::string> sendAndSaveEmailVerificationCode(const std::string& email, const std::string& type);
+  std::expected<std::string, VerificationCodeError> sendAndSaveEmailVerificationCode(const std::string& email, const std::string& type);
 
   // return token, user struct
   std::expected<std::tuple<std::string, User>, std::string> loginEmailPwd(const std::string& email,
@@ -38,8 +46,11 @@ public:
   std::expected<void, std::string> sendEmailVerificationCode(const std::string& email, const std::string& code);
 private:
   std::expected<std::string, std::string> generateVerificationCode(const std::string& email);
-  std::expected<void, std::string> saveVerificationCodeToRedis(const std::string& email, const std::string& code, const std::string& type);
-  std::expected<std::string, std::string> loadVerificationCodeFromRedis(const std::string& email, const std::string& type);
+  static std::string verificationCodeKey(const std::string& email, const std::string& type, const std::string& suffix = "");
+  // 以下均为一次往返的原子脚本: 登记验证码并限制发送频率; 校验并消费验证码, 同时统计输错次数
+  std::expected<void, VerificationCodeError> issueVerificationCode(const std::string& email, const std::string& code, const std::string& type);
+  std::expected<void, std::string> discardVerificationCode(const std::string& email, const std::string& type);
+  std::expected<void, std::string> consumeVerificationCode(const std::string& email, const std::string& code, const std::string& type);
 
   std::shared_ptr<UserRepository> repository_;
   std::shared_ptr<EmailSender> email_sender_;
@@ -1,6 +1,7 @@
 #include "mysql_user_repository.hpp"
 #include "common/config/config.hpp"
 #include "common/connection_pool/mysql_connection_pool.hpp"
+#include "common/restful/request_trace.hpp"
 #include <cassert>
 #include <cppconn/prepared_statement.h>
 #include <uuid/uuid.h>
@@ -17,7 +18,11 @@ bool MysqlUserRepository::save(const User& user) {
                      "VALUES (?, ?, ?, ?, ?, ?) ON DUPLICATE KEY UPDATE "
                      "email=?, username=?, password_hash=?, salt=?, avatar=?";
 
+  // 等待连接池和执行语句分开计时, 见 common::RequestTrace
+  common::TraceSpan pool_wait("mysql_pool");
   common::MySQLConnectionGuard conn_guard(common::MySQLConnectionPool::getInstance());
+  pool_wait.end();
+  common::TraceSpan query_span("mysql");
 
   MYSQL_STMT* stmt = mysql_stmt_init(conn_guard.get());
   if (!stmt) {
@@ -58,7 +63,10 @@ std::optional<User> MysqlUserRepository::findById(const std::string& id) {
   const char* query = "SELECT id, email, username, password_hash, salt, avatar "
                      "FROM users WHERE id = ?";
   
+  common::TraceSpan pool_wait("mysql_pool");
   common::MySQLConnectionGuard conn_guard(common::MySQLConnectionPool::getInstance());
+  pool_wait.end();
+  common::TraceSpan query_span("mysql");
   MYSQL_STMT* stmt = mysql_stmt_init(conn_guard.get());
   if (!stmt) {
     return std::nullopt;
@@ -150,7 +158,10 @@ std::optional<User> MysqlUserRepository::findByEmail(const std::string& email) {
   const char* query = "SELECT id, email, username, password_hash, salt, avatar "
                      "FROM users WHERE email = ?";
   
+  common::TraceSpan pool_wait("mysql_pool");
   common::MySQLConnectionGuard conn_guard(common::MySQLConnectionPool::getInstance());
+  pool_wait.end();
+  common::TraceSpan query_span("mysql");
   MYSQL_STMT* stmt = mysql_stmt_init(conn_guard.get());
   if (!stmt) {
     return std::nullopt;
@@ -1,74 +1,103 @@
 #include "rest_api_handler.hpp"
+#include <array>
+#include "common/restful/rate_limiter.hpp"
 
 namespace user_service {
 
+namespace {
+
+void writeTokenAndUser(common::JsonWriter &json, std::string_view message,
+                       const std::string &token, const User &user) {
+  json.beginObject()
+      .key("success").value(true)
+      .key("message").value(message)
+      .key("token").value(token)
+      .key("user").beginObject()
+          .key("id").value(user.id())
+          .key("email").value(user.email())
+          .key("username").value(user.username())
+          .key("avatar").value(user.avatar())
+      .endObject()
+      .endObject();
+}
+
+} // namespace
+
 RestApiHandler::RestApiHandler(std::shared_ptr<AuthService> auth_service)
-    : auth_service_(auth_service) {}
-
-http::response<http::string_body> RestApiHandler::doHandleRequest(
-    http::request<http::string_body,
-                  http::basic_fields<std::allocator<char>>> &&req) {
-  std::string target = std::string(req.target());
-
-  if (target == "/api/auth/register-validate-email" &&
-      req.method() == http::verb::post) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleRegisterValidateEmail(body);
-  } else if (target == "/api/auth/register" && req.method() == http::verb::post) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleRegister(body);
-  } else if (target == "/api/auth/login-email-pwd" &&
-             req.method() == http::verb::post) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleLoginEmailPwd(body);
-  } else if (target == "/api/auth/login-email-code" &&
-             req.method() == http::verb::post) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleLoginEmailCode(body);
-  } else if (target == "/api/auth/login-validate-email" &&
-             req.method() == http::verb::post) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleLoginValidateEmail(body);
-  } else if (target == "/api/auth/validate-token" &&
-             req.method() == http::verb::post) {
-    auto auth_header = req[http::field::authorization];
-    if (auth_header.empty()) {
-      return createErrorResponse(http::status::unauthorized,
-                                 "Missing authorization header");
-    }
+    : auth_service_(auth_service) {
+  // 除 validate-token 外的接口都会同步访问 mysql/redis/smtp 或做密码哈希, 标记为 blocking
+  router_
+      .add(http::verb::post, "/api/auth/register-validate-email",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleRegisterValidateEmail(body);
+           }, true)
+      .add(http::verb::post, "/api/auth/register",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleRegister(body);
+           }, true)
+      .add(http::verb::post, "/api/auth/login-email-pwd",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleLoginEmailPwd(body);
+           }, true)
+      .add(http::verb::post, "/api/auth/login-email-code",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleLoginEmailCode(body);
+           }, true)
+      .add(http::verb::post, "/api/auth/login-validate-email",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleLoginValidateEmail(body);
+           }, true)
+      .add(http::verb::post, "/api/auth/validate-token",
+           [this](common::RequestContext &ctx) {
+             auto auth_header = ctx.req[http::field::authorization];
+             if (auth_header.empty()) {
+               return createErrorResponse(http::status::unauthorized,
+                                          "Missing authorization header");
+             }
 
-    std::string token = std::string(auth_header);
-    if (token.starts_with("Bearer ")) {
-      token = token.substr(7);
-    }
+             std::string token = std::string(auth_header);
+             if (token.starts_with("Bearer ")) {
+               token = token.substr(7);
+             }
 
-    return handleValidateToken(token);
-  } else {
-    return createErrorResponse(http::status::not_found, "Endpoint not found");
-  }
+             return handleValidateToken(token);
+           });
+
+  // 登录和发送验证码的接口按 IP 和邮箱限流, 防止撞库和邮件轰炸
+  use(common::rateLimitMiddleware({"/api/auth/register-validate-email",
+                                   "/api/auth/login-email-pwd",
+                                   "/api/auth/login-email-code",
+                                   "/api/auth/login-validate-email"},
+                                  config::Config::getInstance().getRateLimit()));
 }
 
-http::response<http::string_body>
-RestApiHandler::handleRegisterValidateEmail(const nlohmann::json &body) {
+common::Response
+RestApiHandler::handleRegisterValidateEmail(common::JsonReader &body) {
   try {
-    if (!body.contains("email")) {
+    auto email = body.getString("email");
+    if (!email) {
       return createErrorResponse(http::status::bad_request,
                                  "Missing email field");
     }
 
-    std::string email = body["email"];
-    auto result =
-        auth_service_->sendAndSaveEmailVerificationCode(email, "register");
+    auto result = auth_service_->sendAndSaveEmailVerificationCode(
+        std::string(*email), "register");
 
     if (result) {
-      nlohmann::json response_json = {
-          {"success", true},
-          {"message", "Verification code sent successfully"},
-          {"code", result.value()} // 开发时返回验证码，生产环境应移除
-      };
-      return createJsonResponse(http::status::ok, response_json);
+      return writeJsonResponse(http::status::ok, [&](common::JsonWriter &json) {
+        json.beginObject()
+            .key("success").value(true)
+            .key("message").value("Verification code sent successfully")
+            .key("code").value(result.value()) // 开发时返回验证码，生产环境应移除
+            .endObject();
+      });
     } else {
-      return createErrorResponse(http::status::bad_request, result.error());
+      return verificationCodeError(result.error());
     }
   } catch (const std::exception &e) {
     return createErrorResponse(
@@ -77,27 +106,28 @@ RestApiHandler::handleRegisterValidateEmail(const nlohmann::json &body) {
   }
 }
 
-http::response<http::string_body>
-RestApiHandler::handleLoginValidateEmail(const nlohmann::json &body) {
+common::Response
+RestApiHandler::handleLoginValidateEmail(common::JsonReader &body) {
   try {
-    if (!body.contains("email")) {
+    auto email = body.getString("email");
+    if (!email) {
       return createErrorResponse(http::status::bad_request,
                                  "Missing email field");
     }
 
-    std::string email = body["email"];
-    auto result =
-        auth_service_->sendAndSaveEmailVerificationCode(email, "login");
+    auto result = auth_service_->sendAndSaveEmailVerificationCode(
+        std::string(*email), "login");
 
     if (result) {
-      nlohmann::json response_json = {
-          {"success", true},
-          {"message", "Verification code sent successfully"},
-          {"code", result.value()} // 开发时返回验证码，生产环境应移除
-      };
-      return createJsonResponse(http::status::ok, response_json);
+      return writeJsonResponse(http::status::ok, [&](common::JsonWriter &json) {
+        json.beginObject()
+            .key("success").value(true)
+            .key("message").value("Verification code sent successfully")
+            .key("code").value(result.value()) // 开发时返回验证码，生产环境应移除
+            .endObject();
+      });
     } else {
-      return createErrorResponse(http::status::bad_request, result.error());
+      return verificationCodeError(result.error());
     }
   } catch (const std::exception &e) {
     return createErrorResponse(
@@ -106,41 +136,43 @@ RestApiHandler::handleLoginValidateEmail(const nlohmann::json &body) {
   }
 }
 
-http::response<http::string_body>
-RestApiHandler::handleRegister(const nlohmann::json &body) {
+common::Response
+RestApiHandler::verificationCodeError(const VerificationCodeError &error) {
+  if (error.retry_after.count() == 0) {
+    return createErrorResponse(http::status::bad_request, error.message);
+  }
+  auto response = createErrorResponse(http::status::too_many_requests, error.message);
+  response.set(http::field::retry_after, std::to_string(error.retry_after.count()));
+  return response;
+}
+
+common::Response
+RestApiHandler::handleRegister(common::JsonReader &body) {
   try {
     // 验证必要字段
-    std::vector<std::string> required_fields = {"email", "verification_code",
-                                              "username", "password"};
-    for (const auto &field : required_fields) {
-      if (!body.contains(field)) {
+    constexpr std::array<std::string_view, 4> required_fields = {
+        "email", "verification_code", "username", "password"};
+    std::array<std::string, 4> values;
+    for (size_t i = 0; i < required_fields.size(); ++i) {
+      auto value = body.getString(required_fields[i]);
+      if (!value) {
         return createErrorResponse(http::status::bad_request,
-                                   "Missing field: " + field);
+                                   "Missing field: " + std::string(required_fields[i]));
       }
+      values[i] = *value;
     }
 
-    std::string email = body["email"];
-    std::string verification_code = body["verification_code"];
-    std::string username = body["username"];
-    std::string password = body["password"];
-    std::string avatar = body.value("avatar", "");
+    auto &[email, verification_code, username, password] = values;
+    std::string avatar(body.getString("avatar").value_or(""));
 
     auto result = auth_service_->registerAndStore(email, verification_code,
                                                   username, password, avatar);
 
     if (result) {
       auto [token, user] = result.value();
-      nlohmann::json response_json = {
-          {"success", true},
-          {"message", "User registered successfully"},
-          {"token", token},
-          {"user",
-           {{"id", user.id()},
-            {"email", user.email()},
-            {"username", user.username()},
-            {"avatar", user.avatar()}}},
-      };
-      return createJsonResponse(http::status::created, response_json);
+      return writeJsonResponse(http::status::created, [&](common::JsonWriter &json) {
+        writeTokenAndUser(json, "User registered successfully", token, user);
+      });
     } else {
       return createErrorResponse(http::status::bad_request, result.error());
     }
@@ -151,32 +183,24 @@ RestApiHandler::handleRegister(const nlohmann::json &body) {
   }
 }
 
-http::response<http::string_body>
-RestApiHandler::handleLoginEmailPwd(const nlohmann::json &body) {
+common::Response
+RestApiHandler::handleLoginEmailPwd(common::JsonReader &body) {
   try {
-    if (!body.contains("email") || !body.contains("password")) {
+    auto email = body.getString("email");
+    auto password = body.getString("password");
+    if (!email || !password) {
       return createErrorResponse(http::status::bad_request,
                                  "Missing email or password");
     }
 
-    std::string email = body["email"];
-    std::string password = body["password"];
-
-    auto result = auth_service_->loginEmailPwd(email, password);
+    auto result = auth_service_->loginEmailPwd(std::string(*email),
+                                               std::string(*password));
 
     if (result) {
       auto [token, user] = result.value();
-      nlohmann::json response_json = {
-          {"success", true},
-          {"message", "Login successful"},
-          {"token", token},
-          {"user",
-           {{"id", user.id()},
-            {"email", user.email()},
-            {"username", user.username()},
-            {"avatar", user.avatar()}}},
-      };
-      return createJsonResponse(http::status::ok, response_json);
+      return writeJsonResponse(http::status::ok, [&](common::JsonWriter &json) {
+        writeTokenAndUser(json, "Login successful", token, user);
+      });
     } else {
       return createErrorResponse(http::status::unauthorized, result.error());
     }
@@ -187,32 +211,24 @@ RestApiHandler::handleLoginEmailPwd(const nlohmann::json &body) {
   }
 }
 
-http::response<http::string_body>
-RestApiHandler::handleLoginEmailCode(const nlohmann::json &body) {
+common::Response
+RestApiHandler::handleLoginEmailCode(common::JsonReader &body) {
   try {
-    if (!body.contains("email") || !body.contains("code")) {
+    auto email = body.getString("email");
+    auto code = body.getString("code");
+    if (!email || !code) {
       return createErrorResponse(http::status::bad_request,
                                  "Missing email or code");
     }
 
-    std::string email = body["email"];
-    std::string code = body["code"];
-
-    auto result = auth_service_->loginEmailVeriCode(email, code);
+    auto result = auth_service_->loginEmailVeriCode(std::string(*email),
+                                                    std::string(*code));
 
     if (result) {
       auto [token, user] = result.value();
-      nlohmann::json response_json = {
-          {"success", true},
-          {"message", "Login successful"},
-          {"token", token},
-          {"user",
-           {{"id", user.id()},
-            {"email", user.email()},
-            {"username", user.username()},
-            {"avatar", user.avatar()}}},
-      };
-      return createJsonResponse(http::status::ok, response_json);
+      return writeJsonResponse(http::status::ok, [&](common::JsonWriter &json) {
+        writeTokenAndUser(json, "Login successful", token, user);
+      });
     } else {
       return createErrorResponse(http::status::unauthorized, result.error());
     }
@@ -223,16 +239,19 @@ RestApiHandler::handleLoginEmailCode(const nlohmann::json &body) {
   }
 }
 
-http::response<http::string_body>
+common::Response
 RestApiHandler::handleValidateToken(const std::string &token) {
   try {
     auto result = auth_service_->validateToken(token);
 
     if (result) {
-      nlohmann::json response_json = {{"success", true},
-                                      {"message", "Token is valid"},
-                                      {"user_id", result.value()}};
-      return createJsonResponse(http::status::ok, response_json);
+      return writeJsonResponse(http::status::ok, [&](common::JsonWriter &json) {
+        json.beginObject()
+            .key("success").value(true)
+            .key("message").value("Token is valid")
+            .key("user_id").value(result.value())
+            .endObject();
+      });
     } else {
       return createErrorResponse(http::status::unauthorized, result.error());
     }
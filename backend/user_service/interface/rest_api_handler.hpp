@@ -1,8 +1,8 @@
 #pragma once
 #include "application/auth_service.hpp"
+#include "common/restful/json_reader.hpp"
 #include "common/restful/rest_api_handler_base.hpp"
 #include <memory>
-#include <nlohmann/json.hpp>
 
 namespace user_service {
 
@@ -10,25 +10,23 @@ class RestApiHandler : public common::RestApiHandlerBase {
 public:
   RestApiHandler(std::shared_ptr<AuthService> auth_service);
 
-protected:
-  http::response<http::string_body> doHandleRequest(
-      http::request<http::string_body,
-                    http::basic_fields<std::allocator<char>>> &&req) override;
-
 private:
   std::shared_ptr<AuthService> auth_service_;
 
-  http::response<http::string_body>
-  handleRegisterValidateEmail(const nlohmann::json &body);
-  http::response<http::string_body> handleRegister(const nlohmann::json &body);
-  http::response<http::string_body>
-  handleLoginEmailPwd(const nlohmann::json &body);
-  http::response<http::string_body>
-  handleLoginEmailCode(const nlohmann::json &body);
-  http::response<http::string_body>
-  handleLoginValidateEmail(const nlohmann::json &body);
-  http::response<http::string_body>
+  common::Response
+  handleRegisterValidateEmail(common::JsonReader &body);
+  common::Response handleRegister(common::JsonReader &body);
+  common::Response
+  handleLoginEmailPwd(common::JsonReader &body);
+  common::Response
+  handleLoginEmailCode(common::JsonReader &body);
+  common::Response
+  handleLoginValidateEmail(common::JsonReader &body);
+  common::Response
   handleValidateToken(const std::string &token);
+  // 发送频率限制回复 429 + Retry-After (与限流中间件一致), 其余错误 400
+  common::Response
+  verificationCodeError(const VerificationCodeError &error);
 };
 
 
@@ -17,7 +17,7 @@ public:
     
     response->set_send_code_success(result.has_value());
     if (!result) {
-      response->set_message(result.error());
+      response->set_message(result.error().message);
     }
     return grpc::Status::OK;
   }
@@ -1,3 +1,4 @@
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <thread>
@@ -11,6 +12,7 @@
 #include "interface/rest_api_handler.hpp"
 #include "common/config/config.hpp"
 #include <sstream>
+#include <string_view>
 
 int main(int argc, char** argv) {
   try {
@@ -44,19 +46,49 @@ int main(int argc, char** argv) {
     std::cout << "gRPC Server listening on " << grpc_server_address.str() << std::endl;
 
     // 启动REST API服务器
-    boost::asio::io_context ioc{1};
-    
     // HTTP服务器监听在不同端口 (gRPC端口 + 1000)
     auto http_port = service_config.port + 1000;
     auto http_endpoint = boost::asio::ip::tcp::endpoint{
       boost::asio::ip::make_address(service_config.host), 
       static_cast<unsigned short>(http_port)
     };
+
+    // --io-threads=N 覆盖配置中的 io 线程数, --reuse-port 切换为每线程独立 acceptor, 便于压测对比
+    auto http_config = cfg.getHttpServer();
+    for (int i = 1; i < argc; ++i) {
+      std::string_view arg = argv[i];
+      if (arg.starts_with("--io-threads=")) {
+        http_config.io_threads = std::stoul(std::string(arg.substr(13)));
+      } else if (arg == "--reuse-port") {
+        http_config.reuse_port_per_thread = true;
+      }
+    }
     
+    // 访问日志由后台线程写出, 进程退出时 AccessLog 析构会写完剩余的记录
+    common::AccessLog::getInstance().open(cfg.getLog());
+
     auto api_handler = std::make_shared<user_service::RestApiHandler>(auth_service);
-    common::HttpServer http_server{ioc, http_endpoint, api_handler};
+    common::HttpServer http_server{http_endpoint, api_handler, http_config};
     
-    std::cout << "HTTP Server listening on " << service_config.host << ":" << http_port << std::endl;
+    std::cout << "HTTP Server listening on " << service_config.host << ":" << http_port
+              << " with " << http_config.io_threads << " io threads"
+              << (http_server.inherited() ? " (listeners taken over from the previous process)" : "") << std::endl;
+
+    // 第一次信号排空后退出, 排空期间再次收到信号时立即停止; 新进程接管监听 socket 时也会排空并退出
+    boost::asio::signal_set signals(http_server.ioContext(), SIGINT, SIGTERM);
+    std::function<void(const boost::system::error_code&, int)> on_signal =
+      [&](const boost::system::error_code& ec, int) {
+        if (ec) {
+          return;
+        }
+        if (http_server.draining()) {
+          http_server.stop();
+          return;
+        }
+        http_server.drain();
+        signals.async_wait(on_signal);
+      };
+    signals.async_wait(on_signal);
     
     // 在单独线程运行grpc服务器
     std::thread grpc_thread([&grpc_server]() {
@@ -64,11 +96,8 @@ int main(int argc, char** argv) {
     });
 
     http_server.run();
-    ioc.run();
-
-    // 主线程运行HTTP服务器
-    
-    ioc.stop();
+    http_server.join();
+    grpc_server->Shutdown();
 
     if (grpc_thread.joinable()) {
       grpc_thread.join();
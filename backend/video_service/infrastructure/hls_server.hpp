@@ -1,29 +1,48 @@
 #pragma once
 #include <string>
-#include <vector>
 #include <memory>
 #include <boost/asio.hpp>
-#include <boost/beast.hpp>
+#include "common/config/config.hpp"
+#include "common/restful/http_server.hpp"
+#include "common/restful/rest_api_handler_base.hpp"
 #include "domain/streaming_service.hpp"
 
 namespace video_service {
+
+// HLS 的播放列表 (.m3u8) 和分片 (.ts), 作为 common::HttpServer 上的路由
+// 分片以文件 body 写出, 不整个读入内存; async_file_io 时换成以 io_uring 读取的 AsyncFileSource,
+// 需要以 ENABLE_IO_URING 编译, 否则忽略。video_dir 在 HttpServer::run 之前设置
+class HlsApiHandler : public common::RestApiHandlerBase {
+public:
+  explicit HlsApiHandler(bool async_file_io = false);
+
+  void setVideoDir(std::string video_dir) { video_dir_ = std::move(video_dir); }
+
+private:
+  common::Response servePlaylist(common::RequestContext& ctx, const std::string& path);
+  common::Response serveSegment(common::RequestContext& ctx, const std::string& path);
+
+  std::string video_dir_;
+  bool async_file_io_;
+};
+
+// 超时、keep-alive、多线程、HTTP/2 等都由 common::HttpServer 提供
 class HlsServer : public StreamingService {
 public:
-  HlsServer(const std::string& address, unsigned short port);
+  HlsServer(const std::string& address, unsigned short port, bool async_file_io = false,
+            const config::HttpServerConfig& cfg = config::Config::getInstance().getHttpServer());
   
+  // 阻塞到 stopServer
   void startServer(const std::string& video_dir) override;
   void stopServer() override;
   std::string getStreamUrl(const std::string& video_id) override;
+  boost::asio::ip::tcp::endpoint localEndpoint() const { return server_.localEndpoint(); } // 端口为 0 时取实际绑定的端口
   
 private:
-  class Session;
-  void doAccept();
   void createPlaylist(const std::string& video_path);
   
-  boost::asio::io_context ioc_;
-  boost::asio::ip::tcp::acceptor acceptor_;
+  std::shared_ptr<HlsApiHandler> handler_;
+  common::HttpServer server_;
   std::string video_dir_;
-  bool running_;
-  std::vector<std::shared_ptr<Session>> sessions_;
 };
-}
\ No newline at end of file
+}
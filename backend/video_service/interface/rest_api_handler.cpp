@@ -3,38 +3,41 @@
 namespace video_service {
 
 RestApiHandler::RestApiHandler(std::shared_ptr<VideoService> video_service)
-    : video_service_(video_service) {}
-
-http::response<http::string_body> RestApiHandler::doHandleRequest(
-    http::request<http::string_body,
-                  http::basic_fields<std::allocator<char>>> &&req) {
-  std::string target = std::string(req.target());
-
-  if (target == "/api/video/upload" && req.method() == http::verb::post) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleUploadVideo(body);
-  } else if (target == "/api/video/info" && req.method() == http::verb::get) {
-    auto body = parseRequestBody(std::string(req.body()));
-    return handleGetVideoInfo(body);
-  } else {
-    return createErrorResponse(http::status::not_found, "Endpoint not found");
-  }
+    : video_service_(video_service) {
+  // 上传会下载并转码视频, 标记为 blocking
+  router_
+      .add(http::verb::post, "/api/video/upload",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleUploadVideo(body);
+           }, true)
+      .add(http::verb::get, "/api/video/info",
+           [this](common::RequestContext &ctx) {
+             common::JsonReader body(ctx.req.body());
+             return handleGetVideoInfo(body);
+           });
 }
 
-http::response<http::string_body>
-RestApiHandler::handleUploadVideo(const nlohmann::json &body) {
+common::Response
+RestApiHandler::handleUploadVideo(common::JsonReader &body) {
   // Placeholder implementation
-  nlohmann::json response_json = {{"success", true},
-                                  {"message", "Video upload started"}};
-  return createJsonResponse(http::status::ok, response_json);
+  return writeJsonResponse(http::status::ok, [](common::JsonWriter &json) {
+    json.beginObject()
+        .key("success").value(true)
+        .key("message").value("Video upload started")
+        .endObject();
+  });
 }
 
-http::response<http::string_body>
-RestApiHandler::handleGetVideoInfo(const nlohmann::json &body) {
+common::Response
+RestApiHandler::handleGetVideoInfo(common::JsonReader &body) {
   // Placeholder implementation
-  nlohmann::json response_json = {{"success", true},
-                                  {"video_title", "Example Video"}};
-  return createJsonResponse(http::status::ok, response_json);
+  return writeJsonResponse(http::status::ok, [](common::JsonWriter &json) {
+    json.beginObject()
+        .key("success").value(true)
+        .key("video_title").value("Example Video")
+        .endObject();
+  });
 }
 
 } // namespace video_service
@@ -8,6 +8,7 @@
 #include "interface/rest_api_handler.hpp"
 #include <grpcpp/server_builder.h>
 #include <filesystem>
+#include <functional>
 #include <sstream>
 #include <thread>
 #include <boost/asio.hpp>
@@ -34,7 +35,8 @@ int main(int argc, char** argv) {
   std::shared_ptr<video_service::StreamingService> streaming_service = 
     std::make_shared<video_service::HlsServer>(
       streaming_config.host,
-      streaming_config.port
+      streaming_config.port,
+      streaming_config.async_file_io
     );
   
   std::shared_ptr<video_service::TranscodingService> transcoding_service = 
@@ -58,19 +60,37 @@ int main(int argc, char** argv) {
   std::cout << "gRPC Server listening on " << grpc_server_address.str() << std::endl;
 
   // Start REST API server
-  boost::asio::io_context ioc{1};
   auto http_port = service_config.port + 1000;
   auto http_endpoint = boost::asio::ip::tcp::endpoint{
     boost::asio::ip::make_address(service_config.host), 
     static_cast<unsigned short>(http_port)
   };
 
+  common::AccessLog::getInstance().open(cfg.getLog());
+
   auto api_handler = std::make_shared<video_service::RestApiHandler>(video_service);
-  common::HttpServer http_server{ioc, http_endpoint, api_handler};
+  common::HttpServer http_server{http_endpoint, api_handler, cfg.getHttpServer()};
+
+  std::cout << "HTTP Server listening on " << service_config.host << ":" << http_port
+            << (http_server.inherited() ? " (listeners taken over from the previous process)" : "") << std::endl;
 
-  std::cout << "HTTP Server listening on " << service_config.host << ":" << http_port << std::endl;
+  // 第一次信号排空后退出, 排空期间再次收到信号时立即停止; 新进程接管监听 socket 时也会排空并退出
+  boost::asio::signal_set signals(http_server.ioContext(), SIGINT, SIGTERM);
+  std::function<void(const boost::system::error_code&, int)> on_signal =
+    [&](const boost::system::error_code& ec, int) {
+      if (ec) {
+        return;
+      }
+      if (http_server.draining()) {
+        http_server.stop();
+        return;
+      }
+      http_server.drain();
+      signals.async_wait(on_signal);
+    };
+  signals.async_wait(on_signal);
 
-  std::thread http_thread([&ioc, &http_server]() {
+  std::thread grpc_thread([&grpc_server]() {
     grpc_server->Wait();
   });
   
@@ -80,16 +100,15 @@ int main(int argc, char** argv) {
   });
   
   http_server.run();
-  ioc.run();
+  http_server.join();
+  grpc_server->Shutdown();
   
   // Stop HLS server
   streaming_service->stopServer();
   hls_thread.join();
 
-  // Stop HTTP server
-  ioc.stop();
-  if (http_thread.joinable()) {
-    http_thread.join();
+  if (grpc_thread.joinable()) {
+    grpc_thread.join();
   }
   
   return 0;
@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+# 对比 HttpServer 在不同 io 线程数下的吞吐与延迟
+# 用法: ./compare_io_threads.sh <user_service可执行文件> [wrk脚本] [url]
+# 例如: ./compare_io_threads.sh ../build/user_service/user_service test_login_pwd.wrk
+# SERVER_FLAGS=--reuse-port 时对比每线程 SO_REUSEPORT acceptor 模式
+# BENCH_HTTP=<bench_http可执行文件> 时改用开环压测: 以固定速率 RATE 发送登录请求 (wrk 是闭环的, 服务端变慢时
+# 发送随之变慢, 尾延迟偏低), 延迟修正了 coordinated omission, 每组结果另存为 io_threads_<N>.json
+set -euo pipefail
+
+BIN=${1:?"usage: $0 <user_service binary> [wrk script] [url]"}
+SCRIPT=${2:-"$(dirname "$0")/test_login_pwd.wrk"}
+URL=${3:-"http://127.0.0.1:51051/api/auth/login-email-pwd"}
+WRK_THREADS=${WRK_THREADS:-8}
+WRK_CONNECTIONS=${WRK_CONNECTIONS:-256}
+DURATION=${DURATION:-30s}
+RATE=${RATE:-5000}
+
+if [[ -z "${BENCH_HTTP:-}" ]] && ! command -v wrk > /dev/null; then
+  echo "wrk not found; install wrk or set BENCH_HTTP=<bench_http binary>" >&2
+  exit 1
+fi
+# 压测客户端与服务端在同一台机器上时, io 线程数超过空闲核数后的结果主要反映争抢 CPU
+echo "cpus: $(nproc)"
+printf "%-10s %-14s %-10s %-10s %-10s\n" "io_threads" "requests/sec" "p50" "p99" "errors"
+for threads in 1 4 16; do
+  "$BIN" --io-threads="$threads" ${SERVER_FLAGS:-} > /dev/null 2>&1 &
+  pid=$!
+  trap 'kill $pid 2>/dev/null || true' EXIT
+  sleep 2
+
+  if [[ -n "${BENCH_HTTP:-}" ]]; then
+    out=$("$BENCH_HTTP" --api="$URL" --rate="$RATE" --duration="${DURATION%s}" --connections="$WRK_CONNECTIONS" \
+      --threads="$WRK_THREADS" --mix=login:100 --json="io_threads_$threads.json")
+    rps=$(awk '$1 == "all" {print $3}' <<< "$out")
+    p50=$(awk '$1 == "all" {print $5 "us"}' <<< "$out")
+    p99=$(awk '$1 == "all" {print $7 "us"}' <<< "$out")
+    errors=$(awk '$1 == "all" {print $4}' <<< "$out")
+  else
+    out=$(wrk -t"$WRK_THREADS" -c"$WRK_CONNECTIONS" -d"$DURATION" --latency -s "$SCRIPT" "$URL")
+    rps=$(awk '/Requests\/sec/ {print $2}' <<< "$out")
+    p50=$(awk '$1 == "50%" {print $2}' <<< "$out")
+    p99=$(awk '$1 == "99%" {print $2}' <<< "$out")
+    errors=$(awk '/Non-2xx|Socket errors/ {printf "%s ", $0}' <<< "$out")
+  fi
+  printf "%-10s %-14s %-10s %-10s %-10s\n" "$threads" "$rps" "$p50" "$p99" "${errors:-0}"
+
+  kill -INT $pid
+  wait $pid || true
+  trap - EXIT
+done